@@ -15,6 +15,7 @@
  */
 
 #include "apr_arch_atomic.h"
+#include "apr_thread_proc.h"
 
 #include <stdlib.h>
 
@@ -76,3 +77,107 @@ APR_DECLARE(void*) apr_atomic_xchgptr(void *volatile *mem, void *with)
 {
     return (void*)atomic_xchg((unsigned long *)mem,(unsigned long)with);
 }
+
+APR_DECLARE(apr_uint32_t) apr_atomic_or32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+    apr_uint32_t old, cmp = *mem;
+
+    while ((old = apr_atomic_cas32(mem, cmp | val, cmp)) != cmp) {
+        cmp = old;
+    }
+    return old;
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_and32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+    apr_uint32_t old, cmp = *mem;
+
+    while ((old = apr_atomic_cas32(mem, cmp & val, cmp)) != cmp) {
+        cmp = old;
+    }
+    return old;
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_read32_ex(volatile apr_uint32_t *mem,
+                                               apr_atomic_order_e order)
+{
+    return apr_atomic_read32(mem);
+}
+
+APR_DECLARE(void) apr_atomic_set32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                      apr_atomic_order_e order)
+{
+    apr_atomic_set32(mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_add32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                              apr_atomic_order_e order)
+{
+    return apr_atomic_add32(mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_cas32_ex(volatile apr_uint32_t *mem, apr_uint32_t with,
+                                              apr_uint32_t cmp,
+                                              apr_atomic_order_e order)
+{
+    return apr_atomic_cas32(mem, with, cmp);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_xchg32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                               apr_atomic_order_e order)
+{
+    return apr_atomic_xchg32(mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_or32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                             apr_atomic_order_e order)
+{
+    return apr_atomic_or32(mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_and32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                              apr_atomic_order_e order)
+{
+    return apr_atomic_and32(mem, val);
+}
+
+APR_DECLARE(void*) apr_atomic_casptr_ex(void *volatile *mem, void *with, const void *cmp,
+                                        apr_atomic_order_e order)
+{
+    return apr_atomic_casptr(mem, with, cmp);
+}
+
+APR_DECLARE(void*) apr_atomic_xchgptr_ex(void *volatile *mem, void *with,
+                                         apr_atomic_order_e order)
+{
+    return apr_atomic_xchgptr(mem, with);
+}
+
+/* No double-width CAS, emulated with a spinlock */
+static volatile apr_uint32_t tagptr_lock;
+
+APR_DECLARE(int) apr_atomic_castagptr(volatile apr_atomic_tagptr_t *mem,
+                                      apr_atomic_tagptr_t *cmp,
+                                      const apr_atomic_tagptr_t *with)
+{
+    int ok;
+
+    while (apr_atomic_xchg32(&tagptr_lock, 1)) {
+        while (tagptr_lock) {
+            apr_thread_yield();
+        }
+    }
+
+    ok = (mem->ptr == cmp->ptr && mem->tag == cmp->tag);
+    if (ok) {
+        mem->ptr = with->ptr;
+        mem->tag = with->tag;
+    }
+    else {
+        cmp->ptr = mem->ptr;
+        cmp->tag = mem->tag;
+    }
+
+    apr_atomic_xchg32(&tagptr_lock, 0);
+    return ok;
+}
@@ -136,4 +136,165 @@ APR_DECLARE(void*) apr_atomic_xchgptr(void *volatile *mem, void *ptr)
 #endif
 }
 
+APR_DECLARE(apr_uint32_t) apr_atomic_or32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+#if HAVE__ATOMIC_BUILTINS
+    return __atomic_fetch_or(mem, val, __ATOMIC_SEQ_CST);
+#else
+    return __sync_fetch_and_or(mem, val);
+#endif
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_and32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+#if HAVE__ATOMIC_BUILTINS
+    return __atomic_fetch_and(mem, val, __ATOMIC_SEQ_CST);
+#else
+    return __sync_fetch_and_and(mem, val);
+#endif
+}
+
+#if HAVE__ATOMIC_BUILTINS
+
+#define LOAD(mo)      rv = __atomic_load_n(mem, mo)
+#define STORE(mo)     __atomic_store_n(mem, val, mo)
+#define ADD(mo)       rv = __atomic_fetch_add(mem, val, mo)
+#define CAS(mo, fmo)  __atomic_compare_exchange_n(mem, &cmp, with, 0, mo, fmo)
+#define XCHG(mo)      rv = __atomic_exchange_n(mem, val, mo)
+#define OR(mo)        rv = __atomic_fetch_or(mem, val, mo)
+#define AND(mo)       rv = __atomic_fetch_and(mem, val, mo)
+
+APR_DECLARE(apr_uint32_t) apr_atomic_read32_ex(volatile apr_uint32_t *mem,
+                                               apr_atomic_order_e order)
+{
+    apr_uint32_t rv;
+    APR__ATOMIC_LOAD_ORDERED(order, LOAD)
+    return rv;
+}
+
+APR_DECLARE(void) apr_atomic_set32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                      apr_atomic_order_e order)
+{
+    APR__ATOMIC_STORE_ORDERED(order, STORE)
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_add32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                              apr_atomic_order_e order)
+{
+    apr_uint32_t rv;
+    APR__ATOMIC_ORDERED(order, ADD)
+    return rv;
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_cas32_ex(volatile apr_uint32_t *mem, apr_uint32_t with,
+                                              apr_uint32_t cmp,
+                                              apr_atomic_order_e order)
+{
+    APR__ATOMIC_CAS_ORDERED(order, CAS)
+    return cmp;
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_xchg32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                               apr_atomic_order_e order)
+{
+    apr_uint32_t rv;
+    APR__ATOMIC_ORDERED(order, XCHG)
+    return rv;
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_or32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                             apr_atomic_order_e order)
+{
+    apr_uint32_t rv;
+    APR__ATOMIC_ORDERED(order, OR)
+    return rv;
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_and32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                              apr_atomic_order_e order)
+{
+    apr_uint32_t rv;
+    APR__ATOMIC_ORDERED(order, AND)
+    return rv;
+}
+
+APR_DECLARE(void*) apr_atomic_casptr_ex(void *volatile *mem, void *with, const void *cmp,
+                                        apr_atomic_order_e order)
+{
+#define CASPTR(mo, fmo) \
+    __atomic_compare_exchange_n(mem, (void *)&cmp, with, 0, mo, fmo)
+    APR__ATOMIC_CAS_ORDERED(order, CASPTR)
+    return (void *)cmp;
+}
+
+APR_DECLARE(void*) apr_atomic_xchgptr_ex(void *volatile *mem, void *with,
+                                         apr_atomic_order_e order)
+{
+    void *rv;
+#define XCHGPTR(mo) rv = __atomic_exchange_n(mem, with, mo)
+    APR__ATOMIC_ORDERED(order, XCHGPTR)
+    return rv;
+}
+
+#else /* !HAVE__ATOMIC_BUILTINS */
+
+/* The __sync builtins are all full barriers */
+
+APR_DECLARE(apr_uint32_t) apr_atomic_read32_ex(volatile apr_uint32_t *mem,
+                                               apr_atomic_order_e order)
+{
+    return apr_atomic_read32(mem);
+}
+
+APR_DECLARE(void) apr_atomic_set32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                      apr_atomic_order_e order)
+{
+    apr_atomic_set32(mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_add32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                              apr_atomic_order_e order)
+{
+    return __sync_fetch_and_add(mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_cas32_ex(volatile apr_uint32_t *mem, apr_uint32_t with,
+                                              apr_uint32_t cmp,
+                                              apr_atomic_order_e order)
+{
+    return __sync_val_compare_and_swap(mem, cmp, with);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_xchg32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                               apr_atomic_order_e order)
+{
+    return apr_atomic_xchg32(mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_or32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                             apr_atomic_order_e order)
+{
+    return __sync_fetch_and_or(mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_and32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                              apr_atomic_order_e order)
+{
+    return __sync_fetch_and_and(mem, val);
+}
+
+APR_DECLARE(void*) apr_atomic_casptr_ex(void *volatile *mem, void *with, const void *cmp,
+                                        apr_atomic_order_e order)
+{
+    return (void *)__sync_val_compare_and_swap(mem, (void *)cmp, with);
+}
+
+APR_DECLARE(void*) apr_atomic_xchgptr_ex(void *volatile *mem, void *with,
+                                         apr_atomic_order_e order)
+{
+    return apr_atomic_xchgptr(mem, with);
+}
+
+#endif /* HAVE__ATOMIC_BUILTINS */
+
 #endif /* USE_ATOMICS_BUILTINS */
@@ -107,4 +107,135 @@ APR_DECLARE(apr_uint64_t) apr_atomic_xchg64(volatile apr_uint64_t *mem, apr_uint
 #endif
 }
 
+APR_DECLARE(apr_uint64_t) apr_atomic_or64(volatile apr_uint64_t *mem, apr_uint64_t val)
+{
+#if HAVE__ATOMIC_BUILTINS64
+    return __atomic_fetch_or(mem, val, __ATOMIC_SEQ_CST);
+#else
+    return __sync_fetch_and_or(mem, val);
+#endif
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_and64(volatile apr_uint64_t *mem, apr_uint64_t val)
+{
+#if HAVE__ATOMIC_BUILTINS64
+    return __atomic_fetch_and(mem, val, __ATOMIC_SEQ_CST);
+#else
+    return __sync_fetch_and_and(mem, val);
+#endif
+}
+
+#if HAVE__ATOMIC_BUILTINS64
+
+#define LOAD(mo)      rv = __atomic_load_n(mem, mo)
+#define STORE(mo)     __atomic_store_n(mem, val, mo)
+#define ADD(mo)       rv = __atomic_fetch_add(mem, val, mo)
+#define CAS(mo, fmo)  __atomic_compare_exchange_n(mem, &cmp, with, 0, mo, fmo)
+#define XCHG(mo)      rv = __atomic_exchange_n(mem, val, mo)
+#define OR(mo)        rv = __atomic_fetch_or(mem, val, mo)
+#define AND(mo)       rv = __atomic_fetch_and(mem, val, mo)
+
+APR_DECLARE(apr_uint64_t) apr_atomic_read64_ex(volatile apr_uint64_t *mem,
+                                               apr_atomic_order_e order)
+{
+    apr_uint64_t rv;
+    APR__ATOMIC_LOAD_ORDERED(order, LOAD)
+    return rv;
+}
+
+APR_DECLARE(void) apr_atomic_set64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                      apr_atomic_order_e order)
+{
+    APR__ATOMIC_STORE_ORDERED(order, STORE)
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_add64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                              apr_atomic_order_e order)
+{
+    apr_uint64_t rv;
+    APR__ATOMIC_ORDERED(order, ADD)
+    return rv;
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_cas64_ex(volatile apr_uint64_t *mem, apr_uint64_t with,
+                                              apr_uint64_t cmp,
+                                              apr_atomic_order_e order)
+{
+    APR__ATOMIC_CAS_ORDERED(order, CAS)
+    return cmp;
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_xchg64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                               apr_atomic_order_e order)
+{
+    apr_uint64_t rv;
+    APR__ATOMIC_ORDERED(order, XCHG)
+    return rv;
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_or64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                             apr_atomic_order_e order)
+{
+    apr_uint64_t rv;
+    APR__ATOMIC_ORDERED(order, OR)
+    return rv;
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_and64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                              apr_atomic_order_e order)
+{
+    apr_uint64_t rv;
+    APR__ATOMIC_ORDERED(order, AND)
+    return rv;
+}
+
+#else /* !HAVE__ATOMIC_BUILTINS64 */
+
+/* The __sync builtins are all full barriers */
+
+APR_DECLARE(apr_uint64_t) apr_atomic_read64_ex(volatile apr_uint64_t *mem,
+                                               apr_atomic_order_e order)
+{
+    return apr_atomic_read64(mem);
+}
+
+APR_DECLARE(void) apr_atomic_set64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                      apr_atomic_order_e order)
+{
+    apr_atomic_set64(mem, val);
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_add64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                              apr_atomic_order_e order)
+{
+    return __sync_fetch_and_add(mem, val);
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_cas64_ex(volatile apr_uint64_t *mem, apr_uint64_t with,
+                                              apr_uint64_t cmp,
+                                              apr_atomic_order_e order)
+{
+    return __sync_val_compare_and_swap(mem, cmp, with);
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_xchg64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                               apr_atomic_order_e order)
+{
+    return apr_atomic_xchg64(mem, val);
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_or64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                             apr_atomic_order_e order)
+{
+    return __sync_fetch_and_or(mem, val);
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_and64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                              apr_atomic_order_e order)
+{
+    return __sync_fetch_and_and(mem, val);
+}
+
+#endif /* HAVE__ATOMIC_BUILTINS64 */
+
 #endif /* USE_ATOMICS_BUILTINS64 */
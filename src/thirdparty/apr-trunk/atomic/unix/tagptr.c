@@ -0,0 +1,106 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_arch_atomic.h"
+#include "apr_thread_proc.h"
+
+#if APR_HAS_ATOMIC_DWCAS && defined(__GNUC__) && defined(__x86_64__)
+
+APR_DECLARE(int) apr_atomic_castagptr(volatile apr_atomic_tagptr_t *mem,
+                                      apr_atomic_tagptr_t *cmp,
+                                      const apr_atomic_tagptr_t *with)
+{
+    char ok;
+
+    __asm__ __volatile__ ("lock; cmpxchg16b %1; setz %0"
+                          : "=q" (ok), "+m" (*mem),
+                            "+a" (cmp->ptr), "+d" (cmp->tag)
+                          : "b" (with->ptr), "c" (with->tag)
+                          : "memory", "cc");
+    return ok;
+}
+
+#elif APR_HAS_ATOMIC_DWCAS
+
+#if APR_SIZEOF_VOIDP == 8
+typedef unsigned __int128 tagptr_word_t;
+#else
+typedef apr_uint64_t tagptr_word_t;
+#endif
+
+typedef union tagptr_u {
+    apr_atomic_tagptr_t tp;
+    tagptr_word_t w;
+} tagptr_u;
+
+APR_DECLARE(int) apr_atomic_castagptr(volatile apr_atomic_tagptr_t *mem,
+                                      apr_atomic_tagptr_t *cmp,
+                                      const apr_atomic_tagptr_t *with)
+{
+    tagptr_u c, w, old;
+
+    c.tp = *cmp;
+    w.tp = *with;
+    old.w = __sync_val_compare_and_swap((volatile tagptr_word_t *)mem,
+                                        c.w, w.w);
+    if (old.w == c.w) {
+        return 1;
+    }
+    *cmp = old.tp;
+    return 0;
+}
+
+#else /* !APR_HAS_ATOMIC_DWCAS */
+
+/* Emulated with spinlocks, hashed by address so that unrelated tagged
+ * pointers rarely share one; the critical section is a few loads and
+ * stores.
+ */
+#define TAGPTR_LOCKS 64
+
+static volatile apr_uint32_t tagptr_locks[TAGPTR_LOCKS];
+
+APR_DECLARE(int) apr_atomic_castagptr(volatile apr_atomic_tagptr_t *mem,
+                                      apr_atomic_tagptr_t *cmp,
+                                      const apr_atomic_tagptr_t *with)
+{
+    volatile apr_uint32_t *lock;
+    int ok;
+
+    lock = &tagptr_locks[(((apr_uintptr_t)mem) >> 4) % TAGPTR_LOCKS];
+    while (apr_atomic_xchg32(lock, 1)) {
+        while (apr_atomic_read32(lock)) {
+#if APR_HAS_THREADS
+            apr_thread_yield();
+#endif
+        }
+    }
+
+    ok = (mem->ptr == cmp->ptr && mem->tag == cmp->tag);
+    if (ok) {
+        mem->ptr = with->ptr;
+        mem->tag = with->tag;
+    }
+    else {
+        cmp->ptr = mem->ptr;
+        cmp->tag = mem->tag;
+    }
+
+    apr_atomic_set32(lock, 0);
+    return ok;
+}
+
+#endif /* APR_HAS_ATOMIC_DWCAS */
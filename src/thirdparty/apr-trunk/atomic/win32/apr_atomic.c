@@ -105,3 +105,92 @@ APR_DECLARE(void*) apr_atomic_xchgptr(void *volatile *mem, void *with)
 {
     return InterlockedExchangePointer(mem, with);
 }
+
+APR_DECLARE(apr_uint32_t) apr_atomic_or32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+    return InterlockedOr((long volatile *)mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_and32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+    return InterlockedAnd((long volatile *)mem, val);
+}
+
+/* The Interlocked functions are all full barriers */
+
+APR_DECLARE(apr_uint32_t) apr_atomic_read32_ex(volatile apr_uint32_t *mem,
+                                               apr_atomic_order_e order)
+{
+    return apr_atomic_read32(mem);
+}
+
+APR_DECLARE(void) apr_atomic_set32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                      apr_atomic_order_e order)
+{
+    apr_atomic_set32(mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_add32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                              apr_atomic_order_e order)
+{
+    return apr_atomic_add32(mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_cas32_ex(volatile apr_uint32_t *mem, apr_uint32_t with,
+                                              apr_uint32_t cmp,
+                                              apr_atomic_order_e order)
+{
+    return apr_atomic_cas32(mem, with, cmp);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_xchg32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                               apr_atomic_order_e order)
+{
+    return apr_atomic_xchg32(mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_or32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                             apr_atomic_order_e order)
+{
+    return apr_atomic_or32(mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_and32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                              apr_atomic_order_e order)
+{
+    return apr_atomic_and32(mem, val);
+}
+
+APR_DECLARE(void*) apr_atomic_casptr_ex(void *volatile *mem, void *with, const void *cmp,
+                                        apr_atomic_order_e order)
+{
+    return apr_atomic_casptr(mem, with, cmp);
+}
+
+APR_DECLARE(void*) apr_atomic_xchgptr_ex(void *volatile *mem, void *with,
+                                         apr_atomic_order_e order)
+{
+    return apr_atomic_xchgptr(mem, with);
+}
+
+APR_DECLARE(int) apr_atomic_castagptr(volatile apr_atomic_tagptr_t *mem,
+                                      apr_atomic_tagptr_t *cmp,
+                                      const apr_atomic_tagptr_t *with)
+{
+#if defined(_WIN64)
+    return InterlockedCompareExchange128((LONG64 volatile *)mem,
+                                         (LONG64)with->tag,
+                                         (LONG64)with->ptr,
+                                         (LONG64 *)cmp);
+#else
+    LONG64 c = *(LONG64 *)cmp, old;
+
+    old = InterlockedCompareExchange64((LONG64 volatile *)mem,
+                                       *(const LONG64 *)with, c);
+    if (old == c) {
+        return 1;
+    }
+    *(LONG64 *)cmp = old;
+    return 0;
+#endif
+}
@@ -558,6 +558,7 @@ class APREnv(Environment):
     subst['@have_proc_invoked@'] = 0
     subst['@aprlfs@'] = 0
     subst['@osuuid@'] = subst['@have_uuid_generate@'] or subst['@have_uuid_create@']
+    subst['@hasatomicdwcas@'] = 0
     subst['@file_as_socket@'] = 1
 
     # check for IPv6 (the user is allowed to disable this via commandline
@@ -623,6 +624,12 @@ class APREnv(Environment):
       subst['@hasprocpthreadser@'] = 1
     else:
       subst['@hasprocpthreadser@'] = 0
+
+    if conf.CheckCHeader('linux/futex.h') and \
+        conf.CheckCHeader('sys/syscall.h'):
+      subst['@hasfutexser@'] = 1
+    else:
+      subst['@hasfutexser@'] = 0
     
     
     subst['@havemmaptmp@'] = 0
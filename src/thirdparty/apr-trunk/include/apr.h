@@ -297,6 +297,7 @@ extern "C" {
 #define APR_HAS_POSIXSEM_SERIALIZE        0
 #define APR_HAS_FCNTL_SERIALIZE           0
 #define APR_HAS_PROC_PTHREAD_SERIALIZE    0
+#define APR_HAS_FUTEX_SERIALIZE           0
 
 #define APR_PROCESS_LOCK_IS_GLOBAL        0
 
@@ -343,6 +344,7 @@ extern "C" {
 #define APR_HAS_LARGE_FILES       1
 #define APR_HAS_XTHREAD_FILES     1
 #define APR_HAS_OS_UUID           1
+#define APR_HAS_ATOMIC_DWCAS      1
 
 #define APR_PROCATTR_USER_SET_REQUIRES_PASSWORD 1
 
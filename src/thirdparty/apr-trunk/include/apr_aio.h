@@ -0,0 +1,315 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_AIO_H
+#define APR_AIO_H
+/**
+ * @file apr_aio.h
+ * @brief APR Asynchronous I/O interface
+ */
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_file_io.h"
+#include "apr_network_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_aio Asynchronous I/O Routines
+ * @ingroup APR
+ *
+ * Completion based I/O: operations are queued on an apr_aio_t, submitted
+ * all together by the next apr_aio_submit() or apr_aio_poll(), and their
+ * completions are collected by apr_aio_poll(), either through the
+ * callback given with the operation or in the array it returns.
+ *
+ * An apr_aio_t is not thread-safe, it is meant to be driven by a single
+ * thread (e.g. one per core).
+ * @{
+ */
+
+/** Opaque structure used for the asynchronous I/O */
+typedef struct apr_aio_t apr_aio_t;
+
+/**
+ * Asynchronous operations
+ */
+typedef enum {
+    APR_AIO_RECV,               /**< apr_aio_recv() */
+    APR_AIO_SEND,               /**< apr_aio_send() */
+    APR_AIO_READ,               /**< apr_aio_read() */
+    APR_AIO_WRITE,              /**< apr_aio_write() */
+    APR_AIO_ACCEPT,             /**< apr_aio_accept() */
+    APR_AIO_CONNECT             /**< apr_aio_connect() */
+} apr_aio_op_e;
+
+/** @see apr_aio_completion_t */
+typedef struct apr_aio_completion_t apr_aio_completion_t;
+
+/**
+ * Function prototype for the completion callbacks.
+ * @param baton The baton given with the operation
+ * @param completion The completed operation
+ * @return Anything but APR_SUCCESS stops apr_aio_poll() which returns
+ *         that status, the remaining completions are left for the next
+ *         call.
+ */
+typedef apr_status_t (*apr_aio_cb_t)(void *baton,
+                                     apr_aio_completion_t *completion);
+
+/** A completed operation */
+struct apr_aio_completion_t {
+    /** The operation */
+    apr_aio_op_e op;
+    /** Its result, APR_EOF when a RECV or READ reaches the end */
+    apr_status_t status;
+    /** The number of bytes received, sent, read or written */
+    apr_size_t len;
+    /** The socket of a RECV, SEND, ACCEPT or CONNECT */
+    apr_socket_t *sock;
+    /** The file of a READ or WRITE */
+    apr_file_t *file;
+    /** The buffer of a RECV, SEND, READ or WRITE */
+    void *buf;
+    /** The new socket of a successful ACCEPT */
+    apr_socket_t *accepted;
+    /** The callback given with the operation */
+    apr_aio_cb_t cb;
+    /** The baton given with the operation */
+    void *baton;
+};
+
+/**
+ * Create an asynchronous I/O object.
+ * @param aio The pointer in which to return the newly created object
+ * @param size The maximum number of operations in flight, and of
+ *        descriptors registered with apr_aio_socket_register() and
+ *        apr_aio_file_register()
+ * @param p The pool from which to allocate the object
+ * @remark The operations in flight when @a p is cleared are cancelled,
+ *         and waited for before its subpools are destroyed, so their
+ *         buffers may come from those subpools.
+ * @remark Receives, sends, reads and writes transfer at most
+ *         APR_UINT32_MAX bytes each, longer ones complete short.
+ * @remark Only supported with io_uring (Linux 5.11 or later), this call
+ *         fails with APR_ENOTIMPL elsewhere.
+ */
+APR_DECLARE(apr_status_t) apr_aio_create(apr_aio_t **aio,
+                                         apr_uint32_t size,
+                                         apr_pool_t *p);
+
+/**
+ * Queue a receive on a socket.
+ * @param aio The asynchronous I/O object
+ * @param sock The socket to receive from
+ * @param buf The buffer to fill, up to @a len bytes
+ * @param len The size of @a buf
+ * @param cb The callback for the completion, or NULL to have it returned
+ *        by apr_aio_poll()
+ * @param baton The baton for @a cb, or for the completion
+ * @return APR_EAGAIN if @a size operations are already in flight
+ * @remark @a buf must stay valid until the operation completes.
+ */
+APR_DECLARE(apr_status_t) apr_aio_recv(apr_aio_t *aio, apr_socket_t *sock,
+                                       char *buf, apr_size_t len,
+                                       apr_aio_cb_t cb, void *baton);
+
+/**
+ * Queue a send on a socket.
+ * @param aio The asynchronous I/O object
+ * @param sock The socket to send to
+ * @param buf The data to send
+ * @param len The length of @a buf
+ * @param cb The callback for the completion, or NULL to have it returned
+ *        by apr_aio_poll()
+ * @param baton The baton for @a cb, or for the completion
+ * @return APR_EAGAIN if @a size operations are already in flight
+ * @remark Like apr_socket_send(), the completion may report less bytes
+ *         sent than @a len.
+ */
+APR_DECLARE(apr_status_t) apr_aio_send(apr_aio_t *aio, apr_socket_t *sock,
+                                       const char *buf, apr_size_t len,
+                                       apr_aio_cb_t cb, void *baton);
+
+/**
+ * Queue a read from a file.
+ * @param aio The asynchronous I/O object
+ * @param file The file to read from, which must not be buffered
+ * @param buf The buffer to fill, up to @a len bytes
+ * @param len The size of @a buf
+ * @param offset Where to read from, or -1 for the current file offset
+ *        (which the read then updates)
+ * @param cb The callback for the completion, or NULL to have it returned
+ *        by apr_aio_poll()
+ * @param baton The baton for @a cb, or for the completion
+ * @return APR_EAGAIN if @a size operations are already in flight,
+ *         APR_EINVAL for a buffered file
+ */
+APR_DECLARE(apr_status_t) apr_aio_read(apr_aio_t *aio, apr_file_t *file,
+                                       void *buf, apr_size_t len,
+                                       apr_off_t offset,
+                                       apr_aio_cb_t cb, void *baton);
+
+/**
+ * Queue a write to a file.
+ * @param aio The asynchronous I/O object
+ * @param file The file to write to, which must not be buffered
+ * @param buf The data to write
+ * @param len The length of @a buf
+ * @param offset Where to write to, or -1 for the current file offset
+ *        (which the write then updates)
+ * @param cb The callback for the completion, or NULL to have it returned
+ *        by apr_aio_poll()
+ * @param baton The baton for @a cb, or for the completion
+ * @return APR_EAGAIN if @a size operations are already in flight,
+ *         APR_EINVAL for a buffered file
+ */
+APR_DECLARE(apr_status_t) apr_aio_write(apr_aio_t *aio, apr_file_t *file,
+                                        const void *buf, apr_size_t len,
+                                        apr_off_t offset,
+                                        apr_aio_cb_t cb, void *baton);
+
+/**
+ * Queue an accept on a listening socket.
+ * @param aio The asynchronous I/O object
+ * @param sock The listening socket
+ * @param connection_pool The pool for the accepted socket
+ * @param cb The callback for the completion, or NULL to have it returned
+ *        by apr_aio_poll()
+ * @param baton The baton for @a cb, or for the completion
+ * @return APR_EAGAIN if @a size operations are already in flight
+ * @remark The accepted socket is set up as by apr_socket_accept().
+ */
+APR_DECLARE(apr_status_t) apr_aio_accept(apr_aio_t *aio, apr_socket_t *sock,
+                                         apr_pool_t *connection_pool,
+                                         apr_aio_cb_t cb, void *baton);
+
+/**
+ * Queue a connect.
+ * @param aio The asynchronous I/O object
+ * @param sock The socket to connect
+ * @param sa The address to connect to, which must stay valid until the
+ *        operation completes
+ * @param cb The callback for the completion, or NULL to have it returned
+ *        by apr_aio_poll()
+ * @param baton The baton for @a cb, or for the completion
+ * @return APR_EAGAIN if @a size operations are already in flight
+ */
+APR_DECLARE(apr_status_t) apr_aio_connect(apr_aio_t *aio, apr_socket_t *sock,
+                                          apr_sockaddr_t *sa,
+                                          apr_aio_cb_t cb, void *baton);
+
+/**
+ * Submit the queued operations, without waiting for completions.
+ * @param aio The asynchronous I/O object
+ * @remark apr_aio_poll() submits them too, this is for when it's not
+ *         going to be called soon.
+ */
+APR_DECLARE(apr_status_t) apr_aio_submit(apr_aio_t *aio);
+
+/**
+ * Submit the queued operations and collect the completions.
+ * @param aio The asynchronous I/O object
+ * @param timeout The amount of time in microseconds to wait for a
+ *        completion, or -1 to wait indefinitely
+ * @param num The number of completions returned in @a completions
+ * @param completions Where to return the completions of the operations
+ *        queued without callback, valid until the next call (may be NULL
+ *        if all the operations have one)
+ * @return APR_TIMEUP if nothing completed, the status of a callback
+ *         which stopped the collect
+ * @remark The callbacks are called as their operation completes, and may
+ *         queue new operations.
+ */
+APR_DECLARE(apr_status_t) apr_aio_poll(apr_aio_t *aio,
+                                       apr_interval_time_t timeout,
+                                       apr_int32_t *num,
+                                       const apr_aio_completion_t **completions);
+
+/**
+ * Register buffers with the kernel, so that the operations using them
+ * don't have to map them each time.
+ * @param aio The asynchronous I/O object
+ * @param vec The buffers
+ * @param nvec The number of buffers
+ * @remark The receives, reads and writes whose buffer lies within one
+ *         of @a vec use it. The buffers must stay valid until they are
+ *         unregistered or @a aio is destroyed.
+ * @remark Only one set of buffers can be registered at a time, and not
+ *         while operations are in flight.
+ */
+APR_DECLARE(apr_status_t) apr_aio_buffers_register(apr_aio_t *aio,
+                                                   const struct iovec *vec,
+                                                   apr_size_t nvec);
+
+/**
+ * Unregister the buffers registered by apr_aio_buffers_register().
+ * @param aio The asynchronous I/O object
+ */
+APR_DECLARE(apr_status_t) apr_aio_buffers_unregister(apr_aio_t *aio);
+
+/**
+ * Register a socket with the kernel (fixed file), so that the operations
+ * on it don't have to look it up each time.
+ * @param aio The asynchronous I/O object
+ * @param sock The socket
+ * @return APR_ENOSPC if @a size descriptors are registered already,
+ *         APR_EEXIST if @a sock is
+ * @remark The socket must be unregistered before it's closed.
+ */
+APR_DECLARE(apr_status_t) apr_aio_socket_register(apr_aio_t *aio,
+                                                  apr_socket_t *sock);
+
+/**
+ * Unregister a socket registered by apr_aio_socket_register().
+ * @param aio The asynchronous I/O object
+ * @param sock The socket
+ * @return APR_NOTFOUND if @a sock is not registered
+ */
+APR_DECLARE(apr_status_t) apr_aio_socket_unregister(apr_aio_t *aio,
+                                                    apr_socket_t *sock);
+
+/**
+ * Register a file with the kernel (fixed file), so that the operations
+ * on it don't have to look it up each time.
+ * @param aio The asynchronous I/O object
+ * @param file The file
+ * @return APR_ENOSPC if @a size descriptors are registered already,
+ *         APR_EEXIST if @a file is
+ * @remark The file must be unregistered before it's closed.
+ */
+APR_DECLARE(apr_status_t) apr_aio_file_register(apr_aio_t *aio,
+                                                apr_file_t *file);
+
+/**
+ * Unregister a file registered by apr_aio_file_register().
+ * @param aio The asynchronous I/O object
+ * @param file The file
+ * @return APR_NOTFOUND if @a file is not registered
+ */
+APR_DECLARE(apr_status_t) apr_aio_file_unregister(apr_aio_t *aio,
+                                                  apr_file_t *file);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_AIO_H */
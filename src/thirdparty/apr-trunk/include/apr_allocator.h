@@ -163,6 +163,21 @@ APR_DECLARE(void) apr_allocator_max_free_set(apr_allocator_t *allocator,
                                              apr_size_t size)
                   __attribute__((nonnull(1)));
 
+struct apr_stats_counter_t;
+
+/**
+ * Account for the memory handed out by the allocator, in bytes: the
+ * counter is added the size of the blocks allocated and subtracted the
+ * size of those freed.
+ * @param allocator The allocator
+ * @param bytes The counter (see apr_stats.h), or NULL to stop accounting
+ * @remark Set the counter before any block is allocated from the
+ * allocator, or it will end up short.
+ */
+APR_DECLARE(void) apr_allocator_stats_set(apr_allocator_t *allocator,
+                                          struct apr_stats_counter_t *bytes)
+                  __attribute__((nonnull(1)));
+
 #include "apr_thread_mutex.h"
 
 #if APR_HAS_THREADS
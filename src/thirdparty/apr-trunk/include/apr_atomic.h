@@ -198,6 +198,265 @@ APR_DECLARE(void*) apr_atomic_casptr(void *volatile *mem, void *with, const void
  */
 APR_DECLARE(void*) apr_atomic_xchgptr(void *volatile *mem, void *with);
 
+/**
+ * Atomic bitwise operations, returning the old value
+ */
+
+/**
+ * atomically OR a value into an apr_uint32_t
+ * @param mem pointer to the object
+ * @param val value to OR into the object
+ * @return the old value of *mem
+ */
+APR_DECLARE(apr_uint32_t) apr_atomic_or32(volatile apr_uint32_t *mem, apr_uint32_t val);
+
+/**
+ * atomically AND a value into an apr_uint32_t
+ * @param mem pointer to the object
+ * @param val value to AND into the object
+ * @return the old value of *mem
+ */
+APR_DECLARE(apr_uint32_t) apr_atomic_and32(volatile apr_uint32_t *mem, apr_uint32_t val);
+
+/**
+ * atomically OR a value into an apr_uint64_t
+ * @param mem pointer to the object
+ * @param val value to OR into the object
+ * @return the old value of *mem
+ */
+APR_DECLARE(apr_uint64_t) apr_atomic_or64(volatile apr_uint64_t *mem, apr_uint64_t val);
+
+/**
+ * atomically AND a value into an apr_uint64_t
+ * @param mem pointer to the object
+ * @param val value to AND into the object
+ * @return the old value of *mem
+ */
+APR_DECLARE(apr_uint64_t) apr_atomic_and64(volatile apr_uint64_t *mem, apr_uint64_t val);
+
+/*
+ * Atomic operations with an explicit memory order
+ * Note: The functions above all order like APR_ATOMIC_SEQ_CST. Platforms
+ * without weaker barriers implement the ones below with the same strong
+ * ordering, which is always correct.
+ */
+
+/**
+ * Memory ordering of the apr_atomic_*_ex() functions
+ */
+typedef enum {
+    APR_ATOMIC_RELAXED, /**< atomicity only, no ordering */
+    APR_ATOMIC_ACQUIRE, /**< no later access moves before the operation */
+    APR_ATOMIC_RELEASE, /**< no earlier access moves after the operation */
+    APR_ATOMIC_ACQ_REL, /**< both, for read-modify-write operations */
+    APR_ATOMIC_SEQ_CST  /**< a single total order, as the functions above */
+} apr_atomic_order_e;
+
+/**
+ * atomically read an apr_uint32_t from memory
+ * @param mem the pointer
+ * @param order the memory order, release orders read as APR_ATOMIC_SEQ_CST
+ */
+APR_DECLARE(apr_uint32_t) apr_atomic_read32_ex(volatile apr_uint32_t *mem,
+                                               apr_atomic_order_e order);
+
+/**
+ * atomically set an apr_uint32_t in memory
+ * @param mem pointer to the object
+ * @param val value that the object will assume
+ * @param order the memory order, acquire orders store as APR_ATOMIC_SEQ_CST
+ */
+APR_DECLARE(void) apr_atomic_set32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                      apr_atomic_order_e order);
+
+/**
+ * atomically add 'val' to an apr_uint32_t
+ * @param mem pointer to the object
+ * @param val amount to add
+ * @param order the memory order
+ * @return old value pointed to by mem
+ */
+APR_DECLARE(apr_uint32_t) apr_atomic_add32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                              apr_atomic_order_e order);
+
+/**
+ * compare an apr_uint32_t's value with 'cmp'.
+ * If they are the same swap the value with 'with'
+ * @param mem pointer to the value
+ * @param with what to swap it with
+ * @param cmp the value to compare it to
+ * @param order the memory order
+ * @return the old value of *mem
+ */
+APR_DECLARE(apr_uint32_t) apr_atomic_cas32_ex(volatile apr_uint32_t *mem, apr_uint32_t with,
+                                              apr_uint32_t cmp,
+                                              apr_atomic_order_e order);
+
+/**
+ * exchange an apr_uint32_t's value with 'val'.
+ * @param mem pointer to the value
+ * @param val what to swap it with
+ * @param order the memory order
+ * @return the old value of *mem
+ */
+APR_DECLARE(apr_uint32_t) apr_atomic_xchg32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                               apr_atomic_order_e order);
+
+/**
+ * atomically OR a value into an apr_uint32_t
+ * @param mem pointer to the object
+ * @param val value to OR into the object
+ * @param order the memory order
+ * @return the old value of *mem
+ */
+APR_DECLARE(apr_uint32_t) apr_atomic_or32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                             apr_atomic_order_e order);
+
+/**
+ * atomically AND a value into an apr_uint32_t
+ * @param mem pointer to the object
+ * @param val value to AND into the object
+ * @param order the memory order
+ * @return the old value of *mem
+ */
+APR_DECLARE(apr_uint32_t) apr_atomic_and32_ex(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                              apr_atomic_order_e order);
+
+/**
+ * atomically read an apr_uint64_t from memory
+ * @param mem the pointer
+ * @param order the memory order, release orders read as APR_ATOMIC_SEQ_CST
+ */
+APR_DECLARE(apr_uint64_t) apr_atomic_read64_ex(volatile apr_uint64_t *mem,
+                                               apr_atomic_order_e order);
+
+/**
+ * atomically set an apr_uint64_t in memory
+ * @param mem pointer to the object
+ * @param val value that the object will assume
+ * @param order the memory order, acquire orders store as APR_ATOMIC_SEQ_CST
+ */
+APR_DECLARE(void) apr_atomic_set64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                      apr_atomic_order_e order);
+
+/**
+ * atomically add 'val' to an apr_uint64_t
+ * @param mem pointer to the object
+ * @param val amount to add
+ * @param order the memory order
+ * @return old value pointed to by mem
+ */
+APR_DECLARE(apr_uint64_t) apr_atomic_add64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                              apr_atomic_order_e order);
+
+/**
+ * compare an apr_uint64_t's value with 'cmp'.
+ * If they are the same swap the value with 'with'
+ * @param mem pointer to the value
+ * @param with what to swap it with
+ * @param cmp the value to compare it to
+ * @param order the memory order
+ * @return the old value of *mem
+ */
+APR_DECLARE(apr_uint64_t) apr_atomic_cas64_ex(volatile apr_uint64_t *mem, apr_uint64_t with,
+                                              apr_uint64_t cmp,
+                                              apr_atomic_order_e order);
+
+/**
+ * exchange an apr_uint64_t's value with 'val'.
+ * @param mem pointer to the value
+ * @param val what to swap it with
+ * @param order the memory order
+ * @return the old value of *mem
+ */
+APR_DECLARE(apr_uint64_t) apr_atomic_xchg64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                               apr_atomic_order_e order);
+
+/**
+ * atomically OR a value into an apr_uint64_t
+ * @param mem pointer to the object
+ * @param val value to OR into the object
+ * @param order the memory order
+ * @return the old value of *mem
+ */
+APR_DECLARE(apr_uint64_t) apr_atomic_or64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                             apr_atomic_order_e order);
+
+/**
+ * atomically AND a value into an apr_uint64_t
+ * @param mem pointer to the object
+ * @param val value to AND into the object
+ * @param order the memory order
+ * @return the old value of *mem
+ */
+APR_DECLARE(apr_uint64_t) apr_atomic_and64_ex(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                              apr_atomic_order_e order);
+
+/**
+ * compare the pointer's value with cmp.
+ * If they are the same swap the value with 'with'
+ * @param mem pointer to the pointer
+ * @param with what to swap it with
+ * @param cmp the value to compare it to
+ * @param order the memory order
+ * @return the old value of the pointer
+ */
+APR_DECLARE(void*) apr_atomic_casptr_ex(void *volatile *mem, void *with, const void *cmp,
+                                        apr_atomic_order_e order);
+
+/**
+ * exchange a pair of pointer values
+ * @param mem pointer to the pointer
+ * @param with what to swap it with
+ * @param order the memory order
+ * @return the old value of the pointer
+ */
+APR_DECLARE(void*) apr_atomic_xchgptr_ex(void *volatile *mem, void *with,
+                                         apr_atomic_order_e order);
+
+/*
+ * Double-width compare-and-swap of a tagged pointer
+ */
+
+/**
+ * A pointer along with a tag, such as a counter bumped on every update
+ * so that a recycled pointer does not compare equal (the ABA problem).
+ * @remark The type is aligned on its size, as double-width CAS needs it;
+ * allocate it as part of a structure rather than on its own from a pool,
+ * whose allocations are only aligned on APR_ALIGN_DEFAULT.
+ */
+#if defined(_MSC_VER) && APR_SIZEOF_VOIDP == 8
+typedef __declspec(align(16)) struct apr_atomic_tagptr_t
+#elif defined(_MSC_VER)
+typedef __declspec(align(8)) struct apr_atomic_tagptr_t
+#else
+typedef struct apr_atomic_tagptr_t
+#endif
+{
+    void *ptr;          /**< the pointer */
+    apr_uintptr_t tag;  /**< the tag */
+}
+#if defined(__GNUC__)
+__attribute__((aligned(2 * APR_SIZEOF_VOIDP)))
+#endif
+apr_atomic_tagptr_t;
+
+/**
+ * compare a tagged pointer with cmp, both pointer and tag.
+ * If they are the same swap it with 'with', otherwise store its current
+ * value into cmp.
+ * @param mem pointer to the tagged pointer
+ * @param cmp the value to compare it to, updated on failure
+ * @param with what to swap it with
+ * @return non-zero if the swap happened
+ * @remark Reading mem to initialize cmp need not be atomic, a torn value
+ * only makes the first swap fail. When APR_HAS_ATOMIC_DWCAS is zero, the
+ * operation is emulated with (hashed) spinlocks rather than lock-free.
+ */
+APR_DECLARE(int) apr_atomic_castagptr(volatile apr_atomic_tagptr_t *mem,
+                                      apr_atomic_tagptr_t *cmp,
+                                      const apr_atomic_tagptr_t *with);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -0,0 +1,371 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_BTREE_H
+#define APR_BTREE_H
+/**
+ * @file apr_btree.h
+ * @brief APR B+tree ordered container
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_btree B+tree ordered container
+ * An ordered container of opaque elements, kept in fat cache line
+ * sized nodes so that a lookup touches a few contiguous blocks of memory
+ * instead of chasing a pointer per level per element as the skip list
+ * does. The comparison and multi-index model follows apr_skiplist.
+ * @ingroup APR
+ * @{
+ */
+
+/**
+ * apr_btree_compare is the function type that must be implemented
+ * per object type that is used in a B+tree for comparisons to maintain
+ * order. The first argument is the searched value (or the element being
+ * placed), the second one is an element of the tree.
+ */
+typedef int (*apr_btree_compare) (void *, void *);
+
+/**
+ * apr_btree_freefunc is the function type that must be implemented
+ * to handle elements as they are removed from a B+tree.
+ */
+typedef void (*apr_btree_freefunc) (void *);
+
+/**
+ * Declaration prototype for the iterator callback function of
+ * apr_btree_range_do().
+ * @param rec The data passed as the last argument to apr_btree_range_do()
+ * @param elt The current element
+ * @return Return non-zero to continue the iteration, zero to stop it.
+ */
+typedef int (apr_btree_do_callback_fn_t)(void *rec, void *elt);
+
+/** Opaque structure used to represent the B+tree */
+typedef struct apr_btree_t apr_btree_t;
+
+/** Opaque structure used to represent the nodes of the B+tree */
+struct apr_btree_node_t;
+
+/**
+ * A position within a B+tree (or one of its indexes).
+ * @remark The fields are private. An iterator is invalidated by any
+ * insertion into or removal from the tree it was obtained from.
+ */
+typedef struct apr_btree_iter_t {
+    /** The tree (or index) the iterator walks */
+    apr_btree_t *bt;
+    /** The leaf holding the current element, NULL when exhausted */
+    struct apr_btree_node_t *node;
+    /** The position of the current element within the leaf */
+    int pos;
+} apr_btree_iter_t;
+
+/**
+ * Allocate a new B+tree
+ * @param bt The pointer in which to return the newly created tree
+ * @param p The pool from which to allocate the tree (optional).
+ * @remark Unlike most APR functions, a pool is optional.  If no pool
+ * is provided, the C standard library heap functions will be used instead
+ * and the tree must be released with apr_btree_destroy().
+ */
+APR_DECLARE(apr_status_t) apr_btree_create(apr_btree_t **bt, apr_pool_t *p);
+
+/**
+ * Set the comparison functions to be used for ordering and searching
+ * the tree.
+ * @param bt The B+tree
+ * @param comp The function comparing two elements, used for placement
+ * @param compk The function comparing a key to an element, used for
+ * searching
+ * @remark If comparison functions were already set, an index ordered by
+ * the new functions is added instead, as with apr_btree_add_index().
+ */
+APR_DECLARE(void) apr_btree_set_compare(apr_btree_t *bt,
+                                        apr_btree_compare comp,
+                                        apr_btree_compare compk);
+
+/**
+ * Add an index ordered by the given comparison functions, and populate
+ * it with the elements of the tree.
+ * @param bt The B+tree
+ * @param comp The function comparing two elements, used for placement
+ * @param compk The function comparing a key to an element, used for
+ * searching
+ * @remark Elements inserted into or removed from the tree are inserted
+ * into or removed from all its indexes.  An index is selected by passing
+ * its @a comp to the *_compare() functions.  If an index using @a comp
+ * already exists, nothing is done.
+ */
+APR_DECLARE(apr_status_t) apr_btree_add_index(apr_btree_t *bt,
+                                              apr_btree_compare comp,
+                                              apr_btree_compare compk);
+
+/**
+ * Insert an element into the tree if no equal element exists.
+ * @param bt The B+tree
+ * @param data The element to insert
+ * @return APR_SUCCESS, APR_EEXIST if an equal element is already in
+ * the tree, APR_EINVAL if no comparison function is set, or APR_ENOMEM.
+ */
+APR_DECLARE(apr_status_t) apr_btree_insert(apr_btree_t *bt, void *data);
+
+/**
+ * Add an element into the tree, allowing for duplicates.
+ * @param bt The B+tree
+ * @param data The element to add
+ * @remark Duplicates are kept in insertion order: the element is placed
+ * after the existing equal ones.
+ */
+APR_DECLARE(apr_status_t) apr_btree_add(apr_btree_t *bt, void *data);
+
+/**
+ * Add an element into the tree, removing the existing duplicates.
+ * @param bt The B+tree
+ * @param data The element to add
+ * @param myfree A function to be called for each removed duplicate
+ */
+APR_DECLARE(apr_status_t) apr_btree_replace(apr_btree_t *bt, void *data,
+                                            apr_btree_freefunc myfree);
+
+/**
+ * Load a sorted run of elements into an empty tree in O(n).
+ * @param bt The B+tree, which must be empty
+ * @param elts The elements, ordered by the tree's comparison function
+ * @param nelts The number of elements
+ * @return APR_EINVAL if the tree is not empty, has no comparison
+ * function, or if @a elts is not sorted; APR_ENOMEM on allocation failure.
+ * @remark The leaves are packed nearly full, which is best for read mostly
+ * trees.  The indexes, if any, are populated by regular insertions.
+ */
+APR_DECLARE(apr_status_t) apr_btree_bulk_load(apr_btree_t *bt,
+                                              void *const *elts,
+                                              apr_size_t nelts);
+
+/**
+ * Return the first element equal to the searched value using the
+ * specified index.
+ * @param bt The B+tree
+ * @param data The value to search for
+ * @param iter A pointer to the returned position (optional)
+ * @param comp The comparison function of the index to use
+ * @return The element found, or NULL.
+ */
+APR_DECLARE(void *) apr_btree_find_compare(apr_btree_t *bt, void *data,
+                                           apr_btree_iter_t *iter,
+                                           apr_btree_compare comp);
+
+/**
+ * Return the first element equal to the searched value.
+ * @param bt The B+tree
+ * @param data The value to search for
+ * @param iter A pointer to the returned position (optional)
+ */
+APR_DECLARE(void *) apr_btree_find(apr_btree_t *bt, void *data,
+                                   apr_btree_iter_t *iter);
+
+/**
+ * Return the first element not less than the searched value using the
+ * specified index.
+ * @param bt The B+tree
+ * @param data The value to search for
+ * @param iter A pointer to the returned position (optional)
+ * @param comp The comparison function of the index to use
+ * @return The element found, or NULL if all the elements are less than
+ * @a data.
+ */
+APR_DECLARE(void *) apr_btree_lower_bound_compare(apr_btree_t *bt,
+                                                  void *data,
+                                                  apr_btree_iter_t *iter,
+                                                  apr_btree_compare comp);
+
+/**
+ * Return the first element not less than the searched value.
+ * @param bt The B+tree
+ * @param data The value to search for
+ * @param iter A pointer to the returned position (optional)
+ */
+APR_DECLARE(void *) apr_btree_lower_bound(apr_btree_t *bt, void *data,
+                                          apr_btree_iter_t *iter);
+
+/**
+ * Return the first element of the specified index.
+ * @param bt The B+tree
+ * @param iter A pointer to the returned position
+ * @param comp The comparison function of the index to use
+ */
+APR_DECLARE(void *) apr_btree_first_compare(apr_btree_t *bt,
+                                            apr_btree_iter_t *iter,
+                                            apr_btree_compare comp);
+
+/**
+ * Return the first element of the tree.
+ * @param bt The B+tree
+ * @param iter A pointer to the returned position
+ */
+APR_DECLARE(void *) apr_btree_first(apr_btree_t *bt, apr_btree_iter_t *iter);
+
+/**
+ * Return the last element of the specified index.
+ * @param bt The B+tree
+ * @param iter A pointer to the returned position
+ * @param comp The comparison function of the index to use
+ */
+APR_DECLARE(void *) apr_btree_last_compare(apr_btree_t *bt,
+                                           apr_btree_iter_t *iter,
+                                           apr_btree_compare comp);
+
+/**
+ * Return the last element of the tree.
+ * @param bt The B+tree
+ * @param iter A pointer to the returned position
+ */
+APR_DECLARE(void *) apr_btree_last(apr_btree_t *bt, apr_btree_iter_t *iter);
+
+/**
+ * Return the next element.
+ * @param iter On entry, the position to start with; on return, the
+ * position of the element returned
+ * @remark NULL is returned at the end of the tree.
+ */
+APR_DECLARE(void *) apr_btree_next(apr_btree_iter_t *iter);
+
+/**
+ * Return the previous element.
+ * @param iter On entry, the position to start with; on return, the
+ * position of the element returned
+ * @remark NULL is returned at the beginning of the tree.
+ */
+APR_DECLARE(void *) apr_btree_previous(apr_btree_iter_t *iter);
+
+/**
+ * Return the element at the given position.
+ * @param iter The position
+ */
+APR_DECLARE(void *) apr_btree_element(const apr_btree_iter_t *iter);
+
+/**
+ * Call a function for each element of a range, in order.
+ * @param bt The B+tree
+ * @param comp The comparison function of the index to scan, or NULL for
+ * the tree itself
+ * @param lo The lower bound (inclusive) of the range, or NULL
+ * @param hi The upper bound (inclusive) of the range, or NULL
+ * @param cb The function to call for each element
+ * @param rec The data to pass as the first argument to @a cb
+ * @return 0 if one of the @a cb calls returned zero, 1 otherwise.
+ * @remark The bounds are compared using the key comparison function of
+ * the index.  The tree must not be modified by @a cb.
+ */
+APR_DECLARE(int) apr_btree_range_do(apr_btree_t *bt, apr_btree_compare comp,
+                                    void *lo, void *hi,
+                                    apr_btree_do_callback_fn_t *cb,
+                                    void *rec);
+
+/**
+ * Remove the first element equal to the searched value, using the
+ * specified index to locate it.
+ * @param bt The B+tree
+ * @param data The value to search for
+ * @param myfree A function to be called for the removed element
+ * @param comp The comparison function of the index to use
+ * @return 1 if an element was removed, 0 otherwise.
+ */
+APR_DECLARE(int) apr_btree_remove_compare(apr_btree_t *bt, void *data,
+                                          apr_btree_freefunc myfree,
+                                          apr_btree_compare comp);
+
+/**
+ * Remove the first element equal to the searched value.
+ * @param bt The B+tree
+ * @param data The value to search for
+ * @param myfree A function to be called for the removed element
+ * @return 1 if an element was removed, 0 otherwise.
+ */
+APR_DECLARE(int) apr_btree_remove(apr_btree_t *bt, void *data,
+                                  apr_btree_freefunc myfree);
+
+/**
+ * Remove the element at the given position.
+ * @param bt The B+tree
+ * @param iter The position, obtained from @a bt or one of its indexes
+ * @param myfree A function to be called for the removed element
+ * @return 1 if an element was removed, 0 otherwise.
+ * @remark The iterator is invalidated.
+ */
+APR_DECLARE(int) apr_btree_remove_iter(apr_btree_t *bt,
+                                       apr_btree_iter_t *iter,
+                                       apr_btree_freefunc myfree);
+
+/**
+ * Return the first element of the tree, removing it from the tree.
+ * @param bt The B+tree
+ * @param myfree A function to be called for the removed element
+ * @remark NULL will be returned if there are no elements
+ */
+APR_DECLARE(void *) apr_btree_pop(apr_btree_t *bt, apr_btree_freefunc myfree);
+
+/**
+ * Return the first element of the tree, leaving it in the tree.
+ * @param bt The B+tree
+ * @remark NULL will be returned if there are no elements
+ */
+APR_DECLARE(void *) apr_btree_peek(apr_btree_t *bt);
+
+/**
+ * Remove all elements from the tree.
+ * @param bt The B+tree
+ * @param myfree A function to be called for each removed element
+ * @remark The nodes are kept for reuse by subsequent insertions.
+ */
+APR_DECLARE(void) apr_btree_remove_all(apr_btree_t *bt,
+                                       apr_btree_freefunc myfree);
+
+/**
+ * Remove all elements from the tree and release its memory.
+ * @param bt The B+tree
+ * @param myfree A function to be called for each removed element
+ */
+APR_DECLARE(void) apr_btree_destroy(apr_btree_t *bt,
+                                    apr_btree_freefunc myfree);
+
+/**
+ * Return the number of elements in the tree, in O(1).
+ * @param bt The B+tree
+ */
+APR_DECLARE(apr_size_t) apr_btree_size(const apr_btree_t *bt);
+
+/**
+ * Return the height of the tree (number of node levels), in O(1).
+ * @param bt The B+tree
+ */
+APR_DECLARE(int) apr_btree_height(const apr_btree_t *bt);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ! APR_BTREE_H */
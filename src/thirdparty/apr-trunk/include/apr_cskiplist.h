@@ -0,0 +1,151 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_CSKIPLIST_H
+#define APR_CSKIPLIST_H
+/**
+ * @file apr_cskiplist.h
+ * @brief APR concurrent (lock-free) skip list
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_cskiplist Concurrent skip list
+ * A skip list which can be used by any number of threads without
+ * external locking.  Insertions link nodes with compare-and-swap,
+ * removals first mark a node as logically deleted and then unlink it,
+ * and lookups only walk the list.  Unlinked nodes are freed by epoch
+ * based reclamation once no concurrent operation can still reference
+ * them.
+ * @ingroup APR
+ * @{
+ */
+
+/**
+ * apr_cskiplist_compare is the function type that must be implemented
+ * per object type that is used in a concurrent skip list.  The first
+ * argument is the searched value (or the element being placed), the
+ * second one is an element of the list.
+ */
+typedef int (*apr_cskiplist_compare) (void *, void *);
+
+/** Opaque structure used to represent the concurrent skip list */
+typedef struct apr_cskiplist_t apr_cskiplist_t;
+
+/**
+ * Create a concurrent skip list.
+ * @param csl The pointer in which to return the newly created list
+ * @param comp The comparison function used for ordering and searching
+ * @param p The pool from which to allocate the list
+ * @remark The nodes are allocated from the heap and released when they
+ * are reclaimed, or when @a p is cleared or destroyed.  No operation may
+ * be in progress at that time.
+ */
+APR_DECLARE(apr_status_t) apr_cskiplist_create(apr_cskiplist_t **csl,
+                                               apr_cskiplist_compare comp,
+                                               apr_pool_t *p);
+
+/**
+ * Insert an element into the list if no equal element exists.
+ * @param csl The concurrent skip list
+ * @param data The element to insert, which can't be NULL
+ * @return APR_SUCCESS, APR_EEXIST if an equal element is already in the
+ * list, or APR_ENOMEM.
+ */
+APR_DECLARE(apr_status_t) apr_cskiplist_insert(apr_cskiplist_t *csl,
+                                               void *data);
+
+/**
+ * Add an element into the list, allowing for duplicates.
+ * @param csl The concurrent skip list
+ * @param data The element to add, which can't be NULL
+ * @remark Equal elements are ordered by the time their insertion
+ * started, which is FIFO for a single producer.
+ */
+APR_DECLARE(apr_status_t) apr_cskiplist_add(apr_cskiplist_t *csl,
+                                            void *data);
+
+/**
+ * Return the first element equal to the searched value.
+ * @param csl The concurrent skip list
+ * @param data The value to search for
+ * @return The element, or NULL if not found.
+ * @remark Lock-free, the list is not modified but the call is accounted
+ * for in its shared epoch counters, and on return it may free the nodes
+ * removed meanwhile.
+ */
+APR_DECLARE(void *) apr_cskiplist_find(apr_cskiplist_t *csl, void *data);
+
+/**
+ * Return the first element greater than the searched value.
+ * @param csl The concurrent skip list
+ * @param data The value to search for, or NULL for the first element
+ * @return The element, or NULL if there is none.
+ * @remark Iterating a concurrent list is done by passing each returned
+ * element back (or, with duplicates, an element which compares equal).
+ * @remark Lock-free, the list is not modified but the call is accounted
+ * for in its shared epoch counters, and on return it may free the nodes
+ * removed meanwhile.
+ */
+APR_DECLARE(void *) apr_cskiplist_next(apr_cskiplist_t *csl, void *data);
+
+/**
+ * Return the first element of the list, leaving it in the list.
+ * @param csl The concurrent skip list
+ * @remark NULL will be returned if there are no elements.
+ */
+APR_DECLARE(void *) apr_cskiplist_peek(apr_cskiplist_t *csl);
+
+/**
+ * Remove the first element of the list.
+ * @param csl The concurrent skip list
+ * @return The removed element, or NULL if there are no elements.
+ * @remark When several threads pop concurrently, each element is
+ * returned to exactly one of them.
+ */
+APR_DECLARE(void *) apr_cskiplist_pop(apr_cskiplist_t *csl);
+
+/**
+ * Remove the first element equal to the searched value.
+ * @param csl The concurrent skip list
+ * @param data The value to search for
+ * @param removed Where to return the removed element (optional)
+ * @return APR_SUCCESS or APR_NOTFOUND.
+ */
+APR_DECLARE(apr_status_t) apr_cskiplist_remove(apr_cskiplist_t *csl,
+                                               void *data, void **removed);
+
+/**
+ * Return the number of elements in the list.
+ * @param csl The concurrent skip list
+ * @remark The value is only a snapshot while other threads modify the list.
+ */
+APR_DECLARE(apr_size_t) apr_cskiplist_size(apr_cskiplist_t *csl);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ! APR_CSKIPLIST_H */
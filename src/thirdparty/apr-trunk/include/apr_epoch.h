@@ -0,0 +1,198 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_EPOCH_H
+#define APR_EPOCH_H
+
+/**
+ * @file apr_epoch.h
+ * @brief Epoch based memory reclamation
+ */
+
+#include "apu.h"
+#include "apr_allocator.h"
+#include "apr_errno.h"
+#include "apr_pools.h"
+#include "apr_thread_pool.h"
+
+#if APR_HAS_THREADS
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup APR_Util_Epoch Epoch based memory reclamation
+ * @ingroup APR
+ * @{
+ */
+
+/**
+ * opaque structures
+ */
+typedef struct apr_epoch_t apr_epoch_t;
+typedef struct apr_epoch_thread_t apr_epoch_thread_t;
+
+/**
+ * create an epoch domain
+ *
+ * Readers of a lock-free structure access it within critical sections,
+ * bracketed by apr_epoch_enter() and apr_epoch_exit(). Writers unlink
+ * objects from the structure and retire them, the object is then freed
+ * once every critical section which might still see it has exited.
+ *
+ * A global epoch is advanced when no thread is in a critical section
+ * entered in an older epoch; objects retired in epoch e are freed once
+ * the global epoch reaches e + 2. Reclaiming is done by whoever calls
+ * apr_epoch_reclaim(), or in the background by a thread pool.
+ *
+ * @param epoch The new epoch domain
+ * @param a pool to allocate the domain from
+ * @remark Objects still retired when the pool is cleared are freed then,
+ * no critical section may be running anymore.
+ */
+APR_DECLARE(apr_status_t) apr_epoch_create(apr_epoch_t **epoch,
+                                           apr_pool_t *a);
+
+/**
+ * register the calling thread with an epoch domain
+ *
+ * @param thd where to store the thread's record
+ * @param epoch the epoch domain
+ * @returns APR_SUCCESS on success
+ * @remark The record is used by this thread only, records of unregistered
+ * threads are recycled.
+ */
+APR_DECLARE(apr_status_t) apr_epoch_register(apr_epoch_thread_t **thd,
+                                             apr_epoch_t *epoch);
+
+/**
+ * unregister a thread, handing over the objects it retired
+ *
+ * @param thd the thread's record
+ * @returns APR_EBUSY the thread is in a critical section
+ * @returns APR_SUCCESS on success
+ */
+APR_DECLARE(apr_status_t) apr_epoch_unregister(apr_epoch_thread_t *thd);
+
+/**
+ * enter a critical section, within which no object reachable from the
+ * structure is freed
+ *
+ * @param thd the thread's record
+ * @remark Critical sections nest, only the outermost one counts.
+ */
+APR_DECLARE(void) apr_epoch_enter(apr_epoch_thread_t *thd);
+
+/**
+ * exit a critical section
+ *
+ * @param thd the thread's record
+ * @remark Objects retired since the last exit are handed over to the
+ * reclaimer when the outermost section exits.
+ */
+APR_DECLARE(void) apr_epoch_exit(apr_epoch_thread_t *thd);
+
+/**
+ * retire an object, to be freed by func(data) once no critical section
+ * may see it anymore
+ *
+ * @param thd the thread's record
+ * @param func the function freeing the object
+ * @param data the object
+ * @returns APR_SUCCESS on success
+ * @remark The object must already be unreachable to critical sections
+ * entered from now on. func runs in the thread reclaiming.
+ */
+APR_DECLARE(apr_status_t) apr_epoch_retire(apr_epoch_thread_t *thd,
+                                           void (*func)(void *data),
+                                           void *data);
+
+/**
+ * retire a pool, to be destroyed once no critical section may see
+ * anything allocated from it anymore
+ *
+ * @param thd the thread's record
+ * @param pool the pool
+ * @returns APR_SUCCESS on success
+ * @remark The pool is destroyed by the thread reclaiming, its parent must
+ * allow for this (see apr_allocator_mutex_set()).
+ */
+APR_DECLARE(apr_status_t) apr_epoch_retire_pool(apr_epoch_thread_t *thd,
+                                                apr_pool_t *pool);
+
+/**
+ * retire a memory node, to be given back to its allocator once no
+ * critical section may see it anymore
+ *
+ * @param thd the thread's record
+ * @param allocator the allocator the node was allocated from
+ * @param node the node
+ * @returns APR_SUCCESS on success
+ * @remark The allocator must allow for apr_allocator_free() from the
+ * thread reclaiming (see apr_allocator_mutex_set()).
+ */
+APR_DECLARE(apr_status_t) apr_epoch_retire_node(apr_epoch_thread_t *thd,
+                                                apr_allocator_t *allocator,
+                                                apr_memnode_t *node);
+
+/**
+ * advance the global epoch if possible, and free the retired objects
+ * which no critical section may see anymore
+ *
+ * @param epoch the epoch domain
+ * @param count where to store the number of objects freed, or NULL
+ * @returns APR_SUCCESS on success
+ * @remark Reclaimers are serialized, and must not be in a critical section
+ * themselves (the epoch would not advance).
+ */
+APR_DECLARE(apr_status_t) apr_epoch_reclaim(apr_epoch_t *epoch,
+                                            apr_size_t *count);
+
+/**
+ * reclaim in the background, with a task of the thread pool running
+ * apr_epoch_reclaim() every interval
+ *
+ * @param epoch the epoch domain
+ * @param tp the thread pool
+ * @param interval the time between reclaims
+ * @returns APR_EBUSY background reclaiming is already started
+ * @returns APR_SUCCESS on success
+ * @remark Background reclaiming stops with apr_epoch_reclaim_stop() or when
+ * the epoch's pool is cleared, the thread pool must outlive it.
+ */
+APR_DECLARE(apr_status_t) apr_epoch_reclaim_start(apr_epoch_t *epoch,
+                                                  apr_thread_pool_t *tp,
+                                                  apr_interval_time_t interval);
+
+/**
+ * stop reclaiming in the background
+ *
+ * @param epoch the epoch domain
+ * @returns APR_SUCCESS on success
+ * @remark Returns once the running reclaim task, if any, has completed.
+ */
+APR_DECLARE(apr_status_t) apr_epoch_reclaim_stop(apr_epoch_t *epoch);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APR_HAS_THREADS */
+
+#endif /* APR_EPOCH_H */
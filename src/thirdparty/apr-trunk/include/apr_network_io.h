@@ -108,6 +108,31 @@ extern "C" {
 #define APR_SO_FREEBIND     131072 /**< Allow binding to addresses not owned
                                     * by any interface
                                     */
+#define APR_SO_REUSEPORT    262144 /**< Allow several sockets to bind the
+                                    * same address and port, the kernel
+                                    * balancing the connections among them
+                                    */
+#define APR_UDP_GRO         524288 /**< Let the kernel coalesce the
+                                    * received UDP datagrams of a flow,
+                                    * @see apr_socket_recvmmsg()
+                                    */
+#define APR_SO_BUSY_POLL   1048576 /**< Busy poll the device for this
+                                    * many microseconds when receiving
+                                    * with nothing queued
+                                    */
+#define APR_TCP_QUICKACK   2097152 /**< Acknowledge received segments
+                                    * at once, rather than delaying
+                                    * acknowledgements
+                                    */
+#define APR_SO_INCOMING_CPU 4194304 /**< Prefer, among sockets bound with
+                                     * APR_SO_REUSEPORT, the one whose
+                                     * value is the CPU the packets of a
+                                     * new connection are handled by
+                                     */
+#define APR_TCP_FASTOPEN   8388608 /**< Accept TCP Fast Open connections
+                                    * on a listening socket, the value is
+                                    * the number of pending ones allowed
+                                    */
 
 /** @} */
 
@@ -583,6 +608,90 @@ APR_DECLARE(apr_status_t) apr_socket_sendv(apr_socket_t *sock,
                                            const struct iovec *vec,
                                            apr_int32_t nvec, apr_size_t *len);
 
+/**
+ * Called once the kernel is done with a buffer sent by apr_socket_send_zc()
+ * @param baton The baton given to apr_socket_send_zc()
+ */
+typedef void (*apr_socket_zc_release_fn_t)(void *baton);
+
+/**
+ * Send data over a network without copying it into the kernel, where
+ * possible (MSG_ZEROCOPY).
+ * @param sock The socket to send the data over.
+ * @param buf The buffer which contains the data to be sent.
+ * @param len On entry, the number of bytes to send; on exit, the number
+ *            of bytes sent.
+ * @param release Called with @a baton once the buffer is finished and the
+ *                kernel is done with the bytes sent, e.g. to destroy the
+ *                bucket or the pool that holds @a buf (or when @a sock
+ *                is closed, see apr_socket_zc_reap()).
+ * @param baton The baton for @a release
+ * @remark This function acts like apr_socket_send(), but the bytes sent
+ *         must be left untouched until @a release is called, exactly
+ *         once per buffer. The buffer is finished by the call which sends
+ *         all the bytes it is given, or fails with an error other than
+ *         APR_EAGAIN or APR_TIMEUP.
+ * @remark After a partial send (or APR_EAGAIN, APR_TIMEUP), the rest of
+ *         the buffer is sent by calling this function again with the same
+ *         @a release and @a baton, which continue the same buffer. To give
+ *         up on the buffer instead, call it with a zero length.
+ * @remark The kernel tells the completions through the socket's error
+ *         queue, signaled by APR_POLLERR, and apr_socket_zc_reap() (also
+ *         called by this function) reads them and calls the releases.
+ * @remark Small sends, and sends on systems or sockets not supporting
+ *         zero-copy, copy the data and call @a release before returning,
+ *         as do the sends following a report from the kernel that it had
+ *         to copy the data anyway (e.g. on loopback).
+ */
+APR_DECLARE(apr_status_t) apr_socket_send_zc(apr_socket_t *sock,
+                                             const char *buf,
+                                             apr_size_t *len,
+                                             apr_socket_zc_release_fn_t release,
+                                             void *baton);
+
+/**
+ * Read the completions of apr_socket_send_zc() and release their buffers.
+ * @param sock The socket the data was sent over
+ * @param timeout How long to wait for all the buffers to be released, 0
+ *                to only take the completions already there, or a
+ *                negative value to wait as long as needed.
+ * @param pending Set to the number of buffers still not released, if not
+ *                NULL, including one left partially sent.
+ * @return APR_TIMEUP if some buffers are still pending at @a timeout.
+ * @remark Closing @a sock, or cleaning up its pool, waits up to one
+ *         second for the pending buffers, then releases all of them (as
+ *         well as one left partially sent) since the completions can't be
+ *         read anymore. Those released then may still be transmitted by
+ *         the kernel, so a caller who reuses the buffers should call this
+ *         with a negative @a timeout before closing.
+ */
+APR_DECLARE(apr_status_t) apr_socket_zc_reap(apr_socket_t *sock,
+                                             apr_interval_time_t timeout,
+                                             apr_uint32_t *pending);
+
+/**
+ * Relay data from a socket to another, through a pipe with splice() on
+ * Linux, so that it's never copied to user space, or through a buffer
+ * elsewhere.
+ * @param src The socket to read the data from
+ * @param dst The socket to write the data to
+ * @param len On entry, the maximum number of bytes to relay; on exit, the
+ *            number of bytes written to @a dst.
+ * @remark The reads on @a src and the writes on @a dst follow their own
+ *         timeouts, see apr_socket_timeout_set(). An error (APR_EOF when
+ *         @a src is shut down) is only returned if no byte was written.
+ * @remark The data read from @a src that @a dst could not take (e.g. when
+ *         it's non-blocking) is kept for @a dst, and written first by the
+ *         next apr_socket_splice() to @a dst (which can be called once
+ *         @a dst is writable, even if @a src is not readable). It is
+ *         discarded when the pool of @a dst is cleaned up.
+ * @remark On Linux the pipe is reused by the calling thread, and only
+ *         kept by @a dst when data is left in it.
+ */
+APR_DECLARE(apr_status_t) apr_socket_splice(apr_socket_t *src,
+                                            apr_socket_t *dst,
+                                            apr_size_t *len);
+
 /**
  * @param sock The socket to send from
  * @param where The apr_sockaddr_t describing where to send the data
@@ -613,6 +722,65 @@ APR_DECLARE(apr_status_t) apr_socket_recvfrom(apr_sockaddr_t *from,
                                               apr_int32_t flags, char *buf,
                                               apr_size_t *len);
 
+/** A datagram, for apr_socket_sendmmsg() and apr_socket_recvmmsg() */
+typedef struct apr_socket_msg_t {
+    /** The buffers of the datagram */
+    struct iovec *vec;
+    /** The number of buffers */
+    apr_int32_t nvec;
+    /** The address to send the datagram to, or NULL on a connected
+     *  socket; on receive, updated with the address the datagram was
+     *  received from, unless NULL */
+    apr_sockaddr_t *addr;
+    /** The number of bytes sent or received */
+    apr_size_t len;
+    /** On send, if not 0, the size of the segments the datagram is split
+     *  into by the kernel or the NIC (UDP segmentation offload); on
+     *  receive, the size of the segments coalesced into the datagram
+     *  with APR_UDP_GRO, or 0 */
+    apr_uint16_t segment_size;
+} apr_socket_msg_t;
+
+/**
+ * Send a batch of datagrams, in as few system calls as possible.
+ * @param sock The socket to send from
+ * @param flags The flags to use
+ * @param msgs The datagrams to send, whose len member is updated
+ * @param nmsgs On entry, the number of datagrams to send; on exit, the
+ *              number of datagrams sent
+ * @remark This function acts like a blocking write by default, until the
+ *         first datagram is sent. An error is only returned if none is.
+ * @remark With a segment_size, a datagram is sent as len / segment_size
+ *         datagrams of that size (the last one can be shorter), which
+ *         goes through the stack once. APR_ENOTIMPL is returned where
+ *         UDP segmentation offload is not available.
+ */
+APR_DECLARE(apr_status_t) apr_socket_sendmmsg(apr_socket_t *sock,
+                                              apr_int32_t flags,
+                                              apr_socket_msg_t *msgs,
+                                              apr_uint32_t *nmsgs);
+
+/**
+ * Receive a batch of datagrams, in as few system calls as possible.
+ * @param sock The socket to receive from
+ * @param flags The flags to use
+ * @param msgs The buffers to receive the datagrams in, whose len,
+ *             segment_size and addr members are updated
+ * @param nmsgs On entry, the number of datagrams to receive; on exit, the
+ *              number of datagrams received
+ * @remark This function acts like a blocking read by default, until the
+ *         first datagram is received, then it only takes the datagrams
+ *         already queued.
+ * @remark With APR_UDP_GRO set on the socket, a received datagram can be
+ *         made of several datagrams of segment_size bytes (the last one
+ *         can be shorter), the buffers should then be large enough (64KB)
+ *         not to truncate it.
+ */
+APR_DECLARE(apr_status_t) apr_socket_recvmmsg(apr_socket_t *sock,
+                                              apr_int32_t flags,
+                                              apr_socket_msg_t *msgs,
+                                              apr_uint32_t *nmsgs);
+
 #if APR_HAS_SENDFILE || defined(DOXYGEN)
 
 /**
@@ -643,6 +811,64 @@ APR_DECLARE(apr_status_t) apr_socket_sendfile(apr_socket_t *sock,
 
 #endif /* APR_HAS_SENDFILE */
 
+/**
+ * @defgroup apr_socket_tls Kernel TLS
+ * @{
+ */
+
+#define APR_SOCKET_TLS_TX      1   /**< encrypt what is sent */
+#define APR_SOCKET_TLS_RX      2   /**< decrypt what is received */
+
+#define APR_SOCKET_TLS_1_2     0x0303  /**< TLS 1.2 records */
+#define APR_SOCKET_TLS_1_3     0x0304  /**< TLS 1.3 records */
+
+#define APR_SOCKET_TLS_AES_GCM_128          1  /**< 16 bytes key */
+#define APR_SOCKET_TLS_AES_GCM_256          2  /**< 32 bytes key */
+#define APR_SOCKET_TLS_CHACHA20_POLY1305    3  /**< 32 bytes key */
+
+/**
+ * The keys of one direction of a TLS session, as negotiated by the TLS
+ * library.
+ */
+typedef struct apr_socket_tls_keys_t {
+    /** The record version, APR_SOCKET_TLS_1_2 or APR_SOCKET_TLS_1_3 */
+    int version;
+    /** The cipher, one of the APR_SOCKET_TLS_* ciphers */
+    int cipher;
+    /** The traffic key, of the cipher's key size */
+    const unsigned char *key;
+    /** The 12 bytes IV of the traffic key (for AES-GCM in TLS 1.2, the
+     *  4 bytes implicit nonce followed by the 8 bytes of the explicit
+     *  nonce of the next record) */
+    const unsigned char *iv;
+    /** The sequence number of the next record */
+    apr_uint64_t seq;
+} apr_socket_tls_keys_t;
+
+/**
+ * Hand the record layer of a TLS session over to the kernel.
+ * @param sock The connected TCP socket of the session.
+ * @param direction APR_SOCKET_TLS_TX or APR_SOCKET_TLS_RX, each direction
+ *        is installed with its own keys.
+ * @param keys The keys of @a direction, copied.
+ * @remark Once the TX direction is installed, everything sent on the
+ * socket (apr_socket_send(), apr_socket_sendv(), apr_socket_sendfile())
+ * goes out as TLS application data records, encrypted by the kernel, so
+ * files are sent without going through user space. Once the RX direction
+ * is installed, apr_socket_recv() returns the decrypted application data.
+ * @remark This must be called after the handshake, when nothing is left
+ * buffered by the TLS library for that direction. Records other than
+ * application data (alerts, e.g. close_notify, or TLS 1.3 key updates)
+ * are not sent, and make apr_socket_recv() fail when received.
+ * @return APR_ENOTIMPL if the platform or the kernel has no TLS support,
+ * or does not support @a cipher.
+ */
+APR_DECLARE(apr_status_t) apr_socket_tls_install(apr_socket_t *sock,
+                                                 int direction,
+                                                 const apr_socket_tls_keys_t *keys);
+
+/** @} */
+
 /**
  * Read data from a network.
  * @param sock The socket to read the data from.
@@ -695,12 +921,88 @@ APR_DECLARE(apr_status_t) apr_socket_wait(apr_socket_t *sock,
  *            APR_SO_SNDBUF     --  Set the SendBufferSize
  *            APR_SO_RCVBUF     --  Set the ReceiveBufferSize
  *            APR_SO_FREEBIND   --  Allow binding to non-local IP address.
+ *            APR_SO_REUSEPORT  --  Allow several sockets to bind the same
+ *                                  address and port.
+ *            APR_UDP_GRO       --  Receive coalesced UDP datagrams.
+ *            APR_SO_BUSY_POLL  --  Busy poll for this many microseconds
+ *                                  before blocking in a receive.
+ *            APR_SO_INCOMING_CPU -- Steer the connections received on
+ *                                  that CPU to this listening socket.
+ *            APR_TCP_DEFER_ACCEPT -- Accept a connection only once data
+ *                                  is received, waiting at most this
+ *                                  many seconds.
+ *            APR_TCP_FASTOPEN  --  Allow this many pending TCP Fast Open
+ *                                  connections on a listening socket.
+ *            APR_TCP_NODELAY   --  Disable Nagle's algorithm.
+ *            APR_TCP_QUICKACK  --  Don't delay acknowledgements, the
+ *                                  kernel may reset this on its own.
  * </PRE>
  * @param on Value for the option.
+ * @return APR_ENOTIMPL if the option is not supported on the platform,
+ * APR_EACCES if the process is not allowed to set that value.
  */
 APR_DECLARE(apr_status_t) apr_socket_opt_set(apr_socket_t *sock,
                                              apr_int32_t opt, apr_int32_t on);
 
+/**
+ * @defgroup apr_socket_profile Socket option profiles
+ * @{
+ */
+
+/** An option of a profile */
+typedef struct apr_socket_optval_t {
+    /** The option, as given to apr_socket_opt_set() */
+    apr_int32_t opt;
+    /** The value of the option */
+    apr_int32_t on;
+} apr_socket_optval_t;
+
+/** A named set of socket options, applied in one call */
+typedef struct apr_socket_profile_t {
+    /** The name of the profile */
+    const char *name;
+    /** The options, applied in order */
+    const apr_socket_optval_t *opts;
+    /** The number of options */
+    int nopts;
+} apr_socket_profile_t;
+
+/**
+ * Find a predefined profile.
+ * @param name The name of the profile.  One of:
+ * <PRE>
+ *            "low-latency"         --  for connections: APR_TCP_NODELAY,
+ *                                      APR_TCP_QUICKACK and 50us of
+ *                                      APR_SO_BUSY_POLL
+ *            "low-latency-listen"  --  for listening sockets:
+ *                                      APR_TCP_NODELAY (inherited by the
+ *                                      accepted connections where the
+ *                                      platform does so), 1s of
+ *                                      APR_TCP_DEFER_ACCEPT and 256
+ *                                      APR_TCP_FASTOPEN connections
+ * </PRE>
+ * @return NULL if there is no such profile
+ * @remark Applications with other needs (e.g. buffer sizes, or
+ * APR_SO_INCOMING_CPU) define their own apr_socket_profile_t.
+ */
+APR_DECLARE(const apr_socket_profile_t *) apr_socket_profile_get(const char *name);
+
+/**
+ * Set all the options of a profile on a socket.
+ * @param sock The socket to set up.
+ * @param profile The profile.
+ * @param unsupported If not NULL, set to the options which were skipped,
+ *        ORed together.
+ * @remark The options the platform does not support (APR_ENOTIMPL), or
+ * the process is not allowed to set (APR_EACCES), are skipped, the others
+ * are set in order until one fails.
+ */
+APR_DECLARE(apr_status_t) apr_socket_profile_apply(apr_socket_t *sock,
+                                                   const apr_socket_profile_t *profile,
+                                                   apr_int32_t *unsupported);
+
+/** @} */
+
 /**
  * Setup socket timeout for the specified socket
  * @param sock The socket to set up.
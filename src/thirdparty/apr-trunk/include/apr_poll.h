@@ -73,6 +73,17 @@ extern "C" {
                                       * the specified non-default method cannot be
                                       * used
                                       */
+#define APR_POLLSET_EDGE       0x020 /**< Descriptors are edge-triggered: one is
+                                      * reported again only after new activity,
+                                      * so it must be read or written until
+                                      * APR_EAGAIN (APR_POLLSET_EPOLL only, the
+                                      * other methods stay level-triggered)
+                                      */
+#define APR_POLLSET_EXCLUSIVE  0x040 /**< Descriptors are added with
+                                      * APR_POLLEXCL, so that a listener shared
+                                      * by several pollsets wakes up only one
+                                      * of them (EPOLLEXCLUSIVE)
+                                      */
 /** @} */
 
 /**
@@ -85,7 +96,12 @@ typedef enum {
     APR_POLLSET_PORT,           /**< Poll uses Solaris event port method */
     APR_POLLSET_EPOLL,          /**< Poll uses epoll method */
     APR_POLLSET_POLL,           /**< Poll uses poll method */
-    APR_POLLSET_AIO_MSGQ        /**< Poll uses z/OS asio method */
+    APR_POLLSET_AIO_MSGQ,       /**< Poll uses z/OS asio method */
+    APR_POLLSET_IOURING         /**< Poll uses Linux io_uring method; the
+                                 *   kernel holds a reference to each polled
+                                 *   descriptor, so remove it before closing
+                                 *   or it stays open until the pollset is
+                                 *   destroyed */
 } apr_pollset_method_e;
 
 /** Used in apr_pollfd_t to determine what the apr_descriptor is */
@@ -279,9 +295,26 @@ APR_DECLARE(apr_status_t) apr_pollset_poll(apr_pollset_t *pollset,
  * @param pollset The pollset to use
  * @remark If the pollset was not created with APR_POLLSET_WAKEABLE the
  *         return value is APR_EINIT.
+ * @remark Concurrent wakeups are coalesced, and a wakeup made while no
+ *         thread is in apr_pollset_poll() is not signaled but makes the
+ *         next call return without blocking (APR_EINTR if nothing is
+ *         ready), so at most the first one costs a system call.
  */
 APR_DECLARE(apr_status_t) apr_pollset_wakeup(apr_pollset_t *pollset);
 
+struct apr_stats_histogram_t;
+
+/**
+ * Account for the number of signalled descriptors per apr_pollset_poll()
+ * @param pollset The pollset
+ * @param events The histogram of the signalled descriptors (see apr_stats.h),
+ *               or NULL to stop accounting
+ * @remark Timed out and interrupted polls are recorded as zero events,
+ *         failures are not recorded.
+ */
+APR_DECLARE(void) apr_pollset_stats_set(apr_pollset_t *pollset,
+                                        struct apr_stats_histogram_t *events);
+
 /**
  * Poll the descriptors in the poll structure
  * @param aprset The poll structure we will be using.
@@ -417,6 +450,11 @@ typedef apr_status_t (*apr_pollcb_cb_t)(void *baton, apr_pollfd_t *descriptor);
  * @remark APR_EINTR will be returned if the pollset has been created with
  *         APR_POLLSET_WAKEABLE and apr_pollcb_wakeup() has been called while
  *         waiting for activity.
+ * @remark If the pollcb has been created with APR_POLLSET_EDGE, the
+ *         descriptors signalled but not passed to @a func because it
+ *         returned an error are passed by the next call.
+ * @remark With APR_POLLSET_EPOLL, the number of descriptors passed to
+ *         @a func by one call is not limited by the size of the pollcb.
  */
 APR_DECLARE(apr_status_t) apr_pollcb_poll(apr_pollcb_t *pollcb,
                                           apr_interval_time_t timeout,
@@ -428,6 +466,11 @@ APR_DECLARE(apr_status_t) apr_pollcb_poll(apr_pollcb_t *pollcb,
  * @param pollcb The pollcb to use
  * @remark If the pollcb was not created with APR_POLLSET_WAKEABLE the
  *         return value is APR_EINIT.
+ * @remark Concurrent wakeups are coalesced, and a wakeup made while no
+ *         thread is in apr_pollcb_poll() is not signaled but makes the
+ *         next call return APR_EINTR without blocking (once the callbacks
+ *         of what is ready have run), so at most the first one costs a
+ *         system call.
  */
 APR_DECLARE(apr_status_t) apr_pollcb_wakeup(apr_pollcb_t *pollcb);
 
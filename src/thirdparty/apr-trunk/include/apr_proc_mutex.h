@@ -50,7 +50,8 @@ typedef enum {
     APR_LOCK_PROC_PTHREAD,  /**< POSIX pthread process-based locking */
     APR_LOCK_POSIXSEM,      /**< POSIX semaphore process-based locking */
     APR_LOCK_DEFAULT,       /**< Use the default process lock */
-    APR_LOCK_DEFAULT_TIMED  /**< Use the default process timed lock */
+    APR_LOCK_DEFAULT_TIMED, /**< Use the default process timed lock */
+    APR_LOCK_FUTEX          /**< Linux futex in shared memory */
 } apr_lockmech_e;
 
 /** Opaque structure representing a process mutex. */
@@ -72,12 +73,22 @@ typedef struct apr_proc_mutex_t apr_proc_mutex_t;
  *            APR_LOCK_SYSVSEM
  *            APR_LOCK_POSIXSEM
  *            APR_LOCK_PROC_PTHREAD
+ *            APR_LOCK_FUTEX
  *            APR_LOCK_DEFAULT     pick the default mechanism for the platform
  * </PRE>
  * @param pool the pool from which to allocate the mutex.
  * @see apr_lockmech_e
  * @warning Check APR_HAS_foo_SERIALIZE defines to see if the platform supports
  *          APR_LOCK_foo.  Only APR_LOCK_DEFAULT is portable.
+ * @remark APR_LOCK_FUTEX keeps the lock word in anonymous shared memory,
+ *         so that it is only inherited by forked children, and neither
+ *         locking nor unlocking enter the kernel when uncontended. The
+ *         word holds the pid of the owner: a waiter which finds that the
+ *         owner has exited takes the lock over, as if it had been
+ *         released. An exited owner is only noticed by its parent or
+ *         once reaped, and not at all if its pid has been reused by another
+ *         process meanwhile, in which case the lock stays held. Forked
+ *         children must call apr_proc_mutex_child_init() before using it.
  */
 APR_DECLARE(apr_status_t) apr_proc_mutex_create(apr_proc_mutex_t **mutex,
                                                 const char *fname,
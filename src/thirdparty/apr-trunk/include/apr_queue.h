@@ -57,6 +57,24 @@ APR_DECLARE(apr_status_t) apr_queue_create(apr_queue_t **queue,
                                            unsigned int queue_capacity,
                                            apr_pool_t *a);
 
+/**
+ * create a lock-free FIFO queue
+ *
+ * The queue is a bounded ring of slots, each with a sequence number telling
+ * whether it is free or filled for the current lap, which any number of
+ * threads push to and pop from with atomic operations only. Threads which
+ * have to wait spin for a while before sleeping, and are woken up only
+ * when there are sleepers.
+ *
+ * @param queue The new queue
+ * @param queue_capacity maximum size of the queue
+ * @param a pool to allocate queue from
+ * @remark All the functions of the API work on both kinds of queues.
+ */
+APR_DECLARE(apr_status_t) apr_queue_create_lockfree(apr_queue_t **queue,
+                                                    unsigned int queue_capacity,
+                                                    apr_pool_t *a);
+
 /**
  * push/add an object to the queue, blocking if the queue is already full
  *
@@ -135,6 +153,74 @@ APR_DECLARE(apr_status_t) apr_queue_timedpush(apr_queue_t *queue, void *data,
 APR_DECLARE(apr_status_t) apr_queue_timedpop(apr_queue_t *queue, void **data,
                                              apr_interval_time_t timeout);
 
+/**
+ * push/add up to n objects to the queue in order, blocking if the queue is
+ * already full
+ *
+ * @param queue the queue
+ * @param data the objects
+ * @param n the number of objects
+ * @param npushed the number of objects pushed, at least one on success
+ * @returns APR_EINTR the blocking was interrupted (try again)
+ * @returns APR_EOF the queue has been terminated
+ * @returns APR_SUCCESS on a successful push
+ */
+APR_DECLARE(apr_status_t) apr_queue_push_batch(apr_queue_t *queue,
+                                               void *const *data,
+                                               unsigned int n,
+                                               unsigned int *npushed);
+
+/**
+ * pop/get up to n objects from the queue, blocking if the queue is already
+ * empty
+ *
+ * @param queue the queue
+ * @param data where to store the objects
+ * @param n the maximum number of objects
+ * @param npopped the number of objects popped, at least one on success
+ * @returns APR_EINTR the blocking was interrupted (try again)
+ * @returns APR_EOF the queue has been terminated
+ * @returns APR_SUCCESS on a successful pop
+ */
+APR_DECLARE(apr_status_t) apr_queue_pop_batch(apr_queue_t *queue,
+                                              void **data,
+                                              unsigned int n,
+                                              unsigned int *npopped);
+
+/**
+ * push/add up to n objects to the queue in order, returning immediately if
+ * the queue is full
+ *
+ * @param queue the queue
+ * @param data the objects
+ * @param n the number of objects
+ * @param npushed the number of objects pushed, at least one on success
+ * @returns APR_EAGAIN the queue is full
+ * @returns APR_EOF the queue has been terminated
+ * @returns APR_SUCCESS on a successful push
+ */
+APR_DECLARE(apr_status_t) apr_queue_trypush_batch(apr_queue_t *queue,
+                                                  void *const *data,
+                                                  unsigned int n,
+                                                  unsigned int *npushed);
+
+/**
+ * pop/get up to n objects from the queue, returning immediately if the
+ * queue is empty
+ *
+ * @param queue the queue
+ * @param data where to store the objects
+ * @param n the maximum number of objects
+ * @param npopped the number of objects popped, at least one on success
+ * @returns APR_EAGAIN the queue is empty
+ * @returns APR_EOF the queue has been terminated
+ * @returns APR_SUCCESS on a successful pop
+ */
+APR_DECLARE(apr_status_t) apr_queue_trypop_batch(apr_queue_t *queue,
+                                                 void **data,
+                                                 unsigned int n,
+                                                 unsigned int *npopped);
+
 /**
  * returns the size of the queue.
  *
@@ -0,0 +1,274 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_REACTOR_H
+#define APR_REACTOR_H
+
+/**
+ * @file apr_reactor.h
+ * @brief Multi-threaded event loops
+ */
+
+#include "apu.h"
+#include "apr_errno.h"
+#include "apr_pools.h"
+#include "apr_poll.h"
+#include "apr_time.h"
+
+#if APR_HAS_THREADS
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup APR_Util_Reactor Multi-threaded event loops
+ * @ingroup APR
+ * @{
+ */
+
+/**
+ * A reactor runs a number of event loops, each in its own thread. A loop
+ * owns an apr_pollcb_t, on which it watches descriptors, a timer list,
+ * and a queue of tasks posted by the other threads, which wake it up
+ * through the pollcb.
+ *
+ * Everything a loop runs (I/O, timer and task callbacks) runs in its
+ * thread, one at a time: the state of a connection handled by a single
+ * loop needs no locking. Descriptors and timers are managed from the
+ * loop's own thread only, other threads post a task to the loop to do so.
+ */
+
+/** opaque reactor */
+typedef struct apr_reactor_t apr_reactor_t;
+
+/** opaque event loop of a reactor */
+typedef struct apr_reactor_loop_t apr_reactor_loop_t;
+
+/** opaque descriptor watched by a loop */
+typedef struct apr_reactor_io_t apr_reactor_io_t;
+
+/** opaque timer of a loop */
+typedef struct apr_reactor_timer_t apr_reactor_timer_t;
+
+/**
+ * task or timer callback
+ * @param loop the loop running the callback
+ * @param baton the baton given with the task or timer
+ */
+typedef void (*apr_reactor_fn_t)(apr_reactor_loop_t *loop, void *baton);
+
+/**
+ * I/O callback
+ * @param loop the loop running the callback
+ * @param pfd the watched descriptor, with the triggered events in its
+ * rtnevents member
+ * @param baton the baton given with the descriptor
+ */
+typedef void (*apr_reactor_io_fn_t)(apr_reactor_loop_t *loop,
+                                    const apr_pollfd_t *pfd, void *baton);
+
+/**
+ * accept callback
+ * @param loop the loop which accepted the connection
+ * @param sock the new connection, non-blocking
+ * @param pool the pool of the connection, a child of the loop's pool
+ * @param baton the baton given to apr_reactor_listen()
+ * @remark The callback owns @a pool, which must only be used and
+ * destroyed from the loop's thread (e.g. by the connection's own
+ * callbacks).
+ */
+typedef void (*apr_reactor_accept_fn_t)(apr_reactor_loop_t *loop,
+                                        apr_socket_t *sock,
+                                        apr_pool_t *pool, void *baton);
+
+/**
+ * create a reactor and start its loops
+ *
+ * @param reactor the new reactor
+ * @param nloops the number of loops (and threads)
+ * @param size the size of each loop's pollcb, and the number of tasks
+ * its queue holds
+ * @param pool the pool to allocate the reactor from
+ * @remark The loops are stopped and their threads joined when @a pool
+ * is cleared, or by apr_reactor_destroy().
+ */
+APR_DECLARE(apr_status_t) apr_reactor_create(apr_reactor_t **reactor,
+                                             int nloops, apr_uint32_t size,
+                                             apr_pool_t *pool);
+
+/**
+ * stop the loops, join their threads and destroy the reactor
+ *
+ * @param reactor the reactor
+ * @remark The tasks still queued are not run.
+ */
+APR_DECLARE(apr_status_t) apr_reactor_destroy(apr_reactor_t *reactor);
+
+/**
+ * get the number of loops of a reactor
+ *
+ * @param reactor the reactor
+ */
+APR_DECLARE(int) apr_reactor_nloops(const apr_reactor_t *reactor);
+
+/**
+ * get a loop of a reactor
+ *
+ * @param reactor the reactor
+ * @param n the index of the loop, from 0 to apr_reactor_nloops() - 1
+ * @returns NULL if there is no such loop
+ */
+APR_DECLARE(apr_reactor_loop_t *) apr_reactor_loop_get(apr_reactor_t *reactor,
+                                                       int n);
+
+/**
+ * get the loop a key (e.g. a connection or session id) is affine to
+ *
+ * @param reactor the reactor
+ * @param key the key
+ * @remark A key is always mapped to the same loop, so that the tasks
+ * posted for it run in order and never concurrently.
+ */
+APR_DECLARE(apr_reactor_loop_t *) apr_reactor_loop_for(apr_reactor_t *reactor,
+                                                       apr_uint64_t key);
+
+/**
+ * get the index of a loop
+ *
+ * @param loop the loop
+ */
+APR_DECLARE(int) apr_reactor_loop_index(const apr_reactor_loop_t *loop);
+
+/**
+ * get the reactor of a loop
+ *
+ * @param loop the loop
+ */
+APR_DECLARE(apr_reactor_t *) apr_reactor_loop_reactor(const apr_reactor_loop_t *loop);
+
+/**
+ * get the pool of a loop, which lives until the reactor is destroyed
+ *
+ * @param loop the loop
+ * @remark The pool must only be used from the loop's thread.
+ */
+APR_DECLARE(apr_pool_t *) apr_reactor_loop_pool(const apr_reactor_loop_t *loop);
+
+/**
+ * post a task to a loop, from any thread
+ *
+ * @param loop the loop
+ * @param func the task
+ * @param baton the baton for @a func
+ * @returns APR_EAGAIN the loop's queue is full
+ * @returns APR_EOF the reactor is being destroyed
+ * @remark The tasks posted to a loop by a thread run in the order they
+ * were posted.
+ */
+APR_DECLARE(apr_status_t) apr_reactor_post(apr_reactor_loop_t *loop,
+                                           apr_reactor_fn_t func,
+                                           void *baton);
+
+/**
+ * watch a descriptor, from the loop's thread
+ *
+ * @param io where to return the handle of the watch
+ * @param loop the loop
+ * @param pfd the descriptor and the events to watch, copied
+ * @param func the callback for the events
+ * @param baton the baton for @a func
+ * @remark The descriptor is level-triggered. The client_data member of
+ * @a pfd is not kept, @a baton is passed instead.
+ */
+APR_DECLARE(apr_status_t) apr_reactor_io_add(apr_reactor_io_t **io,
+                                             apr_reactor_loop_t *loop,
+                                             const apr_pollfd_t *pfd,
+                                             apr_reactor_io_fn_t func,
+                                             void *baton);
+
+/**
+ * stop watching a descriptor, from the loop's thread
+ *
+ * @param io the handle returned by apr_reactor_io_add()
+ * @remark The callback is not called anymore, even for the events
+ * already received, and @a io must not be used afterward. The descriptor
+ * must be removed before it's closed.
+ */
+APR_DECLARE(apr_status_t) apr_reactor_io_remove(apr_reactor_io_t *io);
+
+/**
+ * run a callback after some time, from the loop's thread
+ *
+ * @param timer where to return the handle of the timer, may be NULL
+ * @param loop the loop
+ * @param delay the time to wait before running @a func
+ * @param func the callback
+ * @param baton the baton for @a func
+ * @remark Timers due at the same time run in the order they were added.
+ */
+APR_DECLARE(apr_status_t) apr_reactor_timer_add(apr_reactor_timer_t **timer,
+                                                apr_reactor_loop_t *loop,
+                                                apr_interval_time_t delay,
+                                                apr_reactor_fn_t func,
+                                                void *baton);
+
+/**
+ * cancel a timer which has not run yet, from the loop's thread
+ *
+ * @param timer the handle returned by apr_reactor_timer_add()
+ * @remark @a timer must not be used once its callback has been called,
+ * nor once it is cancelled.
+ */
+APR_DECLARE(apr_status_t) apr_reactor_timer_cancel(apr_reactor_timer_t *timer);
+
+/**
+ * listen on an address from every loop
+ *
+ * Each loop gets its own listening socket bound with APR_SO_REUSEPORT,
+ * so the kernel shards the incoming connections among the loops, which
+ * then handle them. Where APR_SO_REUSEPORT is not supported, the loops
+ * share one listening socket, watched with APR_POLLEXCL.
+ *
+ * @param reactor the reactor
+ * @param sa the address to listen on, if its port is 0 the port chosen
+ * for the first socket is used for all of them
+ * @param backlog the backlog of each listening socket
+ * @param func the callback for the accepted connections
+ * @param baton the baton for @a func
+ * @remark The call returns once every loop watches its listening socket,
+ * or with the error of the first loop which could not, after the other
+ * loops have stopped watching theirs and the sockets have been closed.
+ * Otherwise the listening sockets are closed with the reactor.
+ * @remark The call waits for the other loops to run a task: it must not
+ * be called from two loops at the same time, each would wait for the
+ * other forever.
+ */
+APR_DECLARE(apr_status_t) apr_reactor_listen(apr_reactor_t *reactor,
+                                             apr_sockaddr_t *sa,
+                                             apr_int32_t backlog,
+                                             apr_reactor_accept_fn_t func,
+                                             void *baton);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APR_HAS_THREADS */
+
+#endif /* APR_REACTOR_H */
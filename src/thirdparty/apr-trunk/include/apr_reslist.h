@@ -94,6 +94,47 @@ APR_DECLARE(apr_status_t) apr_reslist_create(apr_reslist_t **reslist,
                                              void *params,
                                              apr_pool_t *pool);
 
+/**
+ * Create a new sharded resource list, with the same parameters as
+ * apr_reslist_create() and the number of shards.
+ *
+ * A released resource is parked in a slot picked by the releasing thread,
+ * from where the same thread takes it back at its next acquire, with
+ * atomic operations only. Resources which do not fit in a slot go to a
+ * shard, picked by thread too, with its own lock. Threads only have to
+ * wait on the list when hmax is reached and no resource is available.
+ *
+ * @param reslist An address where the pointer to the new resource
+ *                list will be stored.
+ * @param min Allowed minimum number of available resources.
+ * @param smax Soft maximum on the number of resources, see
+ *             apr_reslist_create().
+ * @param hmax Absolute maximum limit on the number of total resources.
+ * @param ttl Maximum amount of time in microseconds an unused resource is
+ *            valid, or zero.
+ * @param con Constructor routine that is called to create a new resource.
+ * @param de Destructor routine that is called to destroy an expired resource.
+ * @param params Passed to constructor and deconstructor
+ * @param nshards The number of shards, typically the number of CPUs.
+ * @param pool The pool from which to create this resource list.
+ * @remark All the functions of the API work on both kinds of lists. The
+ *         constructor and destructor are still called one at a time, the
+ *         pool being shared. Acquiring with APR_RESLIST_ACQUIRE_FIFO skips
+ *         the thread's slot, and the order only holds within a shard.
+ * @remark Maintenance is run by apr_reslist_release() only when the number
+ *         of available resources is below min or, with a ttl, when above
+ *         smax and the oldest available resource may have expired.
+ */
+APR_DECLARE(apr_status_t) apr_reslist_create_sharded(apr_reslist_t **reslist,
+                                                     int min, int smax,
+                                                     int hmax,
+                                                     apr_interval_time_t ttl,
+                                                     apr_reslist_constructor con,
+                                                     apr_reslist_destructor de,
+                                                     void *params,
+                                                     int nshards,
+                                                     apr_pool_t *pool);
+
 /**
  * Destroy the given resource list and all resources controlled by
  * this list.
@@ -0,0 +1,132 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_SPSC_QUEUE_H
+#define APR_SPSC_QUEUE_H
+
+/**
+ * @file apr_spsc_queue.h
+ * @brief Single producer, single consumer record queue
+ */
+
+#include "apu.h"
+#include "apr_errno.h"
+#include "apr_pools.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup APR_Util_SPSC Single producer, single consumer record queue
+ * @ingroup APR
+ * @{
+ */
+
+/**
+ * opaque structure
+ */
+typedef struct apr_spsc_queue_t apr_spsc_queue_t;
+
+/**
+ * create a single producer, single consumer queue
+ *
+ * The queue is a byte ring holding variable-length records, which are
+ * written and read in place. The producer and the consumer each own one
+ * index, kept in its own cache line, and only look at the other side's
+ * index when their cached copy says the ring is full or empty.
+ *
+ * @param queue The new queue
+ * @param size the size of the ring in bytes, rounded up to a power of two
+ * @param a pool to allocate queue from
+ * @remark At most one thread may produce and one thread may consume at any
+ * time. None of the calls block, waiting on APR_EAGAIN is up to the caller.
+ */
+APR_DECLARE(apr_status_t) apr_spsc_queue_create(apr_spsc_queue_t **queue,
+                                                apr_size_t size,
+                                                apr_pool_t *a);
+
+/**
+ * reserve room for a record of len bytes at the end of the queue
+ *
+ * @param queue the queue
+ * @param len the length of the record
+ * @param rec where to store the address of the record, to be filled in
+ * @returns APR_EAGAIN the queue is full
+ * @returns APR_EINVAL the record can never fit (more than half the size)
+ * @returns APR_SUCCESS on success
+ * @remark The record is invisible to the consumer until committed, a
+ * reservation which is not committed is simply forgotten by the next one.
+ */
+APR_DECLARE(apr_status_t) apr_spsc_queue_reserve(apr_spsc_queue_t *queue,
+                                                 apr_size_t len, void **rec);
+
+/**
+ * publish the record returned by the last apr_spsc_queue_reserve()
+ *
+ * @param queue the queue
+ * @param rec the reserved record
+ * @param len the final length of the record, up to the reserved one
+ * @returns APR_EINVAL rec is not the pending reservation, or len is too large
+ * @returns APR_SUCCESS on success
+ */
+APR_DECLARE(apr_status_t) apr_spsc_queue_commit(apr_spsc_queue_t *queue,
+                                                void *rec, apr_size_t len);
+
+/**
+ * copy a record of len bytes to the end of the queue
+ *
+ * @param queue the queue
+ * @param data the record
+ * @param len the length of the record
+ * @returns APR_EAGAIN the queue is full
+ * @returns APR_EINVAL the record can never fit (more than half the size)
+ * @returns APR_SUCCESS on success
+ */
+APR_DECLARE(apr_status_t) apr_spsc_queue_push(apr_spsc_queue_t *queue,
+                                              const void *data,
+                                              apr_size_t len);
+
+/**
+ * get the record at the front of the queue, without removing it
+ *
+ * @param queue the queue
+ * @param rec where to store the address of the record
+ * @param len where to store the length of the record
+ * @returns APR_EAGAIN the queue is empty
+ * @returns APR_SUCCESS on success
+ * @remark The record stays valid until apr_spsc_queue_release().
+ */
+APR_DECLARE(apr_status_t) apr_spsc_queue_peek(apr_spsc_queue_t *queue,
+                                              void **rec, apr_size_t *len);
+
+/**
+ * remove the record returned by apr_spsc_queue_peek(), giving its room
+ * back to the producer
+ *
+ * @param queue the queue
+ * @returns APR_EINVAL no record was peeked
+ * @returns APR_SUCCESS on success
+ */
+APR_DECLARE(apr_status_t) apr_spsc_queue_release(apr_spsc_queue_t *queue);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APR_SPSC_QUEUE_H */
@@ -0,0 +1,246 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_STATS_H
+#define APR_STATS_H
+
+/**
+ * @file apr_stats.h
+ * @brief Sharded counters and latency histograms
+ */
+
+#include "apu.h"
+#include "apr_errno.h"
+#include "apr_pools.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup APR_Util_Stats Sharded counters and histograms
+ * @ingroup APR
+ * @{
+ */
+
+/**
+ * opaque structures
+ */
+typedef struct apr_stats_t apr_stats_t;
+typedef struct apr_stats_counter_t apr_stats_counter_t;
+typedef struct apr_stats_histogram_t apr_stats_histogram_t;
+
+/** shard by the CPU the caller runs on rather than by thread */
+#define APR_STATS_PER_CPU 0x01
+
+/** metric types, see apr_stats_do() */
+typedef enum {
+    APR_STATS_COUNTER,
+    APR_STATS_HISTOGRAM
+} apr_stats_type_e;
+
+/**
+ * a point in time copy of a histogram
+ */
+typedef struct apr_stats_snapshot_t {
+    /** number of values recorded */
+    apr_uint64_t count;
+    /** sum of the values recorded */
+    apr_uint64_t sum;
+    /** highest value recorded */
+    apr_uint64_t max;
+    /** number of buckets */
+    apr_size_t nbuckets;
+    /** number of values recorded per bucket */
+    apr_uint64_t *buckets;
+    /** significant bits kept per value, bucket i covers the values
+     * from apr_stats_bucket_value(snap, i) up to the next bucket's */
+    int precision;
+} apr_stats_snapshot_t;
+
+/**
+ * create a metrics registry
+ *
+ * Metrics are split in shards, each updated by a subset of the threads
+ * and on its own cache line, so that updating does not bounce a shared
+ * line between CPUs; shards are summed when read. By default threads are
+ * spread over the shards round-robin, APR_STATS_PER_CPU picks the shard
+ * of the CPU running the caller instead, where the platform tells.
+ *
+ * @param stats the new registry
+ * @param flags 0 or APR_STATS_PER_CPU
+ * @param p a pool to allocate the registry and its metrics from
+ * @returns APR_SUCCESS on success
+ */
+APR_DECLARE(apr_status_t) apr_stats_create(apr_stats_t **stats,
+                                           apr_uint32_t flags,
+                                           apr_pool_t *p);
+
+/**
+ * create a counter
+ *
+ * @param counter the new counter
+ * @param stats the registry
+ * @param name the counter's name, copied
+ * @returns APR_SUCCESS on success
+ */
+APR_DECLARE(apr_status_t) apr_stats_counter_create(
+        apr_stats_counter_t **counter, apr_stats_t *stats, const char *name);
+
+/**
+ * add to a counter
+ *
+ * @param counter the counter
+ * @param val the value to add
+ */
+APR_DECLARE(void) apr_stats_counter_add(apr_stats_counter_t *counter,
+                                        apr_uint64_t val);
+
+/**
+ * subtract from a counter
+ *
+ * @param counter the counter
+ * @param val the value to subtract
+ * @remark Shards may wrap around, only their sum is meaningful.
+ */
+APR_DECLARE(void) apr_stats_counter_sub(apr_stats_counter_t *counter,
+                                        apr_uint64_t val);
+
+/**
+ * read a counter, summing its shards
+ *
+ * @param counter the counter
+ * @returns the counter's value
+ * @remark Concurrent updates may or may not be accounted.
+ */
+APR_DECLARE(apr_uint64_t) apr_stats_counter_read(
+        const apr_stats_counter_t *counter);
+
+/**
+ * create a histogram
+ *
+ * Values are bucketed with their precision most significant bits kept,
+ * hence a relative error of at most 2^-precision over the whole range
+ * (e.g. 1% for a precision of 7).
+ *
+ * @param hist the new histogram
+ * @param stats the registry
+ * @param name the histogram's name, copied
+ * @param highest the highest value to track, higher ones are recorded as
+ * this one (but still accounted for in the sum and max)
+ * @param precision the significant bits kept, from 1 to 10
+ * @returns APR_EINVAL the precision is out of range
+ * @returns APR_SUCCESS on success
+ */
+APR_DECLARE(apr_status_t) apr_stats_histogram_create(
+        apr_stats_histogram_t **hist, apr_stats_t *stats, const char *name,
+        apr_uint64_t highest, int precision);
+
+/**
+ * record a value in a histogram
+ *
+ * @param hist the histogram
+ * @param val the value
+ * @remark Lock-free, recording takes a few relaxed atomic additions on the
+ * caller's shard.
+ */
+APR_DECLARE(void) apr_stats_histogram_record(apr_stats_histogram_t *hist,
+                                             apr_uint64_t val);
+
+/**
+ * take a snapshot of a histogram, summing its shards
+ *
+ * @param snap the new snapshot
+ * @param hist the histogram
+ * @param p a pool to allocate the snapshot from
+ * @returns APR_SUCCESS on success
+ * @remark Concurrent records may be partly accounted, e.g. in count but
+ * not yet in the buckets.
+ */
+APR_DECLARE(apr_status_t) apr_stats_histogram_snapshot(
+        apr_stats_snapshot_t **snap, const apr_stats_histogram_t *hist,
+        apr_pool_t *p);
+
+/**
+ * get the lowest value of a snapshot's bucket
+ *
+ * @param snap the snapshot
+ * @param bucket the bucket's index
+ * @returns the lowest value counted in the bucket
+ */
+APR_DECLARE(apr_uint64_t) apr_stats_bucket_value(
+        const apr_stats_snapshot_t *snap, apr_size_t bucket);
+
+/**
+ * get a percentile of the values recorded in a snapshot
+ *
+ * @param snap the snapshot
+ * @param percentile the percentile, from 0.0 to 100.0
+ * @returns the value at this percentile, within the histogram's
+ * precision, or 0 if nothing was recorded
+ */
+APR_DECLARE(apr_uint64_t) apr_stats_snapshot_percentile(
+        const apr_stats_snapshot_t *snap, double percentile);
+
+/**
+ * callback for apr_stats_do()
+ *
+ * @param baton the baton passed to apr_stats_do()
+ * @param name the metric's name
+ * @param type the metric's type
+ * @param value the counter's value, or the histogram's count
+ * @param snap the histogram's snapshot, NULL for counters
+ * @returns APR_SUCCESS to continue, any other status to stop iterating
+ */
+typedef apr_status_t (apr_stats_do_callback_fn_t)(void *baton,
+                                                  const char *name,
+                                                  apr_stats_type_e type,
+                                                  apr_uint64_t value,
+                                                  const apr_stats_snapshot_t *snap);
+
+/**
+ * iterate over the metrics of a registry, in creation order
+ *
+ * @param stats the registry
+ * @param cb the callback
+ * @param baton passed to the callback
+ * @param p a pool to allocate the snapshots from
+ * @returns APR_SUCCESS if the callback returned APR_SUCCESS for every
+ * metric, otherwise the status it stopped the iteration with
+ */
+APR_DECLARE(apr_status_t) apr_stats_do(apr_stats_t *stats,
+                                       apr_stats_do_callback_fn_t *cb,
+                                       void *baton, apr_pool_t *p);
+
+/**
+ * export the metrics of a registry as text, one line per metric
+ *
+ * Counters are output as "name value", histograms as "name count=n
+ * sum=n max=n p50=n p90=n p99=n p999=n".
+ *
+ * @param stats the registry
+ * @param p a pool to allocate the text from
+ * @returns the text
+ */
+APR_DECLARE(const char *) apr_stats_dump(apr_stats_t *stats, apr_pool_t *p);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APR_STATS_H */
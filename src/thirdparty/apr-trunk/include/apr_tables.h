@@ -70,8 +70,18 @@ struct apr_array_header_t {
     int nalloc;
     /** The elements in the array */
     char *elts;
+    /** How the elements are allocated, see apr_array_make_ex() */
+    int flags;
 };
 
+/**
+ * Allocate the elements of an array from the heap, growing them in place
+ * with realloc(), instead of allocating each larger block from the pool.
+ * The elements are freed when the pool of the array is cleared or
+ * destroyed, unless they were moved out with apr_array_move_out().
+ */
+#define APR_ARRAY_HEAP 0x1
+
 /**
  * The (opaque) structure for string-content tables.
  */
@@ -121,6 +131,24 @@ APR_DECLARE(int) apr_is_empty_array(const apr_array_header_t *a);
 APR_DECLARE(apr_array_header_t *) apr_array_make(apr_pool_t *p,
                                                  int nelts, int elt_size);
 
+/**
+ * Create an array with the given allocation flags.
+ * @param p The pool to allocate the memory out of
+ * @param nelts the number of elements in the initial array
+ * @param elt_size The size of each element in the array.
+ * @param flags 0 or APR_ARRAY_HEAP
+ * @return The new array, or NULL if the elements can't be allocated
+ * @remark A pool array leaves each outgrown block behind in the pool, so
+ *         that an array built one push at a time uses up to twice its
+ *         final size.  A heap array doesn't, which suits large arrays in
+ *         long-lived pools.  Since a heap array may move its elements
+ *         when it grows, a header copied with apr_array_copy_hdr() is only
+ *         valid until the next push into the original array.
+ */
+APR_DECLARE(apr_array_header_t *) apr_array_make_ex(apr_pool_t *p,
+                                                    int nelts, int elt_size,
+                                                    int flags);
+
 /**
  * Add a new element to an array (as a first-in, last-out stack).
  * @param arr The array to add an element to.
@@ -130,6 +158,30 @@ APR_DECLARE(apr_array_header_t *) apr_array_make(apr_pool_t *p,
  */
 APR_DECLARE(void *) apr_array_push(apr_array_header_t *arr);
 
+/**
+ * Add several new elements to an array at once.
+ * @param arr The array to add the elements to.
+ * @param nelts The number of elements to add.
+ * @return Location of the first new element, the others follow it, or
+ *         NULL if @a nelts is negative or the array can't grow that much.
+ *         The new elements are zeroed, even when their space is reused.
+ * @remark The array grows at most once, to the next power of two times
+ *         its current size which holds all the elements.
+ */
+APR_DECLARE(void *) apr_array_push_n(apr_array_header_t *arr, int nelts);
+
+/**
+ * Make room in an array for a total number of elements.
+ * @param arr The array to grow.
+ * @param nelts The number of elements the array should be able to hold
+ *        without allocating.
+ * @return APR_SUCCESS, APR_EINVAL if @a nelts is negative, or APR_ENOMEM
+ *         if the space can't be allocated or addressed.
+ * @remark Nothing is done if the array is already large enough.
+ */
+APR_DECLARE(apr_status_t) apr_array_reserve(apr_array_header_t *arr,
+                                            int nelts);
+
 /** A helper macro for accessing a member of an APR array.
  *
  * @param ary the array
@@ -165,14 +217,28 @@ APR_DECLARE(void *) apr_array_pop(apr_array_header_t *arr);
  */
 APR_DECLARE(void) apr_array_clear(apr_array_header_t *arr);
 
+/**
+ * Move the elements out of an array, leaving it empty.
+ * @param arr The array to take the elements from.
+ * @param nelts Where to return the number of elements (optional).
+ * @return The elements, or NULL if none were allocated.
+ * @remark The elements of an APR_ARRAY_HEAP array are then owned by the
+ *         caller, who must free() them.  Those of a pool array stay in the
+ *         pool.  Either way the array can be used again, and allocates a
+ *         new block on the next push.
+ */
+APR_DECLARE(void *) apr_array_move_out(apr_array_header_t *arr, int *nelts);
+
 /**
  * Concatenate two arrays together.
  * @param dst The destination array, and the one to go first in the combined
  *            array
  * @param src The source array to add to the destination array
+ * @return APR_SUCCESS, or APR_ENOMEM if the destination array can't grow
+ *         that much, in which case it is left unchanged.
  */
-APR_DECLARE(void) apr_array_cat(apr_array_header_t *dst,
-			        const apr_array_header_t *src);
+APR_DECLARE(apr_status_t) apr_array_cat(apr_array_header_t *dst,
+                                        const apr_array_header_t *src);
 
 /**
  * Copy the entire array.
@@ -201,7 +267,8 @@ APR_DECLARE(apr_array_header_t *) apr_array_copy_hdr(apr_pool_t *p,
  * @param p The pool to allocate the new array out of
  * @param first The array to put first in the new array.
  * @param second The array to put second in the new array.
- * @return A new array containing the data from the two arrays passed in.
+ * @return A new array containing the data from the two arrays passed in,
+ *         or NULL if it can't be allocated.
 */
 APR_DECLARE(apr_array_header_t *) apr_array_append(apr_pool_t *p,
                                       const apr_array_header_t *first,
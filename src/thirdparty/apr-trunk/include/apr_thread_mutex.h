@@ -44,6 +44,9 @@ typedef struct apr_thread_mutex_t apr_thread_mutex_t;
 #define APR_THREAD_MUTEX_NESTED   0x1   /**< enable nested (recursive) locks */
 #define APR_THREAD_MUTEX_UNNESTED 0x2   /**< disable nested locks */
 #define APR_THREAD_MUTEX_TIMED    0x4   /**< enable timed locks */
+#define APR_THREAD_MUTEX_ADAPTIVE 0x8   /**< spin a while before blocking */
+#define APR_THREAD_MUTEX_READER_BIASED 0x10 /**< scalable readers, for
+                                              * apr_thread_rwlock_create_ex() */
 
 /* Delayed the include to avoid a circular reference */
 #include "apr_pools.h"
@@ -58,11 +61,19 @@ typedef struct apr_thread_mutex_t apr_thread_mutex_t;
  *           APR_THREAD_MUTEX_DEFAULT   platform-optimal lock behavior.
  *           APR_THREAD_MUTEX_NESTED    enable nested (recursive) locks.
  *           APR_THREAD_MUTEX_UNNESTED  disable nested locks (non-recursive).
+ *           APR_THREAD_MUTEX_TIMED     enable timed locks.
+ *           APR_THREAD_MUTEX_ADAPTIVE  retry a bounded number of times
+ *                                      before blocking.
  * </PRE>
  * @param pool the pool from which to allocate the mutex.
  * @warning Be cautious in using APR_THREAD_MUTEX_DEFAULT.  While this is the
  * most optimal mutex based on a given platform's performance characteristics,
  * it will behave as either a nested or an unnested lock.
+ * @remark An adaptive mutex is meant for short critical sections: when it
+ * is held, the locker spins for a while (on multiprocessors only) hoping
+ * for it to be released, before going to sleep. On Linux it is a futex
+ * word, locked and unlocked without a system call when uncontended, except
+ * for nested mutexes which stay on pthread.
  */
 APR_DECLARE(apr_status_t) apr_thread_mutex_create(apr_thread_mutex_t **mutex,
                                                   unsigned int flags,
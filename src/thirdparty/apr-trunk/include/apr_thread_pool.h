@@ -79,6 +79,38 @@ APR_DECLARE(apr_status_t) apr_thread_pool_create(apr_thread_pool_t **me,
                                                  apr_size_t max_threads,
                                                  apr_pool_t *pool);
 
+/**
+ * Use a work-stealing scheduler: each thread has its own deque of tasks.
+ * The tasks pushed by a thread of the pool go to that deque, where the
+ * thread takes them last-in first-out without locking. Idle threads steal
+ * the oldest tasks from the other deques. Tasks pushed from outside the
+ * pool, and scheduled tasks, still go through the shared priority queue.
+ */
+#define APR_THREAD_POOL_WORK_STEALING 0x1
+
+/**
+ * Create a thread pool with the given scheduling flags
+ * @param me The pointer in which to return the newly created apr_thread_pool
+ * object, or NULL if thread pool creation fails.
+ * @param init_threads The number of threads to be created initially, this number
+ * will also be used as the initial value for the maximum number of idle threads.
+ * @param max_threads The maximum number of threads that can be created
+ * @param flags 0 or APR_THREAD_POOL_WORK_STEALING
+ * @param pool The pool to use
+ * @return APR_SUCCESS if the thread pool was created successfully. Otherwise,
+ * the error code.
+ * @remark In work-stealing mode, the priority of a task pushed to a deque
+ * (by apr_thread_pool_push() or apr_thread_pool_top() from a task) is not
+ * used for ordering. Such tasks are owned and cancelled as any other.
+ * Only the first max_threads threads get a deque; threads added later by
+ * apr_thread_pool_thread_max_set() only steal.
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_create_ex(apr_thread_pool_t **me,
+                                                    apr_size_t init_threads,
+                                                    apr_size_t max_threads,
+                                                    int flags,
+                                                    apr_pool_t *pool);
+
 /**
  * Destroy the thread pool and stop all the threads
  * @return APR_SUCCESS if all threads are stopped.
@@ -99,6 +131,98 @@ APR_DECLARE(apr_status_t) apr_thread_pool_push(apr_thread_pool_t *me,
                                                void *param,
                                                apr_byte_t priority,
                                                void *owner);
+
+/** Opaque completion latch, see apr_thread_pool_push_batch(). */
+typedef struct apr_thread_pool_latch_t apr_thread_pool_latch_t;
+
+/** A task to be pushed by apr_thread_pool_push_batch() */
+typedef struct apr_thread_pool_task_desc_t {
+    /** The task function */
+    apr_thread_start_t func;
+    /** The parameter for the task function */
+    void *param;
+    /** Owner of this task */
+    void *owner;
+    /** The priority of the task */
+    apr_byte_t priority;
+} apr_thread_pool_task_desc_t;
+
+/**
+ * Schedule a batch of tasks, each to the bottom of the tasks of same
+ * priority, as apr_thread_pool_push() would.
+ * @param me The thread pool
+ * @param tasks The tasks to push
+ * @param n The number of tasks
+ * @param latch A latch to be counted down once for each task, when it has
+ * run or has been cancelled, or NULL
+ * @return APR_SUCCESS if the tasks had been scheduled successfully
+ * @remark The lock of the pool is taken once for the whole batch, and at
+ * most as many idle threads as there are tasks are woken up.
+ * @remark The latch is raised by @a n before any task is queued, and
+ * lowered again for the tasks which could not be queued on error.
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_push_batch(apr_thread_pool_t *me,
+                                   const apr_thread_pool_task_desc_t *tasks,
+                                   apr_size_t n,
+                                   apr_thread_pool_latch_t *latch);
+
+/**
+ * Create a latch, a counter which threads can wait on to drop to zero.
+ * @param latch The pointer in which to return the newly created latch
+ * @param pool The pool to use
+ * @return APR_SUCCESS if the latch was created successfully
+ * @remark A latch is usually given to apr_thread_pool_push_batch() to wait
+ * for a group of tasks, but it can also be counted explicitly. It can be
+ * reused once it has dropped to zero.
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_latch_create(
+                                            apr_thread_pool_latch_t **latch,
+                                            apr_pool_t *pool);
+
+/**
+ * Raise the count of a latch
+ * @param latch The latch
+ * @param n The number to add
+ */
+APR_DECLARE(void) apr_thread_pool_latch_add(apr_thread_pool_latch_t *latch,
+                                            apr_uint32_t n);
+
+/**
+ * Lower the count of a latch by one, waking up the waiters if it drops
+ * to zero.
+ * @param latch The latch
+ * @remark Only the last count down takes the lock of the latch.
+ */
+APR_DECLARE(void) apr_thread_pool_latch_done(apr_thread_pool_latch_t *latch);
+
+/**
+ * Get the current count of a latch
+ * @param latch The latch
+ * @return The number of counts not done yet
+ */
+APR_DECLARE(apr_uint32_t) apr_thread_pool_latch_count(
+                                            apr_thread_pool_latch_t *latch);
+
+/**
+ * Wait for the count of a latch to drop to zero
+ * @param latch The latch
+ * @return APR_SUCCESS once the count is zero
+ * @note A task should not wait on a latch of tasks queued behind it in the
+ * same pool, unless other threads are available to run them.
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_latch_wait(
+                                            apr_thread_pool_latch_t *latch);
+
+/**
+ * Wait for the count of a latch to drop to zero, for a limited time
+ * @param latch The latch
+ * @param timeout The maximum time to wait, in microseconds
+ * @return APR_SUCCESS once the count is zero, or APR_TIMEUP
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_latch_timedwait(
+                                            apr_thread_pool_latch_t *latch,
+                                            apr_interval_time_t timeout);
+
 /**
  * Schedule a task to be run after a delay
  * @param me The thread pool
@@ -137,6 +261,7 @@ APR_DECLARE(apr_status_t) apr_thread_pool_top(apr_thread_pool_t *me,
  * @return APR_SUCCESS if the task has been cancelled successfully
  * @note The task function should not be calling cancel, otherwise the function
  * may get stuck forever. The function assert if it detect such a case.
+ * @remark This goes through all the queued and scheduled tasks.
  */
 APR_DECLARE(apr_status_t) apr_thread_pool_tasks_cancel(apr_thread_pool_t *me,
                                                        void *owner);
@@ -280,6 +405,82 @@ APR_DECLARE(apr_size_t) apr_thread_pool_threshold_set(apr_thread_pool_t *me,
  */
 APR_DECLARE(apr_size_t) apr_thread_pool_threshold_get(apr_thread_pool_t * me);
 
+/**
+ * Access function for the starvation limit of the priority lanes.
+ * Queued tasks are kept in four lanes by priority (0-63, 64-127, 128-191
+ * and 192-255), and a thread always takes a task of the highest non-empty
+ * lane. With a non-zero limit, a lane which has been passed over for that
+ * many tasks while it was not empty gets the next one instead.
+ * Each priority has its own queue, so queuing and taking a task does not
+ * depend on the number of tasks queued.
+ * @param me The thread pool
+ * @param limit The new limit, 0 for strict priority (the default)
+ * @return The original limit
+ * @remark In work-stealing mode, this only applies to the shared queue.
+ */
+APR_DECLARE(apr_size_t) apr_thread_pool_starvation_limit_set(
+                                                    apr_thread_pool_t *me,
+                                                    apr_size_t limit);
+
+/**
+ * Access function for the starvation limit of the priority lanes.
+ * @param me The thread pool
+ * @return The current limit
+ */
+APR_DECLARE(apr_size_t) apr_thread_pool_starvation_limit_get(
+                                                    apr_thread_pool_t *me);
+
+struct apr_stats_histogram_t;
+
+/**
+ * Account for the time tasks wait in the queue and the time they run,
+ * in microseconds.
+ * @param me The thread pool
+ * @param queue_wait The histogram of the queue waits (see apr_stats.h), or
+ *        NULL
+ * @param run_time The histogram of the run times, or NULL
+ * @remark Only tasks pushed or scheduled afterwards are accounted for their
+ * queue wait, scheduled tasks from the time they are due.
+ */
+APR_DECLARE(void) apr_thread_pool_stats_set(apr_thread_pool_t *me,
+                                struct apr_stats_histogram_t *queue_wait,
+                                struct apr_stats_histogram_t *run_time);
+
+/**
+ * Pin each thread to a single CPU of the set, in turn, rather than letting
+ * all the threads run on any CPU of the set.
+ */
+#define APR_THREAD_POOL_AFFINITY_SPREAD 0x1
+
+/**
+ * Restrict the threads of the pool to a set of CPUs. The current threads
+ * are moved, and the threads created later start there.
+ * @param me The thread pool
+ * @param cpus The CPU numbers
+ * @param ncpus The number of CPUs, or 0 to let the threads run anywhere
+ * @param flags 0 or APR_THREAD_POOL_AFFINITY_SPREAD
+ * @return APR_SUCCESS, APR_EINVAL for an invalid CPU number, or
+ * APR_ENOTIMPL if the platform has no thread affinity.
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_affinity_set(apr_thread_pool_t *me,
+                                                       const int *cpus,
+                                                       apr_size_t ncpus,
+                                                       int flags);
+
+/**
+ * Restrict the threads of the pool to the CPUs of a NUMA node, as
+ * apr_thread_pool_affinity_set() does.
+ * @param me The thread pool
+ * @param node The NUMA node number
+ * @param flags 0 or APR_THREAD_POOL_AFFINITY_SPREAD
+ * @return APR_SUCCESS, an error if the node is unknown, or APR_ENOTIMPL if
+ * the platform has no thread affinity or NUMA topology information.
+ * @remark Memory is not bound to the node, but the first touch by the
+ * threads of the pool places it there on most systems.
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_numa_node_set(apr_thread_pool_t *me,
+                                                        int node, int flags);
+
 /**
  * Get owner of the task currently been executed by the thread.
  * @param thd The thread is executing a task
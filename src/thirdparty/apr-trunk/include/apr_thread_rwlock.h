@@ -25,6 +25,7 @@
 #include "apr.h"
 #include "apr_pools.h"
 #include "apr_errno.h"
+#include "apr_thread_mutex.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -59,6 +60,29 @@ typedef struct apr_thread_rwlock_t apr_thread_rwlock_t;
  */
 APR_DECLARE(apr_status_t) apr_thread_rwlock_create(apr_thread_rwlock_t **rwlock,
                                                    apr_pool_t *pool);
+/**
+ * Create and initialize a read-write lock that can be used to synchronize
+ * threads, with options.
+ * @param rwlock the memory address where the newly created readwrite lock
+ *        will be stored.
+ * @param flags Or'ed value of:
+ * <PRE>
+ *           APR_THREAD_MUTEX_DEFAULT        same as apr_thread_rwlock_create().
+ *           APR_THREAD_MUTEX_READER_BIASED  scalable read locking.
+ * </PRE>
+ * @param pool the pool from which to allocate the mutex.
+ * @remark A reader-biased lock lets readers register in counters spread
+ * over as many cache lines, rather than all updating the lock, which makes
+ * read locking scale with the number of CPUs. Write locking is much more
+ * expensive, since the writer has to wait for all the counters to drain,
+ * and is followed by a period where readers use the lock as usual. A
+ * thread must not read lock again a reader-biased lock it already holds.
+ * Where reader bias is not available, it is the same as the default lock.
+ */
+APR_DECLARE(apr_status_t) apr_thread_rwlock_create_ex(apr_thread_rwlock_t **rwlock,
+                                                      unsigned int flags,
+                                                      apr_pool_t *pool);
+
 /**
  * Acquire a shared-read lock on the given read-write lock. This will allow
  * multiple threads to enter the same critical section while they have acquired
@@ -55,4 +55,40 @@
 apr_status_t apr__atomic_generic64_init(apr_pool_t *p);
 #endif
 
+#if HAVE__ATOMIC_BUILTINS || HAVE__ATOMIC_BUILTINS64
+/* The __atomic builtins need a constant memory order (anything else is
+ * taken as __ATOMIC_SEQ_CST), so OP is expanded once for each of them.
+ * Loads can't release and stores can't acquire, such orders are made
+ * sequentially consistent; a failed CAS is a load.
+ */
+#define APR__ATOMIC_ORDERED(order, OP) \
+    switch (order) { \
+    case APR_ATOMIC_RELAXED: OP(__ATOMIC_RELAXED); break; \
+    case APR_ATOMIC_ACQUIRE: OP(__ATOMIC_ACQUIRE); break; \
+    case APR_ATOMIC_RELEASE: OP(__ATOMIC_RELEASE); break; \
+    case APR_ATOMIC_ACQ_REL: OP(__ATOMIC_ACQ_REL); break; \
+    default:                 OP(__ATOMIC_SEQ_CST); break; \
+    }
+#define APR__ATOMIC_LOAD_ORDERED(order, OP) \
+    switch (order) { \
+    case APR_ATOMIC_RELAXED: OP(__ATOMIC_RELAXED); break; \
+    case APR_ATOMIC_ACQUIRE: OP(__ATOMIC_ACQUIRE); break; \
+    default:                 OP(__ATOMIC_SEQ_CST); break; \
+    }
+#define APR__ATOMIC_STORE_ORDERED(order, OP) \
+    switch (order) { \
+    case APR_ATOMIC_RELAXED: OP(__ATOMIC_RELAXED); break; \
+    case APR_ATOMIC_RELEASE: OP(__ATOMIC_RELEASE); break; \
+    default:                 OP(__ATOMIC_SEQ_CST); break; \
+    }
+#define APR__ATOMIC_CAS_ORDERED(order, OP) \
+    switch (order) { \
+    case APR_ATOMIC_RELAXED: OP(__ATOMIC_RELAXED, __ATOMIC_RELAXED); break; \
+    case APR_ATOMIC_ACQUIRE: OP(__ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE); break; \
+    case APR_ATOMIC_RELEASE: OP(__ATOMIC_RELEASE, __ATOMIC_RELAXED); break; \
+    case APR_ATOMIC_ACQ_REL: OP(__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE); break; \
+    default:                 OP(__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); break; \
+    }
+#endif
+
 #endif /* ATOMIC_H */
@@ -61,6 +61,12 @@
 #if APR_HAVE_NETINET_IN_H
 #include <netinet/in.h>
 #endif
+#ifdef HAVE_NETINET_UDP_H
+#include <netinet/udp.h>
+#endif
+#ifdef HAVE_LINUX_TLS_H
+#include <linux/tls.h>
+#endif
 #if APR_HAVE_ARPA_INET_H
 #include <arpa/inet.h>
 #endif
@@ -120,6 +126,11 @@ struct apr_socket_t {
     apr_int32_t options;
     apr_int32_t inherit;
     sock_userdata_t *userdata;
+    /* the buffers sent by apr_socket_send_zc() not released yet, waited
+     * for up to SOCKET_ZC_LINGER when the socket is closed */
+    struct socket_zc_t *zc;
+    /* the data apr_socket_splice() read for this socket, not written yet */
+    struct socket_splice_t *splice;
 #ifndef WAITIO_USES_POLL
     /* if there is a timeout set, then this pollset is used */
     apr_pollset_t *pollset;
@@ -130,6 +141,19 @@ const char *apr_inet_ntop(int af, const void *src, char *dst, apr_size_t size);
 int apr_inet_pton(int af, const char *src, void *dst);
 void apr_sockaddr_vars_set(apr_sockaddr_t *, int, apr_port_t);
 
+/* What apr_socket_accept() and apr_socket_connect() do after the syscall,
+ * for when it's made elsewhere (e.g. asynchronously).
+ */
+apr_status_t apr__socket_accepted(apr_socket_t **new, apr_socket_t *sock,
+                                  int s, apr_sockaddr_t *sa,
+                                  apr_pool_t *connection_context);
+void apr__socket_connected(apr_socket_t *sock, apr_sockaddr_t *sa);
+
+/* How long closing a socket waits for the kernel to be done with the
+ * buffers given to apr_socket_send_zc(), before releasing them anyway.
+ */
+#define SOCKET_ZC_LINGER apr_time_from_sec(1)
+
 #define apr_is_option_set(skt, option)  \
     (((skt)->options & (option)) == (option))
 
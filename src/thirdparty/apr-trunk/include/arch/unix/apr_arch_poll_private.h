@@ -28,6 +28,8 @@
 #include <sys/port_impl.h>
 #endif
 
+#include "apr_stats.h"
+
 #ifdef HAVE_KQUEUE
 #include <sys/types.h>
 #include <sys/event.h>
@@ -87,6 +89,21 @@
 #define WAKEUP_USES_PIPE 1
 #endif
 
+/* On Linux the wakeup "pipe" is a single eventfd, both of its ends */
+#if WAKEUP_USES_PIPE && defined(HAVE_EVENTFD)
+#define WAKEUP_USES_EVENTFD 1
+#else
+#define WAKEUP_USES_EVENTFD 0
+#endif
+
+/* States of wakeup_set: a wakeup is either signaled through the wakeup
+ * pipe while the poller may be blocking, or only left pending when it is
+ * known to be awake, the poller then takes it before polling again.
+ */
+#define WAKEUP_NONE     0
+#define WAKEUP_SIGNALED 1
+#define WAKEUP_PENDING  2
+
 #if defined(POLLSET_USES_KQUEUE) || defined(POLLSET_USES_EPOLL) || defined(POLLSET_USES_PORT) || defined(POLLSET_USES_AIO_MSGQ)
 
 #include "apr_ring.h"
@@ -134,13 +151,15 @@ struct apr_pollset_t
 #endif
     apr_pollfd_t wakeup_pfd;
     volatile apr_uint32_t wakeup_set;
+    volatile apr_uint32_t wakeup_polling;
     apr_pollset_private_t *p;
     const apr_pollset_provider_t *provider;
+    apr_stats_histogram_t *stats;
 };
 
 typedef union {
 #if defined(HAVE_EPOLL)
-    struct epoll_event *epoll;
+    struct epoll_batch_t *epoll;
 #endif
 #if defined(HAVE_PORT_CREATE)
     port_event_t *port;
@@ -150,6 +169,9 @@ typedef union {
 #endif
 #if defined(HAVE_POLL)
     struct pollfd *ps;
+#endif
+#if defined(HAVE_IO_URING)
+    struct uring_poller_t *uring;
 #endif
     void *undef;
 } apr_pollcb_pset;
@@ -167,6 +189,7 @@ struct apr_pollcb_t {
 #endif
     apr_pollfd_t wakeup_pfd;
     volatile apr_uint32_t wakeup_set;
+    volatile apr_uint32_t wakeup_polling;
     int fd;
     apr_pollcb_pset pollset;
     apr_pollfd_t **copyset;
@@ -199,12 +222,20 @@ struct apr_pollcb_provider_t {
 apr_status_t apr_poll_create_wakeup_pipe(apr_pool_t *pool, apr_pollfd_t *pfd,
                                          apr_file_t **wakeup_pipe);
 apr_status_t apr_poll_close_wakeup_pipe(apr_file_t **wakeup_pipe);
+apr_status_t apr_poll_signal_wakeup_pipe(volatile apr_uint32_t *wakeup_set,
+                                         volatile apr_uint32_t *wakeup_polling,
+                                         apr_file_t **wakeup_pipe);
 void apr_poll_drain_wakeup_pipe(volatile apr_uint32_t *wakeup_set, apr_file_t **wakeup_pipe);
 #else
 apr_status_t apr_poll_create_wakeup_socket(apr_pool_t *pool, apr_pollfd_t *pfd,
                                          apr_socket_t **wakeup_socket);
 apr_status_t apr_poll_close_wakeup_socket(apr_socket_t **wakeup_socket);
+apr_status_t apr_poll_signal_wakeup_socket(volatile apr_uint32_t *wakeup_set,
+                                           volatile apr_uint32_t *wakeup_polling,
+                                           apr_socket_t **wakeup_socket);
 void apr_poll_drain_wakeup_socket(volatile apr_uint32_t *wakeup_set, apr_socket_t **wakeup_socket);
 #endif
+int apr_poll_enter_wakeup(volatile apr_uint32_t *wakeup_set,
+                          volatile apr_uint32_t *wakeup_polling);
 
 #endif /* APR_ARCH_POLL_PRIVATE_H */
@@ -27,6 +27,7 @@
 #include "apr_file_io.h"
 #include "apr_arch_file_io.h"
 #include "apr_time.h"
+#include "apr_shm.h"
 
 /* System headers required by Locks library */
 #if APR_HAVE_SYS_TYPES_H
@@ -63,6 +64,12 @@
 #if APR_HAVE_PTHREAD_H
 #include <pthread.h>
 #endif
+#if APR_HAS_FUTEX_SERIALIZE
+#include <signal.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 /* End System Headers */
 
 struct apr_proc_mutex_unix_lock_methods_t {
@@ -113,6 +120,14 @@ struct apr_proc_mutex_t {
                                  * refcounting impossible/undesirable.
                                  */
 #endif
+#if APR_HAS_FUTEX_SERIALIZE
+    apr_shm_t *futex_shm;       /* Segment holding the futex word, unless
+                                 * apr_os_proc_mutex_put()ed.
+                                 */
+    apr_uint32_t futex_pid;     /* Our pid, as stored in the word by the
+                                 * owner; refreshed by child_init.
+                                 */
+#endif
 };
 
 void apr_proc_mutex_unix_setup_lock(void);
@@ -35,6 +35,11 @@
 struct apr_thread_cond_t {
     apr_pool_t *pool;
     pthread_cond_t cond;
+#ifdef THREAD_MUTEX_FUTEX
+    /* for waits on adaptive mutexes, which pthread knows nothing about */
+    volatile apr_uint32_t seq;
+    volatile apr_uint32_t waiters;
+#endif
 };
 #endif
 
@@ -30,14 +30,43 @@
 #endif
 
 #if APR_HAS_THREADS
+
+#if defined(HAVE_LINUX_FUTEX_H) && defined(HAVE_SYS_SYSCALL_H)
+#define THREAD_MUTEX_FUTEX 1
+#endif
+
+/* How many times an adaptive mutex is retried before blocking (on SMP
+ * only), and how to tell the CPU that we are spinning.
+ */
+#define THREAD_MUTEX_SPINS 100
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define THREAD_MUTEX_CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define THREAD_MUTEX_CPU_RELAX() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define THREAD_MUTEX_CPU_RELAX()
+#endif
+
 struct apr_thread_mutex_t {
     apr_pool_t *pool;
     pthread_mutex_t mutex;
 #ifndef HAVE_PTHREAD_MUTEX_TIMEDLOCK
     apr_thread_cond_t *cond;
     int locked, num_waiters;
+#endif
+    apr_uint32_t spins;         /* adaptive: tries before blocking */
+#ifdef THREAD_MUTEX_FUTEX
+    int futex;                  /* adaptive: word is the lock, not mutex */
+    volatile apr_uint32_t word; /* 0: unlocked, 1: locked, 2: contended */
 #endif
 };
+
+#ifdef THREAD_MUTEX_FUTEX
+long apr__thread_mutex_futex(volatile apr_uint32_t *word, int op,
+                             apr_uint32_t val, apr_interval_time_t timeout);
+#endif
+
 #endif
 
 #endif  /* THREAD_MUTEX_H */
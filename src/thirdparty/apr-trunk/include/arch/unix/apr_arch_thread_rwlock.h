@@ -21,6 +21,7 @@
 #include "apr_private.h"
 #include "apr_general.h"
 #include "apr_thread_rwlock.h"
+#include "apr_thread_proc.h"
 #include "apr_pools.h"
 
 #if APR_HAVE_PTHREAD_H
@@ -31,9 +32,25 @@
 #if APR_HAS_THREADS
 #ifdef HAVE_PTHREAD_RWLOCKS
 
+#if APR_HAS_THREAD_LOCAL
+#define THREAD_RWLOCK_BIASED 1
+
+/* A reader counter, in its own cache line */
+typedef union thread_rwlock_readers {
+    volatile apr_uint32_t count;
+    char pad[64];
+} thread_rwlock_readers;
+#endif
+
 struct apr_thread_rwlock_t {
     apr_pool_t *pool;
     pthread_rwlock_t rwlock;
+#ifdef THREAD_RWLOCK_BIASED
+    volatile apr_uint32_t rbias;    /* readers may skip rwlock */
+    apr_uint32_t nreaders;          /* zero unless reader-biased */
+    thread_rwlock_readers *readers;
+    apr_time_t inhibit_until;       /* no bias before, under rwlock */
+#endif
 };
 
 #else
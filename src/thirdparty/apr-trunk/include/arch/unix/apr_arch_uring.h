@@ -0,0 +1,102 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_ARCH_URING_H
+#define APR_ARCH_URING_H
+
+#include "apr.h"
+#include "apr_private.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+
+#ifdef HAVE_IO_URING
+
+#include <linux/io_uring.h>
+
+/*
+ * A bare io_uring instance, mapped from the kernel without liburing.
+ *
+ * Submission entries are filled with apr__uring_get_sqe() and handed to
+ * the kernel by the next apr__uring_enter(), so that any number of them
+ * costs a single syscall. Completions are walked from apr__uring_cqe()
+ * and consumed with apr__uring_cq_advance().
+ *
+ * The ring is not thread-safe, callers serialize the accesses.
+ */
+typedef struct apr__uring_t {
+    int fd;
+    unsigned features;
+    /* submission ring */
+    volatile apr_uint32_t *sq_head;
+    volatile apr_uint32_t *sq_tail;
+    volatile apr_uint32_t *sq_flags;
+    apr_uint32_t *sq_array;
+    apr_uint32_t sq_mask;
+    apr_uint32_t sq_entries;
+    apr_uint32_t sq_local;      /* entries filled, up to sq_local */
+    struct io_uring_sqe *sqes;
+    /* completion ring */
+    volatile apr_uint32_t *cq_head;
+    volatile apr_uint32_t *cq_tail;
+    apr_uint32_t cq_mask;
+    struct io_uring_cqe *cqes;
+    /* mappings */
+    void *sq_ring;
+    apr_size_t sq_ring_size;
+    void *cq_ring;
+    apr_size_t cq_ring_size;
+    apr_size_t sqes_size;
+} apr__uring_t;
+
+/* Set up a ring of at least entries submissions and cq_entries
+ * completions, returns APR_ENOTIMPL if the kernel lacks any of the
+ * features (IORING_FEAT_*).
+ */
+apr_status_t apr__uring_create(apr__uring_t *ring, apr_uint32_t entries,
+                               apr_uint32_t cq_entries,
+                               apr_uint32_t features);
+
+void apr__uring_destroy(apr__uring_t *ring);
+
+/* A zeroed submission entry, or NULL if the ring is full and submitting
+ * what's pending failed.
+ */
+struct io_uring_sqe *apr__uring_get_sqe(apr__uring_t *ring);
+
+/* Make the filled entries visible to the kernel, returns their number */
+apr_uint32_t apr__uring_flush(apr__uring_t *ring);
+
+/* Submit nsubmit flushed entries and wait for nwait completions, for at
+ * most timeout (negative for no limit). Returns APR_TIMEUP or APR_EINTR
+ * when the wait ended with less completions.
+ */
+apr_status_t apr__uring_enter(apr__uring_t *ring, apr_uint32_t nsubmit,
+                              apr_uint32_t nwait,
+                              apr_interval_time_t timeout);
+
+/* The n-th pending completion, or NULL if there are no more */
+struct io_uring_cqe *apr__uring_cqe(apr__uring_t *ring, apr_uint32_t n);
+
+/* Consume the first n pending completions */
+void apr__uring_cq_advance(apr__uring_t *ring, apr_uint32_t n);
+
+/* io_uring_register(), returns the (positive) result in *res if not NULL */
+apr_status_t apr__uring_register(apr__uring_t *ring, unsigned int opcode,
+                                 void *arg, unsigned int nr_args, int *res);
+
+#endif /* HAVE_IO_URING */
+
+#endif /* APR_ARCH_URING_H */
@@ -40,7 +40,8 @@ static apr_status_t proc_mutex_no_child_init(apr_proc_mutex_t **mutex,
 }
 #endif
 
-#if APR_HAS_POSIXSEM_SERIALIZE || APR_HAS_PROC_PTHREAD_SERIALIZE
+#if APR_HAS_POSIXSEM_SERIALIZE || APR_HAS_PROC_PTHREAD_SERIALIZE || \
+    APR_HAS_FUTEX_SERIALIZE
 static apr_status_t proc_mutex_no_perms_set(apr_proc_mutex_t *mutex,
                                             apr_fileperms_t perms,
                                             apr_uid_t uid,
@@ -1003,6 +1004,238 @@ static const apr_proc_mutex_unix_lock_methods_t mutex_proc_pthread_cond_methods
 
 #endif
 
+#if APR_HAS_FUTEX_SERIALIZE
+
+/* The futex word lives in anonymous shared memory. It is zero when the
+ * mutex is free, otherwise the pid of the owner, with FUTEX_WAITERS set
+ * once some process may be sleeping on it. Uncontended lock and unlock
+ * are a single atomic operation each.
+ *
+ * Since the kernel's robust futex list belongs to the C library, owner
+ * death is detected by the waiters instead: one which has slept for
+ * PROC_FUTEX_SLICE without the word changing (or a failed trylock) checks
+ * whether the owner still exists, and takes the mutex over if not. This
+ * goes by pid only: should the dead owner's pid be reused by another live
+ * process, the owner looks alive and the mutex stays held until that
+ * process exits too, which may be never.
+ *
+ * The pid written into the word is cached in futex_pid when the mutex is
+ * created, so a forked child must call apr_proc_mutex_child_init() to
+ * lock under its own pid.
+ */
+#define PROC_FUTEX_SLICE apr_time_from_msec(100)
+
+#define proc_futex_word(m) \
+    ((volatile apr_uint32_t *)(m)->os.futex_interproc)
+
+static long proc_futex(volatile apr_uint32_t *word, int op, apr_uint32_t val,
+                       apr_interval_time_t timeout)
+{
+    struct timespec ts, *pts = NULL;
+
+    if (timeout >= 0) {
+        ts.tv_sec = apr_time_sec(timeout);
+        ts.tv_nsec = apr_time_usec(timeout) * 1000; /* nanoseconds */
+        pts = &ts;
+    }
+    return syscall(SYS_futex, word, op, val, pts, NULL, 0);
+}
+
+static int proc_futex_owner_gone(pid_t owner)
+{
+    siginfo_t info;
+
+    if (kill(owner, 0) < 0) {
+        return errno == ESRCH;
+    }
+    /* an exited child of ours lingers until we reap it */
+    info.si_pid = 0;
+    return waitid(P_PID, owner, &info, WEXITED | WNOHANG | WNOWAIT) == 0
+           && info.si_pid == owner;
+}
+
+/* Take the mutex over if its owner, as last seen in v, has exited. */
+static int proc_futex_recover(apr_proc_mutex_t *mutex, apr_uint32_t v)
+{
+    pid_t owner = (pid_t)(v & FUTEX_TID_MASK);
+
+    if (!owner || !proc_futex_owner_gone(owner)) {
+        return 0;
+    }
+    return apr_atomic_cas32(proc_futex_word(mutex),
+                            mutex->futex_pid | (v & FUTEX_WAITERS), v) == v;
+}
+
+static apr_status_t proc_mutex_futex_release(apr_proc_mutex_t *);
+
+static apr_status_t proc_mutex_futex_cleanup(void *mutex_)
+{
+    apr_proc_mutex_t *mutex = mutex_;
+    apr_status_t rv = APR_SUCCESS;
+
+    if (mutex->curr_locked == 1) {
+        proc_mutex_futex_release(mutex);
+    }
+    if (mutex->futex_shm) {
+        rv = apr_shm_destroy(mutex->futex_shm);
+        mutex->futex_shm = NULL;
+    }
+    return rv;
+}
+
+static apr_status_t proc_mutex_futex_create(apr_proc_mutex_t *new_mutex,
+                                            const char *fname)
+{
+    apr_status_t rv;
+
+    rv = apr_shm_create(&new_mutex->futex_shm, sizeof(apr_uint32_t), NULL,
+                        new_mutex->pool);
+    if (rv != APR_SUCCESS) {
+        new_mutex->futex_shm = NULL;
+        return rv;
+    }
+    new_mutex->os.futex_interproc = apr_shm_baseaddr_get(new_mutex->futex_shm);
+    *new_mutex->os.futex_interproc = 0;
+    new_mutex->futex_pid = getpid();
+    new_mutex->curr_locked = 0;
+
+    apr_pool_cleanup_register(new_mutex->pool,
+                              (void *)new_mutex,
+                              apr_proc_mutex_cleanup,
+                              apr_pool_cleanup_null);
+    return APR_SUCCESS;
+}
+
+static apr_status_t proc_mutex_futex_child_init(apr_proc_mutex_t **mutex,
+                                                apr_pool_t *pool,
+                                                const char *fname)
+{
+    (*mutex)->futex_pid = getpid();
+    (*mutex)->curr_locked = 0;
+    return APR_SUCCESS;
+}
+
+static apr_status_t proc_mutex_futex_acquire_ex(apr_proc_mutex_t *mutex,
+                                                apr_interval_time_t timeout)
+{
+    volatile apr_uint32_t *word = proc_futex_word(mutex);
+    apr_uint32_t self = mutex->futex_pid, v, w;
+    apr_interval_time_t slice;
+    apr_time_t deadline = 0;
+
+    v = apr_atomic_cas32(word, self, 0);
+    if (v == 0) {
+        mutex->curr_locked = 1;
+        return APR_SUCCESS;
+    }
+    if (!timeout) {
+        if (proc_futex_recover(mutex, v)) {
+            mutex->curr_locked = 1;
+            return APR_SUCCESS;
+        }
+        return APR_TIMEUP;
+    }
+    if (timeout > 0) {
+        deadline = apr_time_now() + timeout;
+    }
+
+    for (;;) {
+        if (v == 0) {
+            /* others may still be waiting, so wake one on release */
+            v = apr_atomic_cas32(word, self | FUTEX_WAITERS, 0);
+            if (v == 0) {
+                break;
+            }
+            continue;
+        }
+        if (!(v & FUTEX_WAITERS)) {
+            w = apr_atomic_cas32(word, v | FUTEX_WAITERS, v);
+            if (w != v) {
+                v = w;
+                continue;
+            }
+            v |= FUTEX_WAITERS;
+        }
+
+        slice = PROC_FUTEX_SLICE;
+        if (timeout > 0) {
+            apr_interval_time_t left = deadline - apr_time_now();
+            if (left <= 0) {
+                if (proc_futex_recover(mutex, v)) {
+                    break;
+                }
+                return APR_TIMEUP;
+            }
+            if (left < slice) {
+                slice = left;
+            }
+        }
+
+        if (proc_futex(word, FUTEX_WAIT, v, slice) < 0) {
+            if (errno == ETIMEDOUT) {
+                if (apr_atomic_read32(word) == v
+                        && proc_futex_recover(mutex, v)) {
+                    break;
+                }
+            }
+            else if (errno != EAGAIN && errno != EINTR) {
+                return errno;
+            }
+        }
+        v = apr_atomic_read32(word);
+    }
+
+    mutex->curr_locked = 1;
+    return APR_SUCCESS;
+}
+
+static apr_status_t proc_mutex_futex_acquire(apr_proc_mutex_t *mutex)
+{
+    return proc_mutex_futex_acquire_ex(mutex, -1);
+}
+
+static apr_status_t proc_mutex_futex_tryacquire(apr_proc_mutex_t *mutex)
+{
+    apr_status_t rv = proc_mutex_futex_acquire_ex(mutex, 0);
+    return (rv == APR_TIMEUP) ? APR_EBUSY : rv;
+}
+
+static apr_status_t proc_mutex_futex_timedacquire(apr_proc_mutex_t *mutex,
+                                                  apr_interval_time_t timeout)
+{
+    return proc_mutex_futex_acquire_ex(mutex, (timeout <= 0) ? 0 : timeout);
+}
+
+static apr_status_t proc_mutex_futex_release(apr_proc_mutex_t *mutex)
+{
+    volatile apr_uint32_t *word = proc_futex_word(mutex);
+
+    mutex->curr_locked = 0;
+    if (apr_atomic_xchg32(word, 0) & FUTEX_WAITERS) {
+        if (proc_futex(word, FUTEX_WAKE, 1, -1) < 0) {
+            return errno;
+        }
+    }
+    return APR_SUCCESS;
+}
+
+static const apr_proc_mutex_unix_lock_methods_t mutex_futex_methods =
+{
+    APR_PROCESS_LOCK_MECH_IS_GLOBAL,
+    proc_mutex_futex_create,
+    proc_mutex_futex_acquire,
+    proc_mutex_futex_tryacquire,
+    proc_mutex_futex_timedacquire,
+    proc_mutex_futex_release,
+    proc_mutex_futex_cleanup,
+    proc_mutex_futex_child_init,
+    proc_mutex_no_perms_set,
+    APR_LOCK_FUTEX,
+    "futex"
+};
+
+#endif /* futex implementation */
+
 #if APR_HAS_FCNTL_SERIALIZE
 
 static struct flock proc_mutex_lock_it;
@@ -1362,6 +1595,10 @@ static apr_status_t proc_mutex_choose_method(apr_proc_mutex_t *new_mutex,
 #if APR_HAS_POSIXSEM_SERIALIZE
     new_mutex->os.psem_interproc = NULL;
 #endif
+#if APR_HAS_FUTEX_SERIALIZE
+    new_mutex->os.futex_interproc = NULL;
+    new_mutex->futex_shm = NULL;
+#endif
 #if APR_HAS_SYSVSEM_SERIALIZE || APR_HAS_FCNTL_SERIALIZE || APR_HAS_FLOCK_SERIALIZE
     new_mutex->os.crossproc = -1;
 
@@ -1435,6 +1672,20 @@ static apr_status_t proc_mutex_choose_method(apr_proc_mutex_t *new_mutex,
         }
 #else
         return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_LOCK_FUTEX:
+#if APR_HAS_FUTEX_SERIALIZE
+        new_mutex->meth = &mutex_futex_methods;
+        if (ospmutex) {
+            if (ospmutex->futex_interproc == NULL) {
+                return APR_EINVAL;
+            }
+            new_mutex->os.futex_interproc = ospmutex->futex_interproc;
+            new_mutex->futex_pid = getpid();
+        }
+#else
+        return APR_ENOTIMPL;
 #endif
         break;
     case APR_LOCK_DEFAULT_TIMED:
@@ -21,6 +21,45 @@
 #include "apr_arch_thread_mutex.h"
 #include "apr_arch_thread_cond.h"
 
+#ifdef THREAD_MUTEX_FUTEX
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+
+/* Waiting on an adaptive mutex: the sequence changes on every signal or
+ * broadcast while there are waiters, so a waiter which read it before
+ * releasing the mutex cannot miss one.
+ */
+static apr_status_t cond_futex_wait(apr_thread_cond_t *cond,
+                                    apr_thread_mutex_t *mutex,
+                                    apr_interval_time_t timeout)
+{
+    apr_status_t rv = APR_SUCCESS;
+    apr_uint32_t seq;
+
+    apr_atomic_inc32(&cond->waiters);
+    seq = apr_atomic_read32(&cond->seq);
+    apr_thread_mutex_unlock(mutex);
+
+    if (apr__thread_mutex_futex(&cond->seq, FUTEX_WAIT_PRIVATE, seq,
+                                timeout) && errno == ETIMEDOUT) {
+        rv = APR_TIMEUP;
+    }
+
+    apr_atomic_dec32(&cond->waiters);
+    apr_thread_mutex_lock(mutex);
+    return rv;
+}
+
+static void cond_futex_wake(apr_thread_cond_t *cond, int n)
+{
+    if (apr_atomic_read32(&cond->waiters)) {
+        apr_atomic_inc32(&cond->seq);
+        apr__thread_mutex_futex(&cond->seq, FUTEX_WAKE_PRIVATE, n, -1);
+    }
+}
+#endif
+
 static apr_status_t thread_cond_cleanup(void *data)
 {
     apr_thread_cond_t *cond = (apr_thread_cond_t *)data;
@@ -44,6 +83,10 @@ APR_DECLARE(apr_status_t) apr_thread_cond_create(apr_thread_cond_t **cond,
     new_cond = apr_palloc(pool, sizeof(apr_thread_cond_t));
 
     new_cond->pool = pool;
+#ifdef THREAD_MUTEX_FUTEX
+    new_cond->seq = 0;
+    new_cond->waiters = 0;
+#endif
 
     if ((rv = pthread_cond_init(&new_cond->cond, NULL))) {
 #ifdef HAVE_ZOS_PTHREADS
@@ -65,6 +108,12 @@ APR_DECLARE(apr_status_t) apr_thread_cond_wait(apr_thread_cond_t *cond,
 {
     apr_status_t rv;
 
+#ifdef THREAD_MUTEX_FUTEX
+    if (mutex->futex) {
+        return cond_futex_wait(cond, mutex, -1);
+    }
+#endif
+
     rv = pthread_cond_wait(&cond->cond, &mutex->mutex);
 #ifdef HAVE_ZOS_PTHREADS
     if (rv) {
@@ -79,6 +128,13 @@ APR_DECLARE(apr_status_t) apr_thread_cond_timedwait(apr_thread_cond_t *cond,
                                                     apr_interval_time_t timeout)
 {
     apr_status_t rv;
+
+#ifdef THREAD_MUTEX_FUTEX
+    if (mutex->futex) {
+        return cond_futex_wait(cond, mutex, timeout < 0 ? -1 : timeout);
+    }
+#endif
+
     if (timeout < 0) {
         rv = pthread_cond_wait(&cond->cond, &mutex->mutex);
 #ifdef HAVE_ZOS_PTHREADS
@@ -113,6 +169,10 @@ APR_DECLARE(apr_status_t) apr_thread_cond_signal(apr_thread_cond_t *cond)
 {
     apr_status_t rv;
 
+#ifdef THREAD_MUTEX_FUTEX
+    cond_futex_wake(cond, 1);
+#endif
+
     rv = pthread_cond_signal(&cond->cond);
 #ifdef HAVE_ZOS_PTHREADS
     if (rv) {
@@ -126,6 +186,10 @@ APR_DECLARE(apr_status_t) apr_thread_cond_broadcast(apr_thread_cond_t *cond)
 {
     apr_status_t rv;
 
+#ifdef THREAD_MUTEX_FUTEX
+    cond_futex_wake(cond, INT_MAX);
+#endif
+
     rv = pthread_cond_broadcast(&cond->cond);
 #ifdef HAVE_ZOS_PTHREADS
     if (rv) {
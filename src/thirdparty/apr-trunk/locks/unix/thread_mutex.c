@@ -18,8 +18,97 @@
 #define APR_WANT_MEMFUNC
 #include "apr_want.h"
 
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #if APR_HAS_THREADS
 
+#ifdef THREAD_MUTEX_FUTEX
+#include <errno.h>
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+long apr__thread_mutex_futex(volatile apr_uint32_t *word, int op,
+                             apr_uint32_t val, apr_interval_time_t timeout)
+{
+    struct timespec ts, *pts = NULL;
+
+    if (timeout >= 0) {
+        ts.tv_sec = apr_time_sec(timeout);
+        ts.tv_nsec = apr_time_usec(timeout) * 1000;
+        pts = &ts;
+    }
+    return syscall(SYS_futex, word, op, val, pts, NULL, 0);
+}
+
+/*
+ * Adaptive mutexes: the word goes from 0 to 1 when locked without
+ * contention, and to 2 when some thread may be blocked on it, in which
+ * case the unlocker has to wake one up. Before blocking a thread retries
+ * for a while, in case the owner releases the lock shortly.
+ */
+static apr_status_t futex_lock(apr_thread_mutex_t *mutex,
+                               apr_interval_time_t timeout)
+{
+    apr_time_t deadline = 0;
+    apr_uint32_t n;
+
+    if (apr_atomic_cas32(&mutex->word, 1, 0) == 0) {
+        return APR_SUCCESS;
+    }
+    for (n = mutex->spins; n; --n) {
+        THREAD_MUTEX_CPU_RELAX();
+        if (apr_atomic_read32(&mutex->word) == 0
+                && apr_atomic_cas32(&mutex->word, 1, 0) == 0) {
+            return APR_SUCCESS;
+        }
+    }
+
+    if (timeout > 0) {
+        deadline = apr_time_now() + timeout;
+    }
+    while (apr_atomic_xchg32(&mutex->word, 2) != 0) {
+        if (timeout > 0) {
+            timeout = deadline - apr_time_now();
+            if (timeout <= 0) {
+                return APR_TIMEUP;
+            }
+        }
+        if (apr__thread_mutex_futex(&mutex->word, FUTEX_WAIT_PRIVATE, 2,
+                                    timeout) && errno == ETIMEDOUT) {
+            return APR_TIMEUP;
+        }
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t futex_unlock(apr_thread_mutex_t *mutex)
+{
+    if (apr_atomic_xchg32(&mutex->word, 0) == 2) {
+        apr__thread_mutex_futex(&mutex->word, FUTEX_WAKE_PRIVATE, 1, -1);
+    }
+    return APR_SUCCESS;
+}
+
+#endif /* THREAD_MUTEX_FUTEX */
+
+static apr_uint32_t thread_mutex_spins(void)
+{
+    static volatile apr_uint32_t spins = APR_UINT32_MAX;
+
+    if (spins == APR_UINT32_MAX) {
+        /* spinning only helps when the owner can run meanwhile */
+#if defined(_SC_NPROCESSORS_ONLN)
+        spins = sysconf(_SC_NPROCESSORS_ONLN) == 1 ? 0 : THREAD_MUTEX_SPINS;
+#else
+        spins = THREAD_MUTEX_SPINS;
+#endif
+    }
+    return spins;
+}
+
 static apr_status_t thread_mutex_cleanup(void *data)
 {
     apr_thread_mutex_t *mutex = data;
@@ -50,6 +139,14 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_create(apr_thread_mutex_t **mutex,
     new_mutex = apr_pcalloc(pool, sizeof(apr_thread_mutex_t));
     new_mutex->pool = pool;
 
+    if (flags & APR_THREAD_MUTEX_ADAPTIVE) {
+        new_mutex->spins = thread_mutex_spins();
+#ifdef THREAD_MUTEX_FUTEX
+        /* nested locks are left to pthread */
+        new_mutex->futex = !(flags & APR_THREAD_MUTEX_NESTED);
+#endif
+    }
+
 #ifdef HAVE_PTHREAD_MUTEX_RECURSIVE
     if (flags & APR_THREAD_MUTEX_NESTED) {
         pthread_mutexattr_t mattr;
@@ -97,7 +194,11 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_create(apr_thread_mutex_t **mutex,
     }
 
 #ifndef HAVE_PTHREAD_MUTEX_TIMEDLOCK
-    if (flags & APR_THREAD_MUTEX_TIMED) {
+    if ((flags & APR_THREAD_MUTEX_TIMED)
+#ifdef THREAD_MUTEX_FUTEX
+            && !new_mutex->futex
+#endif
+            ) {
         rv = apr_thread_cond_create(&new_mutex->cond, pool);
         if (rv) {
 #ifdef HAVE_ZOS_PTHREADS
@@ -120,6 +221,20 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_create(apr_thread_mutex_t **mutex,
 APR_DECLARE(apr_status_t) apr_thread_mutex_lock(apr_thread_mutex_t *mutex)
 {
     apr_status_t rv;
+    apr_uint32_t n;
+
+#ifdef THREAD_MUTEX_FUTEX
+    if (mutex->futex) {
+        return futex_lock(mutex, -1);
+    }
+#endif
+
+    for (n = mutex->spins; n; --n) {
+        if (apr_thread_mutex_trylock(mutex) == APR_SUCCESS) {
+            return APR_SUCCESS;
+        }
+        THREAD_MUTEX_CPU_RELAX();
+    }
 
 #ifndef HAVE_PTHREAD_MUTEX_TIMEDLOCK
     if (mutex->cond) {
@@ -169,6 +284,15 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_trylock(apr_thread_mutex_t *mutex)
 {
     apr_status_t rv;
 
+#ifdef THREAD_MUTEX_FUTEX
+    if (mutex->futex) {
+        if (apr_atomic_cas32(&mutex->word, 1, 0) != 0) {
+            return APR_EBUSY;
+        }
+        return APR_SUCCESS;
+    }
+#endif
+
 #ifndef HAVE_PTHREAD_MUTEX_TIMEDLOCK
     if (mutex->cond) {
         apr_status_t rv2;
@@ -217,6 +341,18 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_timedlock(apr_thread_mutex_t *mutex,
 {
     apr_status_t rv = APR_ENOTIMPL;
 
+#ifdef THREAD_MUTEX_FUTEX
+    if (mutex->futex) {
+        if (timeout <= 0) {
+            if (apr_atomic_cas32(&mutex->word, 1, 0) != 0) {
+                return APR_TIMEUP;
+            }
+            return APR_SUCCESS;
+        }
+        return futex_lock(mutex, timeout);
+    }
+#endif
+
 #ifdef HAVE_PTHREAD_MUTEX_TIMEDLOCK
     if (timeout <= 0) {
         rv = pthread_mutex_trylock(&mutex->mutex);
@@ -302,6 +438,12 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_unlock(apr_thread_mutex_t *mutex)
 {
     apr_status_t status;
 
+#ifdef THREAD_MUTEX_FUTEX
+    if (mutex->futex) {
+        return futex_unlock(mutex);
+    }
+#endif
+
 #ifndef HAVE_PTHREAD_MUTEX_TIMEDLOCK
     if (mutex->cond) {
         status = pthread_mutex_lock(&mutex->mutex);
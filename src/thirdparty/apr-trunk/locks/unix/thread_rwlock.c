@@ -15,12 +15,130 @@
  */
 
 #include "apr_arch_thread_rwlock.h"
+#include "apr_arch_thread_mutex.h"
 #include "apr_private.h"
+#include "apr_atomic.h"
+
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #if APR_HAS_THREADS
 
 #ifdef HAVE_PTHREAD_RWLOCKS
 
+#ifdef THREAD_RWLOCK_BIASED
+
+/*
+ * Reader-biased locks: while the bias is on, readers only increment the
+ * counter picked by their thread, in its own cache line, then check that
+ * the bias is still on. A writer first takes the rwlock, then turns the
+ * bias off and waits for the counters to drain, so readers come to the
+ * rwlock until it has been unbiased for a multiple of the time the drain
+ * took, after which a reader turns it on again.
+ */
+#define RWLOCK_MAX_READERS 64
+#define RWLOCK_HELD_MAX    8
+#define RWLOCK_INHIBIT     9
+#define RWLOCK_SPINS       100
+
+static volatile apr_uint32_t rwlock_nthreads;
+static APR_THREAD_LOCAL apr_uint32_t rwlock_self;
+
+/* the locks the thread holds through its counters, since unlock does not
+ * tell which kind of lock it releases
+ */
+static APR_THREAD_LOCAL struct rwlock_held {
+    apr_thread_rwlock_t *rwlock;
+    volatile apr_uint32_t *count;
+} rwlock_held[RWLOCK_HELD_MAX];
+static APR_THREAD_LOCAL int rwlock_nheld;
+
+static int biased_rdlock(apr_thread_rwlock_t *rwlock)
+{
+    volatile apr_uint32_t *count;
+
+    if (!rwlock->nreaders || !apr_atomic_read32(&rwlock->rbias)
+            || rwlock_nheld == RWLOCK_HELD_MAX) {
+        return 0;
+    }
+    if (!rwlock_self) {
+        rwlock_self = apr_atomic_inc32(&rwlock_nthreads) + 1;
+    }
+    count = &rwlock->readers[rwlock_self & (rwlock->nreaders - 1)].count;
+
+    apr_atomic_inc32(count);
+    if (!apr_atomic_read32(&rwlock->rbias)) {
+        apr_atomic_dec32(count);
+        return 0;
+    }
+    rwlock_held[rwlock_nheld].rwlock = rwlock;
+    rwlock_held[rwlock_nheld].count = count;
+    rwlock_nheld++;
+    return 1;
+}
+
+static int biased_unlock(apr_thread_rwlock_t *rwlock)
+{
+    int i;
+
+    if (!rwlock->nreaders) {
+        return 0;
+    }
+    for (i = rwlock_nheld; i-- > 0; ) {
+        if (rwlock_held[i].rwlock == rwlock) {
+            apr_atomic_dec32(rwlock_held[i].count);
+            rwlock_held[i] = rwlock_held[--rwlock_nheld];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Called with the read lock held */
+static void biased_rearm(apr_thread_rwlock_t *rwlock)
+{
+    if (rwlock->nreaders && !apr_atomic_read32(&rwlock->rbias)
+            && apr_time_now() >= rwlock->inhibit_until) {
+        apr_atomic_set32(&rwlock->rbias, 1);
+    }
+}
+
+/* Called with the write lock held, returns whether no reader is left
+ * (always unless trying)
+ */
+static int biased_revoke(apr_thread_rwlock_t *rwlock, int trying)
+{
+    apr_time_t start, now;
+    apr_uint32_t i, n;
+
+    if (!rwlock->nreaders || !apr_atomic_read32(&rwlock->rbias)) {
+        return 1;
+    }
+    start = apr_time_now();
+    apr_atomic_set32(&rwlock->rbias, 0);
+
+    for (i = 0; i < rwlock->nreaders; ++i) {
+        for (n = 0; apr_atomic_read32(&rwlock->readers[i].count); ++n) {
+            if (trying) {
+                apr_atomic_set32(&rwlock->rbias, 1);
+                return 0;
+            }
+            if (n < RWLOCK_SPINS) {
+                THREAD_MUTEX_CPU_RELAX();
+            }
+            else {
+                apr_thread_yield();
+            }
+        }
+    }
+    now = apr_time_now();
+    rwlock->inhibit_until = now + (now - start) * RWLOCK_INHIBIT;
+    return 1;
+}
+
+#endif /* THREAD_RWLOCK_BIASED */
+
 /* The rwlock must be initialized but not locked by any thread when
  * cleanup is called. */
 static apr_status_t thread_rwlock_cleanup(void *data)
@@ -37,15 +155,42 @@ static apr_status_t thread_rwlock_cleanup(void *data)
     return stat;
 }
 
-APR_DECLARE(apr_status_t) apr_thread_rwlock_create(apr_thread_rwlock_t **rwlock,
-                                                   apr_pool_t *pool)
+APR_DECLARE(apr_status_t) apr_thread_rwlock_create_ex(apr_thread_rwlock_t **rwlock,
+                                                      unsigned int flags,
+                                                      apr_pool_t *pool)
 {
     apr_thread_rwlock_t *new_rwlock;
     apr_status_t stat;
 
-    new_rwlock = apr_palloc(pool, sizeof(apr_thread_rwlock_t));
+    if (flags & ~APR_THREAD_MUTEX_READER_BIASED) {
+        return APR_ENOTIMPL;
+    }
+
+    new_rwlock = apr_pcalloc(pool, sizeof(apr_thread_rwlock_t));
     new_rwlock->pool = pool;
 
+#ifdef THREAD_RWLOCK_BIASED
+    if (flags & APR_THREAD_MUTEX_READER_BIASED) {
+        apr_uint32_t n = 2;
+        char *mem;
+
+        /* about two counters per CPU */
+#if defined(_SC_NPROCESSORS_ONLN)
+        while (n < RWLOCK_MAX_READERS
+               && n < 2 * (apr_uint32_t)sysconf(_SC_NPROCESSORS_ONLN)) {
+            n <<= 1;
+        }
+#else
+        n = RWLOCK_MAX_READERS;
+#endif
+        mem = apr_pcalloc(pool, (n + 1) * sizeof(thread_rwlock_readers));
+        new_rwlock->readers = (thread_rwlock_readers *)
+            APR_ALIGN((apr_uintptr_t)mem, sizeof(thread_rwlock_readers));
+        new_rwlock->nreaders = n;
+        new_rwlock->rbias = 1;
+    }
+#endif
+
     if ((stat = pthread_rwlock_init(&new_rwlock->rwlock, NULL))) {
 #ifdef HAVE_ZOS_PTHREADS
         stat = errno;
@@ -61,15 +206,32 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_create(apr_thread_rwlock_t **rwlock,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_thread_rwlock_create(apr_thread_rwlock_t **rwlock,
+                                                   apr_pool_t *pool)
+{
+    return apr_thread_rwlock_create_ex(rwlock, 0, pool);
+}
+
 APR_DECLARE(apr_status_t) apr_thread_rwlock_rdlock(apr_thread_rwlock_t *rwlock)
 {
     apr_status_t stat;
 
+#ifdef THREAD_RWLOCK_BIASED
+    if (biased_rdlock(rwlock)) {
+        return APR_SUCCESS;
+    }
+#endif
+
     stat = pthread_rwlock_rdlock(&rwlock->rwlock);
 #ifdef HAVE_ZOS_PTHREADS
     if (stat) {
         stat = errno;
     }
+#endif
+#ifdef THREAD_RWLOCK_BIASED
+    if (!stat) {
+        biased_rearm(rwlock);
+    }
 #endif
     return stat;
 }
@@ -78,11 +240,22 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_tryrdlock(apr_thread_rwlock_t *rwloc
 {
     apr_status_t stat;
 
+#ifdef THREAD_RWLOCK_BIASED
+    if (biased_rdlock(rwlock)) {
+        return APR_SUCCESS;
+    }
+#endif
+
     stat = pthread_rwlock_tryrdlock(&rwlock->rwlock);
 #ifdef HAVE_ZOS_PTHREADS
     if (stat) {
         stat = errno;
     }
+#endif
+#ifdef THREAD_RWLOCK_BIASED
+    if (!stat) {
+        biased_rearm(rwlock);
+    }
 #endif
     /* Normalize the return code. */
     if (stat == EBUSY)
@@ -99,6 +272,11 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_wrlock(apr_thread_rwlock_t *rwlock)
     if (stat) {
         stat = errno;
     }
+#endif
+#ifdef THREAD_RWLOCK_BIASED
+    if (!stat) {
+        biased_revoke(rwlock, 0);
+    }
 #endif
     return stat;
 }
@@ -112,6 +290,12 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_trywrlock(apr_thread_rwlock_t *rwloc
     if (stat) {
         stat = errno;
     }
+#endif
+#ifdef THREAD_RWLOCK_BIASED
+    if (!stat && !biased_revoke(rwlock, 1)) {
+        pthread_rwlock_unlock(&rwlock->rwlock);
+        stat = EBUSY;
+    }
 #endif
     /* Normalize the return code. */
     if (stat == EBUSY)
@@ -123,6 +307,12 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_unlock(apr_thread_rwlock_t *rwlock)
 {
     apr_status_t stat;
 
+#ifdef THREAD_RWLOCK_BIASED
+    if (biased_unlock(rwlock)) {
+        return APR_SUCCESS;
+    }
+#endif
+
     stat = pthread_rwlock_unlock(&rwlock->rwlock);
 #ifdef HAVE_ZOS_PTHREADS
     if (stat) {
@@ -139,6 +329,13 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_destroy(apr_thread_rwlock_t *rwlock)
 
 #else  /* HAVE_PTHREAD_RWLOCKS */
 
+APR_DECLARE(apr_status_t) apr_thread_rwlock_create_ex(apr_thread_rwlock_t **rwlock,
+                                                      unsigned int flags,
+                                                      apr_pool_t *pool)
+{
+    return APR_ENOTIMPL;
+}
+
 APR_DECLARE(apr_status_t) apr_thread_rwlock_create(apr_thread_rwlock_t **rwlock,
                                                    apr_pool_t *pool)
 {
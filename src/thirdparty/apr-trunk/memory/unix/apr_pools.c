@@ -28,6 +28,7 @@
 #include "apr_hash.h"
 #include "apr_time.h"
 #include "apr_support.h"
+#include "apr_stats.h"
 #define APR_WANT_MEMFUNC
 #include "apr_want.h"
 #include "apr_env.h"
@@ -130,6 +131,8 @@ struct apr_allocator_t {
     apr_thread_mutex_t *mutex;
 #endif /* APR_HAS_THREADS */
     apr_pool_t         *owner;
+    /** Bytes handed out, @see apr_allocator_stats_set() */
+    apr_stats_counter_t *stats;
     /**
      * Lists of free nodes. Slot MAX_INDEX is used for oversized nodes,
      * and the slots 0..MAX_INDEX-1 contain nodes of sizes
@@ -232,6 +235,12 @@ APR_DECLARE(apr_pool_t *) apr_allocator_owner_get(apr_allocator_t *allocator)
     return allocator->owner;
 }
 
+APR_DECLARE(void) apr_allocator_stats_set(apr_allocator_t *allocator,
+                                          apr_stats_counter_t *bytes)
+{
+    allocator->stats = bytes;
+}
+
 APR_DECLARE(void) apr_allocator_max_free_set(apr_allocator_t *allocator,
                                              apr_size_t in_size)
 {
@@ -414,6 +423,10 @@ have_node:
     node->next = NULL;
     node->first_avail = (char *)node + APR_MEMNODE_T_SIZE;
 
+    if (allocator->stats) {
+        apr_stats_counter_add(allocator->stats, node->endp - (char *)node);
+    }
+
     APR_VALGRIND_UNDEFINED(node->first_avail, size - APR_MEMNODE_T_SIZE);
 
     return node;
@@ -425,6 +438,7 @@ void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
     apr_memnode_t *next, *freelist = NULL;
     apr_size_t index, max_index;
     apr_size_t max_free_index, current_free_index;
+    apr_size_t freed = 0;
 
     allocator_lock(allocator);
 
@@ -438,6 +452,7 @@ void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
     do {
         next = node->next;
         index = node->index;
+        freed += node->endp - (char *)node;
 
         APR_VALGRIND_NOACCESS((char *)node + APR_MEMNODE_T_SIZE,
                               (node->index+1) << BOUNDARY_INDEX);
@@ -479,6 +494,10 @@ void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
 
     allocator_unlock(allocator);
 
+    if (allocator->stats) {
+        apr_stats_counter_sub(allocator->stats, freed);
+    }
+
     while (freelist != NULL) {
         node = freelist;
         freelist = node->next;
@@ -213,4 +213,59 @@ APR_DECLARE(apr_status_t) apr_socket_recvfrom(apr_sockaddr_t *from,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_socket_send_zc(apr_socket_t *sock,
+                                             const char *buf,
+                                             apr_size_t *len,
+                                             apr_socket_zc_release_fn_t release,
+                                             void *baton)
+{
+    /* No zero-copy, the data is copied by the time it returns */
+    apr_size_t want = *len;
+    apr_status_t rv = apr_socket_send(sock, buf, len);
+
+    /* finished unless the caller sends the rest */
+    if ((rv == APR_SUCCESS && *len == want)
+            || (rv != APR_SUCCESS && !APR_STATUS_IS_EAGAIN(rv)
+                && !APR_STATUS_IS_TIMEUP(rv))) {
+        release(baton);
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_zc_reap(apr_socket_t *sock,
+                                             apr_interval_time_t timeout,
+                                             apr_uint32_t *pending)
+{
+    if (pending) {
+        *pending = 0;
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_splice(apr_socket_t *src,
+                                            apr_socket_t *dst,
+                                            apr_size_t *len)
+{
+    *len = 0;
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_sendmmsg(apr_socket_t *sock,
+                                              apr_int32_t flags,
+                                              apr_socket_msg_t *msgs,
+                                              apr_uint32_t *nmsgs)
+{
+    *nmsgs = 0;
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_recvmmsg(apr_socket_t *sock,
+                                              apr_int32_t flags,
+                                              apr_socket_msg_t *msgs,
+                                              apr_uint32_t *nmsgs)
+{
+    *nmsgs = 0;
+    return APR_ENOTIMPL;
+}
+
 #endif /* ! BEOS_BONE */
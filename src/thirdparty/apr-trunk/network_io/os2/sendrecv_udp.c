@@ -114,3 +114,21 @@ APR_DECLARE(apr_status_t) apr_socket_recvfrom(apr_sockaddr_t *from,
         }
     } while (1);
 }
+
+APR_DECLARE(apr_status_t) apr_socket_sendmmsg(apr_socket_t *sock,
+                                              apr_int32_t flags,
+                                              apr_socket_msg_t *msgs,
+                                              apr_uint32_t *nmsgs)
+{
+    *nmsgs = 0;
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_recvmmsg(apr_socket_t *sock,
+                                              apr_int32_t flags,
+                                              apr_socket_msg_t *msgs,
+                                              apr_uint32_t *nmsgs)
+{
+    *nmsgs = 0;
+    return APR_ENOTIMPL;
+}
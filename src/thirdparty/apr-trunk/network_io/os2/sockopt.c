@@ -129,6 +129,14 @@ APR_DECLARE(apr_status_t) apr_socket_opt_get(apr_socket_t *sock,
 }
 
 
+APR_DECLARE(apr_status_t) apr_socket_tls_install(apr_socket_t *sock,
+                                                 int direction,
+                                                 const apr_socket_tls_keys_t *keys)
+{
+    return APR_ENOTIMPL;
+}
+
+
 APR_DECLARE(apr_status_t) apr_socket_atmark(apr_socket_t *sock, int *atmark)
 {
     int oobmark;
@@ -27,6 +27,21 @@
 #include <osreldate.h>
 #endif
 
+#if defined(HAVE_SPLICE) && defined(SPLICE_F_MOVE)
+#define USE_SPLICE 1
+#if APR_HAS_THREADS
+#include <pthread.h>
+#endif
+#endif
+
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) \
+    && defined(HAVE_LINUX_ERRQUEUE_H) && defined(HAVE_POLL)
+#define USE_ZEROCOPY 1
+#include <linux/errqueue.h>
+#include <poll.h>
+#include "apr_ring.h"
+#endif
+
 apr_status_t apr_socket_send(apr_socket_t *sock, const char *buf,
                              apr_size_t *len)
 {
@@ -245,6 +260,875 @@ do_select:
 #endif
 }
 
+#ifdef USE_ZEROCOPY
+
+/* Below this size, copying is cheaper than the page pinning and the
+ * completion of a zero-copy send.
+ */
+#define ZC_MIN_SIZE 16384
+
+/* A buffer given to apr_socket_send_zc(), possibly over several calls
+ * when sent partially, released once finished and no longer referenced
+ * by the kernel.
+ */
+typedef struct zc_buffer_t zc_buffer_t;
+struct zc_buffer_t {
+    apr_socket_zc_release_fn_t release;
+    void *baton;
+    /* zero-copy sends of the buffer not completed yet */
+    apr_uint32_t refs;
+    int finished;
+    zc_buffer_t *next;          /* free list */
+};
+
+typedef struct zc_pending_t zc_pending_t;
+struct zc_pending_t {
+    APR_RING_ENTRY(zc_pending_t) link;
+    apr_uint32_t id;
+    zc_buffer_t *buffer;
+};
+
+typedef struct socket_zc_t {
+    APR_RING_HEAD(zc_pending_ring_t, zc_pending_t) pending;
+    APR_RING_HEAD(zc_free_ring_t, zc_pending_t) free;
+    apr_uint32_t npending;
+    /* the buffer partially sent, which the next call continues */
+    zc_buffer_t *current;
+    zc_buffer_t *free_buffers;
+    /* buffers not released yet */
+    apr_uint32_t nbuffers;
+    /* id of the next zero-copy send, as counted by the kernel */
+    apr_uint32_t next_id;
+    /* zero-copy is off when not supported, or when the kernel copies */
+    int enabled;
+} socket_zc_t;
+
+static void zc_buffer_put(socket_zc_t *zc, zc_buffer_t *buffer)
+{
+    if (buffer->finished && !buffer->refs) {
+        buffer->next = zc->free_buffers;
+        zc->free_buffers = buffer;
+        zc->nbuffers--;
+        buffer->release(buffer->baton);
+    }
+}
+
+static void zc_buffer_finish(socket_zc_t *zc, zc_buffer_t *buffer)
+{
+    if (zc->current == buffer) {
+        zc->current = NULL;
+    }
+    buffer->finished = 1;
+    zc_buffer_put(zc, buffer);
+}
+
+/* The buffer continued by a call for release/baton, which finishes the
+ * one the caller gave up on if any, or a new one if create is set.
+ */
+static zc_buffer_t *zc_buffer_get(apr_socket_t *sock, socket_zc_t *zc,
+                                  apr_socket_zc_release_fn_t release,
+                                  void *baton, int create)
+{
+    zc_buffer_t *buffer = zc->current;
+
+    if (buffer && (buffer->release != release || buffer->baton != baton)) {
+        zc_buffer_finish(zc, buffer);
+        buffer = NULL;
+    }
+    if (!buffer && create) {
+        if (zc->free_buffers) {
+            buffer = zc->free_buffers;
+            zc->free_buffers = buffer->next;
+        }
+        else {
+            buffer = apr_palloc(sock->pool, sizeof(*buffer));
+        }
+        buffer->release = release;
+        buffer->baton = baton;
+        buffer->refs = 0;
+        buffer->finished = 0;
+        zc->nbuffers++;
+        zc->current = buffer;
+    }
+    return buffer;
+}
+
+static void zc_release(socket_zc_t *zc, zc_pending_t *pend)
+{
+    APR_RING_REMOVE(pend, link);
+    APR_RING_INSERT_TAIL(&zc->free, pend, zc_pending_t, link);
+    zc->npending--;
+    pend->buffer->refs--;
+    zc_buffer_put(zc, pend->buffer);
+}
+
+static void zc_release_all(socket_zc_t *zc)
+{
+    while (!APR_RING_EMPTY(&zc->pending, zc_pending_t, link)) {
+        zc_release(zc, APR_RING_FIRST(&zc->pending));
+    }
+    if (zc->current) {
+        zc_buffer_finish(zc, zc->current);
+    }
+}
+
+/* Runs before the subpools are destroyed, the batons may live there,
+ * and before the socket is closed, so the kernel gets some time to be
+ * done with the bytes still queued.
+ */
+static apr_status_t zc_cleanup(void *data)
+{
+    apr_socket_t *sock = data;
+
+    if (sock->socketdes != -1) {
+        (void)apr_socket_zc_reap(sock, SOCKET_ZC_LINGER, NULL);
+    }
+    zc_release_all(sock->zc);
+    return APR_SUCCESS;
+}
+
+static socket_zc_t *zc_get(apr_socket_t *sock)
+{
+    socket_zc_t *zc = sock->zc;
+
+    if (!zc) {
+        int one = 1;
+
+        zc = apr_palloc(sock->pool, sizeof(*zc));
+        APR_RING_INIT(&zc->pending, zc_pending_t, link);
+        APR_RING_INIT(&zc->free, zc_pending_t, link);
+        zc->npending = 0;
+        zc->current = NULL;
+        zc->free_buffers = NULL;
+        zc->nbuffers = 0;
+        zc->next_id = 0;
+        zc->enabled = (sock->type == SOCK_STREAM
+                       && setsockopt(sock->socketdes, SOL_SOCKET,
+                                     SO_ZEROCOPY, &one, sizeof(one)) == 0);
+        apr_pool_pre_cleanup_register(sock->pool, sock, zc_cleanup);
+        sock->zc = zc;
+    }
+    return zc;
+}
+
+/* Release the sends from lo to hi (inclusive, wrapping) */
+static void zc_complete(socket_zc_t *zc, apr_uint32_t lo, apr_uint32_t hi)
+{
+    zc_pending_t *pend, *next;
+
+    for (pend = APR_RING_FIRST(&zc->pending);
+         pend != APR_RING_SENTINEL(&zc->pending, zc_pending_t, link);
+         pend = next) {
+        next = APR_RING_NEXT(pend, link);
+        if (pend->id - lo <= hi - lo) {
+            zc_release(zc, pend);
+        }
+    }
+}
+
+/* Read the completions already in the error queue */
+static apr_status_t zc_read_errqueue(apr_socket_t *sock, socket_zc_t *zc)
+{
+    while (zc->npending) {
+        union {
+            char buf[CMSG_SPACE(sizeof(struct sock_extended_err))
+                     + CMSG_SPACE(sizeof(struct sockaddr_in6))];
+            struct cmsghdr align;
+        } control;
+        struct msghdr mh;
+        struct cmsghdr *cm;
+        int rc;
+
+        memset(&mh, 0, sizeof(mh));
+        mh.msg_control = control.buf;
+        mh.msg_controllen = sizeof(control.buf);
+        do {
+            rc = recvmsg(sock->socketdes, &mh, MSG_ERRQUEUE | MSG_DONTWAIT);
+        } while (rc == -1 && errno == EINTR);
+        if (rc == -1) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? APR_SUCCESS
+                                                             : errno;
+        }
+
+        for (cm = CMSG_FIRSTHDR(&mh); cm; cm = CMSG_NXTHDR(&mh, cm)) {
+            struct sock_extended_err serr;
+
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+#if APR_HAVE_IPV6
+                  || (cm->cmsg_level == SOL_IPV6
+                      && cm->cmsg_type == IPV6_RECVERR)
+#endif
+                  )) {
+                continue;
+            }
+            memcpy(&serr, CMSG_DATA(cm), sizeof(serr));
+            if (serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr.ee_errno) {
+                continue;
+            }
+            /* Copying anyway costs more than the plain send */
+            if (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                zc->enabled = 0;
+            }
+            zc_complete(zc, serr.ee_info, serr.ee_data);
+        }
+    }
+    return APR_SUCCESS;
+}
+
+apr_status_t apr_socket_send_zc(apr_socket_t *sock, const char *buf,
+                                apr_size_t *len,
+                                apr_socket_zc_release_fn_t release,
+                                void *baton)
+{
+    socket_zc_t *zc = zc_get(sock);
+    zc_buffer_t *buffer;
+    zc_pending_t *pend;
+    apr_size_t want = *len;
+    apr_status_t arv = APR_SUCCESS;
+    apr_ssize_t rv;
+
+    if (zc->npending) {
+        (void)zc_read_errqueue(sock, zc);
+    }
+    if (!zc->enabled || *len < ZC_MIN_SIZE) {
+        goto do_copy;
+    }
+
+    if (sock->options & APR_INCOMPLETE_WRITE) {
+        sock->options &= ~APR_INCOMPLETE_WRITE;
+        goto do_select;
+    }
+
+    do {
+        rv = send(sock->socketdes, buf, *len, MSG_ZEROCOPY);
+    } while (rv == -1 && errno == EINTR);
+
+    while (rv == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)
+                    && (sock->timeout > 0)) {
+do_select:
+        arv = apr_wait_for_io_or_timeout(NULL, sock, 0);
+        if (arv != APR_SUCCESS) {
+            *len = 0;
+            goto done;
+        }
+        else {
+            do {
+                rv = send(sock->socketdes, buf, *len, MSG_ZEROCOPY);
+            } while (rv == -1 && errno == EINTR);
+        }
+    }
+    if (rv == -1) {
+        /* Too many pages pinned already */
+        if (errno == ENOBUFS) {
+            goto do_copy;
+        }
+        *len = 0;
+        arv = errno;
+        goto done;
+    }
+    if ((sock->timeout > 0) && (rv < *len)) {
+        sock->options |= APR_INCOMPLETE_WRITE;
+    }
+    *len = rv;
+
+    /* the kernel references the buffer until the send completes */
+    buffer = zc_buffer_get(sock, zc, release, baton, 1);
+    if (!APR_RING_EMPTY(&zc->free, zc_pending_t, link)) {
+        pend = APR_RING_FIRST(&zc->free);
+        APR_RING_REMOVE(pend, link);
+    }
+    else {
+        pend = apr_palloc(sock->pool, sizeof(*pend));
+    }
+    pend->id = zc->next_id++;
+    pend->buffer = buffer;
+    buffer->refs++;
+    APR_RING_INSERT_TAIL(&zc->pending, pend, zc_pending_t, link);
+    zc->npending++;
+    goto done;
+
+do_copy:
+    arv = apr_socket_send(sock, buf, len);
+
+done:
+    /* A partial send, or one to retry, leaves the buffer to the next
+     * call, otherwise the buffer is finished.
+     */
+    if ((arv == APR_SUCCESS && *len < want)
+            || APR_STATUS_IS_EAGAIN(arv) || APR_STATUS_IS_TIMEUP(arv)) {
+        (void)zc_buffer_get(sock, zc, release, baton, *len > 0);
+    }
+    else if ((buffer = zc_buffer_get(sock, zc, release, baton, 0))) {
+        zc_buffer_finish(zc, buffer);
+    }
+    else {
+        release(baton);
+    }
+    return arv;
+}
+
+apr_status_t apr_socket_zc_reap(apr_socket_t *sock,
+                                apr_interval_time_t timeout,
+                                apr_uint32_t *pending)
+{
+    socket_zc_t *zc = sock->zc;
+    apr_time_t deadline = 0;
+    apr_status_t rv = APR_SUCCESS;
+
+    if (zc && sock->socketdes == -1) {
+        zc_release_all(zc);
+    }
+    if (timeout > 0) {
+        deadline = apr_time_now() + timeout;
+    }
+    while (zc && zc->npending) {
+        struct pollfd pfd;
+        int rc, ms = -1;
+
+        if ((rv = zc_read_errqueue(sock, zc)) != APR_SUCCESS
+                || !zc->npending || timeout == 0) {
+            break;
+        }
+        if (timeout > 0) {
+            apr_interval_time_t left = deadline - apr_time_now();
+
+            if (left <= 0) {
+                rv = APR_TIMEUP;
+                break;
+            }
+            ms = (int)apr_time_as_msec(left + 999);
+        }
+
+        /* The error queue is signaled by POLLERR, always polled */
+        pfd.fd = sock->socketdes;
+        pfd.events = 0;
+        pfd.revents = 0;
+        rc = poll(&pfd, 1, ms);
+        if (rc == -1 && errno != EINTR) {
+            rv = errno;
+            break;
+        }
+        if (rc > 0 && (pfd.revents & POLLNVAL)) {
+            zc_release_all(zc);
+        }
+    }
+    if (zc && zc->npending && timeout == 0 && rv == APR_SUCCESS) {
+        rv = APR_TIMEUP;
+    }
+
+    if (pending) {
+        *pending = zc ? zc->nbuffers : 0;
+    }
+    return rv;
+}
+
+#else /* !USE_ZEROCOPY */
+
+apr_status_t apr_socket_send_zc(apr_socket_t *sock, const char *buf,
+                                apr_size_t *len,
+                                apr_socket_zc_release_fn_t release,
+                                void *baton)
+{
+    apr_size_t want = *len;
+    apr_status_t rv = apr_socket_send(sock, buf, len);
+
+    /* copied, so finished unless the caller sends the rest */
+    if ((rv == APR_SUCCESS && *len == want)
+            || (rv != APR_SUCCESS && !APR_STATUS_IS_EAGAIN(rv)
+                && !APR_STATUS_IS_TIMEUP(rv))) {
+        release(baton);
+    }
+    return rv;
+}
+
+apr_status_t apr_socket_zc_reap(apr_socket_t *sock,
+                                apr_interval_time_t timeout,
+                                apr_uint32_t *pending)
+{
+    if (pending) {
+        *pending = 0;
+    }
+    return APR_SUCCESS;
+}
+
+#endif /* USE_ZEROCOPY */
+
+#ifdef USE_SPLICE
+
+/* A pipe, and the number of bytes in it */
+typedef struct socket_splice_t {
+    int fd[2];
+    apr_size_t pending;
+} socket_splice_t;
+
+static void splice_pipe_destroy(void *data)
+{
+    socket_splice_t *sp = data;
+
+    close(sp->fd[0]);
+    close(sp->fd[1]);
+    free(sp);
+}
+
+static apr_status_t splice_pipe_cleanup(void *data)
+{
+    splice_pipe_destroy(data);
+    return APR_SUCCESS;
+}
+
+static socket_splice_t *splice_pipe_create(void)
+{
+    socket_splice_t *sp = malloc(sizeof(*sp));
+
+    if (!sp) {
+        return NULL;
+    }
+    if (pipe2(sp->fd, O_NONBLOCK | O_CLOEXEC) == -1) {
+        free(sp);
+        return NULL;
+    }
+    sp->pending = 0;
+    return sp;
+}
+
+#if APR_HAS_THREADS
+static pthread_once_t splice_once = PTHREAD_ONCE_INIT;
+static pthread_key_t splice_key;
+static int splice_key_ok;
+
+static void splice_key_create(void)
+{
+    splice_key_ok = (pthread_key_create(&splice_key,
+                                        splice_pipe_destroy) == 0);
+}
+
+/* The calling thread's pipe, closed when the thread exits */
+static socket_splice_t *splice_pipe_get(void)
+{
+    socket_splice_t *sp;
+
+    pthread_once(&splice_once, splice_key_create);
+    if (!splice_key_ok) {
+        return NULL;
+    }
+    sp = pthread_getspecific(splice_key);
+    if (!sp && (sp = splice_pipe_create())) {
+        pthread_setspecific(splice_key, sp);
+    }
+    return sp;
+}
+
+static void splice_pipe_detach(void)
+{
+    pthread_setspecific(splice_key, NULL);
+}
+#else
+static socket_splice_t *splice_thread_pipe;
+
+static socket_splice_t *splice_pipe_get(void)
+{
+    if (!splice_thread_pipe) {
+        splice_thread_pipe = splice_pipe_create();
+    }
+    return splice_thread_pipe;
+}
+
+static void splice_pipe_detach(void)
+{
+    splice_thread_pipe = NULL;
+}
+#endif
+
+/* Write what's in the pipe to dst */
+static apr_status_t splice_flush(apr_socket_t *dst, socket_splice_t *sp,
+                                 apr_size_t *written)
+{
+    while (sp->pending) {
+        apr_ssize_t rv;
+
+        /* The pipe is not empty, only dst can block (if blocking) */
+        do {
+            rv = splice(sp->fd[0], NULL, dst->socketdes, NULL, sp->pending,
+                        SPLICE_F_MOVE);
+        } while (rv == -1 && errno == EINTR);
+        if (rv == -1) {
+            apr_status_t arv = errno;
+
+            if ((arv == EAGAIN || arv == EWOULDBLOCK) && dst->timeout > 0
+                    && (arv = apr_wait_for_io_or_timeout(NULL, dst,
+                                                         0)) == APR_SUCCESS) {
+                continue;
+            }
+            return arv;
+        }
+        sp->pending -= rv;
+        *written += rv;
+    }
+    return APR_SUCCESS;
+}
+
+apr_status_t apr_socket_splice(apr_socket_t *src, apr_socket_t *dst,
+                               apr_size_t *len)
+{
+    socket_splice_t *sp = dst->splice;
+    apr_size_t max = *len, written = 0;
+    apr_status_t rv = APR_SUCCESS;
+
+    /* What was left for dst first */
+    if (sp && sp->pending) {
+        rv = splice_flush(dst, sp, &written);
+        if (sp->pending) {
+            *len = written;
+            return written ? APR_SUCCESS : rv;
+        }
+    }
+    if (!sp && !(sp = splice_pipe_get())) {
+        *len = written;
+        return written ? APR_SUCCESS : APR_ENOMEM;
+    }
+
+    while (written < max) {
+        apr_ssize_t n;
+
+        /* The pipe is empty, only src can block (if blocking) */
+        do {
+            n = splice(src->socketdes, NULL, sp->fd[1], NULL, max - written,
+                       SPLICE_F_MOVE
+                       | (src->timeout < 0 ? 0 : SPLICE_F_NONBLOCK));
+        } while (n == -1 && errno == EINTR);
+        if (n == -1) {
+            rv = errno;
+            if ((rv == EAGAIN || rv == EWOULDBLOCK) && !written
+                    && src->timeout > 0
+                    && (rv = apr_wait_for_io_or_timeout(NULL, src,
+                                                        1)) == APR_SUCCESS) {
+                continue;
+            }
+            break;
+        }
+        if (n == 0) {
+            rv = APR_EOF;
+            break;
+        }
+
+        sp->pending = n;
+        rv = splice_flush(dst, sp, &written);
+        if (sp->pending) {
+            /* dst keeps the data, the thread gets another pipe */
+            if (!dst->splice) {
+                splice_pipe_detach();
+                dst->splice = sp;
+                apr_pool_cleanup_register(dst->pool, sp, splice_pipe_cleanup,
+                                          apr_pool_cleanup_null);
+            }
+            break;
+        }
+        /* A blocking src would block again */
+        if (rv != APR_SUCCESS || src->timeout < 0) {
+            break;
+        }
+    }
+
+    *len = written;
+    return written ? APR_SUCCESS : rv;
+}
+
+#else /* !USE_SPLICE */
+
+#define SPLICE_BUFSIZE 65536
+
+/* What was read for the socket, not written yet */
+typedef struct socket_splice_t {
+    char buf[SPLICE_BUFSIZE];
+    apr_size_t offset;
+    apr_size_t pending;
+} socket_splice_t;
+
+static apr_status_t splice_flush(apr_socket_t *dst, const char *buf,
+                                 apr_size_t *offset, apr_size_t *pending,
+                                 apr_size_t *written)
+{
+    while (*pending) {
+        apr_size_t n = *pending;
+        apr_status_t rv = apr_socket_send(dst, buf + *offset, &n);
+
+        *offset += n;
+        *pending -= n;
+        *written += n;
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    return APR_SUCCESS;
+}
+
+apr_status_t apr_socket_splice(apr_socket_t *src, apr_socket_t *dst,
+                               apr_size_t *len)
+{
+    socket_splice_t *sp = dst->splice;
+    apr_size_t max = *len, written = 0;
+    apr_status_t rv = APR_SUCCESS;
+    char buf[SPLICE_BUFSIZE];
+
+    if (sp && sp->pending) {
+        rv = splice_flush(dst, sp->buf, &sp->offset, &sp->pending, &written);
+        if (sp->pending) {
+            *len = written;
+            return written ? APR_SUCCESS : rv;
+        }
+    }
+
+    while (written < max) {
+        apr_size_t n = max - written, offset = 0;
+
+        if (n > sizeof(buf)) {
+            n = sizeof(buf);
+        }
+        rv = apr_socket_recv(src, buf, &n);
+        if (n == 0) {
+            break;
+        }
+
+        rv = splice_flush(dst, buf, &offset, &n, &written);
+        if (n) {
+            /* dst keeps the data */
+            if (!sp) {
+                sp = dst->splice = apr_palloc(dst->pool, sizeof(*sp));
+            }
+            memcpy(sp->buf, buf + offset, n);
+            sp->offset = 0;
+            sp->pending = n;
+            break;
+        }
+        /* Unless non-blocking, src would wait again */
+        if (rv != APR_SUCCESS || src->timeout != 0) {
+            break;
+        }
+    }
+
+    *len = written;
+    return written ? APR_SUCCESS : rv;
+}
+
+#endif /* USE_SPLICE */
+
+/* Datagrams passed to the kernel per sendmmsg() or recvmmsg() call */
+#define MMSG_BATCH 64
+
+#if defined(HAVE_RECVMMSG) && defined(MSG_WAITFORONE)
+#define USE_RECVMMSG 1
+#endif
+
+/* Room for the UDP_SEGMENT or UDP_GRO control message */
+typedef union {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+} msg_control_t;
+
+static void msghdr_set(struct msghdr *mh, apr_socket_msg_t *msg,
+                       msg_control_t *control, int send)
+{
+    memset(mh, 0, sizeof(*mh));
+    mh->msg_iov = msg->vec;
+    mh->msg_iovlen = msg->nvec;
+    if (msg->addr) {
+        mh->msg_name = &msg->addr->sa;
+        mh->msg_namelen = send ? msg->addr->salen : sizeof(msg->addr->sa);
+    }
+    if (!control) {
+        return;
+    }
+    if (send) {
+#ifdef UDP_SEGMENT
+        struct cmsghdr *cm;
+        apr_uint16_t segment_size = msg->segment_size;
+
+        mh->msg_control = control->buf;
+        mh->msg_controllen = CMSG_SPACE(sizeof(segment_size));
+        cm = CMSG_FIRSTHDR(mh);
+        cm->cmsg_level = IPPROTO_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof(segment_size));
+        memcpy(CMSG_DATA(cm), &segment_size, sizeof(segment_size));
+#endif
+    }
+    else {
+        mh->msg_control = control->buf;
+        mh->msg_controllen = sizeof(control->buf);
+    }
+}
+
+static void msg_received(apr_socket_msg_t *msg, struct msghdr *mh,
+                         apr_size_t len)
+{
+    msg->len = len;
+    msg->segment_size = 0;
+#ifdef UDP_GRO
+    if (mh->msg_control) {
+        struct cmsghdr *cm;
+
+        for (cm = CMSG_FIRSTHDR(mh); cm; cm = CMSG_NXTHDR(mh, cm)) {
+            if (cm->cmsg_level == IPPROTO_UDP && cm->cmsg_type == UDP_GRO) {
+                int segment_size;
+
+                memcpy(&segment_size, CMSG_DATA(cm), sizeof(segment_size));
+                msg->segment_size = (apr_uint16_t)segment_size;
+                break;
+            }
+        }
+    }
+#endif
+    /* As with recvfrom(), the address may not be filled in */
+    if (msg->addr
+            && mh->msg_namelen > APR_OFFSETOF(struct sockaddr_in, sin_port)) {
+        msg->addr->salen = mh->msg_namelen;
+        apr_sockaddr_vars_set(msg->addr, msg->addr->sa.sin.sin_family,
+                              ntohs(msg->addr->sa.sin.sin_port));
+    }
+}
+
+apr_status_t apr_socket_sendmmsg(apr_socket_t *sock, apr_int32_t flags,
+                                 apr_socket_msg_t *msgs, apr_uint32_t *nmsgs)
+{
+    apr_uint32_t n = *nmsgs, sent = 0, i;
+    apr_status_t rv = APR_SUCCESS;
+
+#ifndef UDP_SEGMENT
+    for (i = 0; i < n; ++i) {
+        if (msgs[i].segment_size) {
+            *nmsgs = 0;
+            return APR_ENOTIMPL;
+        }
+    }
+#endif
+
+    while (sent < n) {
+#ifdef HAVE_SENDMMSG
+        struct mmsghdr mmh[MMSG_BATCH];
+        msg_control_t control[MMSG_BATCH];
+        apr_uint32_t batch = n - sent;
+        int rc;
+
+        if (batch > MMSG_BATCH) {
+            batch = MMSG_BATCH;
+        }
+        for (i = 0; i < batch; ++i) {
+            apr_socket_msg_t *msg = &msgs[sent + i];
+
+            msghdr_set(&mmh[i].msg_hdr, msg,
+                       msg->segment_size ? &control[i] : NULL, 1);
+        }
+        do {
+            rc = sendmmsg(sock->socketdes, mmh, batch, flags);
+        } while (rc == -1 && errno == EINTR);
+#else
+        msg_control_t control;
+        struct msghdr mh;
+        apr_ssize_t rc;
+
+        msghdr_set(&mh, &msgs[sent],
+                   msgs[sent].segment_size ? &control : NULL, 1);
+        do {
+            rc = sendmsg(sock->socketdes, &mh, flags);
+        } while (rc == -1 && errno == EINTR);
+#endif
+        if (rc == -1) {
+            rv = errno;
+            /* Only wait until the first datagram is sent */
+            if ((rv == EAGAIN || rv == EWOULDBLOCK) && !sent
+                    && sock->timeout > 0
+                    && (rv = apr_wait_for_io_or_timeout(NULL, sock,
+                                                        0)) == APR_SUCCESS) {
+                continue;
+            }
+            break;
+        }
+#ifdef HAVE_SENDMMSG
+        for (i = 0; i < (apr_uint32_t)rc; ++i) {
+            msgs[sent + i].len = mmh[i].msg_len;
+        }
+        sent += rc;
+        if ((apr_uint32_t)rc < batch) {
+            break;
+        }
+#else
+        msgs[sent++].len = rc;
+#endif
+    }
+
+    *nmsgs = sent;
+    return sent ? APR_SUCCESS : rv;
+}
+
+apr_status_t apr_socket_recvmmsg(apr_socket_t *sock, apr_int32_t flags,
+                                 apr_socket_msg_t *msgs, apr_uint32_t *nmsgs)
+{
+    apr_uint32_t n = *nmsgs, recvd = 0;
+    apr_status_t rv = APR_SUCCESS;
+    int gro = apr_is_option_set(sock, APR_UDP_GRO);
+
+    while (recvd < n) {
+#ifdef USE_RECVMMSG
+        struct mmsghdr mmh[MMSG_BATCH];
+        msg_control_t control[MMSG_BATCH];
+        apr_uint32_t batch = n - recvd, i;
+        int rc;
+
+        if (batch > MMSG_BATCH) {
+            batch = MMSG_BATCH;
+        }
+        for (i = 0; i < batch; ++i) {
+            msghdr_set(&mmh[i].msg_hdr, &msgs[recvd + i],
+                       gro ? &control[i] : NULL, 0);
+        }
+        /* Wait for the first datagram only, then take what's queued */
+        do {
+            rc = recvmmsg(sock->socketdes, mmh, batch,
+                          flags | (recvd ? MSG_DONTWAIT : MSG_WAITFORONE),
+                          NULL);
+        } while (rc == -1 && errno == EINTR);
+#else
+        msg_control_t control;
+        struct msghdr mh;
+        apr_ssize_t rc;
+
+        msghdr_set(&mh, &msgs[recvd], gro ? &control : NULL, 0);
+        do {
+            rc = recvmsg(sock->socketdes, &mh, flags);
+        } while (rc == -1 && errno == EINTR);
+#endif
+        if (rc == -1) {
+            rv = errno;
+            if ((rv == EAGAIN || rv == EWOULDBLOCK) && !recvd
+                    && sock->timeout > 0
+                    && (rv = apr_wait_for_io_or_timeout(NULL, sock,
+                                                        1)) == APR_SUCCESS) {
+                continue;
+            }
+            break;
+        }
+#ifdef USE_RECVMMSG
+        for (i = 0; i < (apr_uint32_t)rc; ++i) {
+            msg_received(&msgs[recvd + i], &mmh[i].msg_hdr, mmh[i].msg_len);
+        }
+        recvd += rc;
+        if ((apr_uint32_t)rc < batch) {
+            break;
+        }
+#else
+        msg_received(&msgs[recvd++], &mh, rc);
+#ifdef MSG_DONTWAIT
+        flags |= MSG_DONTWAIT;
+#else
+        break;
+#endif
+#endif
+    }
+
+    *nmsgs = recvd;
+    return recvd ? APR_SUCCESS : rv;
+}
+
 apr_status_t apr_socket_wait(apr_socket_t *sock, apr_wait_type_t direction)
 {
     return apr_wait_for_io_or_timeout(NULL, sock, direction == APR_WAIT_READ);
@@ -16,6 +16,9 @@
 
 #include "apr_network_io.h"
 #include "apr_poll.h"
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
 
 APR_DECLARE(apr_status_t) apr_socket_atreadeof(apr_socket_t *sock, int *atreadeof)
 {
@@ -73,3 +76,60 @@ APR_DECLARE(apr_status_t) apr_socket_atreadeof(apr_socket_t *sock, int *atreadeo
     return APR_EGENERAL;
 }
 
+
+static const apr_socket_optval_t low_latency_opts[] = {
+    { APR_TCP_NODELAY, 1 },
+    { APR_TCP_QUICKACK, 1 },
+    { APR_SO_BUSY_POLL, 50 }
+};
+
+static const apr_socket_optval_t low_latency_listen_opts[] = {
+    { APR_TCP_NODELAY, 1 },
+    { APR_TCP_DEFER_ACCEPT, 1 },
+    { APR_TCP_FASTOPEN, 256 }
+};
+
+#define PROFILE(name, opts) { name, opts, sizeof(opts) / sizeof(opts[0]) }
+
+static const apr_socket_profile_t profiles[] = {
+    PROFILE("low-latency", low_latency_opts),
+    PROFILE("low-latency-listen", low_latency_listen_opts)
+};
+
+APR_DECLARE(const apr_socket_profile_t *) apr_socket_profile_get(const char *name)
+{
+    int i;
+
+    for (i = 0; i < sizeof(profiles) / sizeof(profiles[0]); ++i) {
+        if (strcmp(profiles[i].name, name) == 0) {
+            return &profiles[i];
+        }
+    }
+    return NULL;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_profile_apply(apr_socket_t *sock,
+                                                   const apr_socket_profile_t *profile,
+                                                   apr_int32_t *unsupported)
+{
+    apr_status_t rv;
+    int i;
+
+    if (unsupported) {
+        *unsupported = 0;
+    }
+    for (i = 0; i < profile->nopts; ++i) {
+        const apr_socket_optval_t *o = &profile->opts[i];
+
+        rv = apr_socket_opt_set(sock, o->opt, o->on);
+        if (rv == APR_ENOTIMPL || APR_STATUS_IS_EACCES(rv)) {
+            if (unsupported) {
+                *unsupported |= o->opt;
+            }
+        }
+        else if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    return APR_SUCCESS;
+}
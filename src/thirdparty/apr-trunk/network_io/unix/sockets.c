@@ -210,7 +210,17 @@ apr_status_t apr_socket_shutdown(apr_socket_t *thesocket,
 
 apr_status_t apr_socket_close(apr_socket_t *thesocket)
 {
-    return apr_pool_cleanup_run(thesocket->pool, thesocket, socket_cleanup);
+    apr_status_t rv;
+
+    if (thesocket->zc && thesocket->socketdes != -1) {
+        (void)apr_socket_zc_reap(thesocket, SOCKET_ZC_LINGER, NULL);
+    }
+    rv = apr_pool_cleanup_run(thesocket->pool, thesocket, socket_cleanup);
+    if (thesocket->zc) {
+        /* the completions can't be read anymore */
+        (void)apr_socket_zc_reap(thesocket, 0, NULL);
+    }
+    return rv;
 }
 
 apr_status_t apr_socket_bind(apr_socket_t *sock, apr_sockaddr_t *sa)
@@ -280,6 +290,13 @@ apr_status_t apr_socket_accept(apr_socket_t **new, apr_socket_t *sock,
         return APR_EINTR;
     }
 #endif
+    return apr__socket_accepted(new, sock, s, &sa, connection_context);
+}
+
+apr_status_t apr__socket_accepted(apr_socket_t **new, apr_socket_t *sock,
+                                  int s, apr_sockaddr_t *sa,
+                                  apr_pool_t *connection_context)
+{
     alloc_socket(new, connection_context);
 
     /* Set up socket variables -- note that it may be possible for
@@ -287,7 +304,7 @@ apr_status_t apr_socket_accept(apr_socket_t **new, apr_socket_t *sock,
      * dual-stack configurations, so ensure that the remote_/local_addr
      * structures are adjusted for the family of the accepted
      * socket: */
-    set_socket_vars(*new, sa.sa.sin.sin_family, SOCK_STREAM, sock->protocol);
+    set_socket_vars(*new, sa->sa.sin.sin_family, SOCK_STREAM, sock->protocol);
 
 #ifndef HAVE_POLL
     (*new)->connected = 1;
@@ -299,8 +316,8 @@ apr_status_t apr_socket_accept(apr_socket_t **new, apr_socket_t *sock,
     (*new)->socketdes = s;
 
     /* Copy in peer's address. */
-    (*new)->remote_addr->sa = sa.sa;
-    (*new)->remote_addr->salen = sa.salen;
+    (*new)->remote_addr->sa = sa->sa;
+    (*new)->remote_addr->salen = sa->salen;
 
     *(*new)->local_addr = *sock->local_addr;
 
@@ -420,6 +437,20 @@ apr_status_t apr_socket_connect(apr_socket_t *sock, apr_sockaddr_t *sa)
 #endif /* SO_ERROR */
     }
 
+    apr__socket_connected(sock, sa);
+
+    if (rc == -1 && errno != EISCONN) {
+        return errno;
+    }
+
+#ifndef HAVE_POLL
+    sock->connected=1;
+#endif
+    return APR_SUCCESS;
+}
+
+void apr__socket_connected(apr_socket_t *sock, apr_sockaddr_t *sa)
+{
     if (memcmp(sa->ipaddr_ptr, generic_inaddr_any, sa->ipaddr_len)) {
         /* A real remote address was passed in.  If the unspecified
          * address was used, the actual remote addr will have to be
@@ -452,15 +483,6 @@ apr_status_t apr_socket_connect(apr_socket_t *sock, apr_sockaddr_t *sa)
          */
         sock->local_interface_unknown = 1;
     }
-
-    if (rc == -1 && errno != EISCONN) {
-        return errno;
-    }
-
-#ifndef HAVE_POLL
-    sock->connected=1;
-#endif
-    return APR_SUCCESS;
 }
 
 apr_status_t apr_socket_type_get(apr_socket_t *sock, int *type)
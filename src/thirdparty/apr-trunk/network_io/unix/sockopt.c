@@ -161,6 +161,69 @@ apr_status_t apr_socket_opt_set(apr_socket_t *sock,
             apr_set_option(sock, APR_SO_REUSEADDR, on);
         }
         break;
+    case APR_SO_REUSEPORT:
+#ifdef SO_REUSEPORT
+        if (on != apr_is_option_set(sock, APR_SO_REUSEPORT)) {
+            if (setsockopt(sock->socketdes, SOL_SOCKET, SO_REUSEPORT, (void *)&one, sizeof(int)) == -1) {
+                return errno;
+            }
+            apr_set_option(sock, APR_SO_REUSEPORT, on);
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_UDP_GRO:
+#ifdef UDP_GRO
+        if (on != apr_is_option_set(sock, APR_UDP_GRO)) {
+            int optval = on ? 1 : 0;
+            if (setsockopt(sock->socketdes, IPPROTO_UDP, UDP_GRO, (void *)&optval, sizeof(int)) == -1) {
+                return errno;
+            }
+            apr_set_option(sock, APR_UDP_GRO, on);
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_SO_BUSY_POLL:
+#ifdef SO_BUSY_POLL
+        /* raising it above net.core.busy_read needs CAP_NET_ADMIN */
+        if (setsockopt(sock->socketdes, SOL_SOCKET, SO_BUSY_POLL, (void *)&on, sizeof(int)) == -1) {
+            return errno == EPERM ? APR_EACCES : errno;
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_SO_INCOMING_CPU:
+#ifdef SO_INCOMING_CPU
+        if (setsockopt(sock->socketdes, SOL_SOCKET, SO_INCOMING_CPU, (void *)&on, sizeof(int)) == -1) {
+            return errno;
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_TCP_QUICKACK:
+#ifdef TCP_QUICKACK
+        /* not cached, the kernel leaves quickack mode by itself */
+        if (setsockopt(sock->socketdes, IPPROTO_TCP, TCP_QUICKACK, (void *)&one, sizeof(int)) == -1) {
+            return errno;
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_TCP_FASTOPEN:
+#ifdef TCP_FASTOPEN
+        if (setsockopt(sock->socketdes, IPPROTO_TCP, TCP_FASTOPEN, (void *)&on, sizeof(int)) == -1) {
+            return errno;
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
     case APR_SO_SNDBUF:
 #ifdef SO_SNDBUF
         if (setsockopt(sock->socketdes, SOL_SOCKET, SO_SNDBUF, (void *)&on, sizeof(int)) == -1) {
@@ -439,6 +502,121 @@ apr_status_t apr_socket_accept_filter(apr_socket_t *sock, const char *name,
 }
 #endif
 
+#if defined(HAVE_LINUX_TLS_H) && defined(TCP_ULP) && defined(TLS_TX)
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+/* The kernel splits the 12 bytes IV in a salt (the implicit nonce, empty
+ * for ChaCha20-Poly1305) and the per record IV.
+ */
+#define TLS_CRYPTO_INFO_SET(info, keys, seq) do { \
+    memcpy((info).key, (keys)->key, sizeof((info).key)); \
+    memcpy((info).salt, (keys)->iv, sizeof((info).salt)); \
+    memcpy((info).iv, (keys)->iv + sizeof((info).salt), sizeof((info).iv)); \
+    memcpy((info).rec_seq, (seq), sizeof((info).rec_seq)); \
+} while (0)
+
+apr_status_t apr_socket_tls_install(apr_socket_t *sock, int direction,
+                                    const apr_socket_tls_keys_t *keys)
+{
+    union {
+        struct tls_crypto_info info;
+        struct tls12_crypto_info_aes_gcm_128 aes_gcm_128;
+#ifdef TLS_CIPHER_AES_GCM_256
+        struct tls12_crypto_info_aes_gcm_256 aes_gcm_256;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+        struct tls12_crypto_info_chacha20_poly1305 chacha20_poly1305;
+#endif
+    } ci;
+    socklen_t cilen;
+    unsigned char seq[8];
+    apr_status_t rv;
+    int optname, i;
+
+    switch (direction) {
+    case APR_SOCKET_TLS_TX:
+        optname = TLS_TX;
+        break;
+    case APR_SOCKET_TLS_RX:
+        optname = TLS_RX;
+        break;
+    default:
+        return APR_EINVAL;
+    }
+
+    /* the record sequence number, in network byte order */
+    for (i = sizeof(seq) - 1; i >= 0; --i) {
+        seq[i] = (unsigned char)(keys->seq >> (8 * (sizeof(seq) - 1 - i)));
+    }
+
+    memset(&ci, 0, sizeof(ci));
+    switch (keys->version) {
+    case APR_SOCKET_TLS_1_2:
+        ci.info.version = TLS_1_2_VERSION;
+        break;
+#ifdef TLS_1_3_VERSION
+    case APR_SOCKET_TLS_1_3:
+        ci.info.version = TLS_1_3_VERSION;
+        break;
+#endif
+    default:
+        return APR_ENOTIMPL;
+    }
+
+    switch (keys->cipher) {
+    case APR_SOCKET_TLS_AES_GCM_128:
+        ci.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        TLS_CRYPTO_INFO_SET(ci.aes_gcm_128, keys, seq);
+        cilen = sizeof(ci.aes_gcm_128);
+        break;
+#ifdef TLS_CIPHER_AES_GCM_256
+    case APR_SOCKET_TLS_AES_GCM_256:
+        ci.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+        TLS_CRYPTO_INFO_SET(ci.aes_gcm_256, keys, seq);
+        cilen = sizeof(ci.aes_gcm_256);
+        break;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case APR_SOCKET_TLS_CHACHA20_POLY1305:
+        ci.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+        TLS_CRYPTO_INFO_SET(ci.chacha20_poly1305, keys, seq);
+        cilen = sizeof(ci.chacha20_poly1305);
+        break;
+#endif
+    default:
+        return APR_ENOTIMPL;
+    }
+
+    /* The "tls" ULP is already there if the other direction is installed,
+     * ENOENT means the kernel has no TLS module.
+     */
+    rv = APR_SUCCESS;
+    if (setsockopt(sock->socketdes, IPPROTO_TCP, TCP_ULP,
+                   "tls", sizeof("tls")) < 0 && errno != EEXIST) {
+        rv = (errno == ENOENT || errno == ENOPROTOOPT) ? APR_ENOTIMPL : errno;
+    }
+    else if (setsockopt(sock->socketdes, SOL_TLS, optname, &ci, cilen) < 0) {
+        rv = errno;
+    }
+
+    /* the key and salt are secret, don't leave them on the stack */
+    apr_memzero_explicit(&ci, sizeof(ci));
+    return rv;
+}
+
+#else
+
+apr_status_t apr_socket_tls_install(apr_socket_t *sock, int direction,
+                                    const apr_socket_tls_keys_t *keys)
+{
+    return APR_ENOTIMPL;
+}
+
+#endif
+
 APR_PERMS_SET_IMPLEMENT(socket)
 {
 #if APR_HAVE_SOCKADDR_UN
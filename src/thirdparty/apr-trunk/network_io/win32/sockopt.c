@@ -238,6 +238,13 @@ APR_DECLARE(apr_status_t) apr_socket_opt_set(apr_socket_t *sock,
         return APR_ENOTIMPL;
 #endif
         break;
+    case APR_SO_REUSEPORT:
+    case APR_UDP_GRO:
+    case APR_SO_BUSY_POLL:
+    case APR_SO_INCOMING_CPU:
+    case APR_TCP_QUICKACK:
+    case APR_TCP_FASTOPEN:
+        return APR_ENOTIMPL;
     default:
         return APR_EINVAL;
         break;
@@ -273,6 +280,14 @@ APR_DECLARE(apr_status_t) apr_socket_opt_get(apr_socket_t *sock,
 }
 
 
+APR_DECLARE(apr_status_t) apr_socket_tls_install(apr_socket_t *sock,
+                                                 int direction,
+                                                 const apr_socket_tls_keys_t *keys)
+{
+    return APR_ENOTIMPL;
+}
+
+
 APR_DECLARE(apr_status_t) apr_socket_atmark(apr_socket_t *sock, int *atmark)
 {
     u_long oobmark;
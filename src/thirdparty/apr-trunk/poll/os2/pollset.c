@@ -16,6 +16,7 @@
 
 #include "apr.h"
 #include "apr_poll.h"
+#include "apr_stats.h"
 #include "apr_arch_networkio.h"
 
 #ifndef MSG_DONTWAIT
@@ -36,6 +37,7 @@ struct apr_pollset_t {
     apr_socket_t *wake_listen;
     apr_socket_t *wake_sender;
     apr_sockaddr_t *wake_address;
+    apr_stats_histogram_t *stats;
 };
 
 
@@ -60,6 +62,7 @@ APR_DECLARE(apr_status_t) apr_pollset_create(apr_pollset_t **pollset,
     (*pollset)->result_set = apr_palloc(p, size * sizeof(apr_pollfd_t));
     (*pollset)->num_read = -1;
     (*pollset)->wake_listen = NULL;
+    (*pollset)->stats = NULL;
     (*pollset)->wake_sender = NULL;
 
     if (flags & APR_POLLSET_WAKEABLE) {
@@ -288,11 +291,26 @@ APR_DECLARE(apr_status_t) apr_pollset_poll(apr_pollset_t *pollset,
         *descriptors = pollset->result_set;
     }
 
+    if (pollset->stats) {
+        if (rc == APR_SUCCESS) {
+            apr_stats_histogram_record(pollset->stats, *num);
+        }
+        else if (APR_STATUS_IS_TIMEUP(rc) || APR_STATUS_IS_EINTR(rc)) {
+            apr_stats_histogram_record(pollset->stats, 0);
+        }
+    }
+
     return rc;
 }
 
 
 
+APR_DECLARE(void) apr_pollset_stats_set(apr_pollset_t *pollset,
+                                        struct apr_stats_histogram_t *events)
+{
+    pollset->stats = events;
+}
+
 APR_DECLARE(apr_status_t) apr_pollset_wakeup(apr_pollset_t *pollset)
 {
     if (!pollset->wake_sender)
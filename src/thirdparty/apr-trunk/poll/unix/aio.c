@@ -0,0 +1,742 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr.h"
+#include "apr_private.h"
+#include "apr_aio.h"
+
+#if defined(HAVE_IO_URING)
+
+#include "apr_hash.h"
+#include "apr_strings.h"
+#include "apr_arch_file_io.h"
+#include "apr_arch_networkio.h"
+#include "apr_arch_uring.h"
+
+/* The timed waits came with kernel 5.11, after all the operations */
+#define AIO_FEATURES (IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG \
+                      | IORING_FEAT_RW_CUR_POS)
+
+/* An sqe's length is 32 bits, longer transfers are cut short (as the
+ * kernel would anyway, at less than 2GB).
+ */
+#define AIO_MAX_LEN ((apr_size_t)APR_UINT32_MAX)
+
+typedef struct aio_op_t aio_op_t;
+
+struct aio_op_t {
+    apr_aio_completion_t c;     /* c.len is the requested length */
+    apr_pool_t *pool;           /* ACCEPT */
+    apr_sockaddr_t *sa;         /* CONNECT */
+    apr_sockaddr_t peer;        /* ACCEPT */
+    aio_op_t *next;
+    int busy;
+};
+
+/* A fixed file, its slot being its index in aio->fixed */
+typedef struct aio_fixed_t {
+    const void *key;            /* the socket or file */
+} aio_fixed_t;
+
+struct apr_aio_t {
+    apr__uring_t ring;
+    apr_pool_t *pool;
+    apr_uint32_t size;
+    aio_op_t *ops;
+    aio_op_t *free_ops;
+    apr_uint32_t inflight;
+    apr_aio_completion_t *results;
+    /* registered buffers */
+    struct iovec *bufs;
+    apr_size_t nbufs;
+    /* fixed files */
+    aio_fixed_t *fixed;
+    apr_hash_t *fixed_index;
+    int *fixed_free;
+    apr_uint32_t nfixed_free;
+};
+
+static apr_status_t aio_cleanup(void *data)
+{
+    apr_aio_t *aio = data;
+    apr_uint32_t i;
+
+    /* The kernel would still complete the operations in flight after
+     * the ring is closed, cancel them and wait. This runs before the
+     * subpools are destroyed, since the buffers (and the connection pools
+     * of the accepts) often come from them.
+     */
+    for (i = 0; i < aio->size; ++i) {
+        struct io_uring_sqe *sqe;
+
+        if (aio->ops[i].busy && (sqe = apr__uring_get_sqe(&aio->ring))) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = (apr_uintptr_t)&aio->ops[i];
+        }
+    }
+    while (aio->inflight) {
+        struct io_uring_cqe *cqe;
+        apr_status_t rv;
+
+        rv = apr__uring_enter(&aio->ring, apr__uring_flush(&aio->ring),
+                              1, -1);
+        if (rv != APR_SUCCESS && !APR_STATUS_IS_EINTR(rv)) {
+            break;
+        }
+        while ((cqe = apr__uring_cqe(&aio->ring, 0)) != NULL) {
+            aio_op_t *op = (aio_op_t *)(apr_uintptr_t)cqe->user_data;
+
+            if (op) {
+                if (op->c.op == APR_AIO_ACCEPT && cqe->res >= 0) {
+                    close(cqe->res);
+                }
+                op->busy = 0;
+                aio->inflight--;
+            }
+            apr__uring_cq_advance(&aio->ring, 1);
+        }
+    }
+
+    apr__uring_destroy(&aio->ring);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_create(apr_aio_t **paio,
+                                         apr_uint32_t size,
+                                         apr_pool_t *p)
+{
+    apr_aio_t *aio;
+    apr_status_t rv;
+    apr_uint32_t i;
+
+    if (!size) {
+        return APR_EINVAL;
+    }
+
+    aio = apr_pcalloc(p, sizeof(*aio));
+    rv = apr__uring_create(&aio->ring, size, size * 2, AIO_FEATURES);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    aio->pool = p;
+    aio->size = size;
+    aio->ops = apr_pcalloc(p, size * sizeof(aio_op_t));
+    for (i = size; i-- > 0; ) {
+        aio->ops[i].next = aio->free_ops;
+        aio->free_ops = &aio->ops[i];
+    }
+    aio->results = apr_palloc(p, size * sizeof(apr_aio_completion_t));
+
+    apr_pool_pre_cleanup_register(p, aio, aio_cleanup);
+
+    *paio = aio;
+    return APR_SUCCESS;
+}
+
+static apr_status_t aio_queue(apr_aio_t *aio, apr_aio_op_e type,
+                              apr_aio_cb_t cb, void *baton,
+                              aio_op_t **pop, struct io_uring_sqe **psqe)
+{
+    struct io_uring_sqe *sqe;
+    aio_op_t *op = aio->free_ops;
+
+    if (!op || !(sqe = apr__uring_get_sqe(&aio->ring))) {
+        return APR_EAGAIN;
+    }
+    aio->free_ops = op->next;
+    aio->inflight++;
+
+    memset(&op->c, 0, sizeof(op->c));
+    op->c.op = type;
+    op->c.cb = cb;
+    op->c.baton = baton;
+    op->busy = 1;
+    sqe->user_data = (apr_uintptr_t)op;
+
+    *pop = op;
+    *psqe = sqe;
+    return APR_SUCCESS;
+}
+
+static void aio_set_fd(apr_aio_t *aio, struct io_uring_sqe *sqe,
+                       const void *key, int fd)
+{
+    aio_fixed_t *fixed = NULL;
+
+    if (aio->fixed_index) {
+        fixed = apr_hash_get(aio->fixed_index, &key, sizeof(key));
+    }
+    if (fixed) {
+        sqe->fd = (int)(fixed - aio->fixed);
+        sqe->flags |= IOSQE_FIXED_FILE;
+    }
+    else {
+        sqe->fd = fd;
+    }
+}
+
+/* The registered buffer containing buf, or -1 */
+static int aio_fixed_buf(apr_aio_t *aio, const void *buf, apr_size_t len)
+{
+    apr_size_t i;
+
+    for (i = 0; i < aio->nbufs; ++i) {
+        const char *base = aio->bufs[i].iov_base;
+
+        if ((const char *)buf >= base
+                && (const char *)buf + len <= base + aio->bufs[i].iov_len) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_recv(apr_aio_t *aio, apr_socket_t *sock,
+                                       char *buf, apr_size_t len,
+                                       apr_aio_cb_t cb, void *baton)
+{
+    struct io_uring_sqe *sqe;
+    aio_op_t *op;
+    apr_status_t rv;
+    int index;
+
+    if (len > AIO_MAX_LEN) {
+        len = AIO_MAX_LEN;
+    }
+    rv = aio_queue(aio, APR_AIO_RECV, cb, baton, &op, &sqe);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    op->c.sock = sock;
+    op->c.buf = buf;
+    op->c.len = len;
+
+    /* a read() is a recv() without flags, fixed buffers included */
+    index = aio_fixed_buf(aio, buf, len);
+    if (index >= 0) {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->off = (apr_uint64_t)-1;
+        sqe->buf_index = (apr_uint16_t)index;
+    }
+    else {
+        sqe->opcode = IORING_OP_RECV;
+    }
+    aio_set_fd(aio, sqe, sock, sock->socketdes);
+    sqe->addr = (apr_uintptr_t)buf;
+    sqe->len = (apr_uint32_t)len;
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_send(apr_aio_t *aio, apr_socket_t *sock,
+                                       const char *buf, apr_size_t len,
+                                       apr_aio_cb_t cb, void *baton)
+{
+    struct io_uring_sqe *sqe;
+    aio_op_t *op;
+    apr_status_t rv;
+
+    if (len > AIO_MAX_LEN) {
+        len = AIO_MAX_LEN;
+    }
+    rv = aio_queue(aio, APR_AIO_SEND, cb, baton, &op, &sqe);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    op->c.sock = sock;
+    op->c.buf = (void *)buf;
+    op->c.len = len;
+
+    /* not a write(), which would raise SIGPIPE */
+    sqe->opcode = IORING_OP_SEND;
+    aio_set_fd(aio, sqe, sock, sock->socketdes);
+    sqe->addr = (apr_uintptr_t)buf;
+    sqe->len = (apr_uint32_t)len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t aio_rw(apr_aio_t *aio, apr_aio_op_e type,
+                           apr_file_t *file, void *buf, apr_size_t len,
+                           apr_off_t offset, apr_aio_cb_t cb, void *baton)
+{
+    struct io_uring_sqe *sqe;
+    aio_op_t *op;
+    apr_status_t rv;
+    int index;
+
+    if (file->buffered) {
+        return APR_EINVAL;
+    }
+    if (len > AIO_MAX_LEN) {
+        len = AIO_MAX_LEN;
+    }
+    rv = aio_queue(aio, type, cb, baton, &op, &sqe);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    op->c.file = file;
+    op->c.buf = buf;
+    op->c.len = len;
+
+    index = aio_fixed_buf(aio, buf, len);
+    if (index >= 0) {
+        sqe->opcode = (type == APR_AIO_WRITE) ? IORING_OP_WRITE_FIXED
+                                              : IORING_OP_READ_FIXED;
+        sqe->buf_index = (apr_uint16_t)index;
+    }
+    else {
+        sqe->opcode = (type == APR_AIO_WRITE) ? IORING_OP_WRITE
+                                              : IORING_OP_READ;
+    }
+    aio_set_fd(aio, sqe, file, file->filedes);
+    sqe->addr = (apr_uintptr_t)buf;
+    sqe->len = (apr_uint32_t)len;
+    sqe->off = (offset < 0) ? (apr_uint64_t)-1 : (apr_uint64_t)offset;
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_read(apr_aio_t *aio, apr_file_t *file,
+                                       void *buf, apr_size_t len,
+                                       apr_off_t offset,
+                                       apr_aio_cb_t cb, void *baton)
+{
+    return aio_rw(aio, APR_AIO_READ, file, buf, len, offset, cb, baton);
+}
+
+APR_DECLARE(apr_status_t) apr_aio_write(apr_aio_t *aio, apr_file_t *file,
+                                        const void *buf, apr_size_t len,
+                                        apr_off_t offset,
+                                        apr_aio_cb_t cb, void *baton)
+{
+    return aio_rw(aio, APR_AIO_WRITE, file, (void *)buf, len, offset,
+                  cb, baton);
+}
+
+APR_DECLARE(apr_status_t) apr_aio_accept(apr_aio_t *aio, apr_socket_t *sock,
+                                         apr_pool_t *connection_pool,
+                                         apr_aio_cb_t cb, void *baton)
+{
+    struct io_uring_sqe *sqe;
+    aio_op_t *op;
+    apr_status_t rv;
+    int flags = SOCK_CLOEXEC;
+
+    rv = aio_queue(aio, APR_AIO_ACCEPT, cb, baton, &op, &sqe);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    op->c.sock = sock;
+    op->pool = connection_pool;
+    op->peer.salen = sizeof(op->peer.sa);
+
+#if defined(SOCK_NONBLOCK) && APR_O_NONBLOCK_INHERITED
+    /* as apr_socket_accept() does */
+    if (apr_is_option_set(sock, APR_SO_NONBLOCK) == 1) {
+        flags |= SOCK_NONBLOCK;
+    }
+#endif
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    aio_set_fd(aio, sqe, sock, sock->socketdes);
+    sqe->addr = (apr_uintptr_t)&op->peer.sa;
+    sqe->addr2 = (apr_uintptr_t)&op->peer.salen;
+    sqe->accept_flags = flags;
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_connect(apr_aio_t *aio, apr_socket_t *sock,
+                                          apr_sockaddr_t *sa,
+                                          apr_aio_cb_t cb, void *baton)
+{
+    struct io_uring_sqe *sqe;
+    aio_op_t *op;
+    apr_status_t rv;
+
+    rv = aio_queue(aio, APR_AIO_CONNECT, cb, baton, &op, &sqe);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    op->c.sock = sock;
+    op->sa = sa;
+
+    sqe->opcode = IORING_OP_CONNECT;
+    aio_set_fd(aio, sqe, sock, sock->socketdes);
+    sqe->addr = (apr_uintptr_t)&sa->sa;
+    sqe->off = sa->salen;
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_submit(apr_aio_t *aio)
+{
+    return apr__uring_enter(&aio->ring, apr__uring_flush(&aio->ring), 0, 0);
+}
+
+/* Fill in the completion and recycle the op */
+static void aio_complete(apr_aio_t *aio, aio_op_t *op, int res,
+                         apr_aio_completion_t *c)
+{
+    *c = op->c;
+    c->len = 0;
+
+    if (res < 0) {
+        c->status = -res;
+    }
+    else {
+        switch (c->op) {
+        case APR_AIO_RECV:
+        case APR_AIO_READ:
+            c->len = res;
+            if (res == 0 && op->c.len) {
+                c->status = APR_EOF;
+            }
+            break;
+        case APR_AIO_SEND:
+        case APR_AIO_WRITE:
+            c->len = res;
+            break;
+        case APR_AIO_ACCEPT:
+            c->status = apr__socket_accepted(&c->accepted, c->sock, res,
+                                             &op->peer, op->pool);
+            break;
+        case APR_AIO_CONNECT:
+            apr__socket_connected(c->sock, op->sa);
+            break;
+        }
+    }
+
+    op->busy = 0;
+    op->next = aio->free_ops;
+    aio->free_ops = op;
+    aio->inflight--;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_poll(apr_aio_t *aio,
+                                       apr_interval_time_t timeout,
+                                       apr_int32_t *num,
+                                       const apr_aio_completion_t **completions)
+{
+    struct io_uring_cqe *cqe;
+    apr_uint32_t nsubmit, nwait, n = 0;
+    apr_status_t rv;
+    int any = 0;
+
+    *num = 0;
+
+    nsubmit = apr__uring_flush(&aio->ring);
+    nwait = (timeout != 0 && !apr__uring_cqe(&aio->ring, 0));
+    rv = apr__uring_enter(&aio->ring, nsubmit, nwait, timeout);
+    if (rv != APR_SUCCESS && !APR_STATUS_IS_TIMEUP(rv)) {
+        return rv;
+    }
+    rv = APR_SUCCESS;
+
+    /* callbacks may queue (and even submit) operations completing here,
+     * don't take more than the results can hold.
+     */
+    while (n < aio->size && (cqe = apr__uring_cqe(&aio->ring, 0)) != NULL) {
+        aio_op_t *op = (aio_op_t *)(apr_uintptr_t)cqe->user_data;
+        int res = cqe->res;
+
+        apr__uring_cq_advance(&aio->ring, 1);
+        any = 1;
+
+        if (op->c.cb) {
+            apr_aio_completion_t c;
+
+            aio_complete(aio, op, res, &c);
+            rv = c.cb(c.baton, &c);
+            if (rv != APR_SUCCESS) {
+                break;
+            }
+        }
+        else {
+            aio_complete(aio, op, res, &aio->results[n++]);
+        }
+    }
+
+    *num = n;
+    if (completions) {
+        *completions = aio->results;
+    }
+    if (!any) {
+        return APR_TIMEUP;
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_buffers_register(apr_aio_t *aio,
+                                                   const struct iovec *vec,
+                                                   apr_size_t nvec)
+{
+    struct iovec *bufs;
+    apr_status_t rv;
+
+    if (aio->nbufs) {
+        return APR_EEXIST;
+    }
+    bufs = apr_pmemdup(aio->pool, vec, nvec * sizeof(struct iovec));
+    rv = apr__uring_register(&aio->ring, IORING_REGISTER_BUFFERS, bufs,
+                             (unsigned int)nvec, NULL);
+    if (rv == APR_SUCCESS) {
+        aio->bufs = bufs;
+        aio->nbufs = nvec;
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_buffers_unregister(apr_aio_t *aio)
+{
+    apr_status_t rv;
+
+    if (!aio->nbufs) {
+        return APR_NOTFOUND;
+    }
+    rv = apr__uring_register(&aio->ring, IORING_UNREGISTER_BUFFERS,
+                             NULL, 0, NULL);
+    if (rv == APR_SUCCESS) {
+        aio->bufs = NULL;
+        aio->nbufs = 0;
+    }
+    return rv;
+}
+
+static apr_status_t aio_fixed_update(apr_aio_t *aio, int slot, int fd)
+{
+    struct io_uring_files_update up;
+    apr_status_t rv;
+    int res;
+
+    memset(&up, 0, sizeof(up));
+    up.offset = slot;
+    up.fds = (apr_uintptr_t)&fd;
+    rv = apr__uring_register(&aio->ring, IORING_REGISTER_FILES_UPDATE,
+                             &up, 1, &res);
+    if (rv == APR_SUCCESS && res != 1) {
+        rv = APR_EGENERAL;
+    }
+    return rv;
+}
+
+static apr_status_t aio_fixed_register(apr_aio_t *aio, const void *key,
+                                       int fd)
+{
+    aio_fixed_t *fixed;
+    apr_status_t rv;
+    int slot;
+
+    if (!aio->fixed_index) {
+        /* a sparse table, filled as descriptors are registered */
+        int *fds = apr_palloc(aio->pool, aio->size * sizeof(int));
+        apr_uint32_t i;
+
+        for (i = 0; i < aio->size; ++i) {
+            fds[i] = -1;
+        }
+        rv = apr__uring_register(&aio->ring, IORING_REGISTER_FILES, fds,
+                                 aio->size, NULL);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        /* reuse fds for the free slots, lowest first */
+        for (i = 0; i < aio->size; ++i) {
+            fds[i] = aio->size - 1 - i;
+        }
+        aio->fixed_free = fds;
+        aio->nfixed_free = aio->size;
+        aio->fixed = apr_pcalloc(aio->pool, aio->size * sizeof(aio_fixed_t));
+        aio->fixed_index = apr_hash_make(aio->pool);
+    }
+
+    if (apr_hash_get(aio->fixed_index, &key, sizeof(key))) {
+        return APR_EEXIST;
+    }
+    if (!aio->nfixed_free) {
+        return APR_ENOSPC;
+    }
+    slot = aio->fixed_free[aio->nfixed_free - 1];
+    rv = aio_fixed_update(aio, slot, fd);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    aio->nfixed_free--;
+
+    fixed = &aio->fixed[slot];
+    fixed->key = key;
+    apr_hash_set(aio->fixed_index, &fixed->key, sizeof(fixed->key), fixed);
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t aio_fixed_unregister(apr_aio_t *aio, const void *key)
+{
+    aio_fixed_t *fixed = NULL;
+    apr_status_t rv;
+    int slot;
+
+    if (aio->fixed_index) {
+        fixed = apr_hash_get(aio->fixed_index, &key, sizeof(key));
+    }
+    if (!fixed) {
+        return APR_NOTFOUND;
+    }
+    slot = (int)(fixed - aio->fixed);
+    rv = aio_fixed_update(aio, slot, -1);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    apr_hash_set(aio->fixed_index, &fixed->key, sizeof(fixed->key), NULL);
+    fixed->key = NULL;
+    aio->fixed_free[aio->nfixed_free++] = slot;
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_socket_register(apr_aio_t *aio,
+                                                  apr_socket_t *sock)
+{
+    return aio_fixed_register(aio, sock, sock->socketdes);
+}
+
+APR_DECLARE(apr_status_t) apr_aio_socket_unregister(apr_aio_t *aio,
+                                                    apr_socket_t *sock)
+{
+    return aio_fixed_unregister(aio, sock);
+}
+
+APR_DECLARE(apr_status_t) apr_aio_file_register(apr_aio_t *aio,
+                                                apr_file_t *file)
+{
+    return aio_fixed_register(aio, file, file->filedes);
+}
+
+APR_DECLARE(apr_status_t) apr_aio_file_unregister(apr_aio_t *aio,
+                                                  apr_file_t *file)
+{
+    return aio_fixed_unregister(aio, file);
+}
+
+#else /* !HAVE_IO_URING */
+
+APR_DECLARE(apr_status_t) apr_aio_create(apr_aio_t **aio,
+                                         apr_uint32_t size,
+                                         apr_pool_t *p)
+{
+    *aio = NULL;
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_recv(apr_aio_t *aio, apr_socket_t *sock,
+                                       char *buf, apr_size_t len,
+                                       apr_aio_cb_t cb, void *baton)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_send(apr_aio_t *aio, apr_socket_t *sock,
+                                       const char *buf, apr_size_t len,
+                                       apr_aio_cb_t cb, void *baton)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_read(apr_aio_t *aio, apr_file_t *file,
+                                       void *buf, apr_size_t len,
+                                       apr_off_t offset,
+                                       apr_aio_cb_t cb, void *baton)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_write(apr_aio_t *aio, apr_file_t *file,
+                                        const void *buf, apr_size_t len,
+                                        apr_off_t offset,
+                                        apr_aio_cb_t cb, void *baton)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_accept(apr_aio_t *aio, apr_socket_t *sock,
+                                         apr_pool_t *connection_pool,
+                                         apr_aio_cb_t cb, void *baton)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_connect(apr_aio_t *aio, apr_socket_t *sock,
+                                          apr_sockaddr_t *sa,
+                                          apr_aio_cb_t cb, void *baton)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_submit(apr_aio_t *aio)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_poll(apr_aio_t *aio,
+                                       apr_interval_time_t timeout,
+                                       apr_int32_t *num,
+                                       const apr_aio_completion_t **completions)
+{
+    *num = 0;
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_buffers_register(apr_aio_t *aio,
+                                                   const struct iovec *vec,
+                                                   apr_size_t nvec)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_buffers_unregister(apr_aio_t *aio)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_socket_register(apr_aio_t *aio,
+                                                  apr_socket_t *sock)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_socket_unregister(apr_aio_t *aio,
+                                                    apr_socket_t *sock)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_file_register(apr_aio_t *aio,
+                                                apr_file_t *file)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_aio_file_unregister(apr_aio_t *aio,
+                                                  apr_file_t *file)
+{
+    return APR_ENOTIMPL;
+}
+
+#endif /* HAVE_IO_URING */
@@ -44,6 +44,24 @@ static unsigned get_epoll_event(apr_int16_t event)
     return rv;
 }
 
+/* What APR_POLLSET_EDGE and APR_POLLSET_EXCLUSIVE add to the events of
+ * the descriptors, but those of the wakeup pipe.
+ */
+static unsigned get_epoll_mode(apr_uint32_t flags, unsigned events)
+{
+    unsigned rv = 0;
+
+    if (flags & APR_POLLSET_EDGE)
+        rv |= EPOLLET;
+#ifdef EPOLLEXCLUSIVE
+    /* EPOLLPRI can't be exclusive (EINVAL) */
+    if ((flags & APR_POLLSET_EXCLUSIVE) && !(events & EPOLLPRI))
+        rv |= EPOLLEXCLUSIVE;
+#endif
+
+    return rv;
+}
+
 static apr_int16_t get_epoll_revent(unsigned event)
 {
     apr_int16_t rv = 0;
@@ -166,6 +184,9 @@ static apr_status_t impl_pollset_add(apr_pollset_t *pollset,
     apr_status_t rv = APR_SUCCESS;
 
     ev.events = get_epoll_event(descriptor->reqevents);
+    if (descriptor != &pollset->wakeup_pfd) {
+        ev.events |= get_epoll_mode(pollset->flags, ev.events);
+    }
 
     if (pollset->flags & APR_POLLSET_NOCOPY) {
         ev.data.ptr = (void *)descriptor;
@@ -335,6 +356,21 @@ static const apr_pollset_provider_t impl = {
 
 const apr_pollset_provider_t *const apr_pollset_provider_epoll = &impl;
 
+/* A pollcb is not limited by its size, so the events are fetched in
+ * batches of at least POLLCB_BATCH_MIN, doubled (up to POLLCB_BATCH_MAX)
+ * whenever one comes full.
+ */
+#define POLLCB_BATCH_MIN 64
+#define POLLCB_BATCH_MAX 1024
+
+struct epoll_batch_t {
+    struct epoll_event *events;
+    int size;
+    /* events[next..count) are not passed to the callback yet */
+    int next;
+    int count;
+};
+
 static apr_status_t impl_pollcb_cleanup(apr_pollcb_t *pollcb)
 {
     close(pollcb->fd);
@@ -346,6 +382,7 @@ static apr_status_t impl_pollcb_create(apr_pollcb_t *pollcb,
                                        apr_pool_t *p,
                                        apr_uint32_t flags)
 {
+    struct epoll_batch_t *batch;
     int fd;
 
 #ifdef HAVE_EPOLL_CREATE1
@@ -380,8 +417,12 @@ static apr_status_t impl_pollcb_create(apr_pollcb_t *pollcb,
     }
 #endif
 
+    batch = apr_pcalloc(p, sizeof(*batch));
+    batch->size = (size < POLLCB_BATCH_MIN) ? POLLCB_BATCH_MIN : size;
+    batch->events = apr_palloc(p, batch->size * sizeof(struct epoll_event));
+
     pollcb->fd = fd;
-    pollcb->pollset.epoll = apr_palloc(p, size * sizeof(struct epoll_event));
+    pollcb->pollset.epoll = batch;
 
     return APR_SUCCESS;
 }
@@ -393,6 +434,9 @@ static apr_status_t impl_pollcb_add(apr_pollcb_t *pollcb,
     int ret;
 
     ev.events = get_epoll_event(descriptor->reqevents);
+    if (descriptor != &pollcb->wakeup_pfd) {
+        ev.events |= get_epoll_mode(pollcb->flags, ev.events);
+    }
     ev.data.ptr = (void *) descriptor;
 
     if (descriptor->desc_type == APR_POLL_SOCKET) {
@@ -432,6 +476,17 @@ static apr_status_t impl_pollcb_remove(apr_pollcb_t *pollcb,
     if (ret < 0) {
         rv = APR_NOTFOUND;
     }
+    else {
+        struct epoll_batch_t *batch = pollcb->pollset.epoll;
+        int i;
+
+        /* Don't pass it from a previous batch */
+        for (i = batch->next; i < batch->count; i++) {
+            if (batch->events[i].data.ptr == descriptor) {
+                batch->events[i].data.ptr = NULL;
+            }
+        }
+    }
 
     return rv;
 }
@@ -442,38 +497,64 @@ static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
                                      apr_pollcb_cb_t func,
                                      void *baton)
 {
-    int ret, i;
+    struct epoll_batch_t *batch = pollcb->pollset.epoll;
     apr_status_t rv = APR_SUCCESS;
 
-    if (timeout > 0) {
-        timeout = (timeout + 999) / 1000;
-    }
+    if (batch->next == batch->count) {
+        int ret;
 
-    ret = epoll_wait(pollcb->fd, pollcb->pollset.epoll, pollcb->nalloc,
-                     timeout);
-    if (ret < 0) {
-        rv = apr_get_netos_error();
-    }
-    else if (ret == 0) {
-        rv = APR_TIMEUP;
-    }
-    else {
-        for (i = 0; i < ret; i++) {
-            apr_pollfd_t *pollfd = (apr_pollfd_t *)(pollcb->pollset.epoll[i].data.ptr);
-
-            if ((pollcb->flags & APR_POLLSET_WAKEABLE) &&
-                pollfd->desc_type == APR_POLL_FILE &&
-                pollfd->desc.f == pollcb->wakeup_pipe[0]) {
-                apr_poll_drain_wakeup_pipe(&pollcb->wakeup_set, pollcb->wakeup_pipe);
-                return APR_EINTR;
+        if (batch->count == batch->size && batch->size < POLLCB_BATCH_MAX) {
+            batch->size *= 2;
+            if (batch->size > POLLCB_BATCH_MAX) {
+                batch->size = POLLCB_BATCH_MAX;
             }
+            batch->events = apr_palloc(pollcb->pool,
+                                       batch->size * sizeof(struct epoll_event));
+        }
+        batch->next = batch->count = 0;
 
-            pollfd->rtnevents = get_epoll_revent(pollcb->pollset.epoll[i].events);
+        if (timeout > 0) {
+            timeout = (timeout + 999) / 1000;
+        }
 
+        ret = epoll_wait(pollcb->fd, batch->events, batch->size, timeout);
+        if (ret < 0) {
+            return apr_get_netos_error();
+        }
+        else if (ret == 0) {
+            return APR_TIMEUP;
+        }
+        batch->count = ret;
+    }
+
+    while (batch->next < batch->count) {
+        struct epoll_event *ev = &batch->events[batch->next++];
+        apr_pollfd_t *pollfd = (apr_pollfd_t *)ev->data.ptr;
+
+        if (!pollfd) {
+            /* removed since */
+            continue;
+        }
+
+        if ((pollcb->flags & APR_POLLSET_WAKEABLE) &&
+            pollfd->desc_type == APR_POLL_FILE &&
+            pollfd->desc.f == pollcb->wakeup_pipe[0]) {
+            apr_poll_drain_wakeup_pipe(&pollcb->wakeup_set, pollcb->wakeup_pipe);
+            rv = APR_EINTR;
+        }
+        else {
+            pollfd->rtnevents = get_epoll_revent(ev->events);
             rv = func(baton, pollfd);
-            if (rv) {
-                return rv;
+        }
+        if (rv) {
+            /* Edge-triggered events would be lost, keep the rest of the
+             * batch for the next call. Level-triggered ones are reported
+             * again anyway.
+             */
+            if (!(pollcb->flags & APR_POLLSET_EDGE)) {
+                batch->next = batch->count;
             }
+            return rv;
         }
     }
 
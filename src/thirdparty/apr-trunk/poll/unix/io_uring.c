@@ -0,0 +1,931 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr.h"
+#include "apr_poll.h"
+#include "apr_time.h"
+#include "apr_hash.h"
+#include "apr_atomic.h"
+#include "apr_portable.h"
+#include "apr_arch_file_io.h"
+#include "apr_arch_networkio.h"
+#include "apr_arch_poll_private.h"
+#include "apr_arch_uring.h"
+
+#if defined(HAVE_IO_URING)
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/*
+ * The ring
+ */
+
+apr_status_t apr__uring_create(apr__uring_t *ring, apr_uint32_t entries,
+                               apr_uint32_t cq_entries,
+                               apr_uint32_t features)
+{
+    struct io_uring_params p;
+    char *sq, *cq;
+    int fd;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CLAMP;
+    if (cq_entries > entries) {
+        p.flags |= IORING_SETUP_CQSIZE;
+        p.cq_entries = cq_entries;
+    }
+#ifdef IORING_SETUP_COOP_TASKRUN
+    /* Completions posted from other contexts must not interrupt what the
+     * thread is doing (e.g. make an epoll_wait() fail with EINTR), they
+     * are run by the next io_uring_enter() anyway.
+     */
+    p.flags |= IORING_SETUP_COOP_TASKRUN;
+    fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0 && errno == EINVAL) {
+        /* before 5.19 */
+        p.flags &= ~IORING_SETUP_COOP_TASKRUN;
+        fd = syscall(__NR_io_uring_setup, entries, &p);
+    }
+#else
+    fd = syscall(__NR_io_uring_setup, entries, &p);
+#endif
+    if (fd < 0) {
+        /* no io_uring, or not for us (e.g. seccomp or sysctl) */
+        if (errno == ENOSYS || errno == EPERM || errno == EACCES) {
+            return APR_ENOTIMPL;
+        }
+        return errno;
+    }
+    if ((p.features & features) != features) {
+        close(fd);
+        return APR_ENOTIMPL;
+    }
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(apr_uint32_t);
+    ring->cq_ring_size = p.cq_off.cqes
+                         + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = 0;
+    }
+    sq = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        apr_status_t rv = errno;
+        close(fd);
+        return rv;
+    }
+    ring->sq_ring = sq;
+    if (ring->cq_ring_size) {
+        cq = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            apr_status_t rv = errno;
+            munmap(sq, ring->sq_ring_size);
+            close(fd);
+            return rv;
+        }
+        ring->cq_ring = cq;
+    }
+    else {
+        cq = sq;
+    }
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        apr_status_t rv = errno;
+        if (ring->cq_ring) {
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        }
+        munmap(sq, ring->sq_ring_size);
+        close(fd);
+        return rv;
+    }
+
+    ring->fd = fd;
+    ring->features = p.features;
+    ring->sq_head = (apr_uint32_t *)(sq + p.sq_off.head);
+    ring->sq_tail = (apr_uint32_t *)(sq + p.sq_off.tail);
+    ring->sq_flags = (apr_uint32_t *)(sq + p.sq_off.flags);
+    ring->sq_array = (apr_uint32_t *)(sq + p.sq_off.array);
+    ring->sq_mask = *(apr_uint32_t *)(sq + p.sq_off.ring_mask);
+    ring->sq_entries = p.sq_entries;
+    ring->sq_local = *ring->sq_tail;
+    ring->cq_head = (apr_uint32_t *)(cq + p.cq_off.head);
+    ring->cq_tail = (apr_uint32_t *)(cq + p.cq_off.tail);
+    ring->cq_mask = *(apr_uint32_t *)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    return APR_SUCCESS;
+}
+
+void apr__uring_destroy(apr__uring_t *ring)
+{
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+        if (ring->cq_ring) {
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        }
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        close(ring->fd);
+        ring->sqes = NULL;
+    }
+}
+
+struct io_uring_sqe *apr__uring_get_sqe(apr__uring_t *ring)
+{
+    struct io_uring_sqe *sqe;
+    apr_uint32_t idx;
+
+    if (ring->sq_local - apr_atomic_read32_ex(ring->sq_head,
+                                              APR_ATOMIC_ACQUIRE)
+            >= ring->sq_entries) {
+        apr_uint32_t n = apr__uring_flush(ring);
+        if (apr__uring_enter(ring, n, 0, 0) != APR_SUCCESS
+                || ring->sq_local - apr_atomic_read32_ex(ring->sq_head,
+                                                         APR_ATOMIC_ACQUIRE)
+                   >= ring->sq_entries) {
+            return NULL;
+        }
+    }
+
+    idx = ring->sq_local++ & ring->sq_mask;
+    sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[idx] = idx;
+    return sqe;
+}
+
+apr_uint32_t apr__uring_flush(apr__uring_t *ring)
+{
+    apr_uint32_t tail = *ring->sq_tail;
+
+    if (tail != ring->sq_local) {
+        apr_atomic_set32_ex(ring->sq_tail, ring->sq_local,
+                            APR_ATOMIC_RELEASE);
+    }
+    return ring->sq_local - apr_atomic_read32_ex(ring->sq_head,
+                                                 APR_ATOMIC_ACQUIRE);
+}
+
+apr_status_t apr__uring_enter(apr__uring_t *ring, apr_uint32_t nsubmit,
+                              apr_uint32_t nwait,
+                              apr_interval_time_t timeout)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned flags = 0;
+    int ret;
+
+    if (nwait || (apr_atomic_read32_ex(ring->sq_flags, APR_ATOMIC_RELAXED)
+                  & IORING_SQ_CQ_OVERFLOW)) {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+    if (!nsubmit && !flags) {
+        return APR_SUCCESS;
+    }
+
+    memset(&arg, 0, sizeof(arg));
+    if (nwait && timeout >= 0) {
+        ts.tv_sec = apr_time_sec(timeout);
+        ts.tv_nsec = apr_time_usec(timeout) * 1000;
+        arg.ts = (apr_uintptr_t)&ts;
+    }
+    flags |= IORING_ENTER_EXT_ARG;
+
+    do {
+        ret = syscall(__NR_io_uring_enter, ring->fd, nsubmit, nwait, flags,
+                      &arg, sizeof(arg));
+    } while (ret < 0 && errno == EINTR && !nwait);
+
+    if (ret < 0) {
+        switch (errno) {
+        case ETIME:
+            return APR_TIMEUP;
+        case EBUSY:
+        case EAGAIN:
+            /* completions to reap first */
+            return APR_SUCCESS;
+        default:
+            return errno;
+        }
+    }
+    return APR_SUCCESS;
+}
+
+struct io_uring_cqe *apr__uring_cqe(apr__uring_t *ring, apr_uint32_t n)
+{
+    apr_uint32_t head = *ring->cq_head;
+
+    if (apr_atomic_read32_ex(ring->cq_tail, APR_ATOMIC_ACQUIRE) - head <= n) {
+        return NULL;
+    }
+    return &ring->cqes[(head + n) & ring->cq_mask];
+}
+
+void apr__uring_cq_advance(apr__uring_t *ring, apr_uint32_t n)
+{
+    if (n) {
+        apr_atomic_set32_ex(ring->cq_head, *ring->cq_head + n,
+                            APR_ATOMIC_RELEASE);
+    }
+}
+
+apr_status_t apr__uring_register(apr__uring_t *ring, unsigned int opcode,
+                                 void *arg, unsigned int nr_args, int *res)
+{
+    int ret;
+
+    do {
+        ret = syscall(__NR_io_uring_register, ring->fd, opcode, arg, nr_args);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        return errno;
+    }
+    if (res) {
+        *res = ret;
+    }
+    return APR_SUCCESS;
+}
+
+/*
+ * The poller, common to the pollset and the pollcb
+ *
+ * Each descriptor has a multishot IORING_OP_POLL_ADD in the kernel,
+ * posting a completion whenever it gets ready. Adding a descriptor only
+ * queues a submission entry, all of them are submitted by the
+ * io_uring_enter() of the next poll, which also waits. Removals are
+ * submitted right away.
+ *
+ * A completion tells that the descriptor got ready at some point, it may
+ * not be anymore when the completion is reaped (e.g. read meanwhile),
+ * while pollsets are level triggered and report what is ready. So the
+ * descriptors completed, plus the ones reported by the last poll which
+ * may still be ready without further completion, are checked with a
+ * nonblocking poll() before being reported.
+ */
+
+/* The multishot poll came with kernel 5.13, as the resource tags did,
+ * the timed waits with 5.11.
+ */
+#define URING_FEATURES (IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG \
+                        | IORING_FEAT_RSRC_TAGS)
+
+typedef struct uring_reg_t uring_reg_t;
+
+struct uring_reg_t {
+    APR_RING_ENTRY(uring_reg_t) link;
+    apr_pollfd_t pfd;           /* copy of the descriptor, if any */
+    apr_pollfd_t *desc;         /* what polls return */
+    const void *key;            /* desc.s */
+    int fd;
+    apr_uint32_t gen;           /* poll the reg is a candidate of */
+    apr_int16_t revents;
+    apr_int16_t failed;         /* POLLERR/POLLNVAL from the kernel */
+    unsigned int multi:1;       /* multishot poll in the kernel */
+    unsigned int removed:1;
+};
+
+APR_RING_HEAD(uring_reg_ring_t, uring_reg_t);
+
+typedef struct uring_poller_t {
+    apr__uring_t ring;
+    apr_pool_t *pool;
+    apr_uint32_t flags;
+    apr_hash_t *regs;
+    /* Removed registrations still seen by polls, then recyclable ones */
+    struct uring_reg_ring_t dead_ring;
+    struct uring_reg_ring_t free_ring;
+    /* Registrations to check, then reported by the last poll */
+    uring_reg_t **ready;
+    struct pollfd *pollset;
+    apr_uint32_t nready;
+    apr_uint32_t nalloc;
+    apr_uint32_t gen;
+    int polling;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *lock;
+#endif
+} uring_poller_t;
+
+#if APR_HAS_THREADS
+#define poller_lock(up) \
+    if ((up)->lock) \
+        apr_thread_mutex_lock((up)->lock)
+#define poller_unlock(up) \
+    if ((up)->lock) \
+        apr_thread_mutex_unlock((up)->lock)
+#else
+#define poller_lock(up)
+#define poller_unlock(up)
+#endif
+
+static apr_int16_t get_event(apr_int16_t event)
+{
+    apr_int16_t rv = 0;
+
+    if (event & APR_POLLIN)
+        rv |= POLLIN;
+    if (event & APR_POLLPRI)
+        rv |= POLLPRI;
+    if (event & APR_POLLOUT)
+        rv |= POLLOUT;
+    /* POLLERR, POLLHUP, and POLLNVAL aren't valid as requested events */
+
+    return rv;
+}
+
+static apr_int16_t get_revent(apr_int16_t event)
+{
+    apr_int16_t rv = 0;
+
+    if (event & POLLIN)
+        rv |= APR_POLLIN;
+    if (event & POLLPRI)
+        rv |= APR_POLLPRI;
+    if (event & POLLOUT)
+        rv |= APR_POLLOUT;
+    if (event & POLLERR)
+        rv |= APR_POLLERR;
+    if (event & POLLHUP)
+        rv |= APR_POLLHUP;
+    if (event & POLLNVAL)
+        rv |= APR_POLLNVAL;
+
+    return rv;
+}
+
+static apr_status_t poller_create(uring_poller_t **pup, apr_uint32_t size,
+                                  apr_pool_t *p, apr_uint32_t flags)
+{
+    uring_poller_t *up;
+    apr_uint32_t entries = 16;
+    apr_status_t rv;
+
+#if !APR_HAS_THREADS
+    if (flags & APR_POLLSET_THREADSAFE) {
+        return APR_ENOTIMPL;
+    }
+#endif
+
+    /* room for the changes between two polls, in most cases, the ring
+     * is submitted early otherwise.
+     */
+    while (entries < size && entries < 4096) {
+        entries <<= 1;
+    }
+
+    up = apr_pcalloc(p, sizeof(*up));
+    rv = apr__uring_create(&up->ring, entries, entries * 4, URING_FEATURES);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+#if APR_HAS_THREADS
+    if (flags & APR_POLLSET_THREADSAFE) {
+        rv = apr_thread_mutex_create(&up->lock, APR_THREAD_MUTEX_DEFAULT, p);
+        if (rv != APR_SUCCESS) {
+            apr__uring_destroy(&up->ring);
+            return rv;
+        }
+    }
+#endif
+    up->pool = p;
+    up->flags = flags;
+    up->regs = apr_hash_make(p);
+    APR_RING_INIT(&up->dead_ring, uring_reg_t, link);
+    APR_RING_INIT(&up->free_ring, uring_reg_t, link);
+    up->nalloc = size;
+    up->ready = apr_palloc(p, size * sizeof(uring_reg_t *));
+    up->pollset = apr_palloc(p, size * sizeof(struct pollfd));
+
+    *pup = up;
+    return APR_SUCCESS;
+}
+
+static apr_status_t poller_queue(uring_poller_t *up, uring_reg_t *reg)
+{
+    struct io_uring_sqe *sqe = apr__uring_get_sqe(&up->ring);
+    apr_uint32_t events;
+
+    if (!sqe) {
+        return APR_EAGAIN;
+    }
+    events = (apr_uint16_t)get_event(reg->desc->reqevents);
+#if APR_IS_BIGENDIAN
+    /* the kernel swaps the halves of poll32_events on big endian */
+    events = (events << 16) | (events >> 16);
+#endif
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = reg->fd;
+    sqe->poll32_events = events;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = (apr_uintptr_t)reg;
+    reg->multi = 1;
+
+    return APR_SUCCESS;
+}
+
+/* A blocked poll would not see changes before it wakes up */
+static apr_status_t poller_submit_if_polling(uring_poller_t *up)
+{
+    if (up->polling) {
+        apr_uint32_t n = apr__uring_flush(&up->ring);
+        return apr__uring_enter(&up->ring, n, 0, 0);
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t poller_add(uring_poller_t *up,
+                               const apr_pollfd_t *descriptor, int copy)
+{
+    uring_reg_t *reg;
+    apr_status_t rv;
+
+    poller_lock(up);
+
+    if (apr_hash_get(up->regs, &descriptor->desc.s, sizeof(void *))) {
+        poller_unlock(up);
+        return APR_EEXIST;
+    }
+
+    if (!APR_RING_EMPTY(&up->free_ring, uring_reg_t, link)) {
+        reg = APR_RING_FIRST(&up->free_ring);
+        APR_RING_REMOVE(reg, link);
+    }
+    else {
+        reg = apr_palloc(up->pool, sizeof(*reg));
+        APR_RING_ELEM_INIT(reg, link);
+    }
+    reg->gen = 0;
+    reg->revents = reg->failed = 0;
+    reg->multi = reg->removed = 0;
+    if (copy) {
+        reg->pfd = *descriptor;
+        reg->desc = &reg->pfd;
+    }
+    else {
+        reg->desc = (apr_pollfd_t *)descriptor;
+    }
+    reg->key = descriptor->desc.s;
+    if (descriptor->desc_type == APR_POLL_SOCKET) {
+        reg->fd = descriptor->desc.s->socketdes;
+    }
+    else {
+        reg->fd = descriptor->desc.f->filedes;
+    }
+
+    rv = poller_queue(up, reg);
+    if (rv == APR_SUCCESS) {
+        apr_hash_set(up->regs, &reg->key, sizeof(void *), reg);
+        rv = poller_submit_if_polling(up);
+    }
+    else {
+        APR_RING_INSERT_TAIL(&up->free_ring, reg, uring_reg_t, link);
+    }
+
+    poller_unlock(up);
+
+    return rv;
+}
+
+static apr_status_t poller_remove(uring_poller_t *up,
+                                  const apr_pollfd_t *descriptor)
+{
+    uring_reg_t *reg;
+    apr_status_t rv = APR_SUCCESS;
+
+    poller_lock(up);
+
+    reg = apr_hash_get(up->regs, &descriptor->desc.s, sizeof(void *));
+    if (!reg) {
+        poller_unlock(up);
+        return APR_NOTFOUND;
+    }
+    apr_hash_set(up->regs, &reg->key, sizeof(void *), NULL);
+
+    reg->removed = 1;
+    if (reg->multi) {
+        struct io_uring_sqe *sqe = apr__uring_get_sqe(&up->ring);
+
+        /* Unlike additions, removals can't wait for the next poll: the
+         * kernel holds the file until its poll is gone, which would keep
+         * it open after the caller closes the descriptor.
+         */
+        if (sqe) {
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = (apr_uintptr_t)reg;
+            rv = apr__uring_enter(&up->ring, apr__uring_flush(&up->ring),
+                                  0, 0);
+        }
+        else {
+            rv = APR_EAGAIN;
+        }
+    }
+    else {
+        APR_RING_INSERT_TAIL(&up->dead_ring, reg, uring_reg_t, link);
+    }
+
+    poller_unlock(up);
+
+    return rv;
+}
+
+/* Reap the completions, up to nalloc candidates */
+static void poller_reap(uring_poller_t *up)
+{
+    struct io_uring_cqe *cqe;
+    apr_uint32_t n;
+
+    for (n = 0; up->nready < up->nalloc
+                && (cqe = apr__uring_cqe(&up->ring, n)) != NULL; ++n) {
+        uring_reg_t *reg;
+
+        /* the removals */
+        if (!cqe->user_data) {
+            continue;
+        }
+        reg = (uring_reg_t *)(apr_uintptr_t)cqe->user_data;
+
+        if (!(cqe->flags & IORING_CQE_F_MORE)) {
+            reg->multi = 0;
+        }
+        if (reg->removed) {
+            if (!reg->multi) {
+                APR_RING_INSERT_TAIL(&up->dead_ring, reg, uring_reg_t, link);
+            }
+            continue;
+        }
+
+        if (cqe->res < 0) {
+            if (cqe->res == -ECANCELED) {
+                /* e.g. the thread which added the descriptor exited */
+                poller_queue(up, reg);
+                continue;
+            }
+            /* the poll is over, until the descriptor is removed */
+            reg->failed = (cqe->res == -EBADF) ? APR_POLLNVAL : APR_POLLERR;
+        }
+        else if (!reg->multi) {
+            /* the kernel ended the multishot, rearm it */
+            poller_queue(up, reg);
+        }
+
+        if (reg->gen != up->gen) {
+            reg->gen = up->gen;
+            up->ready[up->nready++] = reg;
+        }
+    }
+    apr__uring_cq_advance(&up->ring, n);
+}
+
+/* Keep the candidates which are ready, with their revents */
+static void poller_check(uring_poller_t *up)
+{
+    apr_uint32_t i, j;
+    int ret;
+
+    for (i = 0; i < up->nready; ++i) {
+        up->pollset[i].fd = up->ready[i]->fd;
+        up->pollset[i].events = get_event(up->ready[i]->desc->reqevents);
+        up->pollset[i].revents = 0;
+    }
+    do {
+        ret = poll(up->pollset, up->nready, 0);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        /* report them all, as the completions did */
+        for (i = 0; i < up->nready; ++i) {
+            up->pollset[i].revents = up->pollset[i].events;
+        }
+    }
+
+    for (i = 0, j = 0; i < up->nready; ++i) {
+        uring_reg_t *reg = up->ready[i];
+
+        reg->revents = get_revent(up->pollset[i].revents) | reg->failed;
+        if (reg->revents) {
+            up->ready[j++] = reg;
+        }
+    }
+    up->nready = j;
+}
+
+/* Poll for events, the registrations reported are left in up->ready and
+ * will be checked again by the next poll, unless their entry is nulled.
+ */
+static apr_status_t poller_poll(uring_poller_t *up,
+                                apr_interval_time_t timeout)
+{
+    apr_status_t rv;
+    apr_time_t deadline = 0;
+    apr_uint32_t i, n;
+
+    if (timeout > 0) {
+        deadline = apr_time_now() + timeout;
+    }
+
+    poller_lock(up);
+
+    up->gen++;
+    for (i = 0, n = 0; i < up->nready; ++i) {
+        uring_reg_t *reg = up->ready[i];
+        if (reg && !reg->removed) {
+            reg->gen = up->gen;
+            up->ready[n++] = reg;
+        }
+    }
+    up->nready = n;
+    APR_RING_CONCAT(&up->free_ring, &up->dead_ring, uring_reg_t, link);
+
+    for (;;) {
+        apr_uint32_t nsubmit, nwait;
+
+        /* no wait if there are candidates already */
+        nsubmit = apr__uring_flush(&up->ring);
+        nwait = (timeout != 0 && !up->nready
+                 && !apr__uring_cqe(&up->ring, 0));
+        up->polling = nwait;
+
+        poller_unlock(up);
+        rv = apr__uring_enter(&up->ring, nsubmit, nwait, timeout);
+        poller_lock(up);
+
+        up->polling = 0;
+        poller_reap(up);
+        if (up->nready) {
+            poller_check(up);
+            if (up->nready) {
+                rv = APR_SUCCESS;
+                break;
+            }
+            if (!nwait) {
+                /* nothing ready after all, wait now */
+                continue;
+            }
+        }
+
+        /* completions of removals, or nothing ready, wait more */
+        if (rv != APR_SUCCESS || timeout == 0) {
+            break;
+        }
+        if (timeout > 0) {
+            timeout = deadline - apr_time_now();
+            if (timeout <= 0) {
+                rv = APR_TIMEUP;
+                break;
+            }
+        }
+    }
+
+    if (rv == APR_SUCCESS && !up->nready) {
+        rv = APR_TIMEUP;
+    }
+
+    poller_unlock(up);
+
+    return rv;
+}
+
+static void poller_cleanup(uring_poller_t *up)
+{
+    apr_hash_index_t *hi;
+
+    /* Closing the ring cancels the polls asynchronously, cancel them
+     * now so that the descriptors are released on return.
+     */
+    for (hi = apr_hash_first(NULL, up->regs); hi; hi = apr_hash_next(hi)) {
+        uring_reg_t *reg = apr_hash_this_val(hi);
+        struct io_uring_sqe *sqe;
+
+        if (reg->multi && (sqe = apr__uring_get_sqe(&up->ring)) != NULL) {
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = (apr_uintptr_t)reg;
+        }
+    }
+    apr__uring_enter(&up->ring, apr__uring_flush(&up->ring), 0, 0);
+
+    apr__uring_destroy(&up->ring);
+}
+
+/*
+ * The pollset provider
+ */
+
+struct apr_pollset_private_t
+{
+    uring_poller_t *up;
+    apr_pollfd_t *result_set;
+};
+
+static apr_status_t impl_pollset_cleanup(apr_pollset_t *pollset)
+{
+    poller_cleanup(pollset->p->up);
+    return APR_SUCCESS;
+}
+
+static apr_status_t impl_pollset_create(apr_pollset_t *pollset,
+                                        apr_uint32_t size,
+                                        apr_pool_t *p,
+                                        apr_uint32_t flags)
+{
+    apr_pollset_private_t *priv = apr_pcalloc(p, sizeof(*priv));
+    apr_status_t rv;
+
+    rv = poller_create(&priv->up, size, p, flags);
+    if (rv != APR_SUCCESS) {
+        pollset->p = NULL;
+        return rv;
+    }
+    priv->result_set = apr_palloc(p, size * sizeof(apr_pollfd_t));
+    pollset->p = priv;
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t impl_pollset_add(apr_pollset_t *pollset,
+                                     const apr_pollfd_t *descriptor)
+{
+    return poller_add(pollset->p->up, descriptor,
+                      !(pollset->flags & APR_POLLSET_NOCOPY));
+}
+
+static apr_status_t impl_pollset_remove(apr_pollset_t *pollset,
+                                        const apr_pollfd_t *descriptor)
+{
+    return poller_remove(pollset->p->up, descriptor);
+}
+
+static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
+                                      apr_interval_time_t timeout,
+                                      apr_int32_t *num,
+                                      const apr_pollfd_t **descriptors)
+{
+    uring_poller_t *up = pollset->p->up;
+    apr_status_t rv;
+    apr_uint32_t i;
+    apr_int32_t j;
+
+    *num = 0;
+
+    rv = poller_poll(up, timeout);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    /* up->ready is stable until the next poll */
+    for (i = 0, j = 0; i < up->nready; i++) {
+        uring_reg_t *reg = up->ready[i];
+
+        /* Check if the polled descriptor is our
+         * wakeup pipe. In that case do not put it result set.
+         */
+        if ((pollset->flags & APR_POLLSET_WAKEABLE) &&
+            reg->desc->desc_type == APR_POLL_FILE &&
+            reg->desc->desc.f == pollset->wakeup_pipe[0]) {
+            apr_poll_drain_wakeup_pipe(&pollset->wakeup_set,
+                                       pollset->wakeup_pipe);
+            up->ready[i] = NULL;
+            rv = APR_EINTR;
+        }
+        else {
+            pollset->p->result_set[j] = *reg->desc;
+            pollset->p->result_set[j].rtnevents = reg->revents;
+            j++;
+        }
+    }
+    if (((*num) = j)) { /* any event besides wakeup pipe? */
+        rv = APR_SUCCESS;
+
+        if (descriptors) {
+            *descriptors = pollset->p->result_set;
+        }
+    }
+
+    return rv;
+}
+
+static const apr_pollset_provider_t impl = {
+    impl_pollset_create,
+    impl_pollset_add,
+    impl_pollset_remove,
+    impl_pollset_poll,
+    impl_pollset_cleanup,
+    "io_uring"
+};
+
+const apr_pollset_provider_t *const apr_pollset_provider_io_uring = &impl;
+
+/*
+ * The pollcb provider
+ */
+
+static apr_status_t impl_pollcb_cleanup(apr_pollcb_t *pollcb)
+{
+    poller_cleanup(pollcb->pollset.uring);
+    return APR_SUCCESS;
+}
+
+static apr_status_t impl_pollcb_create(apr_pollcb_t *pollcb,
+                                       apr_uint32_t size,
+                                       apr_pool_t *p,
+                                       apr_uint32_t flags)
+{
+    apr_status_t rv;
+
+    rv = poller_create(&pollcb->pollset.uring, size, p, flags);
+    if (rv != APR_SUCCESS) {
+        pollcb->fd = -1;
+        return rv;
+    }
+    pollcb->fd = pollcb->pollset.uring->ring.fd;
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t impl_pollcb_add(apr_pollcb_t *pollcb,
+                                    apr_pollfd_t *descriptor)
+{
+    return poller_add(pollcb->pollset.uring, descriptor, 0);
+}
+
+static apr_status_t impl_pollcb_remove(apr_pollcb_t *pollcb,
+                                       apr_pollfd_t *descriptor)
+{
+    return poller_remove(pollcb->pollset.uring, descriptor);
+}
+
+static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
+                                     apr_interval_time_t timeout,
+                                     apr_pollcb_cb_t func,
+                                     void *baton)
+{
+    uring_poller_t *up = pollcb->pollset.uring;
+    apr_status_t rv;
+    apr_uint32_t i;
+
+    rv = poller_poll(up, timeout);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    for (i = 0; i < up->nready; i++) {
+        uring_reg_t *reg = up->ready[i];
+        apr_pollfd_t *pollfd = reg->desc;
+
+        if ((pollcb->flags & APR_POLLSET_WAKEABLE) &&
+            pollfd->desc_type == APR_POLL_FILE &&
+            pollfd->desc.f == pollcb->wakeup_pipe[0]) {
+            apr_poll_drain_wakeup_pipe(&pollcb->wakeup_set,
+                                       pollcb->wakeup_pipe);
+            up->ready[i] = NULL;
+            return APR_EINTR;
+        }
+
+        /* removed by a previous callback */
+        if (reg->removed) {
+            continue;
+        }
+
+        pollfd->rtnevents = reg->revents;
+
+        rv = func(baton, pollfd);
+        if (rv) {
+            return rv;
+        }
+    }
+
+    return rv;
+}
+
+static const apr_pollcb_provider_t impl_cb = {
+    impl_pollcb_create,
+    impl_pollcb_add,
+    impl_pollcb_remove,
+    impl_pollcb_poll,
+    impl_pollcb_cleanup,
+    "io_uring"
+};
+
+const apr_pollcb_provider_t *const apr_pollcb_provider_io_uring = &impl_cb;
+
+#endif /* HAVE_IO_URING */
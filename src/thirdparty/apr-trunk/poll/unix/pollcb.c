@@ -41,6 +41,9 @@ extern const apr_pollcb_provider_t *apr_pollcb_provider_epoll;
 #if defined(HAVE_POLL)
 extern const apr_pollcb_provider_t *apr_pollcb_provider_poll;
 #endif
+#if defined(HAVE_IO_URING)
+extern const apr_pollcb_provider_t *apr_pollcb_provider_io_uring;
+#endif
 
 static const apr_pollcb_provider_t *pollcb_provider(apr_pollset_method_e method)
 {
@@ -64,6 +67,11 @@ static const apr_pollcb_provider_t *pollcb_provider(apr_pollset_method_e method)
         case APR_POLLSET_POLL:
 #if defined(HAVE_POLL)
             provider = apr_pollcb_provider_poll;
+#endif
+        break;
+        case APR_POLLSET_IOURING:
+#if defined(HAVE_IO_URING)
+            provider = apr_pollcb_provider_io_uring;
 #endif
         break;
         case APR_POLLSET_SELECT:
@@ -139,7 +147,8 @@ APR_DECLARE(apr_status_t) apr_pollcb_create_ex(apr_pollcb_t **ret_pollcb,
     pollcb->flags = flags;
     pollcb->pool = p;
     pollcb->provider = provider;
-    pollcb->wakeup_set = 0;
+    pollcb->wakeup_set = WAKEUP_NONE;
+    pollcb->wakeup_polling = 0;
 
     rv = (*provider->create)(pollcb, size, p, flags);
     if (rv == APR_ENOTIMPL) {
@@ -222,7 +231,22 @@ APR_DECLARE(apr_status_t) apr_pollcb_poll(apr_pollcb_t *pollcb,
                                           apr_pollcb_cb_t func,
                                           void *baton)
 {
-    return (*pollcb->provider->poll)(pollcb, timeout, func, baton);
+    apr_status_t rv;
+
+    if (!(pollcb->flags & APR_POLLSET_WAKEABLE)) {
+        return (*pollcb->provider->poll)(pollcb, timeout, func, baton);
+    }
+    if (apr_poll_enter_wakeup(&pollcb->wakeup_set, &pollcb->wakeup_polling)) {
+        /* Woken up while awake, only run what's ready already */
+        rv = (*pollcb->provider->poll)(pollcb, 0, func, baton);
+        if (rv == APR_SUCCESS || APR_STATUS_IS_TIMEUP(rv)) {
+            rv = APR_EINTR;
+        }
+        return rv;
+    }
+    rv = (*pollcb->provider->poll)(pollcb, timeout, func, baton);
+    apr_atomic_set32(&pollcb->wakeup_polling, 0);
+    return rv;
 }
 
 APR_DECLARE(apr_status_t) apr_pollcb_wakeup(apr_pollcb_t *pollcb)
@@ -230,16 +254,15 @@ APR_DECLARE(apr_status_t) apr_pollcb_wakeup(apr_pollcb_t *pollcb)
     if (!(pollcb->flags & APR_POLLSET_WAKEABLE))
         return APR_EINIT;
 
-    if (apr_atomic_cas32(&pollcb->wakeup_set, 1, 0) == 0) {
 #if WAKEUP_USES_PIPE
-        return apr_file_putc(1, pollcb->wakeup_pipe[1]);
+    return apr_poll_signal_wakeup_pipe(&pollcb->wakeup_set,
+                                       &pollcb->wakeup_polling,
+                                       pollcb->wakeup_pipe);
 #else
-        apr_size_t len = 1;
-        return apr_socket_send(pollcb->wakeup_socket[1], "\1", &len);
+    return apr_poll_signal_wakeup_socket(&pollcb->wakeup_set,
+                                         &pollcb->wakeup_polling,
+                                         pollcb->wakeup_socket);
 #endif
-    }
-
-    return APR_SUCCESS;
 }
 
 APR_DECLARE(const char *) apr_pollcb_method_name(apr_pollcb_t *pollcb)
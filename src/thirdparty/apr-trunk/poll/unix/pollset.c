@@ -60,6 +60,9 @@ extern const apr_pollset_provider_t *apr_pollset_provider_epoll;
 #if defined(HAVE_AIO_MSGQ)
 extern const apr_pollset_provider_t *apr_pollset_provider_aio_msgq;
 #endif
+#if defined(HAVE_IO_URING)
+extern const apr_pollset_provider_t *apr_pollset_provider_io_uring;
+#endif
 #if defined(HAVE_POLL)
 extern const apr_pollset_provider_t *apr_pollset_provider_poll;
 #endif
@@ -87,6 +90,11 @@ static const apr_pollset_provider_t *pollset_provider(apr_pollset_method_e metho
         case APR_POLLSET_AIO_MSGQ:
 #if defined(HAVE_AIO_MSGQ)
             provider = apr_pollset_provider_aio_msgq;
+#endif
+        break;
+        case APR_POLLSET_IOURING:
+#if defined(HAVE_IO_URING)
+            provider = apr_pollset_provider_io_uring;
 #endif
         break;
         case APR_POLLSET_POLL:
@@ -145,7 +153,9 @@ APR_DECLARE(apr_status_t) apr_pollset_create_ex(apr_pollset_t **ret_pollset,
     pollset->pool = p;
     pollset->flags = flags;
     pollset->provider = provider;
-    pollset->wakeup_set = 0;
+    pollset->wakeup_set = WAKEUP_NONE;
+    pollset->wakeup_polling = 0;
+    pollset->stats = NULL;
 
     rv = (*provider->create)(pollset, size, p, flags);
     if (rv == APR_ENOTIMPL) {
@@ -233,16 +243,15 @@ APR_DECLARE(apr_status_t) apr_pollset_wakeup(apr_pollset_t *pollset)
     if (!(pollset->flags & APR_POLLSET_WAKEABLE))
         return APR_EINIT;
 
-    if (apr_atomic_cas32(&pollset->wakeup_set, 1, 0) == 0) {
 #if WAKEUP_USES_PIPE
-        return apr_file_putc(1, pollset->wakeup_pipe[1]);
+    return apr_poll_signal_wakeup_pipe(&pollset->wakeup_set,
+                                       &pollset->wakeup_polling,
+                                       pollset->wakeup_pipe);
 #else
-        apr_size_t len = 1;
-        return apr_socket_send(pollset->wakeup_socket[1], "\1", &len);
+    return apr_poll_signal_wakeup_socket(&pollset->wakeup_set,
+                                         &pollset->wakeup_polling,
+                                         pollset->wakeup_socket);
 #endif
-    }
-
-    return APR_SUCCESS;
 }
 
 APR_DECLARE(apr_status_t) apr_pollset_add(apr_pollset_t *pollset,
@@ -262,5 +271,37 @@ APR_DECLARE(apr_status_t) apr_pollset_poll(apr_pollset_t *pollset,
                                            apr_int32_t *num,
                                            const apr_pollfd_t **descriptors)
 {
-    return (*pollset->provider->poll)(pollset, timeout, num, descriptors);
+    apr_status_t rv;
+
+    if (!(pollset->flags & APR_POLLSET_WAKEABLE)) {
+        rv = (*pollset->provider->poll)(pollset, timeout, num, descriptors);
+    }
+    else if (apr_poll_enter_wakeup(&pollset->wakeup_set,
+                                   &pollset->wakeup_polling)) {
+        /* Woken up while awake, only return what's ready already */
+        rv = (*pollset->provider->poll)(pollset, 0, num, descriptors);
+        if (APR_STATUS_IS_TIMEUP(rv)) {
+            *num = 0;
+            rv = APR_EINTR;
+        }
+    }
+    else {
+        rv = (*pollset->provider->poll)(pollset, timeout, num, descriptors);
+        apr_atomic_set32(&pollset->wakeup_polling, 0);
+    }
+    if (pollset->stats) {
+        if (rv == APR_SUCCESS) {
+            apr_stats_histogram_record(pollset->stats, *num);
+        }
+        else if (APR_STATUS_IS_TIMEUP(rv) || APR_STATUS_IS_EINTR(rv)) {
+            apr_stats_histogram_record(pollset->stats, 0);
+        }
+    }
+    return rv;
+}
+
+APR_DECLARE(void) apr_pollset_stats_set(apr_pollset_t *pollset,
+                                        struct apr_stats_histogram_t *events)
+{
+    pollset->stats = events;
 }
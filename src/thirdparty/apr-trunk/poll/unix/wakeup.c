@@ -24,6 +24,10 @@
 #include "apr_arch_poll_private.h"
 #include "apr_arch_inherit.h"
 
+#if WAKEUP_USES_EVENTFD
+#include <sys/eventfd.h>
+#endif
+
 #if !APR_FILES_AS_SOCKETS
 
 #ifdef WIN32
@@ -74,7 +78,45 @@ apr_status_t apr_poll_close_wakeup_pipe(apr_file_t **wakeup_pipe)
 
 #endif /* !WIN32 */
 
-#else  /* APR_FILES_AS_SOCKETS */
+#elif WAKEUP_USES_EVENTFD
+
+apr_status_t apr_poll_create_wakeup_pipe(apr_pool_t *pool, apr_pollfd_t *pfd,
+                                         apr_file_t **wakeup_pipe)
+{
+    apr_os_file_t fd;
+    apr_status_t rv;
+
+    /* One descriptor, non-blocking and read/written directly as a counter */
+    fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd == -1)
+        return errno;
+
+    if ((rv = apr_os_pipe_put_ex(&wakeup_pipe[0], &fd, 1, pool))) {
+        close(fd);
+        return rv;
+    }
+    wakeup_pipe[1] = wakeup_pipe[0];
+
+    pfd->p = pool;
+    pfd->reqevents = APR_POLLIN;
+    pfd->desc_type = APR_POLL_FILE;
+    pfd->desc.f = wakeup_pipe[0];
+
+    return APR_SUCCESS;
+}
+
+apr_status_t apr_poll_close_wakeup_pipe(apr_file_t **wakeup_pipe)
+{
+    apr_status_t rv = APR_SUCCESS;
+
+    if (wakeup_pipe[0]) {
+        rv = apr_file_close(wakeup_pipe[0]);
+        wakeup_pipe[0] = wakeup_pipe[1] = NULL;
+    }
+    return rv;
+}
+
+#else  /* APR_FILES_AS_SOCKETS && !WAKEUP_USES_EVENTFD */
 
 apr_status_t apr_poll_create_wakeup_pipe(apr_pool_t *pool, apr_pollfd_t *pfd,
                                          apr_file_t **wakeup_pipe)
@@ -134,17 +176,100 @@ apr_status_t apr_poll_close_wakeup_pipe(apr_file_t **wakeup_pipe)
 
 #endif /* APR_FILES_AS_SOCKETS */
 
+/* Take the wakeup pending for the poller, if any, and otherwise tell the
+ * wakers that it's about to poll so they signal it. Returns non-zero when
+ * a wakeup was taken, the poll should then return APR_EINTR right away.
+ */
+int apr_poll_enter_wakeup(volatile apr_uint32_t *wakeup_set,
+                          volatile apr_uint32_t *wakeup_polling)
+{
+    /* Full barriers, this pairs with the wakers which set wakeup_set and
+     * then look at wakeup_polling.
+     */
+    apr_atomic_xchg32(wakeup_polling, 1);
+    if (apr_atomic_cas32(wakeup_set, WAKEUP_NONE,
+                         WAKEUP_PENDING) == WAKEUP_PENDING) {
+        apr_atomic_set32(wakeup_polling, 0);
+        return 1;
+    }
+    return 0;
+}
+
+/* Whether this waker has to signal the wakeup: only the first of
+ * concurrent wakers does, and only if the poller may be blocking.
+ */
+static int wakeup_needs_signal(volatile apr_uint32_t *wakeup_set,
+                               volatile apr_uint32_t *wakeup_polling)
+{
+    if (apr_atomic_cas32(wakeup_set, WAKEUP_PENDING,
+                         WAKEUP_NONE) != WAKEUP_NONE) {
+        return 0;
+    }
+    if (!apr_atomic_read32(wakeup_polling)) {
+        return 0;
+    }
+    /* Unless the poller took the wakeup meanwhile */
+    return apr_atomic_cas32(wakeup_set, WAKEUP_SIGNALED,
+                            WAKEUP_PENDING) == WAKEUP_PENDING;
+}
+
 #if WAKEUP_USES_PIPE
+apr_status_t apr_poll_signal_wakeup_pipe(volatile apr_uint32_t *wakeup_set,
+                                         volatile apr_uint32_t *wakeup_polling,
+                                         apr_file_t **wakeup_pipe)
+{
+    if (!wakeup_needs_signal(wakeup_set, wakeup_polling)) {
+        return APR_SUCCESS;
+    }
+#if WAKEUP_USES_EVENTFD
+    {
+        apr_uint64_t one = 1;
+        ssize_t rc;
+
+        do {
+            rc = write(wakeup_pipe[1]->filedes, &one, sizeof(one));
+        } while (rc == -1 && errno == EINTR);
+
+        /* EAGAIN means the counter is already non-zero, so readable */
+        if (rc == -1 && errno != EAGAIN) {
+            return errno;
+        }
+        return APR_SUCCESS;
+    }
+#else
+    return apr_file_putc(1, wakeup_pipe[1]);
+#endif
+}
+
 /* Read and discard whatever is in the wakeup pipe.
  */
 void apr_poll_drain_wakeup_pipe(volatile apr_uint32_t *wakeup_set, apr_file_t **wakeup_pipe)
 {
+#if WAKEUP_USES_EVENTFD
+    apr_uint64_t count;
+
+    /* Resets the counter, at once for all the signals */
+    (void)read(wakeup_pipe[0]->filedes, &count, sizeof(count));
+#else
     char ch;
 
     (void)apr_file_getc(&ch, wakeup_pipe[0]);
-    apr_atomic_set32(wakeup_set, 0);
+#endif
+    apr_atomic_set32(wakeup_set, WAKEUP_NONE);
 }
 #else
+apr_status_t apr_poll_signal_wakeup_socket(volatile apr_uint32_t *wakeup_set,
+                                           volatile apr_uint32_t *wakeup_polling,
+                                           apr_socket_t **wakeup_socket)
+{
+    apr_size_t len = 1;
+
+    if (!wakeup_needs_signal(wakeup_set, wakeup_polling)) {
+        return APR_SUCCESS;
+    }
+    return apr_socket_send(wakeup_socket[1], "\1", &len);
+}
+
 /* Read and discard whatever is in the wakeup socket.
  */
 void apr_poll_drain_wakeup_socket(volatile apr_uint32_t *wakeup_set, apr_socket_t **wakeup_socket)
@@ -153,6 +278,6 @@ void apr_poll_drain_wakeup_socket(volatile apr_uint32_t *wakeup_set, apr_socket_
     apr_size_t len;
 
     (void)apr_socket_recv(wakeup_socket[0], &ch, &len);
-    apr_atomic_set32(wakeup_set, 0);
+    apr_atomic_set32(wakeup_set, WAKEUP_NONE);
 }
 #endif
@@ -0,0 +1,1118 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * B+tree with all the elements in the leaves, which are chained for
+ * ordered scans.  Nodes are a few cache lines big and carved out of
+ * cache line aligned chunks, so a lookup walks height() contiguous
+ * blocks and a scan walks the leaves sequentially.
+ *
+ * Inner nodes hold pointers to elements as separators, with the strict
+ * invariant that keys[i] is the very first element of the subtree
+ * child[i + 1].  This both orders the subtrees (duplicates included) and
+ * guarantees that a separator never refers to an element which has been
+ * removed (and possibly freed) from the tree.
+ */
+
+#include "apr_btree.h"
+#include "apr_general.h"
+
+#if APR_HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define BTREE_CACHELINE     64
+#define BTREE_NODE_SIZE     (4 * BTREE_CACHELINE)
+#define BTREE_CHUNK_NODES   16
+
+typedef struct apr_btree_node_t btree_node_t;
+
+struct apr_btree_node_t {
+    btree_node_t *parent;
+    int n;          /* elements of a leaf, keys of an inner node */
+    int leaf;
+};
+
+#define BTREE_LEAF_SLOTS \
+    ((int)((BTREE_NODE_SIZE - sizeof(btree_node_t) - 2 * sizeof(void *)) \
+           / sizeof(void *)))
+#define BTREE_INNER_SLOTS \
+    ((int)((BTREE_NODE_SIZE - sizeof(btree_node_t) - sizeof(void *)) \
+           / (2 * sizeof(void *))))
+#define BTREE_LEAF_MIN      (BTREE_LEAF_SLOTS / 2)
+#define BTREE_INNER_MIN     (BTREE_INNER_SLOTS / 2)
+
+typedef struct btree_leaf_t btree_leaf_t;
+
+struct btree_leaf_t {
+    btree_node_t h;
+    btree_leaf_t *prev;
+    btree_leaf_t *next;
+    void *elts[BTREE_LEAF_SLOTS];
+};
+
+typedef struct btree_inner_t {
+    btree_node_t h;
+    void *keys[BTREE_INNER_SLOTS];
+    btree_node_t *child[BTREE_INNER_SLOTS + 1];
+} btree_inner_t;
+
+struct apr_btree_t {
+    apr_btree_compare compare;
+    apr_btree_compare comparek;
+    btree_node_t *root;
+    btree_leaf_t *head;
+    btree_leaf_t *tail;
+    apr_size_t size;
+    int height;
+    /* The indexes of the tree (if any), chained through next_index */
+    apr_btree_t *index;
+    apr_btree_t *next_index;
+    /* Node allocator */
+    btree_node_t *free_nodes;
+    int nfree;
+    char *chunk_pos;
+    int chunk_left;
+    void *chunks;
+    apr_pool_t *pool;
+};
+
+static btree_node_t *btree_chunk_node(apr_btree_t *bt)
+{
+    btree_node_t *node;
+
+    if (!bt->chunk_left) {
+        apr_size_t size = BTREE_CHUNK_NODES * BTREE_NODE_SIZE
+                          + BTREE_CACHELINE;
+        char *chunk;
+
+        if (bt->pool) {
+            chunk = apr_palloc(bt->pool, size);
+            if (!chunk) {
+                return NULL;
+            }
+        }
+        else {
+            chunk = malloc(sizeof(void *) + size);
+            if (!chunk) {
+                return NULL;
+            }
+            /* Chain the chunks for apr_btree_destroy() */
+            *(void **)chunk = bt->chunks;
+            bt->chunks = chunk;
+            chunk += sizeof(void *);
+        }
+        bt->chunk_pos = (char *)APR_ALIGN((apr_uintptr_t)chunk,
+                                          BTREE_CACHELINE);
+        bt->chunk_left = BTREE_CHUNK_NODES;
+    }
+    node = (btree_node_t *)bt->chunk_pos;
+    bt->chunk_pos += BTREE_NODE_SIZE;
+    bt->chunk_left--;
+    return node;
+}
+
+/* Make sure that an insertion can't fail halfway: splitting needs at most
+ * one node per level plus a new root.
+ */
+static apr_status_t btree_reserve(apr_btree_t *bt)
+{
+    while (bt->nfree < bt->height + 1) {
+        btree_node_t *node = btree_chunk_node(bt);
+        if (!node) {
+            return APR_ENOMEM;
+        }
+        node->parent = bt->free_nodes;
+        bt->free_nodes = node;
+        bt->nfree++;
+    }
+    return APR_SUCCESS;
+}
+
+static btree_node_t *btree_node_get(apr_btree_t *bt, int leaf)
+{
+    btree_node_t *node = bt->free_nodes;
+
+    bt->free_nodes = node->parent;
+    bt->nfree--;
+    node->parent = NULL;
+    node->n = 0;
+    node->leaf = leaf;
+    if (leaf) {
+        ((btree_leaf_t *)node)->prev = ((btree_leaf_t *)node)->next = NULL;
+    }
+    return node;
+}
+
+static void btree_node_put(apr_btree_t *bt, btree_node_t *node)
+{
+    node->parent = bt->free_nodes;
+    bt->free_nodes = node;
+    bt->nfree++;
+}
+
+static APR_INLINE btree_leaf_t *btree_leaf(btree_node_t *node)
+{
+    return (btree_leaf_t *)node;
+}
+
+static APR_INLINE btree_inner_t *btree_inner(btree_node_t *node)
+{
+    return (btree_inner_t *)node;
+}
+
+static int btree_child_index(btree_inner_t *in, btree_node_t *child)
+{
+    int i;
+    for (i = 0; i < in->h.n && in->child[i] != child; i++)
+        ;
+    return i;
+}
+
+/* Binary search of the first slot not less than (or, with upper, greater
+ * than) data.
+ */
+static int btree_bound(void *const *slots, int n, void *data,
+                       apr_btree_compare comp, int upper)
+{
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int compared = comp(data, slots[mid]);
+        if (compared > 0 || (upper && compared == 0)) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static btree_leaf_t *btree_descend(apr_btree_t *bt, void *data,
+                                   apr_btree_compare comp, int upper,
+                                   int *pos)
+{
+    btree_node_t *node = bt->root;
+    while (!node->leaf) {
+        btree_inner_t *in = btree_inner(node);
+        node = in->child[btree_bound(in->keys, in->h.n, data, comp, upper)];
+    }
+    *pos = btree_bound(btree_leaf(node)->elts, node->n, data, comp, upper);
+    return btree_leaf(node);
+}
+
+/* Position iter on the first element not less than data, moving to the
+ * next leaf if the bound lies past the end of the one descended to.
+ */
+static void *btree_seek(apr_btree_t *bt, void *data, apr_btree_compare comp,
+                        apr_btree_iter_t *iter)
+{
+    btree_leaf_t *leaf;
+    int pos;
+
+    iter->bt = bt;
+    iter->node = NULL;
+    iter->pos = 0;
+    if (!bt->root) {
+        return NULL;
+    }
+    leaf = btree_descend(bt, data, comp, 0, &pos);
+    if (pos == leaf->h.n) {
+        leaf = leaf->next;
+        pos = 0;
+        if (!leaf) {
+            return NULL;
+        }
+    }
+    iter->node = &leaf->h;
+    iter->pos = pos;
+    return leaf->elts[pos];
+}
+
+static apr_btree_t *btree_index(apr_btree_t *bt, apr_btree_compare comp)
+{
+    apr_btree_t *t;
+    if (!comp || comp == bt->compare) {
+        return bt;
+    }
+    for (t = bt->index; t; t = t->next_index) {
+        if (t->compare == comp) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+/* Propagate the new first element of a leaf to the separator refering to
+ * it, if any.
+ */
+static void btree_update_sep(btree_leaf_t *leaf)
+{
+    btree_node_t *node = &leaf->h;
+    void *first = leaf->elts[0];
+    while (node->parent) {
+        btree_inner_t *in = btree_inner(node->parent);
+        int i = btree_child_index(in, node);
+        if (i > 0) {
+            in->keys[i - 1] = first;
+            return;
+        }
+        node = &in->h;
+    }
+}
+
+static void btree_insert_parent(apr_btree_t *bt, btree_node_t *left,
+                                void *key, btree_node_t *right)
+{
+    btree_inner_t *in = btree_inner(left->parent), *sib;
+    void *keys[BTREE_INNER_SLOTS + 1];
+    btree_node_t *child[BTREE_INNER_SLOTS + 2];
+    int i, mid, total;
+
+    if (!in) {
+        in = btree_inner(btree_node_get(bt, 0));
+        in->h.n = 1;
+        in->keys[0] = key;
+        in->child[0] = left;
+        in->child[1] = right;
+        left->parent = right->parent = &in->h;
+        bt->root = &in->h;
+        bt->height++;
+        return;
+    }
+
+    i = btree_child_index(in, left);
+    if (in->h.n < BTREE_INNER_SLOTS) {
+        memmove(in->keys + i + 1, in->keys + i,
+                (in->h.n - i) * sizeof(void *));
+        memmove(in->child + i + 2, in->child + i + 1,
+                (in->h.n - i) * sizeof(btree_node_t *));
+        in->keys[i] = key;
+        in->child[i + 1] = right;
+        right->parent = &in->h;
+        in->h.n++;
+        return;
+    }
+
+    /* Split the full inner node, the middle key moves up */
+    total = BTREE_INNER_SLOTS + 1;
+    memcpy(keys, in->keys, i * sizeof(void *));
+    keys[i] = key;
+    memcpy(keys + i + 1, in->keys + i,
+           (BTREE_INNER_SLOTS - i) * sizeof(void *));
+    memcpy(child, in->child, (i + 1) * sizeof(btree_node_t *));
+    child[i + 1] = right;
+    memcpy(child + i + 2, in->child + i + 1,
+           (BTREE_INNER_SLOTS - i) * sizeof(btree_node_t *));
+
+    mid = total / 2;
+    sib = btree_inner(btree_node_get(bt, 0));
+    memcpy(in->keys, keys, mid * sizeof(void *));
+    memcpy(in->child, child, (mid + 1) * sizeof(btree_node_t *));
+    in->h.n = mid;
+    sib->h.n = total - mid - 1;
+    memcpy(sib->keys, keys + mid + 1, sib->h.n * sizeof(void *));
+    memcpy(sib->child, child + mid + 1,
+           (sib->h.n + 1) * sizeof(btree_node_t *));
+    for (i = 0; i <= in->h.n; i++) {
+        in->child[i]->parent = &in->h;
+    }
+    for (i = 0; i <= sib->h.n; i++) {
+        sib->child[i]->parent = &sib->h;
+    }
+    btree_insert_parent(bt, &in->h, keys[mid], &sib->h);
+}
+
+/* Insert data at pos in leaf, btree_reserve() must have been called. */
+static void btree_insert_at(apr_btree_t *bt, btree_leaf_t *leaf, int pos,
+                            void *data)
+{
+    btree_leaf_t *right;
+    int split;
+
+    bt->size++;
+    if (leaf->h.n < BTREE_LEAF_SLOTS) {
+        memmove(leaf->elts + pos + 1, leaf->elts + pos,
+                (leaf->h.n - pos) * sizeof(void *));
+        leaf->elts[pos] = data;
+        leaf->h.n++;
+        return;
+    }
+
+    /* Appending to the last leaf (ascending insertions) keeps it full
+     * rather than leaving two half empty leaves behind.
+     */
+    if (pos == leaf->h.n && !leaf->next) {
+        split = leaf->h.n;
+    }
+    else {
+        split = (leaf->h.n + 1) / 2;
+    }
+    right = btree_leaf(btree_node_get(bt, 1));
+    right->h.n = leaf->h.n - split;
+    memcpy(right->elts, leaf->elts + split, right->h.n * sizeof(void *));
+    leaf->h.n = split;
+    right->prev = leaf;
+    right->next = leaf->next;
+    if (leaf->next) {
+        leaf->next->prev = right;
+    }
+    else {
+        bt->tail = right;
+    }
+    leaf->next = right;
+
+    if (pos < split) {
+        memmove(leaf->elts + pos + 1, leaf->elts + pos,
+                (leaf->h.n - pos) * sizeof(void *));
+        leaf->elts[pos] = data;
+        leaf->h.n++;
+    }
+    else {
+        pos -= split;
+        memmove(right->elts + pos + 1, right->elts + pos,
+                (right->h.n - pos) * sizeof(void *));
+        right->elts[pos] = data;
+        right->h.n++;
+    }
+    btree_insert_parent(bt, &leaf->h, right->elts[0], &right->h);
+}
+
+/* Remove the key i and the child i + 1 of an inner node. */
+static void btree_inner_cut(btree_inner_t *in, int i)
+{
+    memmove(in->keys + i, in->keys + i + 1,
+            (in->h.n - i - 1) * sizeof(void *));
+    memmove(in->child + i + 1, in->child + i + 2,
+            (in->h.n - i - 1) * sizeof(btree_node_t *));
+    in->h.n--;
+}
+
+static void btree_rebalance_inner(apr_btree_t *bt, btree_inner_t *in)
+{
+    btree_inner_t *parent, *left, *right;
+    int i, j;
+
+    if (!in->h.parent) {
+        if (in->h.n == 0) {
+            bt->root = in->child[0];
+            bt->root->parent = NULL;
+            bt->height--;
+            btree_node_put(bt, &in->h);
+        }
+        return;
+    }
+    if (in->h.n >= BTREE_INNER_MIN) {
+        return;
+    }
+
+    parent = btree_inner(in->h.parent);
+    i = btree_child_index(parent, &in->h);
+    left = (i > 0) ? btree_inner(parent->child[i - 1]) : NULL;
+    right = (i < parent->h.n) ? btree_inner(parent->child[i + 1]) : NULL;
+
+    if (right && right->h.n > BTREE_INNER_MIN) {
+        in->keys[in->h.n] = parent->keys[i];
+        in->child[in->h.n + 1] = right->child[0];
+        right->child[0]->parent = &in->h;
+        in->h.n++;
+        parent->keys[i] = right->keys[0];
+        memmove(right->keys, right->keys + 1,
+                (right->h.n - 1) * sizeof(void *));
+        memmove(right->child, right->child + 1,
+                right->h.n * sizeof(btree_node_t *));
+        right->h.n--;
+    }
+    else if (left && left->h.n > BTREE_INNER_MIN) {
+        memmove(in->keys + 1, in->keys, in->h.n * sizeof(void *));
+        memmove(in->child + 1, in->child,
+                (in->h.n + 1) * sizeof(btree_node_t *));
+        in->keys[0] = parent->keys[i - 1];
+        in->child[0] = left->child[left->h.n];
+        in->child[0]->parent = &in->h;
+        in->h.n++;
+        parent->keys[i - 1] = left->keys[left->h.n - 1];
+        left->h.n--;
+    }
+    else {
+        if (!right) {
+            /* Merge into the left sibling instead */
+            right = in;
+            in = left;
+            i--;
+        }
+        in->keys[in->h.n] = parent->keys[i];
+        memcpy(in->keys + in->h.n + 1, right->keys,
+               right->h.n * sizeof(void *));
+        memcpy(in->child + in->h.n + 1, right->child,
+               (right->h.n + 1) * sizeof(btree_node_t *));
+        for (j = 0; j <= right->h.n; j++) {
+            right->child[j]->parent = &in->h;
+        }
+        in->h.n += right->h.n + 1;
+        btree_inner_cut(parent, i);
+        btree_node_put(bt, &right->h);
+        btree_rebalance_inner(bt, parent);
+    }
+}
+
+static void btree_remove_at(apr_btree_t *bt, btree_leaf_t *leaf, int pos)
+{
+    btree_inner_t *parent;
+    btree_leaf_t *left, *right;
+    int i;
+
+    memmove(leaf->elts + pos, leaf->elts + pos + 1,
+            (leaf->h.n - pos - 1) * sizeof(void *));
+    leaf->h.n--;
+    bt->size--;
+
+    if (!leaf->h.parent) {
+        if (leaf->h.n == 0) {
+            btree_node_put(bt, &leaf->h);
+            bt->root = NULL;
+            bt->head = bt->tail = NULL;
+            bt->height = 0;
+        }
+        return;
+    }
+    if (pos == 0) {
+        btree_update_sep(leaf);
+    }
+    if (leaf->h.n >= BTREE_LEAF_MIN) {
+        return;
+    }
+
+    parent = btree_inner(leaf->h.parent);
+    i = btree_child_index(parent, &leaf->h);
+    left = (i > 0) ? btree_leaf(parent->child[i - 1]) : NULL;
+    right = (i < parent->h.n) ? btree_leaf(parent->child[i + 1]) : NULL;
+
+    if (right && right->h.n > BTREE_LEAF_MIN) {
+        leaf->elts[leaf->h.n++] = right->elts[0];
+        memmove(right->elts, right->elts + 1,
+                (right->h.n - 1) * sizeof(void *));
+        right->h.n--;
+        parent->keys[i] = right->elts[0];
+    }
+    else if (left && left->h.n > BTREE_LEAF_MIN) {
+        memmove(leaf->elts + 1, leaf->elts, leaf->h.n * sizeof(void *));
+        leaf->elts[0] = left->elts[--left->h.n];
+        leaf->h.n++;
+        parent->keys[i - 1] = leaf->elts[0];
+    }
+    else {
+        if (!right) {
+            /* Merge into the left sibling instead */
+            right = leaf;
+            leaf = left;
+            i--;
+        }
+        memcpy(leaf->elts + leaf->h.n, right->elts,
+               right->h.n * sizeof(void *));
+        leaf->h.n += right->h.n;
+        leaf->next = right->next;
+        if (right->next) {
+            right->next->prev = leaf;
+        }
+        else {
+            bt->tail = leaf;
+        }
+        btree_inner_cut(parent, i);
+        btree_node_put(bt, &right->h);
+        btree_rebalance_inner(bt, parent);
+    }
+}
+
+/* Insert data in a single tree (no index), with upper (add) or lower
+ * (insert) bound placement.
+ */
+static apr_status_t btree_put(apr_btree_t *bt, void *data, int add)
+{
+    btree_leaf_t *leaf;
+    int pos;
+
+    if (!bt->root) {
+        leaf = btree_leaf(btree_node_get(bt, 1));
+        bt->root = &leaf->h;
+        bt->head = bt->tail = leaf;
+        bt->height = 1;
+        pos = 0;
+    }
+    else {
+        leaf = btree_descend(bt, data, bt->compare, add, &pos);
+        if (!add) {
+            void *elt = NULL;
+            if (pos < leaf->h.n) {
+                elt = leaf->elts[pos];
+            }
+            else if (leaf->next) {
+                elt = leaf->next->elts[0];
+            }
+            if (elt && bt->compare(data, elt) == 0) {
+                return APR_EEXIST;
+            }
+        }
+    }
+    btree_insert_at(bt, leaf, pos, data);
+    return APR_SUCCESS;
+}
+
+static apr_status_t btree_insert(apr_btree_t *bt, void *data, int add)
+{
+    apr_btree_t *t;
+    apr_status_t rv;
+
+    if (!bt->compare) {
+        return APR_EINVAL;
+    }
+    for (t = bt; t; t = (t == bt) ? bt->index : t->next_index) {
+        if ((rv = btree_reserve(t)) != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    rv = btree_put(bt, data, add);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    for (t = bt->index; t; t = t->next_index) {
+        btree_put(t, data, 1);
+    }
+    return APR_SUCCESS;
+}
+
+/* Remove the given element (pointer wise) from a single tree. */
+static void btree_delete_elt(apr_btree_t *bt, void *elt)
+{
+    apr_btree_iter_t iter;
+    void *cur;
+
+    for (cur = btree_seek(bt, elt, bt->compare, &iter);
+         cur && bt->compare(elt, cur) == 0;
+         cur = apr_btree_next(&iter)) {
+        if (cur == elt) {
+            btree_remove_at(bt, btree_leaf(iter.node), iter.pos);
+            return;
+        }
+    }
+}
+
+/* Remove the element found at leaf/pos in t, which is bt or one of its
+ * indexes, from all of them.
+ */
+static void btree_remove_found(apr_btree_t *bt, apr_btree_t *t,
+                               btree_leaf_t *leaf, int pos,
+                               apr_btree_freefunc myfree)
+{
+    void *elt = leaf->elts[pos];
+    apr_btree_t *o;
+
+    btree_remove_at(t, leaf, pos);
+    for (o = bt; o; o = (o == bt) ? bt->index : o->next_index) {
+        if (o != t) {
+            btree_delete_elt(o, elt);
+        }
+    }
+    if (myfree && elt) {
+        myfree(elt);
+    }
+}
+
+APR_DECLARE(apr_status_t) apr_btree_create(apr_btree_t **bt, apr_pool_t *p)
+{
+    apr_btree_t *t;
+    if (p) {
+        t = apr_pcalloc(p, sizeof(apr_btree_t));
+    }
+    else {
+        t = calloc(1, sizeof(apr_btree_t));
+    }
+    if (!t) {
+        *bt = NULL;
+        return APR_ENOMEM;
+    }
+    t->pool = p;
+    *bt = t;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_btree_set_compare(apr_btree_t *bt,
+                                        apr_btree_compare comp,
+                                        apr_btree_compare compk)
+{
+    if (bt->compare && bt->comparek) {
+        apr_btree_add_index(bt, comp, compk);
+    }
+    else {
+        bt->compare = comp;
+        bt->comparek = compk;
+    }
+}
+
+APR_DECLARE(apr_status_t) apr_btree_add_index(apr_btree_t *bt,
+                                              apr_btree_compare comp,
+                                              apr_btree_compare compk)
+{
+    apr_btree_iter_t iter;
+    apr_btree_t *ni, **last;
+    apr_status_t rv;
+    void *elt;
+
+    if (btree_index(bt, comp)) {
+        return APR_SUCCESS;     /* Index already there! */
+    }
+    rv = apr_btree_create(&ni, bt->pool);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    ni->compare = comp;
+    ni->comparek = compk;
+    for (elt = apr_btree_first(bt, &iter); iter.node;
+         elt = apr_btree_next(&iter)) {
+        if ((rv = btree_reserve(ni)) != APR_SUCCESS) {
+            apr_btree_destroy(ni, NULL);
+            return rv;
+        }
+        btree_put(ni, elt, 1);
+    }
+    for (last = &bt->index; *last; last = &(*last)->next_index)
+        ;
+    *last = ni;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_btree_insert(apr_btree_t *bt, void *data)
+{
+    return btree_insert(bt, data, 0);
+}
+
+APR_DECLARE(apr_status_t) apr_btree_add(apr_btree_t *bt, void *data)
+{
+    return btree_insert(bt, data, 1);
+}
+
+APR_DECLARE(apr_status_t) apr_btree_replace(apr_btree_t *bt, void *data,
+                                            apr_btree_freefunc myfree)
+{
+    apr_btree_iter_t iter;
+    void *elt;
+
+    if (!bt->compare) {
+        return APR_EINVAL;
+    }
+    while ((elt = btree_seek(bt, data, bt->compare, &iter))
+           && bt->compare(data, elt) == 0) {
+        btree_remove_found(bt, bt, btree_leaf(iter.node), iter.pos, myfree);
+    }
+    return btree_insert(bt, data, 1);
+}
+
+APR_DECLARE(apr_status_t) apr_btree_bulk_load(apr_btree_t *bt,
+                                              void *const *elts,
+                                              apr_size_t nelts)
+{
+    btree_node_t **level;
+    void **firsts;
+    apr_size_t i, n, count, per, extra, c;
+    apr_btree_t *t;
+    apr_status_t rv;
+
+    if (!bt->compare || bt->root) {
+        return APR_EINVAL;
+    }
+    for (i = 1; i < nelts; i++) {
+        if (bt->compare(elts[i - 1], elts[i]) > 0) {
+            return APR_EINVAL;
+        }
+    }
+    if (!nelts) {
+        return APR_SUCCESS;
+    }
+
+    count = (nelts + BTREE_LEAF_SLOTS - 1) / BTREE_LEAF_SLOTS;
+    level = malloc(count * sizeof(*level));
+    firsts = malloc(count * sizeof(*firsts));
+    if (!level || !firsts) {
+        free(level);
+        free(firsts);
+        return APR_ENOMEM;
+    }
+
+    /* Spread the elements evenly so that no leaf is underfilled */
+    per = nelts / count;
+    extra = nelts % count;
+    for (i = 0, n = 0; i < count; i++) {
+        btree_leaf_t *leaf;
+        apr_size_t take = per + (i < extra);
+        if (bt->nfree == 0 && (rv = btree_reserve(bt)) != APR_SUCCESS) {
+            goto failed;
+        }
+        leaf = btree_leaf(btree_node_get(bt, 1));
+        memcpy(leaf->elts, elts + n, take * sizeof(void *));
+        leaf->h.n = (int)take;
+        if (i) {
+            leaf->prev = btree_leaf(level[i - 1]);
+            leaf->prev->next = leaf;
+        }
+        level[i] = &leaf->h;
+        firsts[i] = elts[n];
+        n += take;
+    }
+    bt->head = btree_leaf(level[0]);
+    bt->tail = btree_leaf(level[count - 1]);
+    bt->size = nelts;
+    bt->height = 1;
+
+    /* Build the inner levels in place, each node's first element being
+     * the separator in its parent.
+     */
+    while (count > 1) {
+        apr_size_t groups = (count + BTREE_INNER_SLOTS) / (BTREE_INNER_SLOTS + 1);
+        per = count / groups;
+        extra = count % groups;
+        for (i = 0, n = 0; i < groups; i++) {
+            btree_inner_t *in;
+            apr_size_t take = per + (i < extra);
+            if (bt->nfree == 0 && (rv = btree_reserve(bt)) != APR_SUCCESS) {
+                goto failed;
+            }
+            in = btree_inner(btree_node_get(bt, 0));
+            for (c = 0; c < take; c++) {
+                in->child[c] = level[n + c];
+                in->child[c]->parent = &in->h;
+                if (c) {
+                    in->keys[c - 1] = firsts[n + c];
+                }
+            }
+            in->h.n = (int)take - 1;
+            firsts[i] = firsts[n];
+            level[i] = &in->h;
+            n += take;
+        }
+        count = groups;
+        bt->height++;
+    }
+    bt->root = level[0];
+    free(level);
+    free(firsts);
+
+    for (t = bt->index; t; t = t->next_index) {
+        for (i = 0; i < nelts; i++) {
+            if ((rv = btree_reserve(t)) != APR_SUCCESS) {
+                return rv;
+            }
+            btree_put(t, elts[i], 1);
+        }
+    }
+    return APR_SUCCESS;
+
+failed:
+    /* Only the (pool or malloc) chunks allocation can fail, which leaves
+     * the nodes taken so far unreachable until the tree is destroyed.
+     */
+    free(level);
+    free(firsts);
+    bt->root = NULL;
+    bt->head = bt->tail = NULL;
+    bt->size = 0;
+    bt->height = 0;
+    return rv;
+}
+
+APR_DECLARE(void *) apr_btree_find_compare(apr_btree_t *bt, void *data,
+                                           apr_btree_iter_t *iter,
+                                           apr_btree_compare comp)
+{
+    apr_btree_iter_t it;
+    apr_btree_t *t = btree_index(bt, comp);
+    void *elt = NULL;
+
+    if (!iter) {
+        iter = &it;
+    }
+    if (!t || !t->comparek) {
+        iter->bt = bt;
+        iter->node = NULL;
+        return NULL;
+    }
+    elt = btree_seek(t, data, t->comparek, iter);
+    if (elt && t->comparek(data, elt) != 0) {
+        iter->node = NULL;
+        elt = NULL;
+    }
+    return elt;
+}
+
+APR_DECLARE(void *) apr_btree_find(apr_btree_t *bt, void *data,
+                                   apr_btree_iter_t *iter)
+{
+    return apr_btree_find_compare(bt, data, iter, bt->compare);
+}
+
+APR_DECLARE(void *) apr_btree_lower_bound_compare(apr_btree_t *bt,
+                                                  void *data,
+                                                  apr_btree_iter_t *iter,
+                                                  apr_btree_compare comp)
+{
+    apr_btree_iter_t it;
+    apr_btree_t *t = btree_index(bt, comp);
+
+    if (!iter) {
+        iter = &it;
+    }
+    if (!t || !t->comparek) {
+        iter->bt = bt;
+        iter->node = NULL;
+        return NULL;
+    }
+    return btree_seek(t, data, t->comparek, iter);
+}
+
+APR_DECLARE(void *) apr_btree_lower_bound(apr_btree_t *bt, void *data,
+                                          apr_btree_iter_t *iter)
+{
+    return apr_btree_lower_bound_compare(bt, data, iter, bt->compare);
+}
+
+APR_DECLARE(void *) apr_btree_first_compare(apr_btree_t *bt,
+                                            apr_btree_iter_t *iter,
+                                            apr_btree_compare comp)
+{
+    apr_btree_t *t = btree_index(bt, comp);
+
+    iter->bt = t ? t : bt;
+    iter->node = (t && t->head) ? &t->head->h : NULL;
+    iter->pos = 0;
+    return iter->node ? t->head->elts[0] : NULL;
+}
+
+APR_DECLARE(void *) apr_btree_first(apr_btree_t *bt, apr_btree_iter_t *iter)
+{
+    return apr_btree_first_compare(bt, iter, bt->compare);
+}
+
+APR_DECLARE(void *) apr_btree_last_compare(apr_btree_t *bt,
+                                           apr_btree_iter_t *iter,
+                                           apr_btree_compare comp)
+{
+    apr_btree_t *t = btree_index(bt, comp);
+
+    iter->bt = t ? t : bt;
+    iter->node = (t && t->tail) ? &t->tail->h : NULL;
+    iter->pos = iter->node ? iter->node->n - 1 : 0;
+    return iter->node ? t->tail->elts[iter->pos] : NULL;
+}
+
+APR_DECLARE(void *) apr_btree_last(apr_btree_t *bt, apr_btree_iter_t *iter)
+{
+    return apr_btree_last_compare(bt, iter, bt->compare);
+}
+
+APR_DECLARE(void *) apr_btree_next(apr_btree_iter_t *iter)
+{
+    btree_leaf_t *leaf = btree_leaf(iter->node);
+
+    if (!leaf) {
+        return NULL;
+    }
+    if (++iter->pos >= leaf->h.n) {
+        leaf = leaf->next;
+        iter->pos = 0;
+        if (!leaf) {
+            iter->node = NULL;
+            return NULL;
+        }
+        iter->node = &leaf->h;
+    }
+    return leaf->elts[iter->pos];
+}
+
+APR_DECLARE(void *) apr_btree_previous(apr_btree_iter_t *iter)
+{
+    btree_leaf_t *leaf = btree_leaf(iter->node);
+
+    if (!leaf) {
+        return NULL;
+    }
+    if (--iter->pos < 0) {
+        leaf = leaf->prev;
+        if (!leaf) {
+            iter->node = NULL;
+            iter->pos = 0;
+            return NULL;
+        }
+        iter->node = &leaf->h;
+        iter->pos = leaf->h.n - 1;
+    }
+    return leaf->elts[iter->pos];
+}
+
+APR_DECLARE(void *) apr_btree_element(const apr_btree_iter_t *iter)
+{
+    return iter->node ? btree_leaf(iter->node)->elts[iter->pos] : NULL;
+}
+
+APR_DECLARE(int) apr_btree_range_do(apr_btree_t *bt, apr_btree_compare comp,
+                                    void *lo, void *hi,
+                                    apr_btree_do_callback_fn_t *cb,
+                                    void *rec)
+{
+    apr_btree_iter_t iter;
+    apr_btree_t *t = btree_index(bt, comp);
+    void *elt;
+
+    if (!t) {
+        return 1;
+    }
+    if (lo) {
+        elt = btree_seek(t, lo, t->comparek, &iter);
+    }
+    else {
+        elt = apr_btree_first(t, &iter);
+    }
+    for (; iter.node; elt = apr_btree_next(&iter)) {
+        if (hi && t->comparek(hi, elt) < 0) {
+            break;
+        }
+        if (!cb(rec, elt)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+APR_DECLARE(int) apr_btree_remove_compare(apr_btree_t *bt, void *data,
+                                          apr_btree_freefunc myfree,
+                                          apr_btree_compare comp)
+{
+    apr_btree_iter_t iter;
+
+    if (!apr_btree_find_compare(bt, data, &iter, comp)) {
+        return 0;
+    }
+    btree_remove_found(bt, iter.bt, btree_leaf(iter.node), iter.pos, myfree);
+    return 1;
+}
+
+APR_DECLARE(int) apr_btree_remove(apr_btree_t *bt, void *data,
+                                  apr_btree_freefunc myfree)
+{
+    return apr_btree_remove_compare(bt, data, myfree, bt->compare);
+}
+
+APR_DECLARE(int) apr_btree_remove_iter(apr_btree_t *bt,
+                                       apr_btree_iter_t *iter,
+                                       apr_btree_freefunc myfree)
+{
+    if (!iter->node) {
+        return 0;
+    }
+    btree_remove_found(bt, iter->bt, btree_leaf(iter->node), iter->pos,
+                       myfree);
+    iter->node = NULL;
+    return 1;
+}
+
+APR_DECLARE(void *) apr_btree_pop(apr_btree_t *bt, apr_btree_freefunc myfree)
+{
+    void *data;
+
+    if (!bt->head) {
+        return NULL;
+    }
+    data = bt->head->elts[0];
+    btree_remove_found(bt, bt, bt->head, 0, myfree);
+    return data;
+}
+
+APR_DECLARE(void *) apr_btree_peek(apr_btree_t *bt)
+{
+    return bt->head ? bt->head->elts[0] : NULL;
+}
+
+static void btree_put_subtree(apr_btree_t *bt, btree_node_t *node)
+{
+    if (!node->leaf) {
+        int i;
+        for (i = 0; i <= node->n; i++) {
+            btree_put_subtree(bt, btree_inner(node)->child[i]);
+        }
+    }
+    btree_node_put(bt, node);
+}
+
+APR_DECLARE(void) apr_btree_remove_all(apr_btree_t *bt,
+                                       apr_btree_freefunc myfree)
+{
+    apr_btree_t *t;
+
+    if (myfree) {
+        btree_leaf_t *leaf;
+        int i;
+        for (leaf = bt->head; leaf; leaf = leaf->next) {
+            for (i = 0; i < leaf->h.n; i++) {
+                if (leaf->elts[i]) {
+                    myfree(leaf->elts[i]);
+                }
+            }
+        }
+    }
+    if (bt->root) {
+        btree_put_subtree(bt, bt->root);
+    }
+    bt->root = NULL;
+    bt->head = bt->tail = NULL;
+    bt->size = 0;
+    bt->height = 0;
+    for (t = bt->index; t; t = t->next_index) {
+        apr_btree_remove_all(t, NULL);
+    }
+}
+
+APR_DECLARE(void) apr_btree_destroy(apr_btree_t *bt,
+                                    apr_btree_freefunc myfree)
+{
+    apr_btree_t *t, *next;
+
+    apr_btree_remove_all(bt, myfree);
+    for (t = bt->index; t; t = next) {
+        next = t->next_index;
+        apr_btree_destroy(t, NULL);
+    }
+    bt->index = NULL;
+    if (!bt->pool) {
+        while (bt->chunks) {
+            void *chunk = bt->chunks;
+            bt->chunks = *(void **)chunk;
+            free(chunk);
+        }
+        free(bt);
+    }
+}
+
+APR_DECLARE(apr_size_t) apr_btree_size(const apr_btree_t *bt)
+{
+    return bt->size;
+}
+
+APR_DECLARE(int) apr_btree_height(const apr_btree_t *bt)
+{
+    return bt->height;
+}
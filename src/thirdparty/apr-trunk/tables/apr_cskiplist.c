@@ -0,0 +1,520 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Lock-free skip list, after Fraser ("Practical lock-freedom") and
+ * Herlihy & Shavit ("The Art of Multiprocessor Programming").
+ *
+ * The low bit of a node's next pointer at some level marks the node as
+ * deleted at that level.  A node is removed by marking its upper levels
+ * top-down and then level 0; whoever marks level 0 owns the removal.
+ * Marked nodes are unlinked (snipped) by any search walking past them.
+ *
+ * Equal elements are kept unique by a sequence number taken at insertion,
+ * so that all levels agree on the order of duplicates and a node can
+ * always be searched for exactly.
+ *
+ * Nodes are heap allocated and freed through a small epoch scheme: each
+ * operation runs inside a section tagged with the global epoch, unlinked
+ * nodes are retired to the limbo list of that epoch, and a limbo list is
+ * freed when the epoch has advanced twice since, which can only happen
+ * once every section that may have seen those nodes has ended.
+ *
+ * apr_epoch_t is not used for this: it needs a record registered by each
+ * thread, which this API does not take, and it only exists with threads.
+ * Two counters shared by all the threads are enough here, at the cost of
+ * some contention on them.
+ */
+
+#include "apr_cskiplist.h"
+#include "apr_atomic.h"
+
+#if APR_HAVE_STDLIB_H
+#include <stdlib.h> /* for malloc, free */
+#endif
+
+#define CSKIPLIST_MAX_HEIGHT 24
+#define CSKIPLIST_RECLAIM_BATCH 64
+
+/* Epochs cycle modulo 6, so that both the parity (section counters) and
+ * the residue modulo 3 (limbo lists) survive the wrap around.
+ */
+#define CSKIPLIST_EPOCHS 6
+
+/* Keeps the contended fields of the list apart from each other */
+#define CSKIPLIST_CACHELINE 64
+
+#define IS_MARKED(p) (((apr_uintptr_t)(p)) & 1)
+#define MARKED(p)    ((void *)(((apr_uintptr_t)(p)) | 1))
+#define UNMARKED(p)  ((cskiplist_node *)(((apr_uintptr_t)(p)) & ~(apr_uintptr_t)1))
+
+typedef struct cskiplist_node cskiplist_node;
+
+struct cskiplist_node {
+    void *data;
+    apr_uint64_t seq;
+    /* Link in the limbo list once retired */
+    cskiplist_node *retired;
+    /* One reference for the inserter, one for the list membership */
+    volatile apr_uint32_t refs;
+    int height;
+    void *volatile next[1];
+};
+
+struct apr_cskiplist_t {
+    apr_cskiplist_compare compare;
+    cskiplist_node *head;
+    char pad0[CSKIPLIST_CACHELINE];
+    volatile apr_uint64_t seq;
+    volatile apr_uint32_t seed;
+    volatile apr_uint32_t size;
+    char pad1[CSKIPLIST_CACHELINE];
+    volatile apr_uint32_t epoch;
+    volatile apr_uint32_t advancing;
+    volatile apr_uint32_t nretired;
+    void *volatile limbo[3];
+    char pad2[CSKIPLIST_CACHELINE];
+    volatile apr_uint32_t active[2];
+    char pad3[CSKIPLIST_CACHELINE];
+};
+
+static void cskiplist_free_chain(cskiplist_node *node)
+{
+    while (node) {
+        cskiplist_node *retired = node->retired;
+        free(node);
+        node = retired;
+    }
+}
+
+static apr_uint32_t cskiplist_enter(apr_cskiplist_t *csl)
+{
+    for (;;) {
+        apr_uint32_t e = apr_atomic_read32(&csl->epoch);
+        apr_atomic_inc32(&csl->active[e & 1]);
+        if (apr_atomic_read32(&csl->epoch) == e) {
+            return e;
+        }
+        apr_atomic_dec32(&csl->active[e & 1]);
+    }
+}
+
+/* Move the epoch forward if no section of the previous epoch is still
+ * running, freeing the nodes retired two epochs ago.
+ */
+static void cskiplist_advance(apr_cskiplist_t *csl)
+{
+    cskiplist_node *node = NULL;
+    apr_uint32_t e, n = 0;
+
+    if (apr_atomic_cas32(&csl->advancing, 1, 0) != 0) {
+        return;
+    }
+    e = apr_atomic_read32(&csl->epoch);
+    if (apr_atomic_read32(&csl->active[(e + 1) & 1]) == 0) {
+        node = apr_atomic_xchgptr(&csl->limbo[(e + 1) % 3], NULL);
+        apr_atomic_set32(&csl->epoch, (e + 1) % CSKIPLIST_EPOCHS);
+    }
+    apr_atomic_set32(&csl->advancing, 0);
+
+    while (node) {
+        cskiplist_node *retired = node->retired;
+        free(node);
+        node = retired;
+        n++;
+    }
+    if (n) {
+        apr_atomic_sub32(&csl->nretired, n);
+    }
+}
+
+static void cskiplist_leave(apr_cskiplist_t *csl, apr_uint32_t e)
+{
+    apr_atomic_dec32(&csl->active[e & 1]);
+    if (apr_atomic_read32(&csl->nretired) >= CSKIPLIST_RECLAIM_BATCH) {
+        cskiplist_advance(csl);
+    }
+}
+
+static void cskiplist_retire(apr_cskiplist_t *csl, apr_uint32_t e,
+                             cskiplist_node *node)
+{
+    void *volatile *limbo = &csl->limbo[e % 3];
+    void *head;
+
+    do {
+        head = *limbo;
+        node->retired = head;
+    } while (apr_atomic_casptr(limbo, node, head) != head);
+    apr_atomic_inc32(&csl->nretired);
+}
+
+static void cskiplist_release(apr_cskiplist_t *csl, apr_uint32_t e,
+                              cskiplist_node *node)
+{
+    if (!apr_atomic_dec32(&node->refs)) {
+        cskiplist_retire(csl, e, node);
+    }
+}
+
+/* Compare a value (and a sequence number, 0 for any) with a node */
+static APR_INLINE int cskiplist_cmp(apr_cskiplist_t *csl, void *data,
+                                    apr_uint64_t seq, cskiplist_node *node)
+{
+    int c = csl->compare(data, node->data);
+    if (c || !seq) {
+        return c;
+    }
+    return (seq > node->seq) - (seq < node->seq);
+}
+
+/* Locate the predecessors and successors of (data, seq) at each level,
+ * unlinking the marked nodes found on the way.
+ */
+static void cskiplist_search(apr_cskiplist_t *csl, void *data,
+                             apr_uint64_t seq, cskiplist_node **preds,
+                             cskiplist_node **succs)
+{
+    cskiplist_node *pred, *curr;
+    void *next;
+    int level;
+
+retry:
+    pred = csl->head;
+    for (level = CSKIPLIST_MAX_HEIGHT - 1; level >= 0; level--) {
+        curr = UNMARKED(pred->next[level]);
+        while (curr) {
+            next = curr->next[level];
+            while (IS_MARKED(next)) {
+                if (apr_atomic_casptr(&pred->next[level], UNMARKED(next),
+                                      curr) != curr) {
+                    goto retry;
+                }
+                curr = UNMARKED(next);
+                if (!curr) {
+                    break;
+                }
+                next = curr->next[level];
+            }
+            if (!curr || cskiplist_cmp(csl, data, seq, curr) <= 0) {
+                break;
+            }
+            pred = curr;
+            curr = UNMARKED(next);
+        }
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+}
+
+/* Read-only search for the first live node not lower than data, or
+ * greater than data if upper is set.  Pointers are followed through data
+ * dependencies, which are ordered after the CAS that published them.
+ */
+static cskiplist_node *cskiplist_seek(apr_cskiplist_t *csl, void *data,
+                                      int upper)
+{
+    cskiplist_node *pred = csl->head, *curr = NULL;
+    void *next;
+    int level;
+
+    for (level = CSKIPLIST_MAX_HEIGHT - 1; level >= 0; level--) {
+        curr = UNMARKED(pred->next[level]);
+        while (curr) {
+            next = curr->next[level];
+            if (IS_MARKED(next)) {
+                curr = UNMARKED(next);
+                continue;
+            }
+            if (data) {
+                int c = csl->compare(data, curr->data);
+                if (c < 0 || (c == 0 && !upper)) {
+                    break;
+                }
+            }
+            else if (!upper) {
+                break;
+            }
+            pred = curr;
+            curr = UNMARKED(next);
+        }
+    }
+    return curr;
+}
+
+static int cskiplist_height(apr_cskiplist_t *csl)
+{
+    apr_uint32_t x = apr_atomic_add32(&csl->seed, 0x9e3779b9);
+    int height = 1;
+
+    x ^= x >> 16;
+    x *= 0x85ebca6b;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35;
+    x ^= x >> 16;
+    while ((x & 1) && height < CSKIPLIST_MAX_HEIGHT) {
+        height++;
+        x >>= 1;
+    }
+    return height;
+}
+
+/* Logically delete a node, returning whether this call did it */
+static int cskiplist_mark(cskiplist_node *node)
+{
+    void *next;
+    int level;
+
+    for (level = node->height - 1; level > 0; level--) {
+        do {
+            next = node->next[level];
+        } while (!IS_MARKED(next)
+                 && apr_atomic_casptr(&node->next[level], MARKED(next),
+                                      next) != next);
+    }
+    for (;;) {
+        next = node->next[0];
+        if (IS_MARKED(next)) {
+            return 0;
+        }
+        if (apr_atomic_casptr(&node->next[0], MARKED(next), next) == next) {
+            return 1;
+        }
+    }
+}
+
+/* Unlink a node we marked and drop the list's reference */
+static void cskiplist_unlink(apr_cskiplist_t *csl, apr_uint32_t e,
+                             cskiplist_node *node)
+{
+    cskiplist_node *preds[CSKIPLIST_MAX_HEIGHT], *succs[CSKIPLIST_MAX_HEIGHT];
+
+    apr_atomic_dec32(&csl->size);
+    cskiplist_search(csl, node->data, node->seq, preds, succs);
+    cskiplist_release(csl, e, node);
+}
+
+static apr_status_t cskiplist_cleanup(void *data)
+{
+    apr_cskiplist_t *csl = data;
+    cskiplist_node *node, *next;
+    int i;
+
+    for (node = UNMARKED(csl->head->next[0]); node; node = next) {
+        next = UNMARKED(node->next[0]);
+        free(node);
+    }
+    for (i = 0; i < 3; ++i) {
+        cskiplist_free_chain(csl->limbo[i]);
+        csl->limbo[i] = NULL;
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_cskiplist_create(apr_cskiplist_t **csl,
+                                               apr_cskiplist_compare comp,
+                                               apr_pool_t *p)
+{
+    apr_cskiplist_t *l;
+
+    l = apr_pcalloc(p, sizeof(*l));
+    l->head = apr_pcalloc(p, APR_OFFSETOF(cskiplist_node, next)
+                             + CSKIPLIST_MAX_HEIGHT * sizeof(void *));
+    l->head->height = CSKIPLIST_MAX_HEIGHT;
+    l->compare = comp;
+    l->seed = (apr_uint32_t)(apr_uintptr_t)l;
+
+    apr_pool_cleanup_register(p, l, cskiplist_cleanup, apr_pool_cleanup_null);
+
+    *csl = l;
+    return APR_SUCCESS;
+}
+
+static apr_status_t cskiplist_insert(apr_cskiplist_t *csl, void *data,
+                                     int dups)
+{
+    cskiplist_node *preds[CSKIPLIST_MAX_HEIGHT], *succs[CSKIPLIST_MAX_HEIGHT];
+    cskiplist_node *node;
+    apr_uint32_t e;
+    int height, level;
+
+    if (!data) {
+        return APR_EINVAL;
+    }
+
+    height = cskiplist_height(csl);
+    node = malloc(APR_OFFSETOF(cskiplist_node, next)
+                  + height * sizeof(void *));
+    if (!node) {
+        return APR_ENOMEM;
+    }
+    node->data = data;
+    node->seq = apr_atomic_inc64(&csl->seq) + 1;
+    node->retired = NULL;
+    node->refs = 2;
+    node->height = height;
+
+    e = cskiplist_enter(csl);
+    for (;;) {
+        cskiplist_search(csl, data, dups ? node->seq : 0, preds, succs);
+        if (!dups && succs[0] && csl->compare(data, succs[0]->data) == 0) {
+            cskiplist_leave(csl, e);
+            free(node);
+            return APR_EEXIST;
+        }
+        for (level = 0; level < height; level++) {
+            node->next[level] = succs[level];
+        }
+        if (apr_atomic_casptr(&preds[0]->next[0], node, succs[0])
+                == succs[0]) {
+            break;
+        }
+    }
+    apr_atomic_inc32(&csl->size);
+
+    /* Linked at level 0, the node is in the list; the upper levels are
+     * only shortcuts, given up as soon as the node gets deleted.
+     */
+    for (level = 1; level < height; level++) {
+        for (;;) {
+            void *next = node->next[level];
+            if (IS_MARKED(next)) {
+                goto linked;
+            }
+            if (next != succs[level]
+                    && apr_atomic_casptr(&node->next[level], succs[level],
+                                         next) != next) {
+                goto linked;
+            }
+            if (apr_atomic_casptr(&preds[level]->next[level], node,
+                                  succs[level]) == succs[level]) {
+                break;
+            }
+            cskiplist_search(csl, data, node->seq, preds, succs);
+        }
+    }
+
+linked:
+    /* A removal may have completed its unlink while we were still linking
+     * upper levels, search again to snip those late links.
+     */
+    if (IS_MARKED(node->next[0])) {
+        cskiplist_search(csl, data, node->seq, preds, succs);
+    }
+    cskiplist_release(csl, e, node);
+    cskiplist_leave(csl, e);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_cskiplist_insert(apr_cskiplist_t *csl,
+                                               void *data)
+{
+    return cskiplist_insert(csl, data, 0);
+}
+
+APR_DECLARE(apr_status_t) apr_cskiplist_add(apr_cskiplist_t *csl,
+                                            void *data)
+{
+    return cskiplist_insert(csl, data, 1);
+}
+
+APR_DECLARE(void *) apr_cskiplist_find(apr_cskiplist_t *csl, void *data)
+{
+    cskiplist_node *node;
+    void *found = NULL;
+    apr_uint32_t e;
+
+    e = cskiplist_enter(csl);
+    node = cskiplist_seek(csl, data, 0);
+    if (node && csl->compare(data, node->data) == 0) {
+        found = node->data;
+    }
+    cskiplist_leave(csl, e);
+    return found;
+}
+
+APR_DECLARE(void *) apr_cskiplist_next(apr_cskiplist_t *csl, void *data)
+{
+    cskiplist_node *node;
+    void *found = NULL;
+    apr_uint32_t e;
+
+    e = cskiplist_enter(csl);
+    node = cskiplist_seek(csl, data, data != NULL);
+    if (node) {
+        found = node->data;
+    }
+    cskiplist_leave(csl, e);
+    return found;
+}
+
+APR_DECLARE(void *) apr_cskiplist_peek(apr_cskiplist_t *csl)
+{
+    return apr_cskiplist_next(csl, NULL);
+}
+
+APR_DECLARE(void *) apr_cskiplist_pop(apr_cskiplist_t *csl)
+{
+    cskiplist_node *node;
+    void *found = NULL;
+    apr_uint32_t e;
+
+    e = cskiplist_enter(csl);
+    for (;;) {
+        node = cskiplist_seek(csl, NULL, 0);
+        if (!node) {
+            break;
+        }
+        if (cskiplist_mark(node)) {
+            found = node->data;
+            cskiplist_unlink(csl, e, node);
+            break;
+        }
+    }
+    cskiplist_leave(csl, e);
+    return found;
+}
+
+APR_DECLARE(apr_status_t) apr_cskiplist_remove(apr_cskiplist_t *csl,
+                                               void *data, void **removed)
+{
+    cskiplist_node *node;
+    apr_status_t rv = APR_NOTFOUND;
+    apr_uint32_t e;
+
+    e = cskiplist_enter(csl);
+    for (;;) {
+        node = cskiplist_seek(csl, data, 0);
+        if (!node || csl->compare(data, node->data) != 0) {
+            break;
+        }
+        if (cskiplist_mark(node)) {
+            if (removed) {
+                *removed = node->data;
+            }
+            cskiplist_unlink(csl, e, node);
+            rv = APR_SUCCESS;
+            break;
+        }
+    }
+    cskiplist_leave(csl, e);
+    return rv;
+}
+
+APR_DECLARE(apr_size_t) apr_cskiplist_size(apr_cskiplist_t *csl)
+{
+    return apr_atomic_read32(&csl->size);
+}
@@ -77,6 +77,73 @@ static void make_array_core(apr_array_header_t *res, apr_pool_t *p,
     res->elt_size = elt_size;
     res->nelts = 0;		/* No active elements yet... */
     res->nalloc = nelts;	/* ...but this many allocated */
+    res->flags = 0;
+}
+
+/* Grow the array so that it holds at least nelts elements, doubling its
+ * size as many times as needed (or up to nelts only, when doubling would
+ * overflow).  Pool arrays copy into a new block from the pool, heap arrays
+ * are reallocated (in place when possible).  Fails, leaving the array as
+ * is, if nelts is negative or that many elements can't be addressed.
+ */
+static int array_grow(apr_array_header_t *arr, int nelts, int clear)
+{
+    int new_size = (arr->nalloc <= 0) ? 1 : arr->nalloc;
+    apr_size_t old_len, new_len;
+    char *new_data;
+
+    if (nelts < 0 || arr->elt_size <= 0) {
+        return 0;
+    }
+    if (arr->nalloc > 0 || nelts > new_size) {
+        do {
+            if (new_size > APR_INT32_MAX / 2) {
+                new_size = nelts;
+                break;
+            }
+            new_size *= 2;
+        } while (nelts > new_size);
+    }
+
+    if ((apr_size_t)new_size > APR_SIZE_MAX / (apr_size_t)arr->elt_size) {
+        return 0;
+    }
+    old_len = (apr_size_t)arr->elt_size * arr->nalloc;
+    new_len = (apr_size_t)arr->elt_size * new_size;
+
+    if (arr->flags & APR_ARRAY_HEAP) {
+        new_data = realloc(arr->elts, new_len);
+        if (new_data == NULL) {
+            apr_abortfunc_t abort_fn = apr_pool_abort_get(arr->pool);
+            if (abort_fn) {
+                abort_fn(APR_ENOMEM);
+            }
+            return 0;
+        }
+    }
+    else {
+        new_data = apr_palloc(arr->pool, new_len);
+        if (new_data == NULL) {
+            return 0;
+        }
+        memcpy(new_data, arr->elts, old_len);
+    }
+    if (clear) {
+        memset(new_data + old_len, 0, new_len - old_len);
+    }
+    arr->elts = new_data;
+    arr->nalloc = new_size;
+    return 1;
+}
+
+static apr_status_t array_heap_cleanup(void *data)
+{
+    apr_array_header_t *arr = data;
+
+    free(arr->elts);
+    arr->elts = NULL;
+    arr->nelts = arr->nalloc = 0;
+    return APR_SUCCESS;
 }
 
 APR_DECLARE(int) apr_is_empty_array(const apr_array_header_t *a)
@@ -94,6 +161,40 @@ APR_DECLARE(apr_array_header_t *) apr_array_make(apr_pool_t *p,
     return res;
 }
 
+APR_DECLARE(apr_array_header_t *) apr_array_make_ex(apr_pool_t *p,
+                                                    int nelts, int elt_size,
+                                                    int flags)
+{
+    apr_array_header_t *res;
+
+    if (!(flags & APR_ARRAY_HEAP)) {
+        return apr_array_make(p, nelts, elt_size);
+    }
+
+    if (nelts < 1) {
+        nelts = 1;
+    }
+
+    res = (apr_array_header_t *) apr_palloc(p, sizeof(apr_array_header_t));
+    res->elts = calloc(nelts, elt_size);
+    if (res->elts == NULL) {
+        apr_abortfunc_t abort_fn = apr_pool_abort_get(p);
+        if (abort_fn) {
+            abort_fn(APR_ENOMEM);
+        }
+        return NULL;
+    }
+    res->pool = p;
+    res->elt_size = elt_size;
+    res->nelts = 0;
+    res->nalloc = nelts;
+    res->flags = APR_ARRAY_HEAP;
+
+    apr_pool_cleanup_register(p, res, array_heap_cleanup,
+                              apr_pool_cleanup_null);
+    return res;
+}
+
 APR_DECLARE(void) apr_array_clear(apr_array_header_t *arr)
 {
     arr->nelts = 0;
@@ -105,68 +206,97 @@ APR_DECLARE(void *) apr_array_pop(apr_array_header_t *arr)
         return NULL;
     }
 
-    return arr->elts + (arr->elt_size * (--arr->nelts));
+    return arr->elts + ((apr_size_t)arr->elt_size * (--arr->nelts));
 }
 
 APR_DECLARE(void *) apr_array_push(apr_array_header_t *arr)
 {
     if (arr->nelts == arr->nalloc) {
-        int new_size = (arr->nalloc <= 0) ? 1 : arr->nalloc * 2;
-        char *new_data;
-
-        new_data = apr_palloc(arr->pool, arr->elt_size * new_size);
-
-        memcpy(new_data, arr->elts, arr->nalloc * arr->elt_size);
-        memset(new_data + arr->nalloc * arr->elt_size, 0,
-               arr->elt_size * (new_size - arr->nalloc));
-        arr->elts = new_data;
-        arr->nalloc = new_size;
+        if (arr->nelts == APR_INT32_MAX
+            || !array_grow(arr, arr->nelts + 1, 1)) {
+            return NULL;
+        }
     }
 
     ++arr->nelts;
-    return arr->elts + (arr->elt_size * (arr->nelts - 1));
+    return arr->elts + ((apr_size_t)arr->elt_size * (arr->nelts - 1));
 }
 
 static void *apr_array_push_noclear(apr_array_header_t *arr)
 {
     if (arr->nelts == arr->nalloc) {
-        int new_size = (arr->nalloc <= 0) ? 1 : arr->nalloc * 2;
-        char *new_data;
+        if (arr->nelts == APR_INT32_MAX
+            || !array_grow(arr, arr->nelts + 1, 0)) {
+            return NULL;
+        }
+    }
 
-        new_data = apr_palloc(arr->pool, arr->elt_size * new_size);
+    ++arr->nelts;
+    return arr->elts + ((apr_size_t)arr->elt_size * (arr->nelts - 1));
+}
+
+APR_DECLARE(void *) apr_array_push_n(apr_array_header_t *arr, int nelts)
+{
+    char *first;
 
-        memcpy(new_data, arr->elts, arr->nalloc * arr->elt_size);
-        arr->elts = new_data;
-        arr->nalloc = new_size;
+    if (nelts < 0 || nelts > APR_INT32_MAX - arr->nelts) {
+        return NULL;
+    }
+    if (arr->nelts + nelts > arr->nalloc) {
+        if (!array_grow(arr, arr->nelts + nelts, 0)) {
+            return NULL;
+        }
     }
 
-    ++arr->nelts;
-    return arr->elts + (arr->elt_size * (arr->nelts - 1));
+    /* the slots may be stale, after apr_array_pop() or apr_array_clear() */
+    first = arr->elts + ((apr_size_t)arr->elt_size * arr->nelts);
+    memset(first, 0, (apr_size_t)arr->elt_size * nelts);
+    arr->nelts += nelts;
+    return first;
 }
 
-APR_DECLARE(void) apr_array_cat(apr_array_header_t *dst,
-			       const apr_array_header_t *src)
+APR_DECLARE(apr_status_t) apr_array_reserve(apr_array_header_t *arr,
+                                            int nelts)
 {
-    int elt_size = dst->elt_size;
+    if (nelts < 0) {
+        return APR_EINVAL;
+    }
+    if (nelts > arr->nalloc && !array_grow(arr, nelts, 1)) {
+        return APR_ENOMEM;
+    }
+    return APR_SUCCESS;
+}
 
-    if (dst->nelts + src->nelts > dst->nalloc) {
-	int new_size = (dst->nalloc <= 0) ? 1 : dst->nalloc * 2;
-	char *new_data;
+APR_DECLARE(void *) apr_array_move_out(apr_array_header_t *arr, int *nelts)
+{
+    void *elts = arr->elts;
 
-	while (dst->nelts + src->nelts > new_size) {
-	    new_size *= 2;
-	}
+    if (nelts) {
+        *nelts = arr->nelts;
+    }
+    arr->elts = NULL;
+    arr->nelts = arr->nalloc = 0;
+    return elts;
+}
 
-	new_data = apr_pcalloc(dst->pool, elt_size * new_size);
-	memcpy(new_data, dst->elts, dst->nalloc * elt_size);
+APR_DECLARE(apr_status_t) apr_array_cat(apr_array_header_t *dst,
+                                        const apr_array_header_t *src)
+{
+    apr_size_t elt_size = dst->elt_size;
 
-	dst->elts = new_data;
-	dst->nalloc = new_size;
+    if (src->nelts > APR_INT32_MAX - dst->nelts) {
+        return APR_ENOMEM;
+    }
+    if (dst->nelts + src->nelts > dst->nalloc) {
+	if (!array_grow(dst, dst->nelts + src->nelts, 1)) {
+	    return APR_ENOMEM;
+	}
     }
 
     memcpy(dst->elts + dst->nelts * elt_size, src->elts,
 	   elt_size * src->nelts);
     dst->nelts += src->nelts;
+    return APR_SUCCESS;
 }
 
 APR_DECLARE(apr_array_header_t *) apr_array_copy(apr_pool_t *p,
@@ -197,6 +327,7 @@ static APR_INLINE void copy_array_hdr_core(apr_array_header_t *res,
     res->elt_size = arr->elt_size;
     res->nelts = arr->nelts;
     res->nalloc = arr->nelts;	/* Force overflow on push */
+    res->flags = 0;		/* ...into a block of our own */
 }
 
 APR_DECLARE(apr_array_header_t *)
@@ -220,7 +351,9 @@ APR_DECLARE(apr_array_header_t *)
 {
     apr_array_header_t *res = apr_array_copy_hdr(p, first);
 
-    apr_array_cat(res, second);
+    if (apr_array_cat(res, second) != APR_SUCCESS) {
+        return NULL;
+    }
     return res;
 }
 
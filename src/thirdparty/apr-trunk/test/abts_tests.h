@@ -95,7 +95,16 @@ const struct testlist {
     {testsiphash},
     {testjson},
     {testjose},
-    {testldap}
+    {testldap},
+    {testbtree},
+    {testcskiplist},
+    {testthreadpool},
+    {testspscqueue},
+    {testmpscqueue},
+    {testepoch},
+    {teststats},
+    {testaio},
+    {testreactor}
 };
 
 #endif /* APR_TEST_INCLUDES */
@@ -0,0 +1,452 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testutil.h"
+#include "apr_aio.h"
+#include "apr_file_io.h"
+#include "apr_network_io.h"
+#include "apr_strings.h"
+
+#define AIO_SIZE 16
+#define FILENAME "data/testaio.txt"
+#define TESTSTR "hello aio world"
+
+static apr_aio_t *aio = NULL;
+static apr_socket_t *listener, *server, *client;
+static apr_file_t *file;
+static char regbuf[256];
+
+/* Poll until one completion without callback comes */
+static const apr_aio_completion_t *wait_one(abts_case *tc)
+{
+    const apr_aio_completion_t *c;
+    apr_int32_t num = 0;
+    apr_status_t rv;
+    int i;
+
+    for (i = 0; i < 50 && !num; ++i) {
+        rv = apr_aio_poll(aio, apr_time_from_msec(100), &num, &c);
+        ABTS_ASSERT(tc, "unexpected poll status",
+                    rv == APR_SUCCESS || APR_STATUS_IS_TIMEUP(rv));
+    }
+    ABTS_INT_EQUAL(tc, 1, num);
+    return num == 1 ? c : NULL;
+}
+
+static apr_status_t accepted_cb(void *baton, apr_aio_completion_t *c)
+{
+    apr_socket_t **sock = baton;
+
+    if (c->status == APR_SUCCESS) {
+        *sock = c->accepted;
+    }
+    return c->status;
+}
+
+static apr_status_t recv_cb(void *baton, apr_aio_completion_t *c)
+{
+    apr_aio_completion_t *out = baton;
+
+    *out = *c;
+    return APR_SUCCESS;
+}
+
+static void create_aio(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+
+    rv = apr_aio_create(&aio, AIO_SIZE, p);
+    if (rv == APR_ENOTIMPL) {
+        aio = NULL;
+        ABTS_NOT_IMPL(tc, "apr_aio (io_uring) not available");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "Couldn't create apr_aio_t", rv);
+}
+
+static void aio_connect(abts_case *tc, void *data)
+{
+    const apr_aio_completion_t *c;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+
+    if (!aio) {
+        return;
+    }
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't get address", rv);
+    rv = apr_socket_create(&listener, sa->family, SOCK_STREAM,
+                           APR_PROTO_TCP, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't create listener", rv);
+    rv = apr_socket_bind(listener, sa);
+    APR_ASSERT_SUCCESS(tc, "Couldn't bind listener", rv);
+    rv = apr_socket_listen(listener, 5);
+    APR_ASSERT_SUCCESS(tc, "Couldn't listen", rv);
+    rv = apr_socket_addr_get(&sa, APR_LOCAL, listener);
+    APR_ASSERT_SUCCESS(tc, "Couldn't get listener address", rv);
+
+    server = NULL;
+    rv = apr_aio_accept(aio, listener, p, accepted_cb, &server);
+    APR_ASSERT_SUCCESS(tc, "Couldn't queue accept", rv);
+
+    rv = apr_socket_create(&client, sa->family, SOCK_STREAM,
+                           APR_PROTO_TCP, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't create client", rv);
+    rv = apr_aio_connect(aio, client, sa, NULL, NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't queue connect", rv);
+
+    c = wait_one(tc);
+    ABTS_PTR_NOTNULL(tc, c);
+    if (c) {
+        ABTS_INT_EQUAL(tc, APR_AIO_CONNECT, c->op);
+        APR_ASSERT_SUCCESS(tc, "connect failed", c->status);
+        ABTS_PTR_EQUAL(tc, client, c->sock);
+    }
+
+    while (!server) {
+        apr_int32_t num;
+
+        rv = apr_aio_poll(aio, apr_time_from_msec(100), &num, NULL);
+        if (rv != APR_SUCCESS && !APR_STATUS_IS_TIMEUP(rv)) {
+            APR_ASSERT_SUCCESS(tc, "accept failed", rv);
+            break;
+        }
+    }
+    ABTS_PTR_NOTNULL(tc, server);
+    if (server) {
+        apr_sockaddr_t *peer;
+        apr_port_t port;
+
+        rv = apr_socket_addr_get(&peer, APR_REMOTE, server);
+        APR_ASSERT_SUCCESS(tc, "Couldn't get peer address", rv);
+        rv = apr_socket_addr_get(&sa, APR_LOCAL, client);
+        APR_ASSERT_SUCCESS(tc, "Couldn't get client address", rv);
+        port = sa->port;
+        ABTS_INT_EQUAL(tc, port, peer->port);
+    }
+}
+
+static void aio_send_recv(abts_case *tc, void *data)
+{
+    const apr_aio_completion_t *c;
+    apr_aio_completion_t done;
+    char buf[64];
+    apr_status_t rv;
+    apr_int32_t num;
+
+    if (!aio || !server) {
+        return;
+    }
+
+    rv = apr_aio_send(aio, client, TESTSTR, strlen(TESTSTR), NULL, NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't queue send", rv);
+    c = wait_one(tc);
+    if (c) {
+        ABTS_INT_EQUAL(tc, APR_AIO_SEND, c->op);
+        APR_ASSERT_SUCCESS(tc, "send failed", c->status);
+        ABTS_SIZE_EQUAL(tc, strlen(TESTSTR), c->len);
+    }
+
+    memset(&done, 0, sizeof(done));
+    memset(buf, 0, sizeof(buf));
+    rv = apr_aio_recv(aio, server, buf, sizeof(buf) - 1, recv_cb, &done);
+    APR_ASSERT_SUCCESS(tc, "Couldn't queue recv", rv);
+    rv = apr_aio_poll(aio, apr_time_from_sec(5), &num, NULL);
+    APR_ASSERT_SUCCESS(tc, "poll failed", rv);
+    ABTS_INT_EQUAL(tc, 0, num);
+    ABTS_INT_EQUAL(tc, APR_AIO_RECV, done.op);
+    APR_ASSERT_SUCCESS(tc, "recv failed", done.status);
+    ABTS_SIZE_EQUAL(tc, strlen(TESTSTR), done.len);
+    ABTS_PTR_EQUAL(tc, buf, done.buf);
+    ABTS_STR_EQUAL(tc, TESTSTR, buf);
+
+    /* nothing in flight */
+    rv = apr_aio_poll(aio, 0, &num, NULL);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+}
+
+static void aio_registered(abts_case *tc, void *data)
+{
+    const apr_aio_completion_t *c;
+    struct iovec vec;
+    apr_status_t rv;
+
+    if (!aio || !server) {
+        return;
+    }
+
+    vec.iov_base = regbuf;
+    vec.iov_len = sizeof(regbuf);
+    rv = apr_aio_buffers_register(aio, &vec, 1);
+    APR_ASSERT_SUCCESS(tc, "Couldn't register buffers", rv);
+    rv = apr_aio_buffers_register(aio, &vec, 1);
+    ABTS_INT_EQUAL(tc, APR_EEXIST, rv);
+
+    rv = apr_aio_socket_register(aio, server);
+    APR_ASSERT_SUCCESS(tc, "Couldn't register socket", rv);
+    rv = apr_aio_socket_register(aio, server);
+    ABTS_INT_EQUAL(tc, APR_EEXIST, rv);
+    rv = apr_aio_socket_register(aio, client);
+    APR_ASSERT_SUCCESS(tc, "Couldn't register socket", rv);
+
+    strcpy(regbuf, TESTSTR);
+    rv = apr_aio_send(aio, client, regbuf, strlen(TESTSTR), NULL, NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't queue send", rv);
+    c = wait_one(tc);
+    if (c) {
+        APR_ASSERT_SUCCESS(tc, "send failed", c->status);
+        ABTS_SIZE_EQUAL(tc, strlen(TESTSTR), c->len);
+    }
+
+    memset(regbuf + 128, 0, 128);
+    rv = apr_aio_recv(aio, server, regbuf + 128, 127, NULL, NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't queue recv", rv);
+    c = wait_one(tc);
+    if (c) {
+        APR_ASSERT_SUCCESS(tc, "recv failed", c->status);
+        ABTS_SIZE_EQUAL(tc, strlen(TESTSTR), c->len);
+        ABTS_STR_EQUAL(tc, TESTSTR, regbuf + 128);
+    }
+
+    rv = apr_aio_socket_unregister(aio, client);
+    APR_ASSERT_SUCCESS(tc, "Couldn't unregister socket", rv);
+    rv = apr_aio_socket_unregister(aio, client);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+    rv = apr_aio_socket_unregister(aio, server);
+    APR_ASSERT_SUCCESS(tc, "Couldn't unregister socket", rv);
+}
+
+static void aio_eof(abts_case *tc, void *data)
+{
+    const apr_aio_completion_t *c;
+    char buf[16];
+    apr_status_t rv;
+
+    if (!aio || !server) {
+        return;
+    }
+
+    rv = apr_aio_recv(aio, server, buf, sizeof(buf), NULL, NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't queue recv", rv);
+    rv = apr_aio_submit(aio);
+    APR_ASSERT_SUCCESS(tc, "Couldn't submit", rv);
+    apr_socket_close(client);
+
+    c = wait_one(tc);
+    if (c) {
+        ABTS_INT_EQUAL(tc, APR_EOF, c->status);
+        ABTS_SIZE_EQUAL(tc, 0, c->len);
+    }
+
+    apr_socket_close(server);
+    apr_socket_close(listener);
+}
+
+static void aio_file(abts_case *tc, void *data)
+{
+    const apr_aio_completion_t *c;
+    apr_file_t *buffered;
+    char buf[32];
+    apr_status_t rv;
+
+    if (!aio) {
+        return;
+    }
+
+    rv = apr_file_open(&file, FILENAME, APR_FOPEN_CREATE | APR_FOPEN_READ
+                       | APR_FOPEN_WRITE | APR_FOPEN_TRUNCATE,
+                       APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't open file", rv);
+
+    rv = apr_aio_write(aio, file, TESTSTR, strlen(TESTSTR), 0, NULL, NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't queue write", rv);
+    c = wait_one(tc);
+    if (c) {
+        ABTS_INT_EQUAL(tc, APR_AIO_WRITE, c->op);
+        APR_ASSERT_SUCCESS(tc, "write failed", c->status);
+        ABTS_SIZE_EQUAL(tc, strlen(TESTSTR), c->len);
+        ABTS_PTR_EQUAL(tc, file, c->file);
+    }
+
+    memset(buf, 0, sizeof(buf));
+    rv = apr_aio_read(aio, file, buf, sizeof(buf) - 1, 6, NULL, NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't queue read", rv);
+    c = wait_one(tc);
+    if (c) {
+        ABTS_INT_EQUAL(tc, APR_AIO_READ, c->op);
+        APR_ASSERT_SUCCESS(tc, "read failed", c->status);
+        ABTS_SIZE_EQUAL(tc, strlen(TESTSTR) - 6, c->len);
+        ABTS_STR_EQUAL(tc, TESTSTR + 6, buf);
+    }
+
+    rv = apr_aio_read(aio, file, buf, sizeof(buf), 100, NULL, NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't queue read", rv);
+    c = wait_one(tc);
+    if (c) {
+        ABTS_INT_EQUAL(tc, APR_EOF, c->status);
+    }
+
+    rv = apr_file_open(&buffered, FILENAME, APR_FOPEN_READ
+                       | APR_FOPEN_BUFFERED, APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't open file", rv);
+    rv = apr_aio_read(aio, buffered, buf, sizeof(buf), 0, NULL, NULL);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    apr_file_close(buffered);
+}
+
+static void aio_file_registered(abts_case *tc, void *data)
+{
+    const apr_aio_completion_t *c;
+    apr_status_t rv;
+
+    if (!aio || !file) {
+        return;
+    }
+
+    rv = apr_aio_file_register(aio, file);
+    APR_ASSERT_SUCCESS(tc, "Couldn't register file", rv);
+
+    /* regbuf is still registered */
+    strcpy(regbuf, "HELLO");
+    rv = apr_aio_write(aio, file, regbuf, 5, 0, NULL, NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't queue write", rv);
+    c = wait_one(tc);
+    if (c) {
+        APR_ASSERT_SUCCESS(tc, "write failed", c->status);
+        ABTS_SIZE_EQUAL(tc, 5, c->len);
+    }
+
+    memset(regbuf, 0, sizeof(regbuf));
+    rv = apr_aio_read(aio, file, regbuf, sizeof(regbuf), 0, NULL, NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't queue read", rv);
+    c = wait_one(tc);
+    if (c) {
+        APR_ASSERT_SUCCESS(tc, "read failed", c->status);
+        ABTS_SIZE_EQUAL(tc, strlen(TESTSTR), c->len);
+        ABTS_STR_EQUAL(tc, "HELLO aio world", regbuf);
+    }
+
+    rv = apr_aio_file_unregister(aio, file);
+    APR_ASSERT_SUCCESS(tc, "Couldn't unregister file", rv);
+    rv = apr_aio_buffers_unregister(aio);
+    APR_ASSERT_SUCCESS(tc, "Couldn't unregister buffers", rv);
+    rv = apr_aio_buffers_unregister(aio);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+}
+
+static void aio_full(abts_case *tc, void *data)
+{
+    static char bufs[AIO_SIZE][4];
+    apr_int32_t n = 0;
+    apr_status_t rv;
+    int i;
+
+    if (!aio || !file) {
+        return;
+    }
+
+    for (i = 0; i < AIO_SIZE; ++i) {
+        rv = apr_aio_read(aio, file, bufs[i], sizeof(bufs[i]), i % 8,
+                          NULL, NULL);
+        APR_ASSERT_SUCCESS(tc, "Couldn't queue read", rv);
+    }
+    rv = apr_aio_read(aio, file, bufs[0], sizeof(bufs[0]), 0, NULL, NULL);
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, rv);
+
+    for (i = 0; i < 50 && n < AIO_SIZE; ++i) {
+        const apr_aio_completion_t *c;
+        apr_int32_t num, j;
+
+        rv = apr_aio_poll(aio, apr_time_from_msec(100), &num, &c);
+        for (j = 0; j < num; ++j) {
+            APR_ASSERT_SUCCESS(tc, "read failed", c[j].status);
+        }
+        n += num;
+    }
+    ABTS_INT_EQUAL(tc, AIO_SIZE, n);
+    ABTS_INT_EQUAL(tc, 'H', bufs[0][0]);
+    ABTS_INT_EQUAL(tc, 'a', bufs[6][0]);
+
+    apr_file_close(file);
+    apr_file_remove(FILENAME, p);
+}
+
+static apr_status_t write_on_cleanup(void *data)
+{
+    apr_size_t n = 1;
+
+    apr_file_write(data, "x", &n);
+    return APR_SUCCESS;
+}
+
+static void aio_pool_cleanup(abts_case *tc, void *data)
+{
+    apr_pool_t *pool, *subpool;
+    apr_file_t *in, *out;
+    apr_aio_t *aio2;
+    apr_size_t n = 1;
+    apr_status_t rv;
+    char c = 0;
+
+    if (!aio) {
+        return;
+    }
+
+    rv = apr_file_pipe_create(&in, &out, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't create pipe", rv);
+
+    /* a read in flight into a subpool's buffer, which writes to the pipe
+     * once cleared: cancelled first, the read must not take the byte.
+     */
+    apr_pool_create(&pool, p);
+    rv = apr_aio_create(&aio2, 1, pool);
+    APR_ASSERT_SUCCESS(tc, "Couldn't create apr_aio_t", rv);
+    apr_pool_create(&subpool, pool);
+    rv = apr_aio_read(aio2, in, apr_palloc(subpool, 16), 16, -1, NULL, NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't queue read", rv);
+    rv = apr_aio_submit(aio2);
+    APR_ASSERT_SUCCESS(tc, "Couldn't submit", rv);
+    apr_pool_cleanup_register(subpool, out, write_on_cleanup,
+                              apr_pool_cleanup_null);
+    apr_pool_destroy(pool);
+
+    rv = apr_file_pipe_timeout_set(in, 0);
+    APR_ASSERT_SUCCESS(tc, "Couldn't make the pipe non-blocking", rv);
+    rv = apr_file_read(in, &c, &n);
+    APR_ASSERT_SUCCESS(tc, "The byte was read by the cancelled op", rv);
+    ABTS_INT_EQUAL(tc, 'x', c);
+
+    apr_file_close(in);
+    apr_file_close(out);
+}
+
+abts_suite *testaio(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, create_aio, NULL);
+    abts_run_test(suite, aio_connect, NULL);
+    abts_run_test(suite, aio_send_recv, NULL);
+    abts_run_test(suite, aio_registered, NULL);
+    abts_run_test(suite, aio_eof, NULL);
+    abts_run_test(suite, aio_file, NULL);
+    abts_run_test(suite, aio_file_registered, NULL);
+    abts_run_test(suite, aio_full, NULL);
+    abts_run_test(suite, aio_pool_cleanup, NULL);
+
+    return suite;
+}
@@ -346,6 +346,112 @@ static void test_inc_neg164(abts_case *tc, void *data)
     ABTS_ASSERT(tc, str, y64 == 0);
 }
 
+static void test_bitwise32(abts_case *tc, void *data)
+{
+    apr_uint32_t y32;
+
+    apr_atomic_set32(&y32, 0x0f0);
+    ABTS_UINT_EQUAL(tc, 0x0f0, apr_atomic_or32(&y32, 0x00f));
+    ABTS_UINT_EQUAL(tc, 0x0ff, y32);
+    ABTS_UINT_EQUAL(tc, 0x0ff, apr_atomic_and32(&y32, 0xf0f));
+    ABTS_UINT_EQUAL(tc, 0x00f, y32);
+    ABTS_UINT_EQUAL(tc, 0x00f, apr_atomic_or32_ex(&y32, 0xf00,
+                                                  APR_ATOMIC_RELEASE));
+    ABTS_UINT_EQUAL(tc, 0xf0f, apr_atomic_and32_ex(&y32, 0x0f0,
+                                                   APR_ATOMIC_ACQUIRE));
+    ABTS_UINT_EQUAL(tc, 0, y32);
+}
+
+static void test_bitwise64(abts_case *tc, void *data)
+{
+    apr_uint64_t y64, hi = APR_UINT64_C(0x1000000000000000);
+
+    apr_atomic_set64(&y64, 1);
+    ABTS_ULLONG_EQUAL(tc, 1, apr_atomic_or64(&y64, hi));
+    ABTS_ULLONG_EQUAL(tc, hi | 1, y64);
+    ABTS_ULLONG_EQUAL(tc, hi | 1, apr_atomic_and64(&y64, hi));
+    ABTS_ULLONG_EQUAL(tc, hi, y64);
+    ABTS_ULLONG_EQUAL(tc, hi, apr_atomic_or64_ex(&y64, 2,
+                                                 APR_ATOMIC_RELAXED));
+    ABTS_ULLONG_EQUAL(tc, hi | 2, apr_atomic_and64_ex(&y64, 2,
+                                                      APR_ATOMIC_ACQ_REL));
+    ABTS_ULLONG_EQUAL(tc, 2, y64);
+}
+
+static void test_ordered32(abts_case *tc, void *data)
+{
+    apr_atomic_order_e order;
+    apr_uint32_t y32;
+    int x;
+    void *ptr = NULL;
+
+    for (order = APR_ATOMIC_RELAXED; order <= APR_ATOMIC_SEQ_CST; order++) {
+        apr_atomic_set32_ex(&y32, 10, order);
+        ABTS_UINT_EQUAL(tc, 10, apr_atomic_read32_ex(&y32, order));
+        ABTS_UINT_EQUAL(tc, 10, apr_atomic_add32_ex(&y32, 5, order));
+        ABTS_UINT_EQUAL(tc, 15, apr_atomic_cas32_ex(&y32, 20, 15, order));
+        ABTS_UINT_EQUAL(tc, 20, apr_atomic_cas32_ex(&y32, 30, 15, order));
+        ABTS_UINT_EQUAL(tc, 20, apr_atomic_xchg32_ex(&y32, 1, order));
+        ABTS_UINT_EQUAL(tc, 1, apr_atomic_read32(&y32));
+
+        ABTS_PTR_EQUAL(tc, NULL, apr_atomic_casptr_ex(&ptr, &x, NULL, order));
+        ABTS_PTR_EQUAL(tc, &x, apr_atomic_casptr_ex(&ptr, NULL, &y32, order));
+        ABTS_PTR_EQUAL(tc, &x, apr_atomic_xchgptr_ex(&ptr, NULL, order));
+        ABTS_PTR_EQUAL(tc, NULL, ptr);
+    }
+}
+
+static void test_ordered64(abts_case *tc, void *data)
+{
+    apr_atomic_order_e order;
+    apr_uint64_t y64, big = APR_UINT64_C(0x100000000);
+
+    for (order = APR_ATOMIC_RELAXED; order <= APR_ATOMIC_SEQ_CST; order++) {
+        apr_atomic_set64_ex(&y64, big, order);
+        ABTS_ULLONG_EQUAL(tc, big, apr_atomic_read64_ex(&y64, order));
+        ABTS_ULLONG_EQUAL(tc, big, apr_atomic_add64_ex(&y64, big, order));
+        ABTS_ULLONG_EQUAL(tc, 2 * big,
+                          apr_atomic_cas64_ex(&y64, 3 * big, 2 * big, order));
+        ABTS_ULLONG_EQUAL(tc, 3 * big,
+                          apr_atomic_cas64_ex(&y64, 0, 2 * big, order));
+        ABTS_ULLONG_EQUAL(tc, 3 * big, apr_atomic_xchg64_ex(&y64, 1, order));
+        ABTS_ULLONG_EQUAL(tc, 1, apr_atomic_read64(&y64));
+    }
+}
+
+static void test_castagptr(abts_case *tc, void *data)
+{
+    apr_atomic_tagptr_t tp, cmp, with;
+    int x;
+
+    ABTS_ASSERT(tc, "apr_atomic_tagptr_t is misaligned",
+                ((apr_uintptr_t)&tp % (2 * sizeof(void *))) == 0);
+
+    tp.ptr = NULL;
+    tp.tag = 0;
+    cmp = tp;
+    with.ptr = &x;
+    with.tag = 1;
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_castagptr(&tp, &cmp, &with));
+    ABTS_PTR_EQUAL(tc, &x, tp.ptr);
+    ABTS_ULLONG_EQUAL(tc, 1, tp.tag);
+
+    /* same pointer, stale tag: fails and gets the current value */
+    cmp.ptr = &x;
+    cmp.tag = 0;
+    with.ptr = NULL;
+    with.tag = 2;
+    ABTS_INT_EQUAL(tc, 0, apr_atomic_castagptr(&tp, &cmp, &with));
+    ABTS_PTR_EQUAL(tc, &x, cmp.ptr);
+    ABTS_ULLONG_EQUAL(tc, 1, cmp.tag);
+    ABTS_PTR_EQUAL(tc, &x, tp.ptr);
+    ABTS_ULLONG_EQUAL(tc, 1, tp.tag);
+
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_castagptr(&tp, &cmp, &with));
+    ABTS_PTR_EQUAL(tc, NULL, tp.ptr);
+    ABTS_ULLONG_EQUAL(tc, 2, tp.tag);
+}
+
 
 #if APR_HAS_THREADS
 
@@ -928,6 +1034,100 @@ static void test_atomics_threaded_setread64(abts_case *tc, void *data)
     apr_thread_join(&retval, thread);
 }
 
+/* A lock-free stack (Treiber's), whose pops would be subject to ABA
+ * without the tag: every thread pops nodes and pushes them back, which
+ * must neither lose nor duplicate any of them.
+ */
+#define STACK_THREADS 4
+#define STACK_NODES 16
+#define STACK_ITERATIONS 100000
+
+typedef struct stack_node_t {
+    struct stack_node_t *volatile next;
+} stack_node_t;
+
+static apr_atomic_tagptr_t stack_top;
+static stack_node_t stack_nodes[STACK_NODES];
+
+static void stack_push(stack_node_t *node)
+{
+    apr_atomic_tagptr_t cmp, with;
+
+    cmp = stack_top;
+    do {
+        node->next = cmp.ptr;
+        with.ptr = node;
+        with.tag = cmp.tag + 1;
+    } while (!apr_atomic_castagptr(&stack_top, &cmp, &with));
+}
+
+static stack_node_t *stack_pop(void)
+{
+    apr_atomic_tagptr_t cmp, with;
+
+    cmp = stack_top;
+    do {
+        if (!cmp.ptr) {
+            return NULL;
+        }
+        with.ptr = ((stack_node_t *)cmp.ptr)->next;
+        with.tag = cmp.tag + 1;
+    } while (!apr_atomic_castagptr(&stack_top, &cmp, &with));
+
+    return cmp.ptr;
+}
+
+static void *APR_THREAD_FUNC stack_func(apr_thread_t *thd, void *data)
+{
+    stack_node_t *mine[2];
+    int i;
+
+    for (i = 0; i < STACK_ITERATIONS; i++) {
+        mine[0] = stack_pop();
+        mine[1] = stack_pop();
+        if (mine[1]) {
+            stack_push(mine[1]);
+        }
+        if (mine[0]) {
+            stack_push(mine[0]);
+        }
+    }
+
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+
+static void test_atomics_tagged_stack(abts_case *tc, void *data)
+{
+    apr_thread_t *thread[STACK_THREADS];
+    stack_node_t *node;
+    apr_status_t rv, retval;
+    int i, count[STACK_NODES] = { 0 }, n = 0;
+
+    stack_top.ptr = NULL;
+    stack_top.tag = 0;
+    for (i = 0; i < STACK_NODES; i++) {
+        stack_push(&stack_nodes[i]);
+    }
+
+    for (i = 0; i < STACK_THREADS; i++) {
+        rv = apr_thread_create(&thread[i], NULL, stack_func, NULL, p);
+        APR_ASSERT_SUCCESS(tc, "Failed creating thread", rv);
+    }
+    for (i = 0; i < STACK_THREADS; i++) {
+        apr_thread_join(&retval, thread[i]);
+    }
+
+    while ((node = stack_pop()) != NULL && n <= STACK_NODES) {
+        count[node - stack_nodes]++;
+        n++;
+    }
+    ABTS_INT_EQUAL(tc, STACK_NODES, n);
+    for (i = 0; i < STACK_NODES; i++) {
+        ABTS_INT_EQUAL(tc, 1, count[i]);
+    }
+}
+
 #endif /* !APR_HAS_THREADS */
 
 abts_suite *testatomic(abts_suite *suite)
@@ -962,6 +1162,11 @@ abts_suite *testatomic(abts_suite *suite)
     abts_run_test(suite, test_set_add_inc_sub64, NULL);
     abts_run_test(suite, test_wrap_zero64, NULL);
     abts_run_test(suite, test_inc_neg164, NULL);
+    abts_run_test(suite, test_bitwise32, NULL);
+    abts_run_test(suite, test_bitwise64, NULL);
+    abts_run_test(suite, test_ordered32, NULL);
+    abts_run_test(suite, test_ordered64, NULL);
+    abts_run_test(suite, test_castagptr, NULL);
 
 #if APR_HAS_THREADS
     abts_run_test(suite, test_atomics_threaded, NULL);
@@ -971,6 +1176,7 @@ abts_suite *testatomic(abts_suite *suite)
     abts_run_test(suite, test_atomics_busyloop_threaded64, NULL);
     abts_run_test(suite, test_atomics_threaded_setread64, &atomic_ops64);
     abts_run_test(suite, test_atomics_threaded_setread64, &atomic_pad.ops64);
+    abts_run_test(suite, test_atomics_tagged_stack, NULL);
 #endif
 
     return suite;
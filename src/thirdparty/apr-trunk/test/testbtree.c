@@ -0,0 +1,405 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testutil.h"
+#include "apr.h"
+#include "apr_strings.h"
+#include "apr_general.h"
+#include "apr_pools.h"
+#include "apr_btree.h"
+#if APR_HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
+static apr_pool_t *ptmp = NULL;
+
+typedef struct elem {
+    int a;
+    int b;
+} elem;
+
+static int comp(void *a, void *b)
+{
+    return *((int *)a) - *((int *)b);
+}
+
+static int acomp(void *a, void *b)
+{
+    return ((elem *)a)->a - ((elem *)b)->a;
+}
+
+static int bcomp(void *a, void *b)
+{
+    return ((elem *)a)->b - ((elem *)b)->b;
+}
+
+/* Walk the tree both ways, checking order and size */
+static void btree_check(abts_case *tc, apr_btree_t *bt,
+                        apr_btree_compare cmp)
+{
+    apr_btree_iter_t iter;
+    apr_size_t count = 0;
+    void *prev = NULL, *elt;
+
+    for (elt = apr_btree_first_compare(bt, &iter, cmp); elt;
+         elt = apr_btree_next(&iter)) {
+        if (prev) {
+            ABTS_TRUE(tc, cmp(prev, elt) <= 0);
+        }
+        prev = elt;
+        count++;
+    }
+    ABTS_SIZE_EQUAL(tc, apr_btree_size(bt), count);
+
+    prev = NULL;
+    for (elt = apr_btree_last_compare(bt, &iter, cmp); elt;
+         elt = apr_btree_previous(&iter)) {
+        if (prev) {
+            ABTS_TRUE(tc, cmp(elt, prev) <= 0);
+        }
+        prev = elt;
+        count--;
+    }
+    ABTS_SIZE_EQUAL(tc, 0, count);
+}
+
+static void btree_basic(abts_case *tc, void *data)
+{
+    apr_btree_t *bt;
+    apr_btree_iter_t iter;
+    const char *val;
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_create(&bt, ptmp));
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_btree_insert(bt, "baton"));
+    apr_btree_set_compare(bt, (apr_btree_compare)strcmp,
+                              (apr_btree_compare)strcmp);
+
+    ABTS_PTR_EQUAL(tc, NULL, apr_btree_peek(bt));
+    ABTS_PTR_EQUAL(tc, NULL, apr_btree_find(bt, "baton", NULL));
+    ABTS_INT_EQUAL(tc, 0, apr_btree_height(bt));
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_insert(bt, "baton"));
+    ABTS_INT_EQUAL(tc, APR_EEXIST, apr_btree_insert(bt, "baton"));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_insert(bt, "abc"));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_insert(bt, "zzz"));
+    ABTS_SIZE_EQUAL(tc, 3, apr_btree_size(bt));
+    ABTS_INT_EQUAL(tc, 1, apr_btree_height(bt));
+
+    val = apr_btree_find(bt, "baton", &iter);
+    ABTS_STR_EQUAL(tc, "baton", val);
+    ABTS_STR_EQUAL(tc, "baton", apr_btree_element(&iter));
+    ABTS_STR_EQUAL(tc, "zzz", apr_btree_next(&iter));
+    ABTS_PTR_EQUAL(tc, NULL, apr_btree_next(&iter));
+    ABTS_PTR_EQUAL(tc, NULL, apr_btree_find(bt, "keynotthere", &iter));
+    ABTS_PTR_EQUAL(tc, NULL, apr_btree_element(&iter));
+
+    ABTS_STR_EQUAL(tc, "baton", apr_btree_lower_bound(bt, "b", NULL));
+    ABTS_PTR_EQUAL(tc, NULL, apr_btree_lower_bound(bt, "zzzz", NULL));
+
+    ABTS_STR_EQUAL(tc, "abc", apr_btree_pop(bt, NULL));
+    ABTS_INT_EQUAL(tc, 1, apr_btree_remove(bt, "zzz", NULL));
+    ABTS_INT_EQUAL(tc, 0, apr_btree_remove(bt, "zzz", NULL));
+    ABTS_STR_EQUAL(tc, "baton", apr_btree_peek(bt));
+    ABTS_SIZE_EQUAL(tc, 1, apr_btree_size(bt));
+
+    apr_btree_remove_all(bt, NULL);
+    ABTS_SIZE_EQUAL(tc, 0, apr_btree_size(bt));
+    ABTS_PTR_EQUAL(tc, NULL, apr_btree_peek(bt));
+
+    apr_pool_clear(ptmp);
+}
+
+#define NUM_ELTS (10000)
+
+static void btree_ordered(abts_case *tc, void *data)
+{
+    apr_btree_t *bt;
+    int *vals, *val, i;
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_create(&bt, ptmp));
+    apr_btree_set_compare(bt, comp, comp);
+
+    vals = apr_palloc(ptmp, NUM_ELTS * sizeof(int));
+    for (i = 0; i < NUM_ELTS; i++) {
+        vals[i] = i;
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_insert(bt, &vals[i]));
+    }
+    ABTS_SIZE_EQUAL(tc, NUM_ELTS, apr_btree_size(bt));
+    ABTS_TRUE(tc, apr_btree_height(bt) > 1);
+    btree_check(tc, bt, comp);
+
+    /* remove every other element, descending */
+    for (i = NUM_ELTS - 1; i >= 0; i -= 2) {
+        ABTS_INT_EQUAL(tc, 1, apr_btree_remove(bt, &vals[i], NULL));
+    }
+    btree_check(tc, bt, comp);
+    for (i = 0; i < NUM_ELTS; i++) {
+        val = apr_btree_find(bt, &vals[i], NULL);
+        if (i % 2) {
+            ABTS_PTR_EQUAL(tc, NULL, val);
+        }
+        else {
+            ABTS_PTR_EQUAL(tc, &vals[i], val);
+        }
+    }
+
+    i = 0;
+    while ((val = apr_btree_pop(bt, NULL))) {
+        ABTS_INT_EQUAL(tc, i, *val);
+        i += 2;
+    }
+    ABTS_INT_EQUAL(tc, NUM_ELTS, i);
+    ABTS_INT_EQUAL(tc, 0, apr_btree_height(bt));
+
+    apr_pool_clear(ptmp);
+}
+
+static void btree_random_loop(abts_case *tc, void *data)
+{
+    apr_btree_t *bt;
+    int *vals, i, n;
+    int *counts;
+
+    apr_time_t now = apr_time_now();
+    srand((unsigned int)(((now >> 32) ^ now) & 0xffffffff));
+
+    /* no pool, exercise the heap path */
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_create(&bt, NULL));
+    apr_btree_set_compare(bt, comp, comp);
+
+    vals = apr_palloc(ptmp, NUM_ELTS * sizeof(int));
+    counts = apr_pcalloc(ptmp, 1000 * sizeof(int));
+    for (i = 0; i < NUM_ELTS; i++) {
+        vals[i] = rand() % 1000;
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_add(bt, &vals[i]));
+        counts[vals[i]]++;
+    }
+    btree_check(tc, bt, comp);
+
+    for (i = 0, n = NUM_ELTS; i < NUM_ELTS; i += 3, n--) {
+        counts[vals[i]]--;
+        ABTS_INT_EQUAL(tc, 1, apr_btree_remove(bt, &vals[i], NULL));
+    }
+    ABTS_SIZE_EQUAL(tc, n, apr_btree_size(bt));
+    btree_check(tc, bt, comp);
+
+    for (i = 0; i < 1000; i++) {
+        apr_btree_iter_t iter;
+        int *val = apr_btree_find(bt, &i, &iter), count = 0;
+        while (val && *val == i) {
+            count++;
+            val = apr_btree_next(&iter);
+        }
+        ABTS_INT_EQUAL(tc, counts[i], count);
+    }
+
+    apr_btree_destroy(bt, NULL);
+    apr_pool_clear(ptmp);
+}
+
+static void btree_duplicates(abts_case *tc, void *data)
+{
+    apr_btree_t *bt;
+    apr_btree_iter_t iter;
+    elem *elts, *e;
+    int i;
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_create(&bt, ptmp));
+    apr_btree_set_compare(bt, acomp, acomp);
+
+    /* duplicates are kept in insertion order, across leaves */
+    elts = apr_palloc(ptmp, 200 * sizeof(elem));
+    for (i = 0; i < 200; i++) {
+        elts[i].a = i % 2;
+        elts[i].b = i;
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_add(bt, &elts[i]));
+    }
+    btree_check(tc, bt, acomp);
+    for (i = 0, e = apr_btree_first(bt, &iter); e;
+         e = apr_btree_next(&iter), i += 2) {
+        if (i == 200) {
+            i = 1;
+        }
+        ABTS_PTR_EQUAL(tc, &elts[i], e);
+    }
+
+    /* remove specific duplicates through an iterator */
+    for (i = 0; i < 200; i += 4) {
+        e = apr_btree_find(bt, &elts[i], &iter);
+        while (e && e != &elts[i]) {
+            ABTS_INT_EQUAL(tc, 0, acomp(e, &elts[i]));
+            e = apr_btree_next(&iter);
+        }
+        ABTS_PTR_EQUAL(tc, &elts[i], e);
+        ABTS_INT_EQUAL(tc, 1, apr_btree_remove_iter(bt, &iter, NULL));
+    }
+    ABTS_SIZE_EQUAL(tc, 150, apr_btree_size(bt));
+    btree_check(tc, bt, acomp);
+
+    e = apr_palloc(ptmp, sizeof(elem));
+    e->a = 1;
+    e->b = -1;
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_replace(bt, e, NULL));
+    ABTS_SIZE_EQUAL(tc, 51, apr_btree_size(bt));
+    ABTS_PTR_EQUAL(tc, e, apr_btree_last(bt, &iter));
+    ABTS_PTR_EQUAL(tc, e, apr_btree_find(bt, e, NULL));
+
+    apr_pool_clear(ptmp);
+}
+
+static int sum_cb(void *rec, void *elt)
+{
+    *(int *)rec += *(int *)elt;
+    return 1;
+}
+
+static int stop_cb(void *rec, void *elt)
+{
+    return ++*(int *)rec < 3;
+}
+
+static void btree_bulk_range(abts_case *tc, void *data)
+{
+    apr_btree_t *bt;
+    void **elts;
+    int *vals, i, lo, hi, sum;
+
+    vals = apr_palloc(ptmp, NUM_ELTS * sizeof(int));
+    elts = apr_palloc(ptmp, NUM_ELTS * sizeof(void *));
+    for (i = 0; i < NUM_ELTS; i++) {
+        vals[i] = i * 2;
+        elts[i] = &vals[i];
+    }
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_create(&bt, ptmp));
+    apr_btree_set_compare(bt, comp, comp);
+
+    /* unsorted input is refused */
+    elts[0] = &vals[2];
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_btree_bulk_load(bt, elts, NUM_ELTS));
+    elts[0] = &vals[0];
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_bulk_load(bt, elts, NUM_ELTS));
+    ABTS_SIZE_EQUAL(tc, NUM_ELTS, apr_btree_size(bt));
+    btree_check(tc, bt, comp);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_btree_bulk_load(bt, elts, NUM_ELTS));
+
+    /* the tree stays usable after the bulk load */
+    for (i = 0; i < NUM_ELTS; i += 7) {
+        ABTS_PTR_EQUAL(tc, &vals[i], apr_btree_find(bt, &vals[i], NULL));
+        ABTS_INT_EQUAL(tc, 1, apr_btree_remove(bt, &vals[i], NULL));
+    }
+    btree_check(tc, bt, comp);
+    for (i = 0; i < NUM_ELTS; i += 7) {
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_insert(bt, &vals[i]));
+    }
+    btree_check(tc, bt, comp);
+
+    /* inclusive bounds, not necessarily in the tree */
+    lo = 9;
+    hi = 20;
+    sum = 0;
+    ABTS_INT_EQUAL(tc, 1, apr_btree_range_do(bt, NULL, &lo, &hi,
+                                             sum_cb, &sum));
+    ABTS_INT_EQUAL(tc, 10 + 12 + 14 + 16 + 18 + 20, sum);
+
+    sum = 0;
+    ABTS_INT_EQUAL(tc, 0, apr_btree_range_do(bt, NULL, &lo, NULL,
+                                             stop_cb, &sum));
+    ABTS_INT_EQUAL(tc, 3, sum);
+
+    hi = 4;
+    sum = 0;
+    ABTS_INT_EQUAL(tc, 1, apr_btree_range_do(bt, NULL, NULL, &hi,
+                                             sum_cb, &sum));
+    ABTS_INT_EQUAL(tc, 0 + 2 + 4, sum);
+
+    apr_pool_clear(ptmp);
+}
+
+static void btree_index(abts_case *tc, void *data)
+{
+    apr_btree_t *bt;
+    apr_btree_iter_t iter;
+    elem *elts, key, *e;
+    int i;
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_create(&bt, ptmp));
+    apr_btree_set_compare(bt, acomp, acomp);
+
+    elts = apr_palloc(ptmp, NUM_ELTS * sizeof(elem));
+    for (i = 0; i < NUM_ELTS / 2; i++) {
+        elts[i].a = i;
+        elts[i].b = NUM_ELTS - i;
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_insert(bt, &elts[i]));
+    }
+
+    /* a second set_compare() adds an index, populated from the tree */
+    apr_btree_set_compare(bt, bcomp, bcomp);
+    for (; i < NUM_ELTS; i++) {
+        elts[i].a = i;
+        elts[i].b = NUM_ELTS - i;
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_btree_insert(bt, &elts[i]));
+    }
+    btree_check(tc, bt, acomp);
+    btree_check(tc, bt, bcomp);
+
+    e = apr_btree_first_compare(bt, &iter, bcomp);
+    ABTS_PTR_EQUAL(tc, &elts[NUM_ELTS - 1], e);
+
+    key.b = 100;
+    e = apr_btree_find_compare(bt, &key, NULL, bcomp);
+    ABTS_PTR_EQUAL(tc, &elts[NUM_ELTS - 100], e);
+
+    /* removing through an index removes from the tree, and vice versa */
+    ABTS_INT_EQUAL(tc, 1, apr_btree_remove_compare(bt, &key, NULL, bcomp));
+    ABTS_PTR_EQUAL(tc, NULL, apr_btree_find(bt, &elts[NUM_ELTS - 100], NULL));
+    ABTS_INT_EQUAL(tc, 1, apr_btree_remove(bt, &elts[0], NULL));
+    key.b = NUM_ELTS;
+    ABTS_PTR_EQUAL(tc, NULL, apr_btree_find_compare(bt, &key, NULL, bcomp));
+
+    ABTS_PTR_EQUAL(tc, &elts[1], apr_btree_pop(bt, NULL));
+    e = apr_btree_last_compare(bt, &iter, bcomp);
+    ABTS_PTR_EQUAL(tc, &elts[2], e);
+    btree_check(tc, bt, acomp);
+    btree_check(tc, bt, bcomp);
+
+    apr_btree_remove_all(bt, NULL);
+    ABTS_PTR_EQUAL(tc, NULL, apr_btree_first_compare(bt, &iter, bcomp));
+
+    apr_pool_clear(ptmp);
+}
+
+abts_suite *testbtree(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    apr_pool_create(&ptmp, p);
+
+    abts_run_test(suite, btree_basic, NULL);
+    abts_run_test(suite, btree_ordered, NULL);
+    abts_run_test(suite, btree_random_loop, NULL);
+    abts_run_test(suite, btree_duplicates, NULL);
+    abts_run_test(suite, btree_bulk_range, NULL);
+    abts_run_test(suite, btree_index, NULL);
+
+    apr_pool_destroy(ptmp);
+
+    return suite;
+}
@@ -0,0 +1,250 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testutil.h"
+#include "apr.h"
+#include "apr_general.h"
+#include "apr_pools.h"
+#include "apr_atomic.h"
+#include "apr_thread_proc.h"
+#include "apr_cskiplist.h"
+#if APR_HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#define NUM_VALS 1000
+
+static int vals[NUM_VALS];
+
+static int cskiplist_int_compare(void *a, void *b)
+{
+    int ia = *(int *)a, ib = *(int *)b;
+    return (ia > ib) - (ia < ib);
+}
+
+static void cskiplist_basic(abts_case *tc, void *data)
+{
+    apr_cskiplist_t *csl;
+    apr_pool_t *pool;
+    void *removed;
+    int i, key;
+
+    apr_pool_create(&pool, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_cskiplist_create(&csl, cskiplist_int_compare, pool));
+    ABTS_PTR_EQUAL(tc, NULL, apr_cskiplist_peek(csl));
+    ABTS_PTR_EQUAL(tc, NULL, apr_cskiplist_pop(csl));
+
+    /* insert in a scattered order */
+    for (i = 0; i < NUM_VALS; ++i) {
+        int j = (i * 7) % NUM_VALS;
+        vals[j] = j;
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_cskiplist_insert(csl, &vals[j]));
+    }
+    ABTS_SIZE_EQUAL(tc, NUM_VALS, apr_cskiplist_size(csl));
+    ABTS_INT_EQUAL(tc, APR_EEXIST, apr_cskiplist_insert(csl, &vals[3]));
+    ABTS_PTR_EQUAL(tc, &vals[0], apr_cskiplist_peek(csl));
+
+    for (i = 0; i < NUM_VALS; ++i) {
+        key = i;
+        ABTS_PTR_EQUAL(tc, &vals[i], apr_cskiplist_find(csl, &key));
+    }
+    key = NUM_VALS;
+    ABTS_PTR_EQUAL(tc, NULL, apr_cskiplist_find(csl, &key));
+
+    /* walk in order */
+    key = -1;
+    ABTS_PTR_EQUAL(tc, &vals[0], apr_cskiplist_next(csl, &key));
+    for (i = 0; i < NUM_VALS - 1; ++i) {
+        ABTS_PTR_EQUAL(tc, &vals[i + 1], apr_cskiplist_next(csl, &vals[i]));
+    }
+    ABTS_PTR_EQUAL(tc, NULL, apr_cskiplist_next(csl, &vals[NUM_VALS - 1]));
+
+    /* remove the odd ones */
+    for (i = 1; i < NUM_VALS; i += 2) {
+        key = i;
+        ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                       apr_cskiplist_remove(csl, &key, &removed));
+        ABTS_PTR_EQUAL(tc, &vals[i], removed);
+    }
+    key = 1;
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, apr_cskiplist_remove(csl, &key, NULL));
+    ABTS_PTR_EQUAL(tc, NULL, apr_cskiplist_find(csl, &key));
+    ABTS_SIZE_EQUAL(tc, NUM_VALS / 2, apr_cskiplist_size(csl));
+    ABTS_PTR_EQUAL(tc, &vals[2], apr_cskiplist_next(csl, &key));
+
+    for (i = 0; i < NUM_VALS; i += 2) {
+        ABTS_PTR_EQUAL(tc, &vals[i], apr_cskiplist_pop(csl));
+    }
+    ABTS_PTR_EQUAL(tc, NULL, apr_cskiplist_pop(csl));
+    ABTS_SIZE_EQUAL(tc, 0, apr_cskiplist_size(csl));
+
+    apr_pool_destroy(pool);
+}
+
+static void cskiplist_duplicates(abts_case *tc, void *data)
+{
+    apr_cskiplist_t *csl;
+    apr_pool_t *pool;
+    int dups[10];
+    int i, key = 5;
+
+    apr_pool_create(&pool, p);
+    apr_cskiplist_create(&csl, cskiplist_int_compare, pool);
+
+    for (i = 0; i < 10; ++i) {
+        dups[i] = 5;
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_cskiplist_add(csl, &dups[i]));
+    }
+    vals[0] = 0;
+    vals[9] = 9;
+    apr_cskiplist_add(csl, &vals[9]);
+    apr_cskiplist_add(csl, &vals[0]);
+    ABTS_SIZE_EQUAL(tc, 12, apr_cskiplist_size(csl));
+    ABTS_INT_EQUAL(tc, APR_EEXIST, apr_cskiplist_insert(csl, &key));
+
+    /* equal elements come out in insertion order */
+    ABTS_PTR_EQUAL(tc, &dups[0], apr_cskiplist_find(csl, &key));
+    ABTS_PTR_EQUAL(tc, &vals[9], apr_cskiplist_next(csl, &key));
+    ABTS_PTR_EQUAL(tc, &vals[0], apr_cskiplist_pop(csl));
+    for (i = 0; i < 10; ++i) {
+        ABTS_PTR_EQUAL(tc, &dups[i], apr_cskiplist_pop(csl));
+    }
+    ABTS_PTR_EQUAL(tc, &vals[9], apr_cskiplist_pop(csl));
+
+    /* left for the pool cleanup */
+    apr_cskiplist_add(csl, &dups[0]);
+    apr_cskiplist_add(csl, &dups[1]);
+    apr_pool_destroy(pool);
+}
+
+#if APR_HAS_THREADS
+
+#define NUM_THREADS 4
+#define NUM_PER_THREAD 20000
+
+static apr_cskiplist_t *shared;
+static int thread_vals[NUM_THREADS * NUM_PER_THREAD];
+static volatile apr_uint32_t popped[NUM_THREADS * NUM_PER_THREAD];
+static volatile apr_uint32_t nproducers;
+
+static void * APR_THREAD_FUNC cskiplist_producer(apr_thread_t *thd,
+                                                 void *data)
+{
+    int *base = data;
+    int i;
+
+    for (i = 0; i < NUM_PER_THREAD; ++i) {
+        /* interleave the keys of all the producers */
+        int *v = base + i;
+        if (i % 4 == 3) {
+            apr_cskiplist_add(shared, v);
+        }
+        else if (apr_cskiplist_insert(shared, v) != APR_SUCCESS) {
+            break;
+        }
+    }
+    apr_atomic_dec32(&nproducers);
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC cskiplist_consumer(apr_thread_t *thd,
+                                                 void *data)
+{
+    for (;;) {
+        int *v = apr_cskiplist_pop(shared);
+        if (v) {
+            apr_atomic_inc32(&popped[v - thread_vals]);
+        }
+        else if (!apr_atomic_read32(&nproducers)) {
+            break;
+        }
+        else {
+            /* also exercise the read side against the writers */
+            int key = rand() % (NUM_THREADS * NUM_PER_THREAD);
+            void *found = apr_cskiplist_find(shared, &key);
+            if (found && *(int *)found != key) {
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void cskiplist_threads(abts_case *tc, void *data)
+{
+    apr_thread_t *producers[NUM_THREADS], *consumers[NUM_THREADS];
+    apr_status_t rv, retval;
+    apr_pool_t *pool;
+    int i, n = NUM_THREADS * NUM_PER_THREAD;
+
+    apr_pool_create(&pool, p);
+    apr_cskiplist_create(&shared, cskiplist_int_compare, pool);
+
+    for (i = 0; i < n; ++i) {
+        /* producer t owns the keys congruent to t */
+        int t = i / NUM_PER_THREAD, k = i % NUM_PER_THREAD;
+        thread_vals[i] = k * NUM_THREADS + t;
+        popped[i] = 0;
+    }
+    apr_atomic_set32(&nproducers, NUM_THREADS);
+
+    for (i = 0; i < NUM_THREADS; ++i) {
+        rv = apr_thread_create(&producers[i], NULL, cskiplist_producer,
+                               &thread_vals[i * NUM_PER_THREAD], pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_thread_create(&consumers[i], NULL, cskiplist_consumer,
+                               NULL, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < NUM_THREADS; ++i) {
+        apr_thread_join(&retval, producers[i]);
+        apr_thread_join(&retval, consumers[i]);
+    }
+
+    /* whatever the consumers missed at the end is still there */
+    for (;;) {
+        int *v = apr_cskiplist_pop(shared);
+        if (!v) {
+            break;
+        }
+        apr_atomic_inc32(&popped[v - thread_vals]);
+    }
+    for (i = 0; i < n; ++i) {
+        if (popped[i] != 1) {
+            break;
+        }
+    }
+    ABTS_INT_EQUAL(tc, n, i);
+    ABTS_SIZE_EQUAL(tc, 0, apr_cskiplist_size(shared));
+
+    apr_pool_destroy(pool);
+}
+
+#endif /* APR_HAS_THREADS */
+
+abts_suite *testcskiplist(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, cskiplist_basic, NULL);
+    abts_run_test(suite, cskiplist_duplicates, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, cskiplist_threads, NULL);
+#endif
+
+    return suite;
+}
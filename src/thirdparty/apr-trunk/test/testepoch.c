@@ -0,0 +1,274 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testutil.h"
+#include "apr.h"
+#include "apr_general.h"
+#include "apr_pools.h"
+#include "apr_atomic.h"
+#include "apr_thread_proc.h"
+#include "apr_epoch.h"
+#if APR_HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#if APR_HAS_THREADS
+
+static apr_uint32_t freed;
+
+static void count_free(void *data)
+{
+    apr_atomic_inc32(&freed);
+}
+
+static apr_status_t pool_destroyed(void *data)
+{
+    *(int *)data = 1;
+    return APR_SUCCESS;
+}
+
+static void epoch_basic(abts_case *tc, void *data)
+{
+    apr_epoch_t *epoch;
+    apr_epoch_thread_t *thd;
+    apr_pool_t *pool;
+    apr_size_t n;
+
+    apr_pool_create(&pool, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_epoch_create(&epoch, pool));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_epoch_register(&thd, epoch));
+    freed = 0;
+
+    apr_epoch_enter(thd);
+    apr_epoch_retire(thd, count_free, NULL);
+    apr_epoch_retire(thd, count_free, NULL);
+    /* not handed over until exited */
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_epoch_reclaim(epoch, &n));
+    ABTS_SIZE_EQUAL(tc, 0, n);
+    ABTS_INT_EQUAL(tc, APR_EBUSY, apr_epoch_unregister(thd));
+    apr_epoch_exit(thd);
+
+    /* retired in epoch 0, the reclaim above advanced to 1 */
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_epoch_reclaim(epoch, &n));
+    ABTS_SIZE_EQUAL(tc, 2, n);
+    ABTS_UINT_EQUAL(tc, 2, freed);
+
+    /* retired in epoch 2, freed two epochs later */
+    apr_epoch_retire(thd, count_free, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_epoch_reclaim(epoch, &n));
+    ABTS_SIZE_EQUAL(tc, 0, n);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_epoch_reclaim(epoch, &n));
+    ABTS_SIZE_EQUAL(tc, 1, n);
+    ABTS_UINT_EQUAL(tc, 3, freed);
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_epoch_unregister(thd));
+
+    /* what's left is freed with the pool */
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_epoch_register(&thd, epoch));
+    apr_epoch_retire(thd, count_free, NULL);
+    apr_pool_destroy(pool);
+    ABTS_UINT_EQUAL(tc, 4, freed);
+}
+
+static void epoch_blocked(abts_case *tc, void *data)
+{
+    apr_epoch_t *epoch;
+    apr_epoch_thread_t *writer, *reader;
+    apr_pool_t *pool;
+    apr_size_t n;
+    int i;
+
+    apr_pool_create(&pool, p);
+    apr_epoch_create(&epoch, pool);
+    apr_epoch_register(&writer, epoch);
+    apr_epoch_register(&reader, epoch);
+    freed = 0;
+
+    apr_epoch_enter(reader);
+    apr_epoch_enter(reader);
+    apr_epoch_retire(writer, count_free, NULL);
+
+    /* the reader may see what was retired as long as it's in there */
+    for (i = 0; i < 5; ++i) {
+        apr_epoch_reclaim(epoch, &n);
+        ABTS_SIZE_EQUAL(tc, 0, n);
+    }
+    apr_epoch_exit(reader);
+    for (i = 0; i < 5; ++i) {
+        apr_epoch_reclaim(epoch, &n);
+        ABTS_SIZE_EQUAL(tc, 0, n);
+    }
+    apr_epoch_exit(reader);
+
+    apr_epoch_reclaim(epoch, &n);
+    ABTS_SIZE_EQUAL(tc, 1, n);
+
+    apr_pool_destroy(pool);
+}
+
+static void epoch_retire_memory(abts_case *tc, void *data)
+{
+    apr_epoch_t *epoch;
+    apr_epoch_thread_t *thd;
+    apr_allocator_t *allocator;
+    apr_memnode_t *node;
+    apr_pool_t *pool, *retired;
+    apr_size_t n;
+    int destroyed = 0;
+
+    apr_pool_create(&pool, p);
+    apr_epoch_create(&epoch, pool);
+    apr_epoch_register(&thd, epoch);
+
+    apr_allocator_create(&allocator);
+    node = apr_allocator_alloc(allocator, 100);
+    ABTS_PTR_NOTNULL(tc, node);
+
+    apr_pool_create(&retired, pool);
+    apr_pool_cleanup_register(retired, &destroyed, pool_destroyed,
+                              apr_pool_cleanup_null);
+
+    apr_epoch_retire_node(thd, allocator, node);
+    apr_epoch_retire_pool(thd, retired);
+
+    apr_epoch_reclaim(epoch, &n);
+    ABTS_INT_EQUAL(tc, 0, destroyed);
+    apr_epoch_reclaim(epoch, &n);
+    ABTS_SIZE_EQUAL(tc, 2, n);
+    ABTS_INT_EQUAL(tc, 1, destroyed);
+
+    apr_pool_destroy(pool);
+    apr_allocator_destroy(allocator);
+}
+
+#define NUM_READERS 4
+#define NUM_UPDATES 20000
+#define OBJ_LIVE 0x11111111
+#define OBJ_DEAD 0xdeaddead
+
+typedef struct obj_t {
+    volatile apr_uint32_t magic;
+    apr_uint32_t seq;
+} obj_t;
+
+static apr_epoch_t *shared;
+static void *volatile current;
+static volatile apr_uint32_t done, bad;
+
+static void obj_free(void *data)
+{
+    obj_t *obj = data;
+
+    obj->magic = OBJ_DEAD;
+    free(obj);
+    apr_atomic_inc32(&freed);
+}
+
+static void * APR_THREAD_FUNC epoch_reader(apr_thread_t *t, void *data)
+{
+    apr_epoch_thread_t *thd;
+
+    apr_epoch_register(&thd, shared);
+    while (!apr_atomic_read32(&done)) {
+        obj_t *obj;
+
+        apr_epoch_enter(thd);
+        obj = apr_atomic_casptr(&current, NULL, NULL);
+        if (obj->magic != OBJ_LIVE) {
+            apr_atomic_inc32(&bad);
+        }
+        apr_epoch_exit(thd);
+    }
+    apr_epoch_unregister(thd);
+
+    return NULL;
+}
+
+static void epoch_threads(abts_case *tc, void *data)
+{
+    apr_thread_t *readers[NUM_READERS];
+    apr_thread_pool_t *tp;
+    apr_epoch_thread_t *thd;
+    apr_status_t rv, retval;
+    apr_pool_t *pool;
+    apr_size_t n;
+    obj_t *obj;
+    int i;
+
+    apr_pool_create(&pool, p);
+    rv = apr_thread_pool_create(&tp, 1, 1, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_epoch_create(&shared, pool);
+    rv = apr_epoch_reclaim_start(shared, tp, 1000);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, APR_EBUSY, apr_epoch_reclaim_start(shared, tp, 1000));
+
+    freed = done = bad = 0;
+    obj = malloc(sizeof(*obj));
+    obj->magic = OBJ_LIVE;
+    obj->seq = 0;
+    current = obj;
+
+    for (i = 0; i < NUM_READERS; ++i) {
+        rv = apr_thread_create(&readers[i], NULL, epoch_reader, NULL, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    apr_epoch_register(&thd, shared);
+    for (i = 1; i <= NUM_UPDATES; ++i) {
+        obj = malloc(sizeof(*obj));
+        obj->magic = OBJ_LIVE;
+        obj->seq = i;
+        obj = apr_atomic_xchgptr(&current, obj);
+        apr_epoch_retire(thd, obj_free, obj);
+        if (i % 1000 == 0) {
+            apr_thread_yield();
+        }
+    }
+    apr_epoch_unregister(thd);
+
+    apr_atomic_set32(&done, 1);
+    for (i = 0; i < NUM_READERS; ++i) {
+        apr_thread_join(&retval, readers[i]);
+    }
+    ABTS_UINT_EQUAL(tc, 0, bad);
+
+    apr_epoch_reclaim_stop(shared);
+    for (i = 0; i < 3; ++i) {
+        apr_epoch_reclaim(shared, &n);
+    }
+    ABTS_UINT_EQUAL(tc, NUM_UPDATES, freed);
+
+    free(current);
+    apr_thread_pool_destroy(tp);
+    apr_pool_destroy(pool);
+}
+
+#endif /* APR_HAS_THREADS */
+
+abts_suite *testepoch(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+#if APR_HAS_THREADS
+    abts_run_test(suite, epoch_basic, NULL);
+    abts_run_test(suite, epoch_blocked, NULL);
+    abts_run_test(suite, epoch_retire_memory, NULL);
+    abts_run_test(suite, epoch_threads, NULL);
+#endif
+
+    return suite;
+}
@@ -210,8 +210,9 @@ static void test_thread_mutex(abts_case *tc, void *data)
 {
     apr_thread_t *t1, *t2, *t3, *t4;
     apr_status_t s1, s2, s3, s4;
+    unsigned int flags = data ? *(unsigned int *)data : APR_THREAD_MUTEX_DEFAULT;
 
-    s1 = apr_thread_mutex_create(&thread_mutex, APR_THREAD_MUTEX_DEFAULT, p);
+    s1 = apr_thread_mutex_create(&thread_mutex, flags, p);
     ABTS_INT_EQUAL(tc, APR_SUCCESS, s1);
     ABTS_PTR_NOTNULL(tc, thread_mutex);
 
@@ -240,8 +241,10 @@ static void test_thread_timedmutex(abts_case *tc, void *data)
     apr_thread_t *t1, *t2, *t3, *t4;
     apr_status_t s1, s2, s3, s4;
     apr_interval_time_t timeout;
+    unsigned int flags = data ? *(unsigned int *)data : 0;
 
-    s1 = apr_thread_mutex_create(&thread_mutex, APR_THREAD_MUTEX_TIMED, p);
+    s1 = apr_thread_mutex_create(&thread_mutex,
+                                 APR_THREAD_MUTEX_TIMED | flags, p);
     ABTS_INT_EQUAL(tc, APR_SUCCESS, s1);
     ABTS_PTR_NOTNULL(tc, thread_mutex);
 
@@ -271,8 +274,9 @@ static void test_thread_rwlock(abts_case *tc, void *data)
 {
     apr_thread_t *t1, *t2, *t3, *t4;
     apr_status_t s1, s2, s3, s4;
+    unsigned int flags = data ? *(unsigned int *)data : 0;
 
-    s1 = apr_thread_rwlock_create(&rwlock, p);
+    s1 = apr_thread_rwlock_create_ex(&rwlock, flags, p);
     if (s1 == APR_ENOTIMPL) {
         ABTS_NOT_IMPL(tc, "rwlocks not implemented");
         return;
@@ -308,15 +312,14 @@ static void test_cond(abts_case *tc, void *data)
     apr_status_t s0, s1, s2, s3, s4;
     int count1, count2, count3, count4;
     int sum;
+    unsigned int flags = data ? *(unsigned int *)data : APR_THREAD_MUTEX_DEFAULT;
 
     APR_ASSERT_SUCCESS(tc, "create put mutex",
-                       apr_thread_mutex_create(&put.mutex,
-                                               APR_THREAD_MUTEX_DEFAULT, p));
+                       apr_thread_mutex_create(&put.mutex, flags, p));
     ABTS_PTR_NOTNULL(tc, put.mutex);
 
     APR_ASSERT_SUCCESS(tc, "create nready mutex",
-                       apr_thread_mutex_create(&nready.mutex,
-                                               APR_THREAD_MUTEX_DEFAULT, p));
+                       apr_thread_mutex_create(&nready.mutex, flags, p));
     ABTS_PTR_NOTNULL(tc, nready.mutex);
 
     APR_ASSERT_SUCCESS(tc, "create condvar",
@@ -363,8 +366,9 @@ static void test_timeoutcond(abts_case *tc, void *data)
     apr_interval_time_t timeout;
     apr_time_t begin, end;
     int i;
+    unsigned int flags = data ? *(unsigned int *)data : APR_THREAD_MUTEX_DEFAULT;
 
-    s = apr_thread_mutex_create(&timeout_mutex, APR_THREAD_MUTEX_DEFAULT, p);
+    s = apr_thread_mutex_create(&timeout_mutex, flags, p);
     ABTS_INT_EQUAL(tc, APR_SUCCESS, s);
     ABTS_PTR_NOTNULL(tc, timeout_mutex);
 
@@ -407,10 +411,11 @@ static void test_timeoutmutex(abts_case *tc, void *data)
     apr_thread_t *th;
     apr_uint32_t flag = 0;
     int i;
+    unsigned int flags = data ? *(unsigned int *)data : 0;
 
     s = apr_thread_mutex_create(&timeout_mutex,
                                 APR_THREAD_MUTEX_TIMED |
-                                APR_THREAD_MUTEX_UNNESTED, p);
+                                APR_THREAD_MUTEX_UNNESTED | flags, p);
     ABTS_INT_EQUAL(tc, APR_SUCCESS, s);
     ABTS_PTR_NOTNULL(tc, timeout_mutex);
 
@@ -492,6 +497,72 @@ static void test_thread_unnestedmutex(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 }
 
+static void test_thread_adaptivemutex(abts_case *tc, void *data)
+{
+    apr_thread_mutex_t *m;
+    apr_status_t rv;
+
+    rv = apr_thread_mutex_create(&m, APR_THREAD_MUTEX_ADAPTIVE, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_PTR_NOTNULL(tc, m);
+
+    rv = apr_thread_mutex_trylock(m);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_thread_mutex_trylock(m);
+    ABTS_INT_EQUAL(tc, APR_EBUSY, rv);
+
+    rv = apr_thread_mutex_unlock(m);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_thread_mutex_lock(m);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_thread_mutex_unlock(m);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_thread_mutex_destroy(m);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+/* A read lock taken through the biased fast path must still keep writers
+ * out, and the other way around.
+ */
+static void test_thread_rwlock_biased(abts_case *tc, void *data)
+{
+    apr_thread_rwlock_t *l;
+    apr_status_t rv;
+    int n;
+
+    rv = apr_thread_rwlock_create_ex(&l, APR_THREAD_MUTEX_READER_BIASED, p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "rwlocks not implemented");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "rwlock_create_ex", rv);
+
+    rv = apr_thread_rwlock_create_ex(&rwlock, 0x1000, p);
+    ABTS_INT_EQUAL(tc, APR_ENOTIMPL, rv);
+
+    for (n = 0; n < 3; n++) {
+        APR_ASSERT_SUCCESS(tc, "rdlock", apr_thread_rwlock_rdlock(l));
+        rv = apr_thread_rwlock_trywrlock(l);
+        ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_EBUSY(rv));
+        APR_ASSERT_SUCCESS(tc, "unlock", apr_thread_rwlock_unlock(l));
+
+        APR_ASSERT_SUCCESS(tc, "wrlock", apr_thread_rwlock_wrlock(l));
+        rv = apr_thread_rwlock_tryrdlock(l);
+        ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_EBUSY(rv));
+        APR_ASSERT_SUCCESS(tc, "unlock", apr_thread_rwlock_unlock(l));
+    }
+
+    APR_ASSERT_SUCCESS(tc, "tryrdlock", apr_thread_rwlock_tryrdlock(l));
+    APR_ASSERT_SUCCESS(tc, "unlock", apr_thread_rwlock_unlock(l));
+    APR_ASSERT_SUCCESS(tc, "trywrlock", apr_thread_rwlock_trywrlock(l));
+    APR_ASSERT_SUCCESS(tc, "unlock", apr_thread_rwlock_unlock(l));
+
+    APR_ASSERT_SUCCESS(tc, "destroy", apr_thread_rwlock_destroy(l));
+}
+
 #ifdef WIN32
 static void *APR_THREAD_FUNC
 thread_win32_abandoned_mutex_function(apr_thread_t *thd, void *data)
@@ -545,6 +616,11 @@ static void threads_not_impl(abts_case *tc, void *data)
 
 abts_suite *testlock(abts_suite *suite)
 {
+#if APR_HAS_THREADS
+    static unsigned int adaptive = APR_THREAD_MUTEX_ADAPTIVE;
+    static unsigned int biased = APR_THREAD_MUTEX_READER_BIASED;
+#endif
+
     suite = ADD_SUITE(suite)
 
 #if !APR_HAS_THREADS
@@ -558,6 +634,14 @@ abts_suite *testlock(abts_suite *suite)
     abts_run_test(suite, test_cond, NULL);
     abts_run_test(suite, test_timeoutcond, NULL);
     abts_run_test(suite, test_timeoutmutex, NULL);
+    abts_run_test(suite, test_thread_adaptivemutex, NULL);
+    abts_run_test(suite, test_thread_mutex, &adaptive);
+    abts_run_test(suite, test_thread_timedmutex, &adaptive);
+    abts_run_test(suite, test_cond, &adaptive);
+    abts_run_test(suite, test_timeoutcond, &adaptive);
+    abts_run_test(suite, test_timeoutmutex, &adaptive);
+    abts_run_test(suite, test_thread_rwlock_biased, NULL);
+    abts_run_test(suite, test_thread_rwlock, &biased);
 #ifdef WIN32
     abts_run_test(suite, test_win32_abandoned_mutex, NULL);
 #endif
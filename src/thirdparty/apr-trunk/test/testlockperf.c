@@ -48,10 +48,14 @@ apr_status_t test_thread_mutex(int num_threads); /* apr_thread_mutex_t */
 
 static apr_thread_rwlock_t *thread_rwlock;
 void * APR_THREAD_FUNC thread_rwlock_func(apr_thread_t *thd, void *data);
+void * APR_THREAD_FUNC thread_rwlock_read_func(apr_thread_t *thd, void *data);
 apr_status_t test_thread_rwlock(int num_threads); /* apr_thread_rwlock_t */
 
 int test_thread_mutex_nested(int num_threads);
 
+/* one write lock out of RWLOCK_WRITE_RATIO, the rest are read locks */
+#define RWLOCK_WRITE_RATIO 64
+
 apr_pool_t *pool;
 int i = 0, x = 0;
 
@@ -84,6 +88,25 @@ void * APR_THREAD_FUNC thread_rwlock_func(apr_thread_t *thd, void *data)
     return NULL;
 }
 
+void * APR_THREAD_FUNC thread_rwlock_read_func(apr_thread_t *thd, void *data)
+{
+    volatile long sum = 0;
+    int i;
+
+    for (i = 0; i < max_counter; i++) {
+        if (i % RWLOCK_WRITE_RATIO == 0) {
+            apr_thread_rwlock_wrlock(thread_rwlock);
+            mutex_counter++;
+        }
+        else {
+            apr_thread_rwlock_rdlock(thread_rwlock);
+            sum += mutex_counter;
+        }
+        apr_thread_rwlock_unlock(thread_rwlock);
+    }
+    return NULL;
+}
+
 int test_thread_mutex(int num_threads)
 {
     apr_thread_t *t[MAX_THREADS];
@@ -279,6 +302,102 @@ int test_thread_rwlock(int num_threads)
     return APR_SUCCESS;
 }
 
+static int test_thread_mutex_adaptive(int num_threads)
+{
+    apr_thread_t *t[MAX_THREADS];
+    apr_status_t s[MAX_THREADS];
+    apr_time_t time_start, time_stop;
+    int i;
+
+    mutex_counter = 0;
+
+    printf("apr_thread_mutex_t Tests\n");
+    printf("%-60s", "    Initializing the apr_thread_mutex_t (ADAPTIVE)");
+    s[0] = apr_thread_mutex_create(&thread_lock, APR_THREAD_MUTEX_ADAPTIVE, pool);
+    if (s[0] != APR_SUCCESS) {
+        printf("Failed!\n");
+        return s[0];
+    }
+    printf("OK\n");
+
+    apr_thread_mutex_lock(thread_lock);
+    printf("    Starting %d threads    ", num_threads);
+    for (i = 0; i < num_threads; ++i) {
+        s[i] = apr_thread_create(&t[i], NULL, thread_mutex_func, NULL, pool);
+        if (s[i] != APR_SUCCESS) {
+            printf("Failed!\n");
+            return s[i];
+        }
+    }
+    printf("OK\n");
+
+    time_start = apr_time_now();
+    apr_thread_mutex_unlock(thread_lock);
+
+    for (i = 0; i < num_threads; ++i) {
+        apr_thread_join(&s[i], t[i]);
+    }
+
+    time_stop = apr_time_now();
+    printf("microseconds: %" APR_INT64_T_FMT " usec\n",
+           (time_stop - time_start));
+    if (mutex_counter != max_counter * num_threads)
+        printf("error: counter = %ld\n", mutex_counter);
+
+    return APR_SUCCESS;
+}
+
+/* Mostly readers, with and without reader bias. */
+static int test_thread_rwlock_read(int num_threads, unsigned int flags)
+{
+    apr_thread_t *t[MAX_THREADS];
+    apr_status_t s[MAX_THREADS];
+    apr_time_t time_start, time_stop;
+    long expected;
+    int i;
+
+    mutex_counter = 0;
+
+    printf("apr_thread_rwlock_t Tests\n");
+    printf("%-60s", flags & APR_THREAD_MUTEX_READER_BIASED
+           ? "    Initializing the apr_thread_rwlock_t (READER_BIASED)"
+           : "    Initializing the apr_thread_rwlock_t (read mostly)");
+    s[0] = apr_thread_rwlock_create_ex(&thread_rwlock, flags, pool);
+    if (s[0] != APR_SUCCESS) {
+        printf("Failed!\n");
+        return s[0];
+    }
+    printf("OK\n");
+
+    apr_thread_rwlock_wrlock(thread_rwlock);
+    printf("    Starting %d threads    ", num_threads);
+    for (i = 0; i < num_threads; ++i) {
+        s[i] = apr_thread_create(&t[i], NULL, thread_rwlock_read_func, NULL,
+                                 pool);
+        if (s[i] != APR_SUCCESS) {
+            printf("Failed!\n");
+            return s[i];
+        }
+    }
+    printf("OK\n");
+
+    time_start = apr_time_now();
+    apr_thread_rwlock_unlock(thread_rwlock);
+
+    for (i = 0; i < num_threads; ++i) {
+        apr_thread_join(&s[i], t[i]);
+    }
+
+    time_stop = apr_time_now();
+    printf("microseconds: %" APR_INT64_T_FMT " usec\n",
+           (time_stop - time_start));
+    expected = (max_counter + RWLOCK_WRITE_RATIO - 1) / RWLOCK_WRITE_RATIO;
+    if (mutex_counter != expected * num_threads)
+        printf("error: counter = %ld\n", mutex_counter);
+
+    return APR_SUCCESS;
+}
+
 int main(int argc, const char * const *argv)
 {
     apr_status_t rv;
@@ -340,6 +459,25 @@ int main(int argc, const char * const *argv)
                     rv, apr_strerror(rv, (char*)errmsg, 200));
             exit(-6);
         }
+
+        if ((rv = test_thread_mutex_adaptive(i)) != APR_SUCCESS) {
+            fprintf(stderr,"thread_mutex (ADAPTIVE) test failed : [%d] %s\n",
+                    rv, apr_strerror(rv, (char*)errmsg, 200));
+            exit(-7);
+        }
+
+        if ((rv = test_thread_rwlock_read(i, 0)) != APR_SUCCESS) {
+            fprintf(stderr,"thread_rwlock (read mostly) test failed : [%d] %s\n",
+                    rv, apr_strerror(rv, (char*)errmsg, 200));
+            exit(-8);
+        }
+
+        if ((rv = test_thread_rwlock_read(i, APR_THREAD_MUTEX_READER_BIASED))
+                != APR_SUCCESS) {
+            fprintf(stderr,"thread_rwlock (READER_BIASED) test failed : [%d] %s\n",
+                    rv, apr_strerror(rv, (char*)errmsg, 200));
+            exit(-9);
+        }
     }
 
     return 0;
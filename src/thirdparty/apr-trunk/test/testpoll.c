@@ -21,6 +21,8 @@
 #include "apr_lib.h"
 #include "apr_network_io.h"
 #include "apr_poll.h"
+#include "apr_thread_proc.h"
+#include "apr_time.h"
 
 #if defined(__linux__)
 #include "arch/unix/apr_private.h"
@@ -304,6 +306,13 @@ static void setup_pollset(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 }
 
+static void destroy_pollset(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    rv = apr_pollset_destroy(pollset);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
 static void multi_event_pollset(abts_case *tc, void *data)
 {
     apr_status_t rv;
@@ -572,6 +581,9 @@ static void pollset_remove(abts_case *tc, void *data)
              (hot_files[1].client_data == (void *)4)) ||
             ((hot_files[0].client_data == (void *)4) &&
              (hot_files[1].client_data == (void *)1)));
+
+    rv = apr_pollset_destroy(pollset);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 }
 
 #define POLLCB_PREREQ \
@@ -585,7 +597,8 @@ static void pollset_remove(abts_case *tc, void *data)
 static void setup_pollcb(abts_case *tc, void *data)
 {
     apr_status_t rv;
-    rv = apr_pollcb_create(&pollcb, LARGE_NUM_SOCKETS, p, 0);
+    rv = apr_pollcb_create_ex(&pollcb, LARGE_NUM_SOCKETS, p, 0,
+                              default_pollset_impl);
     if (rv == APR_ENOTIMPL) {
         pollcb = NULL;
         ABTS_NOT_IMPL(tc, "pollcb interface not supported");
@@ -829,6 +842,9 @@ static void pollset_wakeup(abts_case *tc, void *data)
     rv = apr_pollset_poll(pollset, -1, &num, &descriptors);
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
     ABTS_INT_EQUAL(tc, 1, num);
+
+    rv = apr_pollset_destroy(pollset);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 }
 
 /* Should never be invoked */
@@ -845,7 +861,8 @@ static void pollcb_wakeup(abts_case *tc, void *data)
     apr_status_t rv;
     apr_pollcb_t *pcb;
 
-    rv = apr_pollcb_create(&pcb, 1, p, APR_POLLSET_WAKEABLE);
+    rv = apr_pollcb_create_ex(&pcb, 1, p, APR_POLLSET_WAKEABLE,
+                              default_pollset_impl);
     if (rv == APR_ENOTIMPL) {
         ABTS_NOT_IMPL(tc, "pollcb interface not supported");
         return;
@@ -861,6 +878,340 @@ static void pollcb_wakeup(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, APR_EINTR, rv);
 }
 
+static void pollcb_wakeup_coalesce(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pollcb_t *pcb;
+    int i;
+
+    rv = apr_pollcb_create_ex(&pcb, 1, p, APR_POLLSET_WAKEABLE,
+                              default_pollset_impl);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "pollcb interface not supported");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* several wakeups interrupt a single poll */
+    for (i = 0; i < 3; ++i) {
+        rv = apr_pollcb_wakeup(pcb);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    rv = apr_pollcb_poll(pcb, -1, wakeup_pollcb_cb, tc);
+    ABTS_INT_EQUAL(tc, APR_EINTR, rv);
+    rv = apr_pollcb_poll(pcb, 0, wakeup_pollcb_cb, tc);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+}
+
+static void set_pollset_impl(abts_case *tc, void *data)
+{
+    default_pollset_impl = (int)(apr_size_t)data;
+}
+
+static void pollset_churn(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pollset_t *pollset;
+    const apr_pollfd_t *hot_files;
+    apr_pollfd_t pfd;
+    apr_int32_t num;
+    int i;
+
+    rv = apr_pollset_create_ex(&pollset, 1, p, 0, default_pollset_impl);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    pfd.p = p;
+    pfd.desc_type = APR_POLL_SOCKET;
+    pfd.reqevents = APR_POLLIN;
+    pfd.desc.s = s[0];
+    pfd.client_data = NULL;
+
+    send_msg(s, sa, 0, tc);
+
+    /* more changes than a single submission batch holds */
+    for (i = 0; i < 1000; i++) {
+        rv = apr_pollset_add(pollset, &pfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_pollset_remove(pollset, &pfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    rv = apr_pollset_poll(pollset, 0, &num, &hot_files);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+    ABTS_INT_EQUAL(tc, 0, num);
+
+    rv = apr_pollset_add(pollset, &pfd);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_pollset_poll(pollset, apr_time_from_sec(1), &num, &hot_files);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, num);
+    ABTS_PTR_EQUAL(tc, s[0], hot_files[0].desc.s);
+
+    /* level-triggered, still readable */
+    rv = apr_pollset_poll(pollset, apr_time_from_sec(1), &num, &hot_files);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, num);
+
+    recv_msg(s, 0, p, tc);
+    rv = apr_pollset_poll(pollset, 0, &num, &hot_files);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+    ABTS_INT_EQUAL(tc, 0, num);
+
+    rv = apr_pollset_remove(pollset, &pfd);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_pollset_destroy(pollset);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+#if APR_HAS_THREADS
+static void * APR_THREAD_FUNC add_later(apr_thread_t *thd, void *data)
+{
+    apr_pollset_t *pollset = data;
+    apr_pollfd_t pfd;
+
+    pfd.p = p;
+    pfd.desc_type = APR_POLL_SOCKET;
+    pfd.reqevents = APR_POLLIN;
+    pfd.desc.s = s[1];
+    pfd.client_data = NULL;
+
+    apr_sleep(apr_time_from_msec(100));
+    apr_thread_exit(thd, apr_pollset_add(pollset, &pfd));
+    return NULL;
+}
+
+static void pollset_add_while_polling(abts_case *tc, void *data)
+{
+    apr_status_t rv, retval;
+    apr_pollset_t *pollset;
+    const apr_pollfd_t *hot_files;
+    apr_pollfd_t pfd;
+    apr_thread_t *thd;
+    apr_int32_t num;
+    apr_time_t t1;
+
+    rv = apr_pollset_create_ex(&pollset, 1, p, APR_POLLSET_THREADSAFE,
+                               default_pollset_impl);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "APR_POLLSET_THREADSAFE not supported");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    send_msg(s, sa, 1, tc);
+
+    rv = apr_thread_create(&thd, NULL, add_later, pollset, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* the descriptor added by the thread must wake this one up */
+    t1 = apr_time_now();
+    rv = apr_pollset_poll(pollset, apr_time_from_sec(5), &num, &hot_files);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, num);
+    ABTS_ASSERT(tc, "apr_pollset_poll() didn't see the added descriptor",
+                apr_time_now() - t1 < apr_time_from_sec(5));
+
+    rv = apr_thread_join(&retval, thd);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, retval);
+
+    recv_msg(s, 1, p, tc);
+
+    pfd.p = p;
+    pfd.desc_type = APR_POLL_SOCKET;
+    pfd.reqevents = APR_POLLIN;
+    pfd.desc.s = s[1];
+    rv = apr_pollset_remove(pollset, &pfd);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_pollset_destroy(pollset);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static void * APR_THREAD_FUNC wakeup_later(apr_thread_t *thd, void *data)
+{
+    apr_pollcb_t *pcb = data;
+
+    apr_sleep(apr_time_from_msec(100));
+    apr_thread_exit(thd, apr_pollcb_wakeup(pcb));
+    return NULL;
+}
+
+static void pollcb_wakeup_while_polling(abts_case *tc, void *data)
+{
+    apr_status_t rv, retval;
+    apr_pollcb_t *pcb;
+    apr_thread_t *thd;
+    apr_time_t t1;
+
+    rv = apr_pollcb_create_ex(&pcb, 1, p, APR_POLLSET_WAKEABLE,
+                              default_pollset_impl);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "pollcb interface not supported");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_thread_create(&thd, NULL, wakeup_later, pcb, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* the wakeup of the thread must be signaled to the blocked poll */
+    t1 = apr_time_now();
+    rv = apr_pollcb_poll(pcb, apr_time_from_sec(5), wakeup_pollcb_cb, tc);
+    ABTS_INT_EQUAL(tc, APR_EINTR, rv);
+    ABTS_ASSERT(tc, "apr_pollcb_poll() wasn't woken up",
+                apr_time_now() - t1 < apr_time_from_sec(5));
+
+    rv = apr_thread_join(&retval, thd);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, retval);
+}
+#endif
+
+static void pollset_edge(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pollset_t *pollset;
+    const apr_pollfd_t *hot_files;
+    apr_pollfd_t pfd;
+    apr_int32_t num;
+
+    rv = apr_pollset_create_ex(&pollset, 1, p,
+                               APR_POLLSET_EDGE | APR_POLLSET_NODEFAULT,
+                               APR_POLLSET_EPOLL);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "epoll not supported");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    pfd.p = p;
+    pfd.desc_type = APR_POLL_SOCKET;
+    pfd.reqevents = APR_POLLIN;
+    pfd.desc.s = s[0];
+    pfd.client_data = NULL;
+    rv = apr_pollset_add(pollset, &pfd);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    send_msg(s, sa, 0, tc);
+    rv = apr_pollset_poll(pollset, apr_time_from_sec(1), &num, &hot_files);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, num);
+
+    /* still readable, but not reported again until new data */
+    rv = apr_pollset_poll(pollset, 0, &num, &hot_files);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+    ABTS_INT_EQUAL(tc, 0, num);
+
+    send_msg(s, sa, 0, tc);
+    rv = apr_pollset_poll(pollset, apr_time_from_sec(1), &num, &hot_files);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, num);
+
+    recv_msg(s, 0, p, tc);
+    recv_msg(s, 0, p, tc);
+
+    rv = apr_pollset_destroy(pollset);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static apr_status_t edge_pollcb_cb(void *baton, apr_pollfd_t *descriptor)
+{
+    pollcb_baton_t *pcb = (pollcb_baton_t *) baton;
+
+    pcb->count++;
+    return APR_EGENERAL;
+}
+
+static void pollcb_edge(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pollcb_t *pollcb;
+    apr_pollfd_t pfd[2];
+    pollcb_baton_t pcb;
+    int i;
+
+    rv = apr_pollcb_create_ex(&pollcb, 2, p,
+                              APR_POLLSET_EDGE | APR_POLLSET_NODEFAULT,
+                              APR_POLLSET_EPOLL);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "epoll not supported");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < 2; i++) {
+        pfd[i].p = p;
+        pfd[i].desc_type = APR_POLL_SOCKET;
+        pfd[i].reqevents = APR_POLLIN;
+        pfd[i].desc.s = s[i];
+        pfd[i].client_data = NULL;
+        rv = apr_pollcb_add(pollcb, &pfd[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        send_msg(s, sa, i, tc);
+    }
+
+    /* the callback stops the first poll, the second one must still get
+     * the other descriptor since it won't be signalled again
+     */
+    pcb.tc = tc;
+    pcb.count = 0;
+    rv = apr_pollcb_poll(pollcb, apr_time_from_sec(1), edge_pollcb_cb, &pcb);
+    ABTS_INT_EQUAL(tc, APR_EGENERAL, rv);
+    ABTS_INT_EQUAL(tc, 1, pcb.count);
+    rv = apr_pollcb_poll(pollcb, 0, edge_pollcb_cb, &pcb);
+    ABTS_INT_EQUAL(tc, APR_EGENERAL, rv);
+    ABTS_INT_EQUAL(tc, 2, pcb.count);
+    rv = apr_pollcb_poll(pollcb, 0, edge_pollcb_cb, &pcb);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+    ABTS_INT_EQUAL(tc, 2, pcb.count);
+
+    for (i = 0; i < 2; i++) {
+        recv_msg(s, i, p, tc);
+        rv = apr_pollcb_remove(pollcb, &pfd[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+}
+
+static void pollset_exclusive(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pollset_t *pollsets[2];
+    const apr_pollfd_t *hot_files;
+    apr_pollfd_t pfd;
+    apr_int32_t num;
+    int i;
+
+    pfd.p = p;
+    pfd.desc_type = APR_POLL_SOCKET;
+    pfd.reqevents = APR_POLLIN;
+    pfd.desc.s = s[0];
+    pfd.client_data = NULL;
+
+    for (i = 0; i < 2; i++) {
+        rv = apr_pollset_create_ex(&pollsets[i], 1, p,
+                                   APR_POLLSET_EXCLUSIVE, default_pollset_impl);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_pollset_add(pollsets[i], &pfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    /* nobody is waiting, so both see it */
+    send_msg(s, sa, 0, tc);
+    for (i = 0; i < 2; i++) {
+        rv = apr_pollset_poll(pollsets[i], apr_time_from_sec(1), &num,
+                              &hot_files);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 1, num);
+    }
+    recv_msg(s, 0, p, tc);
+
+    for (i = 0; i < 2; i++) {
+        rv = apr_pollset_remove(pollsets[i], &pfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_pollset_destroy(pollsets[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+}
+
 #define JUSTSLEEP_DELAY apr_time_from_msec(200)
 #if HAVE_EPOLL_WAIT_RELIABLE_TIMEOUT
 #define JUSTSLEEP_ENOUGH(ts, te) \
@@ -933,6 +1284,31 @@ static void justsleep(abts_case *tc, void *data)
     }
 }
 
+static void sleep_pollset(abts_case *tc, void *data)
+{
+    apr_int32_t nsds;
+    const apr_pollfd_t *hot_files;
+    apr_pollset_t *pollset;
+    apr_status_t rv;
+    apr_time_t t1, t2;
+
+    rv = apr_pollset_create_ex(&pollset, 5, p, 0, default_pollset_impl);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    nsds = 1;
+    t1 = apr_time_now();
+    rv = apr_pollset_poll(pollset, JUSTSLEEP_DELAY, &nsds, &hot_files);
+    t2 = apr_time_now();
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+    ABTS_INT_EQUAL(tc, 0, nsds);
+    ABTS_ASSERT(tc,
+                "apr_pollset_poll() didn't sleep",
+                JUSTSLEEP_ENOUGH(t1, t2));
+
+    rv = apr_pollset_destroy(pollset);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
 abts_suite *testpoll(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -963,6 +1339,7 @@ abts_suite *testpoll(abts_suite *suite)
     abts_run_test(suite, send_last_pollset, NULL);
     abts_run_test(suite, clear_last_pollset, NULL);
     abts_run_test(suite, pollset_remove, NULL);
+    abts_run_test(suite, destroy_pollset, NULL);
     abts_run_test(suite, close_all_sockets, NULL);
     abts_run_test(suite, create_all_sockets, NULL);
     abts_run_test(suite, setup_pollcb, NULL);
@@ -971,7 +1348,54 @@ abts_suite *testpoll(abts_suite *suite)
     abts_run_test(suite, timeout_pollin_pollcb, NULL);
     abts_run_test(suite, pollset_wakeup, NULL);
     abts_run_test(suite, pollcb_wakeup, NULL);
+    abts_run_test(suite, pollcb_wakeup_coalesce, NULL);
     abts_run_test(suite, close_all_sockets, NULL);
+    abts_run_test(suite, create_all_sockets, NULL);
+    abts_run_test(suite, pollset_churn, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, pollset_add_while_polling, NULL);
+    abts_run_test(suite, pollcb_wakeup_while_polling, NULL);
+#endif
+    abts_run_test(suite, pollset_edge, NULL);
+    abts_run_test(suite, pollcb_edge, NULL);
+    abts_run_test(suite, pollset_exclusive, NULL);
+    abts_run_test(suite, close_all_sockets, NULL);
+
+    /* the same with io_uring, or the default where it's not available */
+    abts_run_test(suite, set_pollset_impl, (void *)APR_POLLSET_IOURING);
+    abts_run_test(suite, create_all_sockets, NULL);
+    abts_run_test(suite, setup_pollset, NULL);
+    abts_run_test(suite, multi_event_pollset, NULL);
+    abts_run_test(suite, add_sockets_pollset, NULL);
+    abts_run_test(suite, nomessage_pollset, NULL);
+    abts_run_test(suite, send0_pollset, NULL);
+    abts_run_test(suite, recv0_pollset, NULL);
+    abts_run_test(suite, send_middle_pollset, NULL);
+    abts_run_test(suite, clear_middle_pollset, NULL);
+    abts_run_test(suite, send_last_pollset, NULL);
+    abts_run_test(suite, clear_last_pollset, NULL);
+    abts_run_test(suite, pollset_remove, NULL);
+    abts_run_test(suite, destroy_pollset, NULL);
+    abts_run_test(suite, close_all_sockets, NULL);
+    abts_run_test(suite, create_all_sockets, NULL);
+    abts_run_test(suite, setup_pollcb, NULL);
+    abts_run_test(suite, trigger_pollcb, NULL);
+    abts_run_test(suite, timeout_pollcb, NULL);
+    abts_run_test(suite, timeout_pollin_pollcb, NULL);
+    abts_run_test(suite, pollset_wakeup, NULL);
+    abts_run_test(suite, pollcb_wakeup, NULL);
+    abts_run_test(suite, pollcb_wakeup_coalesce, NULL);
+    abts_run_test(suite, close_all_sockets, NULL);
+    abts_run_test(suite, create_all_sockets, NULL);
+    abts_run_test(suite, pollset_churn, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, pollset_add_while_polling, NULL);
+    abts_run_test(suite, pollcb_wakeup_while_polling, NULL);
+#endif
+    abts_run_test(suite, close_all_sockets, NULL);
+    abts_run_test(suite, sleep_pollset, NULL);
+    abts_run_test(suite, set_pollset_impl, (void *)APR_POLLSET_DEFAULT);
+
     abts_run_test(suite, pollset_default, NULL);
     abts_run_test(suite, pollcb_default, NULL);
     abts_run_test(suite, justsleep, NULL);
@@ -254,6 +254,61 @@ static void proc_mutex(abts_case *tc, void *data)
     APR_ASSERT_SUCCESS(tc, "Error destroying shared memory block", rv);
 }
 
+#if APR_HAS_FUTEX_SERIALIZE
+/* A child dies holding the mutex, first reaped before the parent tries
+ * to lock it, then while the parent is waiting for it.
+ */
+static void proc_mutex_owner_died(abts_case *tc, void *data)
+{
+    apr_proc_t child;
+    apr_status_t rv;
+    int n;
+
+    rv = apr_proc_mutex_create(&proc_lock, NULL, APR_LOCK_FUTEX, p);
+    APR_ASSERT_SUCCESS(tc, "create the mutex", rv);
+    if (rv != APR_SUCCESS)
+        return;
+    ABTS_STR_EQUAL(tc, "futex", apr_proc_mutex_name(proc_lock));
+
+    for (n = 0; n < 2; n++) {
+        rv = apr_proc_fork(&child, p);
+        if (rv == APR_INCHILD) {
+            apr_initialize();
+            if (apr_proc_mutex_child_init(&proc_lock, NULL, p))
+                _exit(1);
+            if (apr_proc_mutex_lock(proc_lock))
+                _exit(1);
+            apr_sleep(apr_time_from_msec(200));
+            /* no cleanups, the mutex stays locked */
+            _exit(0);
+        }
+        ABTS_ASSERT(tc, "fork failed", rv == APR_INPARENT);
+
+        /* wait for the child to hold the mutex */
+        while ((rv = apr_proc_mutex_trylock(proc_lock)) == APR_SUCCESS) {
+            apr_proc_mutex_unlock(proc_lock);
+            apr_sleep(1000);
+        }
+        ABTS_ASSERT(tc, "mutex should be busy", APR_STATUS_IS_EBUSY(rv));
+
+        if (n == 0) {
+            await_child(tc, &child);
+            rv = apr_proc_mutex_trylock(proc_lock);
+            APR_ASSERT_SUCCESS(tc, "trylock once the owner died", rv);
+        }
+        else {
+            rv = apr_proc_mutex_lock(proc_lock);
+            APR_ASSERT_SUCCESS(tc, "lock once the owner died", rv);
+            await_child(tc, &child);
+        }
+        rv = apr_proc_mutex_unlock(proc_lock);
+        APR_ASSERT_SUCCESS(tc, "unlock", rv);
+    }
+
+    rv = apr_proc_mutex_destroy(proc_lock);
+    APR_ASSERT_SUCCESS(tc, "destroy the mutex", rv);
+}
+#endif
 
 abts_suite *testprocmutex(abts_suite *suite)
 {
@@ -273,6 +328,9 @@ abts_suite *testprocmutex(abts_suite *suite)
 #endif
 #if APR_HAS_PROC_PTHREAD_SERIALIZE
         ,{APR_LOCK_PROC_PTHREAD, "proc_pthread"}
+#endif
+#if APR_HAS_FUTEX_SERIALIZE
+        ,{APR_LOCK_FUTEX, "futex"}
 #endif
         ,{APR_LOCK_DEFAULT_TIMED, "default_timed"}
     };
@@ -282,6 +340,9 @@ abts_suite *testprocmutex(abts_suite *suite)
     for (i = 0; i < sizeof(lockmechs) / sizeof(lockmechs[0]); i++) {
         abts_run_test(suite, proc_mutex, &lockmechs[i]);
     }
+#if APR_HAS_FUTEX_SERIALIZE
+    abts_run_test(suite, proc_mutex_owner_died, NULL);
+#endif
     return suite;
 }
 
@@ -17,6 +17,7 @@
 #include "apu.h"
 #include "apr_queue.h"
 #include "apr_thread_pool.h"
+#include "apr_atomic.h"
 #include "apr_time.h"
 #include "abts.h"
 #include "testutil.h"
@@ -121,6 +122,16 @@ static void test_queue_producer_consumer(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 }
 
+/* The tests run on both kinds of queues, data is non-NULL for lock-free */
+static apr_status_t create_queue(apr_queue_t **q, unsigned int capacity,
+                                 void *data)
+{
+    if (data) {
+        return apr_queue_create_lockfree(q, capacity, p);
+    }
+    return apr_queue_create(q, capacity, p);
+}
+
 static void test_queue_timeout(abts_case *tc, void *data)
 {
     apr_queue_t *q;
@@ -129,7 +140,7 @@ static void test_queue_timeout(abts_case *tc, void *data)
     unsigned int i;
     void *value;
 
-    rv = apr_queue_create(&q, 5, p);
+    rv = create_queue(&q, 5, data);
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 
     for (i = 0; i < 2; ++i) {
@@ -170,6 +181,191 @@ static void test_queue_timeout(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 }
 
+static void test_queue_batch(abts_case *tc, void *data)
+{
+    apr_queue_t *q;
+    apr_status_t rv;
+    void *in[8], *out[8];
+    unsigned int i, n;
+
+    rv = create_queue(&q, 5, data);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    for (i = 0; i < 8; ++i) {
+        in[i] = &in[i];
+    }
+
+    rv = apr_queue_trypush_batch(q, in, 3, &n);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 3, n);
+    rv = apr_queue_push_batch(q, in + 3, 5, &n);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 2, n);
+    ABTS_INT_EQUAL(tc, 5, apr_queue_size(q));
+    rv = apr_queue_trypush_batch(q, in + 5, 3, &n);
+    ABTS_TRUE(tc, APR_STATUS_IS_EAGAIN(rv));
+    ABTS_INT_EQUAL(tc, 0, n);
+
+    rv = apr_queue_pop_batch(q, out, 2, &n);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 2, n);
+    rv = apr_queue_trypush_batch(q, in + 5, 3, &n);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 2, n);
+    rv = apr_queue_trypop_batch(q, out + 2, 6, &n);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 5, n);
+    for (i = 0; i < 7; ++i) {
+        ABTS_PTR_EQUAL(tc, in[i], out[i]);
+    }
+    rv = apr_queue_trypop_batch(q, out, 8, &n);
+    ABTS_TRUE(tc, APR_STATUS_IS_EAGAIN(rv));
+    ABTS_INT_EQUAL(tc, 0, apr_queue_size(q));
+
+    rv = apr_queue_term(q);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_queue_trypush_batch(q, in, 1, &n);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+}
+
+#define MPMC_THREADS 4
+#define MPMC_ITEMS 100000
+
+static apr_uint32_t mpmc_seen[MPMC_THREADS][MPMC_ITEMS];
+static volatile apr_uint32_t mpmc_disorder;
+
+static void * APR_THREAD_FUNC mpmc_producer(apr_thread_t *thd, void *data)
+{
+    apr_uintptr_t id = (apr_uintptr_t)data;
+    void *batch[16];
+    unsigned int i = 0, j, n;
+
+    while (i < MPMC_ITEMS) {
+        /* alternate single and batch pushes */
+        if (i % 3) {
+            if (apr_queue_push(queue, (void *)(id * MPMC_ITEMS + i + 1))
+                    == APR_SUCCESS) {
+                ++i;
+            }
+            continue;
+        }
+        for (j = 0; j < 16 && i + j < MPMC_ITEMS; ++j) {
+            batch[j] = (void *)(id * MPMC_ITEMS + i + j + 1);
+        }
+        if (apr_queue_push_batch(queue, batch, j, &n) == APR_SUCCESS) {
+            i += n;
+        }
+    }
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC mpmc_consumer(apr_thread_t *thd, void *data)
+{
+    apr_uintptr_t last[MPMC_THREADS] = { 0 };
+    void *batch[16];
+    unsigned int j, n;
+    apr_status_t rv;
+
+    for (;;) {
+        rv = apr_queue_pop_batch(queue, batch, 16, &n);
+        if (rv == APR_EOF) {
+            break;
+        }
+        if (rv != APR_SUCCESS) {
+            continue;
+        }
+        for (j = 0; j < n; ++j) {
+            apr_uintptr_t v = (apr_uintptr_t)batch[j] - 1;
+            apr_uintptr_t id = v / MPMC_ITEMS, k = v % MPMC_ITEMS;
+            /* each consumer sees the items of a producer in order */
+            if (k + 1 <= last[id]) {
+                apr_atomic_inc32(&mpmc_disorder);
+            }
+            last[id] = k + 1;
+            apr_atomic_inc32(&mpmc_seen[id][k]);
+        }
+    }
+    return NULL;
+}
+
+static void test_queue_lockfree_mpmc(abts_case *tc, void *data)
+{
+    apr_thread_t *producers[MPMC_THREADS], *consumers[MPMC_THREADS];
+    apr_status_t rv, retval;
+    apr_uintptr_t i;
+    int k, missing = 0;
+
+    rv = apr_queue_create_lockfree(&queue, 64, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    memset(mpmc_seen, 0, sizeof(mpmc_seen));
+    mpmc_disorder = 0;
+
+    for (i = 0; i < MPMC_THREADS; ++i) {
+        rv = apr_thread_create(&consumers[i], NULL, mpmc_consumer, NULL, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_thread_create(&producers[i], NULL, mpmc_producer,
+                               (void *)i, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < MPMC_THREADS; ++i) {
+        apr_thread_join(&retval, producers[i]);
+    }
+
+    /* let the consumers drain the queue before terminating it */
+    for (k = 0; k < 10000 && apr_queue_size(queue); ++k) {
+        apr_sleep(1000);
+    }
+    apr_sleep(10000);
+    rv = apr_queue_term(queue);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    for (i = 0; i < MPMC_THREADS; ++i) {
+        apr_thread_join(&retval, consumers[i]);
+    }
+
+    for (i = 0; i < MPMC_THREADS; ++i) {
+        for (k = 0; k < MPMC_ITEMS; ++k) {
+            if (mpmc_seen[i][k] != 1) {
+                ++missing;
+            }
+        }
+    }
+    ABTS_INT_EQUAL(tc, 0, missing);
+    ABTS_INT_EQUAL(tc, 0, mpmc_disorder);
+}
+
+static void * APR_THREAD_FUNC blocked_pop(apr_thread_t *thd, void *data)
+{
+    void *v;
+    apr_status_t rv = apr_queue_pop(queue, &v);
+
+    apr_thread_exit(thd, rv);
+    return NULL;
+}
+
+static void test_queue_lockfree_interrupt(abts_case *tc, void *data)
+{
+    apr_thread_t *thd;
+    apr_status_t rv, retval;
+
+    rv = apr_queue_create_lockfree(&queue, 4, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_thread_create(&thd, NULL, blocked_pop, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_sleep(apr_time_from_msec(50));
+    rv = apr_queue_interrupt_all(queue);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_thread_join(&retval, thd);
+    ABTS_INT_EQUAL(tc, APR_EINTR, retval);
+
+    rv = apr_thread_create(&thd, NULL, blocked_pop, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_sleep(apr_time_from_msec(50));
+    rv = apr_queue_term(queue);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_thread_join(&retval, thd);
+    ABTS_INT_EQUAL(tc, APR_EOF, retval);
+}
+
 #endif /* APR_HAS_THREADS */
 
 abts_suite *testqueue(abts_suite *suite)
@@ -179,6 +375,11 @@ abts_suite *testqueue(abts_suite *suite)
 #if APR_HAS_THREADS
     abts_run_test(suite, test_queue_producer_consumer, NULL);
     abts_run_test(suite, test_queue_timeout, NULL);
+    abts_run_test(suite, test_queue_timeout, "lockfree");
+    abts_run_test(suite, test_queue_batch, NULL);
+    abts_run_test(suite, test_queue_batch, "lockfree");
+    abts_run_test(suite, test_queue_lockfree_mpmc, NULL);
+    abts_run_test(suite, test_queue_lockfree_interrupt, NULL);
 #endif /* APR_HAS_THREADS */
 
     return suite;
@@ -0,0 +1,345 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testutil.h"
+#include "apr.h"
+#include "apr_atomic.h"
+#include "apr_general.h"
+#include "apr_pools.h"
+#include "apr_thread_proc.h"
+#include "apr_reactor.h"
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
+#if APR_HAS_THREADS
+
+#define NLOOPS 4
+#define NTASKS 1000
+#define REACTOR_PORT 7690
+
+static apr_reactor_t *reactor;
+static volatile apr_uint32_t done;
+
+/* Wait for done to reach n, or a few seconds */
+static int wait_done(apr_uint32_t n)
+{
+    int i;
+
+    for (i = 0; i < 500 && apr_atomic_read32(&done) < n; ++i) {
+        apr_sleep(apr_time_from_msec(10));
+    }
+    return apr_atomic_read32(&done) == n;
+}
+
+static void post_retry(abts_case *tc, apr_reactor_loop_t *loop,
+                       apr_reactor_fn_t func, void *baton)
+{
+    apr_status_t rv;
+
+    while ((rv = apr_reactor_post(loop, func, baton)) == APR_EAGAIN) {
+        apr_thread_yield();
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static void reactor_create(abts_case *tc, void *data)
+{
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_reactor_create(&reactor, 0, 64, p));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_reactor_create(&reactor, NLOOPS,
+                                                       64, p));
+    ABTS_INT_EQUAL(tc, NLOOPS, apr_reactor_nloops(reactor));
+    ABTS_PTR_EQUAL(tc, NULL, apr_reactor_loop_get(reactor, NLOOPS));
+    ABTS_INT_EQUAL(tc, 2, apr_reactor_loop_index(apr_reactor_loop_get(reactor,
+                                                                      2)));
+}
+
+static int order[NTASKS];
+static int norder;
+
+static void ordered_task(apr_reactor_loop_t *loop, void *baton)
+{
+    order[norder++] = (int)(apr_uintptr_t)baton;
+    apr_atomic_inc32(&done);
+}
+
+static void reactor_post(abts_case *tc, void *data)
+{
+    apr_reactor_loop_t *loop = apr_reactor_loop_get(reactor, 1);
+    int i;
+
+    apr_atomic_set32(&done, 0);
+    norder = 0;
+    for (i = 0; i < NTASKS; ++i) {
+        post_retry(tc, loop, ordered_task, (void *)(apr_uintptr_t)i);
+    }
+    ABTS_ASSERT(tc, "tasks not run", wait_done(NTASKS));
+    for (i = 0; i < NTASKS; ++i) {
+        if (order[i] != i) {
+            ABTS_INT_EQUAL(tc, i, order[i]);
+            break;
+        }
+    }
+}
+
+static volatile apr_uint32_t wrong_loop;
+
+static void affine_task(apr_reactor_loop_t *loop, void *baton)
+{
+    if (loop != baton) {
+        apr_atomic_inc32(&wrong_loop);
+    }
+    apr_atomic_inc32(&done);
+}
+
+static void reactor_affinity(abts_case *tc, void *data)
+{
+    int seen[NLOOPS] = { 0 };
+    apr_uint64_t key;
+    int i;
+
+    apr_atomic_set32(&done, 0);
+    apr_atomic_set32(&wrong_loop, 0);
+    for (key = 0; key < 100; ++key) {
+        apr_reactor_loop_t *loop = apr_reactor_loop_for(reactor, key);
+
+        ABTS_PTR_EQUAL(tc, loop, apr_reactor_loop_for(reactor, key));
+        seen[apr_reactor_loop_index(loop)] = 1;
+        post_retry(tc, loop, affine_task, loop);
+    }
+    for (i = 0; i < NLOOPS; ++i) {
+        ABTS_INT_EQUAL(tc, 1, seen[i]);
+    }
+    ABTS_ASSERT(tc, "tasks not run", wait_done(100));
+    ABTS_INT_EQUAL(tc, 0, apr_atomic_read32(&wrong_loop));
+}
+
+static char fired[8];
+static int nfired;
+
+static void timer_fired(apr_reactor_loop_t *loop, void *baton)
+{
+    fired[nfired++] = *(const char *)baton;
+    apr_atomic_inc32(&done);
+}
+
+static void timers_task(apr_reactor_loop_t *loop, void *baton)
+{
+    apr_reactor_timer_t *timer;
+
+    apr_reactor_timer_add(NULL, loop, apr_time_from_msec(60),
+                          timer_fired, "c");
+    apr_reactor_timer_add(NULL, loop, apr_time_from_msec(20),
+                          timer_fired, "a");
+    apr_reactor_timer_add(&timer, loop, apr_time_from_msec(30),
+                          timer_fired, "x");
+    apr_reactor_timer_add(NULL, loop, apr_time_from_msec(40),
+                          timer_fired, "b");
+    if (apr_reactor_timer_cancel(timer) != APR_SUCCESS) {
+        fired[nfired++] = '!';
+    }
+}
+
+static void reactor_timers(abts_case *tc, void *data)
+{
+    apr_time_t start = apr_time_now();
+
+    apr_atomic_set32(&done, 0);
+    nfired = 0;
+    memset(fired, 0, sizeof(fired));
+    post_retry(tc, apr_reactor_loop_get(reactor, 0), timers_task, NULL);
+
+    ABTS_ASSERT(tc, "timers not run", wait_done(3));
+    ABTS_ASSERT(tc, "timers run early",
+                apr_time_now() - start >= apr_time_from_msec(60));
+    /* and the cancelled one never */
+    apr_sleep(apr_time_from_msec(20));
+    ABTS_STR_EQUAL(tc, "abc", fired);
+}
+
+static apr_file_t *readp, *writep;
+static apr_reactor_io_t *pipe_io;
+static char pipe_data[16];
+
+static void pipe_readable(apr_reactor_loop_t *loop, const apr_pollfd_t *pfd,
+                          void *baton)
+{
+    apr_size_t len = sizeof(pipe_data) - 1;
+
+    if (pfd->desc.f == baton && (pfd->rtnevents & APR_POLLIN)
+            && apr_file_read(pfd->desc.f, pipe_data, &len) == APR_SUCCESS) {
+        pipe_data[len] = '\0';
+    }
+    apr_reactor_io_remove(pipe_io);
+    apr_atomic_inc32(&done);
+}
+
+static void pipe_watch(apr_reactor_loop_t *loop, void *baton)
+{
+    apr_pollfd_t pfd;
+
+    pfd.p = p;
+    pfd.desc_type = APR_POLL_FILE;
+    pfd.reqevents = APR_POLLIN;
+    pfd.desc.f = readp;
+    pfd.client_data = NULL;
+    if (apr_reactor_io_add(&pipe_io, loop, &pfd, pipe_readable,
+                           readp) == APR_SUCCESS) {
+        apr_atomic_inc32(&done);
+    }
+}
+
+static void reactor_io(abts_case *tc, void *data)
+{
+    apr_size_t len = 5;
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_file_pipe_create_ex(&readp, &writep,
+                                           APR_FULL_NONBLOCK, p));
+    apr_atomic_set32(&done, 0);
+    post_retry(tc, apr_reactor_loop_get(reactor, 3), pipe_watch, NULL);
+    ABTS_ASSERT(tc, "not watched", wait_done(1));
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_file_write(writep, "hello", &len));
+    ABTS_ASSERT(tc, "not read", wait_done(2));
+    ABTS_STR_EQUAL(tc, "hello", pipe_data);
+
+    /* removed, nothing more */
+    len = 5;
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_file_write(writep, "again", &len));
+    apr_sleep(apr_time_from_msec(50));
+    ABTS_INT_EQUAL(tc, 2, apr_atomic_read32(&done));
+
+    apr_file_close(writep);
+    apr_file_close(readp);
+}
+
+static void accepted(apr_reactor_loop_t *loop, apr_socket_t *sock,
+                     apr_pool_t *pool, void *baton)
+{
+    apr_size_t len = 1;
+
+    apr_socket_send(sock, "x", &len);
+    apr_socket_close(sock);
+    apr_pool_destroy(pool);
+    apr_atomic_inc32(&done);
+}
+
+static void reactor_listen(abts_case *tc, void *data)
+{
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+    int i;
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, REACTOR_PORT,
+                               0, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't get address", rv);
+
+    apr_atomic_set32(&done, 0);
+    rv = apr_reactor_listen(reactor, sa, 16, accepted, NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't listen", rv);
+
+    for (i = 0; i < 20; ++i) {
+        apr_socket_t *sock;
+        apr_size_t len = 1;
+        char c = 0;
+
+        rv = apr_socket_create(&sock, sa->family, SOCK_STREAM,
+                               APR_PROTO_TCP, p);
+        APR_ASSERT_SUCCESS(tc, "Couldn't create socket", rv);
+        apr_socket_timeout_set(sock, apr_time_from_sec(5));
+        rv = apr_socket_connect(sock, sa);
+        APR_ASSERT_SUCCESS(tc, "Couldn't connect", rv);
+        rv = apr_socket_recv(sock, &c, &len);
+        APR_ASSERT_SUCCESS(tc, "Couldn't receive", rv);
+        ABTS_INT_EQUAL(tc, 'x', c);
+        apr_socket_close(sock);
+    }
+    ABTS_ASSERT(tc, "connections not accepted", wait_done(20));
+}
+
+static volatile apr_status_t loop_listen_rv;
+
+static void listen_task(apr_reactor_loop_t *loop, void *baton)
+{
+    loop_listen_rv = apr_reactor_listen(apr_reactor_loop_reactor(loop),
+                                        baton, 16, accepted, NULL);
+    apr_atomic_inc32(&done);
+}
+
+static void reactor_listen_from_loop(abts_case *tc, void *data)
+{
+    apr_sockaddr_t *sa;
+    apr_socket_t *sock;
+    apr_size_t len = 1;
+    apr_status_t rv;
+    char c = 0;
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, REACTOR_PORT + 1,
+                               0, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't get address", rv);
+
+    /* the loop running the call watches its socket itself */
+    apr_atomic_set32(&done, 0);
+    post_retry(tc, apr_reactor_loop_get(reactor, 2), listen_task, sa);
+    ABTS_ASSERT(tc, "not listening", wait_done(1));
+    APR_ASSERT_SUCCESS(tc, "Couldn't listen", loop_listen_rv);
+
+    rv = apr_socket_create(&sock, sa->family, SOCK_STREAM, APR_PROTO_TCP, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't create socket", rv);
+    apr_socket_timeout_set(sock, apr_time_from_sec(5));
+    rv = apr_socket_connect(sock, sa);
+    APR_ASSERT_SUCCESS(tc, "Couldn't connect", rv);
+    rv = apr_socket_recv(sock, &c, &len);
+    APR_ASSERT_SUCCESS(tc, "Couldn't receive", rv);
+    ABTS_INT_EQUAL(tc, 'x', c);
+    apr_socket_close(sock);
+    ABTS_ASSERT(tc, "connection not accepted", wait_done(2));
+}
+
+static void reactor_destroy(abts_case *tc, void *data)
+{
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_reactor_destroy(reactor));
+}
+
+#endif /* APR_HAS_THREADS */
+
+#if !APR_HAS_THREADS
+static void threads_not_impl(abts_case *tc, void *data)
+{
+    ABTS_NOT_IMPL(tc, "Threads not implemented on this platform");
+}
+#endif
+
+abts_suite *testreactor(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+#if !APR_HAS_THREADS
+    abts_run_test(suite, threads_not_impl, NULL);
+#else
+    abts_run_test(suite, reactor_create, NULL);
+    abts_run_test(suite, reactor_post, NULL);
+    abts_run_test(suite, reactor_affinity, NULL);
+    abts_run_test(suite, reactor_timers, NULL);
+    abts_run_test(suite, reactor_io, NULL);
+    abts_run_test(suite, reactor_listen, NULL);
+    abts_run_test(suite, reactor_listen_from_loop, NULL);
+    abts_run_test(suite, reactor_destroy, NULL);
+#endif
+
+    return suite;
+}
@@ -40,6 +40,10 @@
 #define CONSTRUCT_SLEEP_TIME  APR_TIME_C(2500) /* 2.5 ms */
 #define DESTRUCT_SLEEP_TIME   APR_TIME_C(1000) /* 1.0 ms */
 #define WORK_DELAY_SLEEP_TIME APR_TIME_C(1500) /* 1.5 ms */
+#define RESLIST_SHARDS 4
+
+/* test data flag, not an APR_RESLIST_ACQUIRE_* one */
+#define TEST_SHARDED 0x100
 
 typedef struct {
     apr_interval_time_t sleep_upon_construct;
@@ -221,7 +225,8 @@ static void test_reslist(abts_case *tc, void *data)
     my_parameters_t *params;
     apr_thread_pool_t *thrp;
     my_thread_info_t thread_info[CONSUMER_THREADS];
-    int acquire_flags = (int)(apr_uintptr_t)data;
+    int acquire_flags = (int)(apr_uintptr_t)data & ~TEST_SHARDED;
+    int sharded = (int)(apr_uintptr_t)data & TEST_SHARDED;
 
     rv = apr_thread_pool_create(&thrp, CONSUMER_THREADS/2, CONSUMER_THREADS, p);
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
@@ -233,9 +238,17 @@ static void test_reslist(abts_case *tc, void *data)
     params->sleep_upon_destruct = DESTRUCT_SLEEP_TIME;
 
     /* We're going to want 10 blocks of data from our target rmm. */
-    rv = apr_reslist_create(&rl, RESLIST_MIN, RESLIST_SMAX, RESLIST_HMAX,
-                            RESLIST_TTL, my_constructor, my_destructor,
-                            params, p);
+    if (sharded) {
+        rv = apr_reslist_create_sharded(&rl, RESLIST_MIN, RESLIST_SMAX,
+                                        RESLIST_HMAX, RESLIST_TTL,
+                                        my_constructor, my_destructor,
+                                        params, RESLIST_SHARDS, p);
+    }
+    else {
+        rv = apr_reslist_create(&rl, RESLIST_MIN, RESLIST_SMAX, RESLIST_HMAX,
+                                RESLIST_TTL, my_constructor, my_destructor,
+                                params, p);
+    }
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 
     for (i = 0; i < CONSUMER_THREADS; i++) {
@@ -299,6 +312,84 @@ static void test_reslist_no_ttl(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, params->d_count, 1);
 }
 
+static void *affinity_found;
+
+static void * APR_THREAD_FUNC affinity_thread(apr_thread_t *thd, void *data)
+{
+    apr_reslist_t *rl = data;
+    void *res;
+
+    if (apr_reslist_acquire(rl, &res) == APR_SUCCESS) {
+        affinity_found = res;
+        apr_reslist_release(rl, res);
+    }
+    return NULL;
+}
+
+static void test_reslist_sharded_affinity(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_reslist_t *rl;
+    apr_thread_t *thd;
+    my_parameters_t *params;
+    my_resource_t *res[4], *vp;
+    int i;
+
+    params = apr_pcalloc(p, sizeof(*params));
+
+    ABTS_INT_EQUAL(tc, APR_EINVAL,
+                   apr_reslist_create_sharded(&rl, 0, 4, 4, 0, my_constructor,
+                                              my_destructor, params, 0, p));
+    rv = apr_reslist_create_sharded(&rl, 0, 4, 4, 0, my_constructor,
+                                    my_destructor, params, 2, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < 4; i++) {
+        rv = apr_reslist_acquire(rl, (void **)&res[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    ABTS_INT_EQUAL(tc, 4, apr_reslist_acquired_count(rl));
+
+    /* hmax reached */
+    apr_reslist_timeout_set(rl, 1000);
+    rv = apr_reslist_acquire(rl, (void **)&vp);
+    ABTS_TRUE(tc, APR_STATUS_IS_TIMEUP(rv));
+
+    /* the thread gets back what it last released */
+    for (i = 0; i < 4; i++) {
+        rv = apr_reslist_release(rl, res[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_reslist_acquire(rl, (void **)&vp);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_PTR_EQUAL(tc, res[i], vp);
+    }
+    for (i = 0; i < 4; i++) {
+        apr_reslist_release(rl, res[i]);
+    }
+    ABTS_INT_EQUAL(tc, 0, apr_reslist_acquired_count(rl));
+
+    /* other threads find the released resources wherever they are */
+    for (i = 0; i < 8; i++) {
+        affinity_found = NULL;
+        rv = apr_thread_create(&thd, NULL, affinity_thread, rl, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        apr_thread_join(&rv, thd);
+        ABTS_PTR_NOTNULL(tc, affinity_found);
+    }
+    ABTS_INT_EQUAL(tc, 4, params->c_count);
+
+    /* a bad resource makes room for a new one */
+    rv = apr_reslist_acquire(rl, (void **)&vp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_reslist_invalidate(rl, vp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, params->d_count);
+
+    rv = apr_reslist_destroy(rl);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 4, params->d_count);
+}
+
 #endif /* APR_HAS_THREADS */
 
 abts_suite *testreslist(abts_suite *suite)
@@ -311,6 +402,13 @@ abts_suite *testreslist(abts_suite *suite)
     abts_run_test(suite, test_reslist,
                   (void*)(apr_uintptr_t)APR_RESLIST_ACQUIRE_FIFO);
     abts_run_test(suite, test_reslist_no_ttl, NULL);
+    abts_run_test(suite, test_reslist,
+                  (void*)(apr_uintptr_t)(APR_RESLIST_ACQUIRE_LIFO
+                                         | TEST_SHARDED));
+    abts_run_test(suite, test_reslist,
+                  (void*)(apr_uintptr_t)(APR_RESLIST_ACQUIRE_FIFO
+                                         | TEST_SHARDED));
+    abts_run_test(suite, test_reslist_sharded_affinity, NULL);
 #endif
 
     return suite;
@@ -192,6 +192,573 @@ static void sendto_receivefrom6(abts_case *tc, void *data)
 }
 #endif
 
+#define NMSGS 8
+
+static void udp_pair(abts_case *tc, apr_socket_t **rsock, apr_socket_t **ssock,
+                     apr_sockaddr_t **to)
+{
+    apr_sockaddr_t *from;
+    apr_status_t rv;
+
+    rv = apr_sockaddr_info_get(to, "127.0.0.1", APR_INET, 7773, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Could not get address", rv);
+    rv = apr_sockaddr_info_get(&from, "127.0.0.1", APR_INET, 7774, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Could not get address", rv);
+
+    rv = apr_socket_create(rsock, APR_INET, SOCK_DGRAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Could not create socket", rv);
+    rv = apr_socket_create(ssock, APR_INET, SOCK_DGRAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Could not create socket2", rv);
+    rv = apr_socket_opt_set(*rsock, APR_SO_REUSEADDR, 1);
+    APR_ASSERT_SUCCESS(tc, "Could not set REUSEADDR on socket", rv);
+    rv = apr_socket_opt_set(*ssock, APR_SO_REUSEADDR, 1);
+    APR_ASSERT_SUCCESS(tc, "Could not set REUSEADDR on socket2", rv);
+    rv = apr_socket_bind(*rsock, *to);
+    APR_ASSERT_SUCCESS(tc, "Could not bind socket", rv);
+    rv = apr_socket_bind(*ssock, from);
+    APR_ASSERT_SUCCESS(tc, "Could not bind socket2", rv);
+    rv = apr_socket_timeout_set(*rsock, apr_time_from_sec(5));
+    APR_ASSERT_SUCCESS(tc, "Could not set timeout", rv);
+}
+
+static void sendmmsg_recvmmsg(abts_case *tc, void *data)
+{
+    apr_socket_t *sock, *sock2;
+    apr_sockaddr_t *to;
+    apr_socket_msg_t msgs[NMSGS];
+    struct iovec vecs[NMSGS][2];
+    char bufs[NMSGS][16];
+    apr_uint32_t n, total;
+    apr_status_t rv;
+    int i;
+
+    udp_pair(tc, &sock, &sock2, &to);
+
+    for (i = 0; i < NMSGS; ++i) {
+        vecs[i][0].iov_base = "datagram ";
+        vecs[i][0].iov_len = 9;
+        vecs[i][1].iov_base = apr_itoa(p, i);
+        vecs[i][1].iov_len = 1;
+        msgs[i].vec = vecs[i];
+        msgs[i].nvec = 2;
+        msgs[i].addr = to;
+        msgs[i].segment_size = 0;
+    }
+    n = NMSGS;
+    rv = apr_socket_sendmmsg(sock2, 0, msgs, &n);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, NMSGS, n);
+    ABTS_SIZE_EQUAL(tc, 10, msgs[NMSGS - 1].len);
+
+    for (i = 0; i < NMSGS; ++i) {
+        vecs[i][0].iov_base = bufs[i];
+        vecs[i][0].iov_len = sizeof(bufs[i]) - 1;
+        msgs[i].nvec = 1;
+        apr_sockaddr_info_get(&msgs[i].addr, "127.1.2.3", APR_INET, 4242,
+                              0, p);
+    }
+    /* all the datagrams are queued, but may be taken in several calls */
+    for (total = 0; total < NMSGS; total += n) {
+        n = NMSGS - total;
+        rv = apr_socket_recvmmsg(sock, 0, msgs + total, &n);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    for (i = 0; i < (int)total; ++i) {
+        char *ip_addr;
+
+        bufs[i][msgs[i].len] = '\0';
+        ABTS_STR_EQUAL(tc, apr_psprintf(p, "datagram %d", i), bufs[i]);
+        apr_sockaddr_ip_get(&ip_addr, msgs[i].addr);
+        ABTS_STR_EQUAL(tc, "127.0.0.1", ip_addr);
+        ABTS_INT_EQUAL(tc, 7774, msgs[i].addr->port);
+    }
+
+    /* nothing left */
+    apr_socket_timeout_set(sock, 0);
+    n = NMSGS;
+    rv = apr_socket_recvmmsg(sock, 0, msgs, &n);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_EAGAIN(rv));
+    ABTS_INT_EQUAL(tc, 0, n);
+
+    apr_socket_close(sock);
+    apr_socket_close(sock2);
+}
+
+static void udp_segmentation(abts_case *tc, void *data)
+{
+    apr_socket_t *sock, *sock2;
+    apr_sockaddr_t *to;
+    apr_socket_msg_t msg, msgs[4];
+    struct iovec vec, vecs[4];
+    static char buf[3000], bufs[4][4000];
+    apr_uint32_t n, total;
+    apr_size_t len;
+    apr_status_t rv;
+    int i;
+
+    udp_pair(tc, &sock, &sock2, &to);
+
+    /* one send, three datagrams */
+    memset(buf, 'x', sizeof(buf));
+    vec.iov_base = buf;
+    vec.iov_len = sizeof(buf);
+    msg.vec = &vec;
+    msg.nvec = 1;
+    msg.addr = to;
+    msg.segment_size = 1000;
+    n = 1;
+    rv = apr_socket_sendmmsg(sock2, 0, &msg, &n);
+    if (rv == APR_ENOTIMPL || rv == EIO || rv == EINVAL) {
+        ABTS_NOT_IMPL(tc, "UDP segmentation offload not supported");
+        apr_socket_close(sock);
+        apr_socket_close(sock2);
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, n);
+    ABTS_SIZE_EQUAL(tc, sizeof(buf), msg.len);
+
+    for (i = 0; i < 4; ++i) {
+        vecs[i].iov_base = bufs[i];
+        vecs[i].iov_len = sizeof(bufs[i]);
+        msgs[i].vec = &vecs[i];
+        msgs[i].nvec = 1;
+        msgs[i].addr = NULL;
+    }
+    for (total = 0; total < 3; total += n) {
+        n = 3 - total;
+        rv = apr_socket_recvmmsg(sock, 0, msgs + total, &n);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    for (i = 0; i < (int)total; ++i) {
+        ABTS_SIZE_EQUAL(tc, 1000, msgs[i].len);
+        ABTS_INT_EQUAL(tc, 0, msgs[i].segment_size);
+    }
+
+    /* with GRO, the same datagrams may be received at once */
+    rv = apr_socket_opt_set(sock, APR_UDP_GRO, 1);
+    if (rv == APR_SUCCESS) {
+        n = 1;
+        rv = apr_socket_sendmmsg(sock2, 0, &msg, &n);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        for (len = 0; len < sizeof(buf); len += msgs[0].len) {
+            n = 1;
+            rv = apr_socket_recvmmsg(sock, 0, msgs, &n);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            if (rv != APR_SUCCESS) {
+                break;
+            }
+            if (msgs[0].len > 1000) {
+                ABTS_INT_EQUAL(tc, 1000, msgs[0].segment_size);
+            }
+        }
+        ABTS_SIZE_EQUAL(tc, sizeof(buf), len);
+    }
+
+    apr_socket_close(sock);
+    apr_socket_close(sock2);
+}
+
+static void tcp_pair(abts_case *tc, apr_port_t port, apr_socket_t **client,
+                     apr_socket_t **conn)
+{
+    apr_socket_t *server;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, port, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Could not get address", rv);
+    rv = apr_socket_create(&server, APR_INET, SOCK_STREAM, APR_PROTO_TCP, p);
+    APR_ASSERT_SUCCESS(tc, "Could not create socket", rv);
+    rv = apr_socket_opt_set(server, APR_SO_REUSEADDR, 1);
+    APR_ASSERT_SUCCESS(tc, "Could not set REUSEADDR on socket", rv);
+    rv = apr_socket_bind(server, sa);
+    APR_ASSERT_SUCCESS(tc, "Could not bind socket", rv);
+    rv = apr_socket_listen(server, 1);
+    APR_ASSERT_SUCCESS(tc, "Could not listen", rv);
+    rv = apr_socket_create(client, APR_INET, SOCK_STREAM, APR_PROTO_TCP, p);
+    APR_ASSERT_SUCCESS(tc, "Could not create socket2", rv);
+    rv = apr_socket_connect(*client, sa);
+    APR_ASSERT_SUCCESS(tc, "Could not connect", rv);
+    rv = apr_socket_accept(conn, server, p);
+    APR_ASSERT_SUCCESS(tc, "Could not accept", rv);
+    apr_socket_close(server);
+}
+
+#define ZC_CHUNK 65536
+#define ZC_CHUNKS 16
+
+static int zc_released;
+
+static void zc_release_count(void *baton)
+{
+    ++zc_released;
+}
+
+static void zc_release_pool(void *baton)
+{
+    apr_pool_destroy(baton);
+    ++zc_released;
+}
+
+static void send_zerocopy(abts_case *tc, void *data)
+{
+    apr_socket_t *client, *conn;
+    apr_pool_t *subp;
+    apr_uint32_t pending;
+    apr_size_t len, total;
+    apr_status_t rv;
+    char *buf, *rbuf;
+    int i, nsends = 0;
+
+    tcp_pair(tc, 7775, &client, &conn);
+    rv = apr_socket_timeout_set(client, apr_time_from_sec(5));
+    APR_ASSERT_SUCCESS(tc, "Could not set timeout", rv);
+    rv = apr_socket_timeout_set(conn, apr_time_from_sec(5));
+    APR_ASSERT_SUCCESS(tc, "Could not set timeout", rv);
+
+    /* the buffer lives in a pool destroyed once the kernel is done */
+    zc_released = 0;
+    apr_pool_create(&subp, p);
+    buf = apr_palloc(subp, ZC_CHUNK * ZC_CHUNKS);
+    for (i = 0; i < ZC_CHUNK * ZC_CHUNKS; ++i) {
+        buf[i] = (char)(i % 251);
+    }
+    rbuf = apr_palloc(p, ZC_CHUNK);
+    for (total = 0; total < ZC_CHUNK * ZC_CHUNKS; total += len) {
+        apr_size_t off, n;
+
+        len = ZC_CHUNK * ZC_CHUNKS - total;
+        if (len > ZC_CHUNK) {
+            len = ZC_CHUNK;
+        }
+        /* a partial send is continued with the rest of the chunk */
+        for (off = 0; off < len; off += n) {
+            n = len - off;
+            rv = apr_socket_send_zc(client, buf + total + off, &n,
+                                    total + len < ZC_CHUNK * ZC_CHUNKS
+                                        ? zc_release_count : zc_release_pool,
+                                    subp);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            if (rv != APR_SUCCESS) {
+                break;
+            }
+        }
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        ++nsends;
+
+        for (off = 0; off < len; off += n) {
+            n = len - off;
+            rv = apr_socket_recv(conn, rbuf + off, &n);
+            APR_ASSERT_SUCCESS(tc, "Could not receive", rv);
+        }
+        ABTS_ASSERT(tc, "data corrupted",
+                    memcmp(rbuf, buf + total, len) == 0);
+    }
+
+    rv = apr_socket_zc_reap(client, apr_time_from_sec(5), &pending);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 0, pending);
+    ABTS_INT_EQUAL(tc, nsends, zc_released);
+
+    /* small sends are copied, and released at once */
+    len = 5;
+    rv = apr_socket_send_zc(client, "hello", &len, zc_release_count, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, nsends + 1, zc_released);
+    len = 5;
+    rv = apr_socket_recv(conn, rbuf, &len);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 5, len);
+
+    apr_socket_close(conn);
+    apr_socket_close(client);
+    rv = apr_socket_zc_reap(client, 0, &pending);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 0, pending);
+}
+
+#define SPLICE_TOTAL (1024 * 1024)
+
+static void socket_splice(abts_case *tc, void *data)
+{
+    apr_socket_t *in, *src, *dst, *out;
+    apr_size_t sent = 0, received = 0, n;
+    apr_status_t rv;
+    char *buf, *rbuf;
+    int i, stalled = 0;
+
+    /* in -> src, relayed to dst -> out */
+    tcp_pair(tc, 7776, &in, &src);
+    tcp_pair(tc, 7777, &dst, &out);
+    apr_socket_timeout_set(in, 0);
+    apr_socket_timeout_set(src, 0);
+    apr_socket_timeout_set(dst, 0);
+    apr_socket_timeout_set(out, 0);
+    /* small buffers between dst and out, for dst to fill up quickly */
+    apr_socket_opt_set(dst, APR_SO_SNDBUF, 16384);
+    apr_socket_opt_set(out, APR_SO_RCVBUF, 16384);
+
+    buf = apr_palloc(p, SPLICE_TOTAL);
+    rbuf = apr_palloc(p, SPLICE_TOTAL);
+    for (i = 0; i < SPLICE_TOTAL; ++i) {
+        buf[i] = (char)(i % 251);
+    }
+
+    /* out is not read until dst can't take more, so the relay keeps some */
+    for (i = 0; i < 1000000 && received < SPLICE_TOTAL; ++i) {
+        if (sent < SPLICE_TOTAL) {
+            n = SPLICE_TOTAL - sent;
+            apr_socket_send(in, buf + sent, &n);
+            sent += n;
+        }
+        n = SPLICE_TOTAL;
+        rv = apr_socket_splice(src, dst, &n);
+        if (rv != APR_SUCCESS) {
+            ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_EAGAIN(rv));
+            ABTS_SIZE_EQUAL(tc, 0, n);
+            stalled = 1;
+        }
+        if (stalled) {
+            n = SPLICE_TOTAL - received;
+            apr_socket_recv(out, rbuf + received, &n);
+            received += n;
+        }
+    }
+    ABTS_SIZE_EQUAL(tc, SPLICE_TOTAL, received);
+    ABTS_ASSERT(tc, "data corrupted", memcmp(buf, rbuf, received) == 0);
+
+    /* shut down src, reported once everything is relayed */
+    apr_socket_close(in);
+    apr_socket_timeout_set(src, apr_time_from_sec(5));
+    n = SPLICE_TOTAL;
+    rv = apr_socket_splice(src, dst, &n);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    ABTS_SIZE_EQUAL(tc, 0, n);
+
+    apr_socket_close(src);
+    apr_socket_close(dst);
+    apr_socket_close(out);
+}
+
+#define ZC_PARTIAL_TOTAL (1024 * 1024)
+
+static void send_zerocopy_partial(abts_case *tc, void *data)
+{
+    apr_socket_t *client, *conn;
+    apr_pool_t *subp;
+    apr_uint32_t pending;
+    apr_size_t sent = 0, received = 0, n;
+    apr_status_t rv;
+    char *buf, *rbuf;
+    int i, partial = 0;
+
+    tcp_pair(tc, 7781, &client, &conn);
+    apr_socket_timeout_set(client, 0);
+    apr_socket_timeout_set(conn, 0);
+    /* a small send buffer, for the sends to be partial */
+    apr_socket_opt_set(client, APR_SO_SNDBUF, 16384);
+
+    zc_released = 0;
+    apr_pool_create(&subp, p);
+    buf = apr_palloc(subp, ZC_PARTIAL_TOTAL);
+    for (i = 0; i < ZC_PARTIAL_TOTAL; ++i) {
+        buf[i] = (char)(i % 251);
+    }
+    rbuf = apr_palloc(p, ZC_PARTIAL_TOTAL);
+
+    /* the retries continue the buffer, released once */
+    for (i = 0; i < 1000000 && received < ZC_PARTIAL_TOTAL; ++i) {
+        if (sent < ZC_PARTIAL_TOTAL) {
+            n = ZC_PARTIAL_TOTAL - sent;
+            rv = apr_socket_send_zc(client, buf + sent, &n,
+                                    zc_release_pool, subp);
+            ABTS_ASSERT(tc, "send failed",
+                        rv == APR_SUCCESS || APR_STATUS_IS_EAGAIN(rv));
+            sent += n;
+            if (sent < ZC_PARTIAL_TOTAL) {
+                partial |= (n > 0);
+                ABTS_INT_EQUAL(tc, 0, zc_released);
+            }
+        }
+        n = ZC_PARTIAL_TOTAL - received;
+        apr_socket_recv(conn, rbuf + received, &n);
+        received += n;
+    }
+    ABTS_ASSERT(tc, "no partial send", partial);
+    ABTS_SIZE_EQUAL(tc, ZC_PARTIAL_TOTAL, received);
+    ABTS_ASSERT(tc, "data corrupted",
+                memcmp(rbuf, buf, ZC_PARTIAL_TOTAL) == 0);
+    rv = apr_socket_zc_reap(client, apr_time_from_sec(5), &pending);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 0, pending);
+    ABTS_INT_EQUAL(tc, 1, zc_released);
+
+    /* a buffer given up after a partial send, with a zero length */
+    buf = apr_palloc(p, ZC_PARTIAL_TOTAL);
+    memset(buf, 'x', ZC_PARTIAL_TOTAL);
+    n = ZC_PARTIAL_TOTAL;
+    rv = apr_socket_send_zc(client, buf, &n, zc_release_count, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_ASSERT(tc, "not a partial send", n < ZC_PARTIAL_TOTAL);
+    ABTS_INT_EQUAL(tc, 1, zc_released);
+    n = 0;
+    rv = apr_socket_send_zc(client, buf, &n, zc_release_count, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_socket_zc_reap(client, apr_time_from_sec(5), &pending);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 0, pending);
+    ABTS_INT_EQUAL(tc, 2, zc_released);
+
+    apr_socket_close(client);
+    apr_socket_close(conn);
+}
+
+static void tls_install(abts_case *tc, apr_socket_t *sock, int direction,
+                        const apr_socket_tls_keys_t *keys)
+{
+    apr_status_t rv = apr_socket_tls_install(sock, direction, keys);
+
+    if (rv != APR_ENOTIMPL) {
+        APR_ASSERT_SUCCESS(tc, "Could not install TLS keys", rv);
+    }
+}
+
+static void socket_tls(abts_case *tc, void *data)
+{
+    static const unsigned char key1[16] = "0123456789abcdef";
+    static const unsigned char key2[16] = "fedcba9876543210";
+    static const unsigned char iv[12] = "ivivivivivi";
+    apr_socket_tls_keys_t keys1, keys2;
+    apr_socket_t *client, *conn;
+    apr_size_t n;
+    apr_status_t rv;
+    char rbuf[16];
+
+    tcp_pair(tc, 7778, &client, &conn);
+    apr_socket_timeout_set(client, apr_time_from_sec(5));
+    apr_socket_timeout_set(conn, apr_time_from_sec(5));
+
+    keys1.version = APR_SOCKET_TLS_1_2;
+    keys1.cipher = APR_SOCKET_TLS_AES_GCM_128;
+    keys1.key = key1;
+    keys1.iv = iv;
+    keys1.seq = 0;
+    keys2 = keys1;
+    keys2.key = key2;
+    keys2.seq = 1000;
+
+    rv = apr_socket_tls_install(client, 0, &keys1);
+    ABTS_ASSERT(tc, "bad direction accepted",
+                rv == APR_EINVAL || rv == APR_ENOTIMPL);
+
+    rv = apr_socket_tls_install(client, APR_SOCKET_TLS_TX, &keys1);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "Kernel TLS not supported");
+    }
+    else {
+        APR_ASSERT_SUCCESS(tc, "Could not install TLS keys", rv);
+        /* each end decrypts what the other encrypts */
+        tls_install(tc, conn, APR_SOCKET_TLS_RX, &keys1);
+        tls_install(tc, conn, APR_SOCKET_TLS_TX, &keys2);
+        tls_install(tc, client, APR_SOCKET_TLS_RX, &keys2);
+
+        n = 5;
+        rv = apr_socket_send(client, "hello", &n);
+        APR_ASSERT_SUCCESS(tc, "Could not send", rv);
+        n = sizeof(rbuf);
+        rv = apr_socket_recv(conn, rbuf, &n);
+        APR_ASSERT_SUCCESS(tc, "Could not receive", rv);
+        ABTS_SIZE_EQUAL(tc, 5, n);
+        ABTS_ASSERT(tc, "data corrupted", memcmp(rbuf, "hello", 5) == 0);
+
+        n = 5;
+        rv = apr_socket_send(conn, "world", &n);
+        APR_ASSERT_SUCCESS(tc, "Could not send", rv);
+        n = sizeof(rbuf);
+        rv = apr_socket_recv(client, rbuf, &n);
+        APR_ASSERT_SUCCESS(tc, "Could not receive", rv);
+        ABTS_SIZE_EQUAL(tc, 5, n);
+        ABTS_ASSERT(tc, "data corrupted", memcmp(rbuf, "world", 5) == 0);
+    }
+
+    apr_socket_close(client);
+    apr_socket_close(conn);
+}
+
+static void socket_profile(abts_case *tc, void *data)
+{
+    static const apr_socket_optval_t bulk_opts[] = {
+        { APR_SO_SNDBUF, 65536 },
+        { APR_SO_RCVBUF, 65536 },
+        { APR_SO_INCOMING_CPU, 0 }
+    };
+    static const apr_socket_optval_t bad_opts[] = {
+        { APR_TCP_NODELAY, 0 },
+        /* a bit no option uses */
+        { 0x40000000, 1 },
+        { APR_SO_KEEPALIVE, 1 }
+    };
+    apr_socket_profile_t bulk = { "bulk", bulk_opts, 3 };
+    apr_socket_profile_t bad = { "bad", bad_opts, 3 };
+    const apr_socket_profile_t *profile;
+    apr_socket_t *listener, *client, *conn;
+    apr_sockaddr_t *sa;
+    apr_int32_t unsupported, on;
+    apr_status_t rv;
+
+    ABTS_PTR_EQUAL(tc, NULL, apr_socket_profile_get("no-such-profile"));
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 7779, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Could not get address", rv);
+    rv = apr_socket_create(&listener, APR_INET, SOCK_STREAM, APR_PROTO_TCP,
+                           p);
+    APR_ASSERT_SUCCESS(tc, "Could not create socket", rv);
+    profile = apr_socket_profile_get("low-latency-listen");
+    ABTS_PTR_NOTNULL(tc, profile);
+    rv = apr_socket_profile_apply(listener, profile, &unsupported);
+    APR_ASSERT_SUCCESS(tc, "Could not apply listen profile", rv);
+    ABTS_INT_EQUAL(tc, 0, unsupported & ~(APR_TCP_DEFER_ACCEPT
+                                          | APR_TCP_FASTOPEN));
+    apr_socket_close(listener);
+
+    tcp_pair(tc, 7780, &client, &conn);
+    profile = apr_socket_profile_get("low-latency");
+    ABTS_PTR_NOTNULL(tc, profile);
+    rv = apr_socket_profile_apply(conn, profile, &unsupported);
+    APR_ASSERT_SUCCESS(tc, "Could not apply profile", rv);
+    ABTS_INT_EQUAL(tc, 0, unsupported & ~(APR_TCP_QUICKACK
+                                          | APR_SO_BUSY_POLL));
+    rv = apr_socket_opt_get(conn, APR_TCP_NODELAY, &on);
+    APR_ASSERT_SUCCESS(tc, "Could not get NODELAY", rv);
+    ABTS_INT_EQUAL(tc, 1, on);
+
+    rv = apr_socket_profile_apply(conn, &bulk, NULL);
+    APR_ASSERT_SUCCESS(tc, "Could not apply own profile", rv);
+
+    /* stops at the first error */
+    rv = apr_socket_profile_apply(conn, &bad, &unsupported);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_socket_opt_get(conn, APR_TCP_NODELAY, &on);
+    APR_ASSERT_SUCCESS(tc, "Could not get NODELAY", rv);
+    ABTS_INT_EQUAL(tc, 0, on);
+    rv = apr_socket_opt_get(conn, APR_SO_KEEPALIVE, &on);
+    APR_ASSERT_SUCCESS(tc, "Could not get KEEPALIVE", rv);
+    ABTS_INT_EQUAL(tc, 0, on);
+
+    apr_socket_close(client);
+    apr_socket_close(conn);
+}
+
 static void socket_userdata(abts_case *tc, void *data)
 {
     apr_socket_t *sock1, *sock2;
@@ -225,6 +792,13 @@ abts_suite *testsockets(abts_suite *suite)
     abts_run_test(suite, udp_socket, NULL);
 
     abts_run_test(suite, sendto_receivefrom, NULL);
+    abts_run_test(suite, sendmmsg_recvmmsg, NULL);
+    abts_run_test(suite, udp_segmentation, NULL);
+    abts_run_test(suite, send_zerocopy, NULL);
+    abts_run_test(suite, socket_splice, NULL);
+    abts_run_test(suite, send_zerocopy_partial, NULL);
+    abts_run_test(suite, socket_tls, NULL);
+    abts_run_test(suite, socket_profile, NULL);
 
 #if APR_HAVE_IPV6
     abts_run_test(suite, tcp6_socket, NULL);
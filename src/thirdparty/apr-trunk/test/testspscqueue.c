@@ -0,0 +1,181 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testutil.h"
+#include "apr.h"
+#include "apr_general.h"
+#include "apr_pools.h"
+#include "apr_thread_proc.h"
+#include "apr_spsc_queue.h"
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
+static void spsc_basic(abts_case *tc, void *data)
+{
+    apr_spsc_queue_t *q;
+    apr_pool_t *pool;
+    apr_size_t len;
+    void *rec;
+    int i, n;
+
+    apr_pool_create(&pool, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_create(&q, 200, pool));
+
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, apr_spsc_queue_peek(q, &rec, &len));
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_spsc_queue_release(q));
+    /* rounded up to 256, records take at most half of it */
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_spsc_queue_reserve(q, 121, &rec));
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_push(q, "hello", 6));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_push(q, "", 0));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_peek(q, &rec, &len));
+    ABTS_SIZE_EQUAL(tc, 6, len);
+    ABTS_STR_EQUAL(tc, "hello", rec);
+    /* peeking again returns the same record */
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_peek(q, &rec, &len));
+    ABTS_STR_EQUAL(tc, "hello", rec);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_release(q));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_peek(q, &rec, &len));
+    ABTS_SIZE_EQUAL(tc, 0, len);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_release(q));
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, apr_spsc_queue_peek(q, &rec, &len));
+
+    /* reserve more than needed, commit less */
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_reserve(q, 100, &rec));
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_spsc_queue_commit(q, rec, 101));
+    strcpy(rec, "abc");
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_commit(q, rec, 4));
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_spsc_queue_commit(q, rec, 4));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_peek(q, &rec, &len));
+    ABTS_SIZE_EQUAL(tc, 4, len);
+    ABTS_STR_EQUAL(tc, "abc", rec);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_release(q));
+
+    /* fill it up, 16 bytes per record but for the wrap around */
+    for (n = 0; apr_spsc_queue_push(q, &n, sizeof(n)) == APR_SUCCESS; ++n)
+        ;
+    ABTS_ASSERT(tc, "filled up", n >= 14 && n <= 16);
+    for (i = 0; i < n; ++i) {
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_peek(q, &rec, &len));
+        ABTS_INT_EQUAL(tc, i, *(int *)rec);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_release(q));
+    }
+
+    /* then wrap around many times with records of varying length */
+    for (i = 0, n = 0; i < 1000 || n < i; ) {
+        if (i < 1000
+                && apr_spsc_queue_reserve(q, sizeof(i) + i % 60,
+                                          &rec) == APR_SUCCESS) {
+            memcpy(rec, &i, sizeof(i));
+            memset((char *)rec + sizeof(i), i, i % 60);
+            apr_spsc_queue_commit(q, rec, sizeof(i) + i % 60);
+            ++i;
+            continue;
+        }
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_peek(q, &rec, &len));
+        ABTS_INT_EQUAL(tc, n, *(int *)rec);
+        ABTS_SIZE_EQUAL(tc, sizeof(n) + n % 60, len);
+        ABTS_ASSERT(tc, "record content",
+                    len == sizeof(n) || ((char *)rec)[len - 1] == (char)n);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_spsc_queue_release(q));
+        ++n;
+    }
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, apr_spsc_queue_peek(q, &rec, &len));
+
+    apr_pool_destroy(pool);
+}
+
+#if APR_HAS_THREADS
+
+#define NUM_RECORDS 200000
+
+static apr_spsc_queue_t *shared;
+
+/* records are a sequence number followed by (seq % 97) bytes of it */
+static void * APR_THREAD_FUNC spsc_producer(apr_thread_t *thd, void *data)
+{
+    apr_uint32_t seq;
+
+    for (seq = 0; seq < NUM_RECORDS; ++seq) {
+        apr_size_t len = sizeof(seq) + seq % 97;
+        void *rec;
+
+        while (apr_spsc_queue_reserve(shared, len + 3, &rec) != APR_SUCCESS) {
+            apr_thread_yield();
+        }
+        memcpy(rec, &seq, sizeof(seq));
+        memset((char *)rec + sizeof(seq), (int)seq, len - sizeof(seq));
+        apr_spsc_queue_commit(shared, rec, len);
+    }
+    return NULL;
+}
+
+static void spsc_threads(abts_case *tc, void *data)
+{
+    apr_thread_t *producer;
+    apr_status_t rv, retval;
+    apr_pool_t *pool;
+    apr_uint32_t seq;
+    apr_size_t len;
+    int bad = 0;
+
+    apr_pool_create(&pool, p);
+    apr_spsc_queue_create(&shared, 4096, pool);
+
+    rv = apr_thread_create(&producer, NULL, spsc_producer, NULL, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (seq = 0; seq < NUM_RECORDS; ++seq) {
+        apr_uint32_t got;
+        apr_size_t i;
+        char *rec;
+
+        while (apr_spsc_queue_peek(shared, (void **)&rec, &len) != APR_SUCCESS) {
+            apr_thread_yield();
+        }
+        memcpy(&got, rec, sizeof(got));
+        if (got != seq || len != sizeof(seq) + seq % 97) {
+            ++bad;
+        }
+        for (i = sizeof(seq); i < len; ++i) {
+            if (rec[i] != (char)seq) {
+                ++bad;
+                break;
+            }
+        }
+        apr_spsc_queue_release(shared);
+    }
+    apr_thread_join(&retval, producer);
+
+    ABTS_INT_EQUAL(tc, 0, bad);
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, apr_spsc_queue_peek(shared, &data, &len));
+    apr_pool_destroy(pool);
+}
+
+#endif /* APR_HAS_THREADS */
+
+abts_suite *testspscqueue(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, spsc_basic, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, spsc_threads, NULL);
+#endif
+
+    return suite;
+}
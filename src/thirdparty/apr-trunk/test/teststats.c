@@ -0,0 +1,332 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testutil.h"
+#include "apr.h"
+#include "apr_general.h"
+#include "apr_pools.h"
+#include "apr_allocator.h"
+#include "apr_poll.h"
+#include "apr_thread_proc.h"
+#include "apr_thread_pool.h"
+#include "apr_stats.h"
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
+static void stats_counter(abts_case *tc, void *data)
+{
+    apr_stats_t *stats;
+    apr_stats_counter_t *c;
+    apr_pool_t *pool;
+
+    apr_pool_create(&pool, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_stats_create(&stats, 0, pool));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_stats_counter_create(&c, stats, "requests"));
+
+    ABTS_ASSERT(tc, "starts at zero", apr_stats_counter_read(c) == 0);
+    apr_stats_counter_add(c, 5);
+    apr_stats_counter_add(c, 10);
+    apr_stats_counter_sub(c, 3);
+    ABTS_ASSERT(tc, "add and sub", apr_stats_counter_read(c) == 12);
+
+    apr_pool_destroy(pool);
+}
+
+static void stats_histogram(abts_case *tc, void *data)
+{
+    apr_stats_t *stats;
+    apr_stats_histogram_t *h;
+    apr_stats_snapshot_t *snap;
+    apr_pool_t *pool;
+    apr_uint64_t v, pct;
+    apr_size_t b;
+
+    apr_pool_create(&pool, p);
+    apr_stats_create(&stats, 0, pool);
+    ABTS_INT_EQUAL(tc, APR_EINVAL,
+                   apr_stats_histogram_create(&h, stats, "bad", 1000, 0));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_stats_histogram_create(&h, stats, "latency",
+                                              APR_USEC_PER_SEC * 60, 7));
+
+    apr_stats_histogram_snapshot(&snap, h, pool);
+    ABTS_ASSERT(tc, "empty", snap->count == 0 && snap->max == 0);
+    ABTS_ASSERT(tc, "empty percentile",
+                apr_stats_snapshot_percentile(snap, 50.0) == 0);
+
+    /* 1..10000 once each */
+    for (v = 1; v <= 10000; ++v) {
+        apr_stats_histogram_record(h, v);
+    }
+    apr_stats_histogram_snapshot(&snap, h, pool);
+    ABTS_ASSERT(tc, "count", snap->count == 10000);
+    ABTS_ASSERT(tc, "sum", snap->sum == 10000 * 10001 / 2);
+    ABTS_ASSERT(tc, "max", snap->max == 10000);
+
+    /* within 1/128 of the exact value */
+    pct = apr_stats_snapshot_percentile(snap, 50.0);
+    ABTS_ASSERT(tc, "p50", pct >= 5000 && pct <= 5000 + 5000 / 128);
+    pct = apr_stats_snapshot_percentile(snap, 99.0);
+    ABTS_ASSERT(tc, "p99", pct >= 9900 && pct <= 9900 + 9900 / 128);
+    ABTS_ASSERT(tc, "p100",
+                apr_stats_snapshot_percentile(snap, 100.0) == 10000);
+    ABTS_ASSERT(tc, "p0", apr_stats_snapshot_percentile(snap, 0.0) == 1);
+
+    /* small values are exact, buckets are ordered */
+    ABTS_ASSERT(tc, "bucket 0", apr_stats_bucket_value(snap, 0) == 0);
+    ABTS_ASSERT(tc, "bucket 200", apr_stats_bucket_value(snap, 200) == 200);
+    for (b = 1; b < snap->nbuckets; ++b) {
+        if (apr_stats_bucket_value(snap, b)
+                <= apr_stats_bucket_value(snap, b - 1)) {
+            break;
+        }
+    }
+    ABTS_SIZE_EQUAL(tc, snap->nbuckets, b);
+
+    /* out of range values are clamped, but not their sum and max */
+    apr_stats_histogram_record(h, APR_USEC_PER_SEC * 3600);
+    apr_stats_histogram_snapshot(&snap, h, pool);
+    ABTS_ASSERT(tc, "clamped count", snap->count == 10001);
+    ABTS_ASSERT(tc, "clamped max", snap->max == APR_USEC_PER_SEC * 3600);
+    ABTS_ASSERT(tc, "last bucket", snap->buckets[snap->nbuckets - 1] == 1);
+
+    apr_pool_destroy(pool);
+}
+
+static apr_status_t count_metrics(void *baton, const char *name,
+                                  apr_stats_type_e type, apr_uint64_t value,
+                                  const apr_stats_snapshot_t *snap)
+{
+    return --*(int *)baton > 0 ? APR_SUCCESS : APR_EOF;
+}
+
+static void stats_export(abts_case *tc, void *data)
+{
+    apr_stats_t *stats;
+    apr_stats_counter_t *c;
+    apr_stats_histogram_t *h;
+    apr_pool_t *pool;
+    const char *text;
+    int n;
+
+    apr_pool_create(&pool, p);
+    apr_stats_create(&stats, APR_STATS_PER_CPU, pool);
+    apr_stats_counter_create(&c, stats, "hits");
+    apr_stats_histogram_create(&h, stats, "size", 1000, 3);
+    apr_stats_counter_add(c, 42);
+    apr_stats_histogram_record(h, 2);
+    apr_stats_histogram_record(h, 4);
+
+    text = apr_stats_dump(stats, pool);
+    ABTS_STR_EQUAL(tc, "hits 42\n"
+                   "size count=2 sum=6 max=4 p50=2 p90=4 p99=4 p999=4\n",
+                   text);
+
+    n = 1;
+    ABTS_INT_EQUAL(tc, APR_EOF,
+                   apr_stats_do(stats, count_metrics, &n, pool));
+    n = 3;
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_stats_do(stats, count_metrics, &n, pool));
+    ABTS_INT_EQUAL(tc, 1, n);
+
+    apr_pool_destroy(pool);
+}
+
+static void stats_allocator(abts_case *tc, void *data)
+{
+    apr_stats_t *stats;
+    apr_stats_counter_t *bytes;
+    apr_allocator_t *allocator;
+    apr_memnode_t *node;
+    apr_pool_t *pool, *sub;
+
+    apr_pool_create(&pool, p);
+    apr_stats_create(&stats, 0, pool);
+    apr_stats_counter_create(&bytes, stats, "bytes");
+
+    apr_allocator_create(&allocator);
+    apr_allocator_stats_set(allocator, bytes);
+    node = apr_allocator_alloc(allocator, 10000);
+    ABTS_ASSERT(tc, "node accounted",
+                apr_stats_counter_read(bytes) >= 10000);
+    apr_allocator_free(allocator, node);
+    ABTS_ASSERT(tc, "node freed", apr_stats_counter_read(bytes) == 0);
+
+    apr_pool_create_ex(&sub, NULL, NULL, allocator);
+    apr_palloc(sub, 100000);
+    ABTS_ASSERT(tc, "pool accounted",
+                apr_stats_counter_read(bytes) >= 100000);
+    apr_pool_destroy(sub);
+    ABTS_ASSERT(tc, "pool freed", apr_stats_counter_read(bytes) == 0);
+
+    apr_allocator_destroy(allocator);
+    apr_pool_destroy(pool);
+}
+
+static void stats_pollset(abts_case *tc, void *data)
+{
+    apr_stats_t *stats;
+    apr_stats_histogram_t *events;
+    apr_stats_snapshot_t *snap;
+    apr_pollset_t *pollset;
+    apr_pool_t *pool;
+    apr_int32_t num;
+    const apr_pollfd_t *out;
+    apr_status_t rv;
+
+    apr_pool_create(&pool, p);
+    apr_stats_create(&stats, 0, pool);
+    apr_stats_histogram_create(&events, stats, "events", 1024, 5);
+
+    rv = apr_pollset_create(&pollset, 4, pool, APR_POLLSET_WAKEABLE);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_pollset_stats_set(pollset, events);
+
+    rv = apr_pollset_poll(pollset, 0, &num, &out);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+    apr_pollset_wakeup(pollset);
+    rv = apr_pollset_poll(pollset, -1, &num, &out);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_EINTR(rv));
+
+    apr_stats_histogram_snapshot(&snap, events, pool);
+    ABTS_ASSERT(tc, "two wakeups", snap->count == 2 && snap->buckets[0] == 2);
+
+    apr_pool_destroy(pool);
+}
+
+#if APR_HAS_THREADS
+
+#define NUM_THREADS 4
+#define NUM_ADDS    100000
+#define NUM_TASKS   50
+
+static apr_stats_counter_t *shared_counter;
+static apr_stats_histogram_t *shared_hist;
+
+static void * APR_THREAD_FUNC stats_worker(apr_thread_t *thd, void *data)
+{
+    int i;
+
+    for (i = 0; i < NUM_ADDS; ++i) {
+        apr_stats_counter_add(shared_counter, 1);
+        apr_stats_histogram_record(shared_hist, i % 100);
+    }
+    return NULL;
+}
+
+static void stats_threads(abts_case *tc, void *data)
+{
+    apr_thread_t *threads[NUM_THREADS];
+    apr_stats_snapshot_t *snap;
+    apr_stats_t *stats;
+    apr_status_t rv, retval;
+    apr_pool_t *pool;
+    int i;
+
+    apr_pool_create(&pool, p);
+    apr_stats_create(&stats, (apr_uint32_t)(apr_size_t)data, pool);
+    apr_stats_counter_create(&shared_counter, stats, "adds");
+    apr_stats_histogram_create(&shared_hist, stats, "values", 100, 4);
+
+    for (i = 0; i < NUM_THREADS; ++i) {
+        rv = apr_thread_create(&threads[i], NULL, stats_worker, NULL, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < NUM_THREADS; ++i) {
+        apr_thread_join(&retval, threads[i]);
+    }
+
+    ABTS_ASSERT(tc, "counter",
+                apr_stats_counter_read(shared_counter)
+                    == NUM_THREADS * NUM_ADDS);
+    apr_stats_histogram_snapshot(&snap, shared_hist, pool);
+    ABTS_ASSERT(tc, "count", snap->count == NUM_THREADS * NUM_ADDS);
+    ABTS_ASSERT(tc, "max", snap->max == 99);
+    ABTS_ASSERT(tc, "bucket", snap->buckets[7] == NUM_THREADS * NUM_ADDS / 100);
+
+    apr_pool_destroy(pool);
+}
+
+static void *APR_THREAD_FUNC stats_task(apr_thread_t *thd, void *data)
+{
+    apr_sleep(1000);
+    return NULL;
+}
+
+static void stats_thread_pool(abts_case *tc, void *data)
+{
+    apr_thread_pool_task_desc_t tasks[NUM_TASKS];
+    apr_stats_histogram_t *wait, *run;
+    apr_thread_pool_latch_t *latch;
+    apr_stats_snapshot_t *snap;
+    apr_thread_pool_t *tp;
+    apr_stats_t *stats;
+    apr_pool_t *pool;
+    apr_status_t rv;
+    int i;
+
+    apr_pool_create(&pool, p);
+    apr_stats_create(&stats, 0, pool);
+    apr_stats_histogram_create(&wait, stats, "wait", APR_USEC_PER_SEC, 5);
+    apr_stats_histogram_create(&run, stats, "run", APR_USEC_PER_SEC, 5);
+
+    rv = apr_thread_pool_create(&tp, 0, 2, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_thread_pool_stats_set(tp, wait, run);
+    apr_thread_pool_latch_create(&latch, pool);
+    memset(tasks, 0, sizeof(tasks));
+    for (i = 0; i < NUM_TASKS; ++i) {
+        tasks[i].func = stats_task;
+    }
+    rv = apr_thread_pool_push_batch(tp, tasks, NUM_TASKS, latch);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_thread_pool_latch_wait(latch);
+    apr_thread_pool_destroy(tp);
+
+    apr_stats_histogram_snapshot(&snap, run, pool);
+    ABTS_ASSERT(tc, "run count", snap->count == NUM_TASKS);
+    ABTS_ASSERT(tc, "run time", apr_stats_snapshot_percentile(snap, 50.0)
+                                >= 900);
+    apr_stats_histogram_snapshot(&snap, wait, pool);
+    ABTS_ASSERT(tc, "wait count", snap->count == NUM_TASKS);
+    /* two threads for 50 tasks of 1ms, the last ones wait */
+    ABTS_ASSERT(tc, "wait time", snap->max >= 10000);
+
+    apr_pool_destroy(pool);
+}
+
+#endif /* APR_HAS_THREADS */
+
+abts_suite *teststats(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, stats_counter, NULL);
+    abts_run_test(suite, stats_histogram, NULL);
+    abts_run_test(suite, stats_export, NULL);
+    abts_run_test(suite, stats_allocator, NULL);
+    abts_run_test(suite, stats_pollset, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, stats_threads, (void *)0);
+    abts_run_test(suite, stats_threads, (void *)APR_STATS_PER_CPU);
+    abts_run_test(suite, stats_thread_pool, NULL);
+#endif
+
+    return suite;
+}
@@ -42,6 +42,86 @@ static void array_clear(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, 0, a1->nelts);
 }
 
+static void array_push_n(abts_case *tc, void *data)
+{
+    int flags;
+
+    for (flags = 0; flags <= APR_ARRAY_HEAP; flags += APR_ARRAY_HEAP) {
+        apr_array_header_t *a, *huge, big;
+        apr_pool_t *pool;
+        int *elts, i, n;
+
+        apr_pool_create(&pool, p);
+        a = apr_array_make_ex(pool, 0, sizeof(int), flags);
+        ABTS_PTR_NOTNULL(tc, a);
+
+        for (i = 0; i < 1000; ++i) {
+            APR_ARRAY_PUSH(a, int) = i;
+        }
+        elts = apr_array_push_n(a, 100);
+        ABTS_PTR_EQUAL(tc, &APR_ARRAY_IDX(a, 1000, int), elts);
+        ABTS_INT_EQUAL(tc, 0, elts[0]);
+        ABTS_INT_EQUAL(tc, 0, elts[99]);
+        ABTS_INT_EQUAL(tc, 1100, a->nelts);
+        ABTS_INT_EQUAL(tc, 2048, a->nalloc);
+
+        /* reused slots are zeroed too */
+        apr_array_pop(a);
+        elts = apr_array_push_n(a, 1);
+        ABTS_INT_EQUAL(tc, 0, elts[0]);
+        elts[0] = 42;
+        apr_array_clear(a);
+        elts = apr_array_push_n(a, 1100);
+        ABTS_INT_EQUAL(tc, 0, elts[0]);
+        ABTS_INT_EQUAL(tc, 0, elts[1099]);
+        for (i = 0; i < 1000; ++i) {
+            APR_ARRAY_IDX(a, i, int) = i;
+        }
+
+        ABTS_PTR_EQUAL(tc, NULL, apr_array_push_n(a, -1));
+        ABTS_PTR_EQUAL(tc, NULL, apr_array_push_n(a, APR_INT32_MAX));
+        ABTS_INT_EQUAL(tc, 1100, a->nelts);
+
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_array_reserve(a, 100));
+        ABTS_INT_EQUAL(tc, 2048, a->nalloc);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_array_reserve(a, 5000));
+        ABTS_INT_EQUAL(tc, 8192, a->nalloc);
+        for (i = 0; i < 1000; ++i) {
+            ABTS_INT_EQUAL(tc, i, APR_ARRAY_IDX(a, i, int));
+        }
+        ABTS_INT_EQUAL(tc, 0, APR_ARRAY_IDX(a, 8191, int));
+
+        /* counts that can't be held fail, and leave the array alone */
+        ABTS_INT_EQUAL(tc, APR_EINVAL, apr_array_reserve(a, -1));
+        big = *a;
+        big.nelts = APR_INT32_MAX;
+        ABTS_INT_EQUAL(tc, APR_ENOMEM, apr_array_cat(a, &big));
+        ABTS_INT_EQUAL(tc, 1100, a->nelts);
+        ABTS_INT_EQUAL(tc, 8192, a->nalloc);
+
+        huge = apr_array_make_ex(pool, 1, 1 << 20, flags);
+        ABTS_PTR_NOTNULL(tc, huge);
+        ABTS_INT_EQUAL(tc, APR_ENOMEM,
+                       apr_array_reserve(huge, (1 << 30) + 5));
+        ABTS_INT_EQUAL(tc, 1, huge->nalloc);
+        ABTS_PTR_EQUAL(tc, NULL, apr_array_push_n(huge, APR_INT32_MAX / 2));
+        ABTS_INT_EQUAL(tc, 0, huge->nelts);
+
+        elts = apr_array_move_out(a, &n);
+        ABTS_INT_EQUAL(tc, 1100, n);
+        ABTS_INT_EQUAL(tc, 999, elts[999]);
+        ABTS_INT_EQUAL(tc, 0, a->nelts);
+        if (flags & APR_ARRAY_HEAP) {
+            free(elts);
+        }
+
+        APR_ARRAY_PUSH(a, int) = 42;
+        ABTS_INT_EQUAL(tc, 1, a->nelts);
+        ABTS_INT_EQUAL(tc, 42, APR_ARRAY_IDX(a, 0, int));
+        apr_pool_destroy(pool);
+    }
+}
+
 static void table_make(abts_case *tc, void *data)
 {
     t1 = apr_table_make(p, 5);
@@ -227,6 +307,7 @@ abts_suite *testtable(abts_suite *suite)
     suite = ADD_SUITE(suite)
 
     abts_run_test(suite, array_clear, NULL);
+    abts_run_test(suite, array_push_n, NULL);
     abts_run_test(suite, table_make, NULL);
     abts_run_test(suite, table_get, NULL);
     abts_run_test(suite, table_getm, NULL);
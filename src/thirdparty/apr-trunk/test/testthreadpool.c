@@ -0,0 +1,522 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testutil.h"
+#include "apr.h"
+#include "apr_general.h"
+#include "apr_pools.h"
+#include "apr_atomic.h"
+#include "apr_time.h"
+#include "apr_thread_pool.h"
+
+#if APR_HAS_THREADS
+
+#define NUM_ROOTS 16
+#define NUM_CHILDREN 500
+
+static apr_thread_pool_t *tp;
+static volatile apr_uint32_t count;
+static volatile apr_uint32_t count_other;
+static volatile apr_uint32_t roots_done;
+static char owner_x, owner_y;
+
+/* Wait for a counter to reach a value, for at most ten seconds */
+static apr_uint32_t wait_for(volatile apr_uint32_t *counter,
+                             apr_uint32_t value)
+{
+    int i;
+
+    for (i = 0; i < 10000 && apr_atomic_read32(counter) < value; ++i) {
+        apr_sleep(1000);
+    }
+    return apr_atomic_read32(counter);
+}
+
+static void * APR_THREAD_FUNC leaf_task(apr_thread_t *thd, void *param)
+{
+    if (param) {
+        apr_sleep(1000);
+    }
+    apr_atomic_inc32(&count);
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC other_task(apr_thread_t *thd, void *param)
+{
+    apr_atomic_inc32(&count_other);
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC root_task(apr_thread_t *thd, void *param)
+{
+    int i;
+
+    for (i = 0; i < NUM_CHILDREN; ++i) {
+        apr_thread_pool_push(tp, leaf_task, param,
+                             APR_THREAD_TASK_PRIORITY_NORMAL, &owner_x);
+        if (param) {
+            apr_thread_pool_push(tp, other_task, NULL,
+                                 APR_THREAD_TASK_PRIORITY_NORMAL, &owner_y);
+        }
+    }
+    apr_atomic_inc32(&roots_done);
+    return NULL;
+}
+
+static void fanout_tasks(abts_case *tc)
+{
+    apr_status_t rv;
+    int i;
+
+    apr_atomic_set32(&count, 0);
+    apr_atomic_set32(&roots_done, 0);
+    for (i = 0; i < NUM_ROOTS; ++i) {
+        rv = apr_thread_pool_push(tp, root_task, NULL,
+                                  APR_THREAD_TASK_PRIORITY_NORMAL, NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    ABTS_INT_EQUAL(tc, NUM_ROOTS * NUM_CHILDREN,
+                   wait_for(&count, NUM_ROOTS * NUM_CHILDREN));
+    ABTS_INT_EQUAL(tc, NUM_ROOTS, apr_atomic_read32(&roots_done));
+}
+
+static void fanout(abts_case *tc, int flags)
+{
+    apr_status_t rv;
+    apr_pool_t *pool;
+
+    apr_pool_create(&pool, p);
+    rv = apr_thread_pool_create_ex(&tp, 4, 8, flags, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    fanout_tasks(tc);
+
+    rv = apr_thread_pool_destroy(tp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_pool_destroy(pool);
+}
+
+static void pool_fanout(abts_case *tc, void *data)
+{
+    fanout(tc, 0);
+}
+
+static void ws_fanout(abts_case *tc, void *data)
+{
+    fanout(tc, APR_THREAD_POOL_WORK_STEALING);
+}
+
+static void ws_cancel(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pool_t *pool;
+    apr_uint32_t n;
+
+    apr_pool_create(&pool, p);
+    rv = apr_thread_pool_create_ex(&tp, 4, 4, APR_THREAD_POOL_WORK_STEALING,
+                                   pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_atomic_set32(&count, 0);
+    apr_atomic_set32(&count_other, 0);
+    apr_atomic_set32(&roots_done, 0);
+
+    /* The children of owner_x are slow, they are still queued in the
+     * deques when cancelled.
+     */
+    rv = apr_thread_pool_push(tp, root_task, tp,
+                              APR_THREAD_TASK_PRIORITY_NORMAL, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, wait_for(&roots_done, 1));
+
+    rv = apr_thread_pool_tasks_cancel(tp, &owner_x);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    n = apr_atomic_read32(&count);
+    ABTS_TRUE(tc, n < NUM_CHILDREN);
+
+    /* Nothing of owner_x runs after the cancel, all of owner_y does */
+    ABTS_INT_EQUAL(tc, NUM_CHILDREN, wait_for(&count_other, NUM_CHILDREN));
+    apr_sleep(apr_time_from_msec(50));
+    ABTS_INT_EQUAL(tc, n, apr_atomic_read32(&count));
+    ABTS_SIZE_EQUAL(tc, 0, apr_thread_pool_tasks_count(tp));
+
+    rv = apr_thread_pool_destroy(tp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_pool_destroy(pool);
+}
+
+static apr_thread_pool_latch_t *latch;
+static apr_thread_pool_task_desc_t batch[NUM_CHILDREN];
+
+static void * APR_THREAD_FUNC batch_root_task(apr_thread_t *thd, void *param)
+{
+    /* The children of a batch root go to its deque in work-stealing mode */
+    apr_thread_pool_push_batch(tp, batch, NUM_CHILDREN, latch);
+    apr_atomic_inc32(&roots_done);
+    return NULL;
+}
+
+static void push_batch(abts_case *tc, int flags)
+{
+    apr_status_t rv;
+    apr_pool_t *pool;
+    apr_thread_pool_task_desc_t roots[NUM_ROOTS];
+    int i;
+
+    apr_pool_create(&pool, p);
+    rv = apr_thread_pool_create_ex(&tp, 4, 8, flags, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_thread_pool_latch_create(&latch, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_atomic_set32(&count, 0);
+    apr_atomic_set32(&roots_done, 0);
+    for (i = 0; i < NUM_CHILDREN; ++i) {
+        batch[i].func = leaf_task;
+        batch[i].param = NULL;
+        batch[i].owner = &owner_x;
+        batch[i].priority = (apr_byte_t)(i % 256);
+    }
+
+    /* From outside of the pool */
+    rv = apr_thread_pool_push_batch(tp, batch, NUM_CHILDREN, latch);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_thread_pool_latch_wait(latch);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, NUM_CHILDREN, apr_atomic_read32(&count));
+    ABTS_INT_EQUAL(tc, 0, apr_thread_pool_latch_count(latch));
+
+    /* From the tasks, the latch counting both the roots and the children */
+    for (i = 0; i < NUM_ROOTS; ++i) {
+        roots[i].func = batch_root_task;
+        roots[i].param = NULL;
+        roots[i].owner = NULL;
+        roots[i].priority = APR_THREAD_TASK_PRIORITY_NORMAL;
+    }
+    apr_atomic_set32(&count, 0);
+    rv = apr_thread_pool_push_batch(tp, roots, NUM_ROOTS, latch);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_thread_pool_latch_timedwait(latch, apr_time_from_sec(10));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, NUM_ROOTS, apr_atomic_read32(&roots_done));
+    ABTS_INT_EQUAL(tc, NUM_ROOTS * NUM_CHILDREN, apr_atomic_read32(&count));
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_thread_pool_push_batch(tp, NULL, 0, latch));
+    ABTS_INT_EQUAL(tc, 0, apr_thread_pool_latch_count(latch));
+
+    rv = apr_thread_pool_destroy(tp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_pool_destroy(pool);
+}
+
+static void pool_push_batch(abts_case *tc, void *data)
+{
+    push_batch(tc, 0);
+}
+
+static void ws_push_batch(abts_case *tc, void *data)
+{
+    push_batch(tc, APR_THREAD_POOL_WORK_STEALING);
+}
+
+static void batch_cancel(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pool_t *pool;
+    apr_uint32_t n;
+    int i;
+
+    apr_pool_create(&pool, p);
+    rv = apr_thread_pool_create(&tp, 1, 1, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_thread_pool_latch_create(&latch, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_atomic_set32(&count, 0);
+    for (i = 0; i < NUM_CHILDREN; ++i) {
+        batch[i].func = leaf_task;
+        batch[i].param = tp;
+        batch[i].owner = &owner_x;
+        batch[i].priority = APR_THREAD_TASK_PRIORITY_NORMAL;
+    }
+    rv = apr_thread_pool_push_batch(tp, batch, NUM_CHILDREN, latch);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_TRUE(tc, apr_thread_pool_latch_count(latch) > 0);
+    rv = apr_thread_pool_latch_timedwait(latch, apr_time_from_msec(5));
+    ABTS_INT_EQUAL(tc, APR_TIMEUP, rv);
+
+    /* The cancelled tasks count the latch down too */
+    rv = apr_thread_pool_tasks_cancel(tp, &owner_x);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_thread_pool_latch_timedwait(latch, apr_time_from_sec(10));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    n = apr_atomic_read32(&count);
+    ABTS_TRUE(tc, n < NUM_CHILDREN);
+
+    rv = apr_thread_pool_destroy(tp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_pool_destroy(pool);
+}
+
+#define NUM_SCHEDULED 200
+
+static apr_time_t deadlines[NUM_SCHEDULED];
+static volatile apr_uint32_t early;
+
+static void * APR_THREAD_FUNC timed_task(apr_thread_t *thd, void *param)
+{
+    apr_time_t *deadline = param;
+
+    if (apr_time_now() < *deadline) {
+        apr_atomic_inc32(&early);
+    }
+    apr_atomic_inc32(&count);
+    return NULL;
+}
+
+static void schedule(abts_case *tc, int flags)
+{
+    apr_status_t rv;
+    apr_pool_t *pool;
+    apr_interval_time_t delay;
+    int i;
+
+    apr_pool_create(&pool, p);
+    rv = apr_thread_pool_create_ex(&tp, 2, 4, flags, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_atomic_set32(&count, 0);
+    apr_atomic_set32(&count_other, 0);
+    apr_atomic_set32(&early, 0);
+
+    /* Spread over the first two levels of the wheel, several per tick */
+    for (i = 0; i < NUM_SCHEDULED; ++i) {
+        delay = (apr_interval_time_t)((i * 37) % NUM_SCHEDULED) * 1500;
+        deadlines[i] = apr_time_now() + delay;
+        rv = apr_thread_pool_schedule(tp, timed_task, &deadlines[i], delay,
+                                      &owner_x);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    /* Far beyond the span of the wheel, and a few to cancel before they
+     * are due.
+     */
+    rv = apr_thread_pool_schedule(tp, other_task, NULL,
+                                  apr_time_from_sec(3600 * 24), &owner_y);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    for (i = 0; i < 10; ++i) {
+        rv = apr_thread_pool_schedule(tp, other_task, NULL,
+                                      apr_time_from_sec(1) + i * 5000,
+                                      &owner_y);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    ABTS_INT_EQUAL(tc, NUM_SCHEDULED, wait_for(&count, NUM_SCHEDULED));
+    ABTS_INT_EQUAL(tc, 0, apr_atomic_read32(&early));
+    ABTS_SIZE_EQUAL(tc, 11, apr_thread_pool_scheduled_tasks_count(tp));
+
+    rv = apr_thread_pool_tasks_cancel(tp, &owner_y);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 0, apr_thread_pool_scheduled_tasks_count(tp));
+    apr_sleep(apr_time_from_msec(1100));
+    ABTS_INT_EQUAL(tc, 0, apr_atomic_read32(&count_other));
+
+    rv = apr_thread_pool_destroy(tp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_pool_destroy(pool);
+}
+
+static void pool_schedule(abts_case *tc, void *data)
+{
+    schedule(tc, 0);
+}
+
+static void ws_schedule(abts_case *tc, void *data)
+{
+    schedule(tc, APR_THREAD_POOL_WORK_STEALING);
+}
+
+#define NUM_LANE_TASKS 20
+
+static volatile apr_uint32_t gate;
+static volatile apr_uint32_t order_next;
+static apr_byte_t order[2 * NUM_LANE_TASKS];
+
+static void * APR_THREAD_FUNC gate_task(apr_thread_t *thd, void *param)
+{
+    apr_atomic_inc32(&count);
+    while (!apr_atomic_read32(&gate)) {
+        apr_sleep(1000);
+    }
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC lane_task(apr_thread_t *thd, void *param)
+{
+    order[apr_atomic_inc32(&order_next)] = *(apr_byte_t *)param;
+    return NULL;
+}
+
+/* Queue low and high priority tasks behind a gate, and return the number
+ * of high priority ones run before the first low priority one.
+ */
+static int run_lanes(abts_case *tc, apr_size_t limit)
+{
+    static apr_byte_t low = APR_THREAD_TASK_PRIORITY_LOW;
+    static apr_byte_t high = APR_THREAD_TASK_PRIORITY_HIGHEST;
+    apr_status_t rv;
+    apr_pool_t *pool;
+    int i, first_low;
+
+    apr_pool_create(&pool, p);
+    rv = apr_thread_pool_create(&tp, 1, 1, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 0, apr_thread_pool_starvation_limit_set(tp, limit));
+    ABTS_SIZE_EQUAL(tc, limit, apr_thread_pool_starvation_limit_get(tp));
+
+    apr_atomic_set32(&gate, 0);
+    apr_atomic_set32(&order_next, 0);
+    apr_atomic_set32(&count, 0);
+    apr_thread_pool_push(tp, gate_task, NULL,
+                         APR_THREAD_TASK_PRIORITY_HIGHEST, NULL);
+    ABTS_INT_EQUAL(tc, 1, wait_for(&count, 1));
+    for (i = 0; i < NUM_LANE_TASKS; ++i) {
+        apr_thread_pool_push(tp, lane_task, &low, low, NULL);
+    }
+    for (i = 0; i < NUM_LANE_TASKS; ++i) {
+        apr_thread_pool_push(tp, lane_task, &high, high, NULL);
+    }
+    apr_atomic_set32(&gate, 1);
+
+    ABTS_INT_EQUAL(tc, 2 * NUM_LANE_TASKS,
+                   wait_for(&order_next, 2 * NUM_LANE_TASKS));
+    for (first_low = 0; first_low < 2 * NUM_LANE_TASKS; ++first_low) {
+        if (order[first_low] == low) {
+            break;
+        }
+    }
+
+    rv = apr_thread_pool_destroy(tp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_pool_destroy(pool);
+    return first_low;
+}
+
+static void priority_lanes(abts_case *tc, void *data)
+{
+    /* Strict priority, then one low task every third */
+    ABTS_INT_EQUAL(tc, NUM_LANE_TASKS, run_lanes(tc, 0));
+    ABTS_INT_EQUAL(tc, 2, run_lanes(tc, 2));
+}
+
+static void lane_order(abts_case *tc, void *data)
+{
+    /* Within a lane: higher priority first, FIFO within a priority, and
+     * apr_thread_pool_top() ahead of its priority.
+     */
+    static apr_byte_t ids[] = "abcde";
+    apr_status_t rv;
+    apr_pool_t *pool;
+
+    apr_pool_create(&pool, p);
+    rv = apr_thread_pool_create(&tp, 1, 1, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_atomic_set32(&gate, 0);
+    apr_atomic_set32(&order_next, 0);
+    apr_atomic_set32(&count, 0);
+    apr_thread_pool_push(tp, gate_task, NULL,
+                         APR_THREAD_TASK_PRIORITY_HIGHEST, NULL);
+    ABTS_INT_EQUAL(tc, 1, wait_for(&count, 1));
+    apr_thread_pool_push(tp, lane_task, &ids[0], 10, NULL);
+    apr_thread_pool_push(tp, lane_task, &ids[1], 20, NULL);
+    apr_thread_pool_push(tp, lane_task, &ids[2], 10, NULL);
+    apr_thread_pool_top(tp, lane_task, &ids[3], 10, NULL);
+    apr_thread_pool_push(tp, lane_task, &ids[4], 20, NULL);
+    apr_atomic_set32(&gate, 1);
+
+    ABTS_INT_EQUAL(tc, 5, wait_for(&order_next, 5));
+    ABTS_INT_EQUAL(tc, 'b', order[0]);
+    ABTS_INT_EQUAL(tc, 'e', order[1]);
+    ABTS_INT_EQUAL(tc, 'd', order[2]);
+    ABTS_INT_EQUAL(tc, 'a', order[3]);
+    ABTS_INT_EQUAL(tc, 'c', order[4]);
+
+    rv = apr_thread_pool_destroy(tp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_pool_destroy(pool);
+}
+
+static void worker_affinity(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pool_t *pool;
+    int cpus[1] = { 0 }, bad[1] = { -1 };
+
+    apr_pool_create(&pool, p);
+    rv = apr_thread_pool_create(&tp, 2, 4, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_thread_pool_affinity_set(tp, cpus, 1,
+                                      APR_THREAD_POOL_AFFINITY_SPREAD);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "thread affinity");
+        apr_thread_pool_destroy(tp);
+        apr_pool_destroy(pool);
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, APR_EINVAL,
+                   apr_thread_pool_affinity_set(tp, bad, 1, 0));
+
+    /* Tasks still run, on pinned threads and on new ones */
+    fanout_tasks(tc);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_thread_pool_affinity_set(tp, NULL, 0, 0));
+
+    /* The topology may not be available */
+    rv = apr_thread_pool_numa_node_set(tp, 0, 0);
+    ABTS_TRUE(tc, rv == APR_SUCCESS || APR_STATUS_IS_ENOENT(rv));
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_thread_pool_numa_node_set(tp, -1, 0));
+
+    rv = apr_thread_pool_destroy(tp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_pool_destroy(pool);
+}
+
+#endif /* APR_HAS_THREADS */
+
+abts_suite *testthreadpool(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+#if APR_HAS_THREADS
+    abts_run_test(suite, pool_fanout, NULL);
+    abts_run_test(suite, ws_fanout, NULL);
+    abts_run_test(suite, ws_cancel, NULL);
+    abts_run_test(suite, pool_schedule, NULL);
+    abts_run_test(suite, ws_schedule, NULL);
+    abts_run_test(suite, pool_push_batch, NULL);
+    abts_run_test(suite, ws_push_batch, NULL);
+    abts_run_test(suite, batch_cancel, NULL);
+    abts_run_test(suite, priority_lanes, NULL);
+    abts_run_test(suite, lane_order, NULL);
+    abts_run_test(suite, worker_affinity, NULL);
+#endif
+
+    return suite;
+}
@@ -138,5 +138,14 @@ abts_suite *testjson(abts_suite *suite);
 abts_suite *testjose(abts_suite *suite);
 abts_suite *testbuffer(abts_suite *suite);
 abts_suite *testldap(abts_suite *suite);
+abts_suite *testbtree(abts_suite *suite);
+abts_suite *testcskiplist(abts_suite *suite);
+abts_suite *testthreadpool(abts_suite *suite);
+abts_suite *testspscqueue(abts_suite *suite);
+abts_suite *testmpscqueue(abts_suite *suite);
+abts_suite *testepoch(abts_suite *suite);
+abts_suite *teststats(abts_suite *suite);
+abts_suite *testaio(abts_suite *suite);
+abts_suite *testreactor(abts_suite *suite);
 
 #endif /* APR_TEST_INCLUDES */
@@ -0,0 +1,473 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr.h"
+
+#include "apu.h"
+#include "apr_atomic.h"
+#include "apr_errno.h"
+#include "apr_thread_mutex.h"
+#include "apr_epoch.h"
+
+#if APR_HAS_THREADS
+
+#define EPOCH_CACHELINE 64
+#define EPOCH_BATCH     64  /* retired entries handed over at once */
+#define EPOCH_CHUNK     64  /* entries allocated at once */
+
+#define EPOCH_FUNC 0
+#define EPOCH_POOL 1
+#define EPOCH_NODE 2
+
+/* A retired object, stamped with the global epoch read once it was
+ * unreachable. Entries are allocated by their owner and given back to it
+ * by the reclaimer, so that they are recycled without locking.
+ */
+typedef struct epoch_entry {
+    struct epoch_entry *next;
+    apr_uint64_t epoch;
+    apr_epoch_thread_t *owner;
+    int type;
+    union {
+        void (*func)(void *data);
+        apr_allocator_t *allocator;
+    } u;
+    void *data;
+} epoch_entry;
+
+/* The state is zero outside of critical sections, otherwise the epoch
+ * they were entered in shifted left by one, with the low bit set.
+ */
+struct apr_epoch_thread_t {
+    char                   pad0[EPOCH_CACHELINE];
+    volatile apr_uint64_t  state;
+    apr_uint32_t           nesting;
+    int                    registered;  /* under the epoch's lock */
+    apr_epoch_t           *epoch;
+    apr_epoch_thread_t    *next;        /* idem */
+    epoch_entry           *batch;       /* retired, not handed over yet */
+    epoch_entry           *batch_tail;
+    apr_size_t             batch_cnt;
+    epoch_entry           *cache;       /* free entries */
+    void *volatile         returned;    /* freed entries, given back */
+    char                   pad1[EPOCH_CACHELINE];
+};
+
+struct apr_epoch_t {
+    apr_pool_t            *pool;        /* records and entries, under lock */
+    apr_thread_mutex_t    *lock;
+    apr_epoch_thread_t    *threads;     /* under lock, never removed */
+    epoch_entry           *limbo;       /* handed over, under lock */
+    apr_thread_pool_t     *tp;          /* background reclaiming */
+    apr_interval_time_t    interval;
+    int                    stopping;
+    char                   pad0[EPOCH_CACHELINE];
+    volatile apr_uint64_t  global;
+    char                   pad1[EPOCH_CACHELINE];
+    void *volatile         retired;     /* handed over batches */
+    char                   pad2[EPOCH_CACHELINE];
+};
+
+static void epoch_free(epoch_entry *en)
+{
+    switch (en->type) {
+    case EPOCH_POOL:
+        apr_pool_destroy(en->data);
+        break;
+    case EPOCH_NODE:
+        ((apr_memnode_t *)en->data)->next = NULL;
+        apr_allocator_free(en->u.allocator, en->data);
+        break;
+    default:
+        en->u.func(en->data);
+        break;
+    }
+}
+
+static void epoch_push(void *volatile *list, epoch_entry *first,
+                       epoch_entry *last)
+{
+    void *head;
+
+    do {
+        head = *list;
+        last->next = head;
+    } while (apr_atomic_casptr(list, first, head) != head);
+}
+
+/* Run the frees, and give the entries back to their owners */
+static apr_size_t epoch_free_list(epoch_entry *en)
+{
+    apr_size_t n = 0;
+
+    while (en) {
+        epoch_entry *next = en->next;
+
+        epoch_free(en);
+        epoch_push(&en->owner->returned, en, en);
+        en = next;
+        n++;
+    }
+    return n;
+}
+
+static void epoch_flush(apr_epoch_thread_t *thd)
+{
+    epoch_push(&thd->epoch->retired, thd->batch, thd->batch_tail);
+    thd->batch = thd->batch_tail = NULL;
+    thd->batch_cnt = 0;
+}
+
+static apr_status_t epoch_cleanup(void *data)
+{
+    apr_epoch_t *epoch = data;
+    apr_epoch_thread_t *thd;
+    epoch_entry *en;
+
+    apr_epoch_reclaim_stop(epoch);
+
+    /* Nothing can be in a critical section anymore, free everything */
+    for (thd = epoch->threads; thd; thd = thd->next) {
+        if (thd->batch) {
+            epoch_flush(thd);
+        }
+    }
+    en = apr_atomic_xchgptr(&epoch->retired, NULL);
+    epoch_free_list(en);
+    epoch_free_list(epoch->limbo);
+    epoch->limbo = NULL;
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t epoch_pool_cleanup(void *data)
+{
+    apr_pool_destroy(data);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_epoch_create(apr_epoch_t **epoch,
+                                           apr_pool_t *a)
+{
+    apr_epoch_t *new_epoch;
+    apr_status_t rv;
+
+    new_epoch = apr_pcalloc(a, sizeof(apr_epoch_t));
+
+    rv = apr_thread_mutex_create(&new_epoch->lock, APR_THREAD_MUTEX_DEFAULT,
+                                 a);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    /* Registering and retiring allocate from any thread, while the caller
+     * may keep using a (and its allocator), which is not thread-safe; use
+     * an unmanaged pool with its own allocator, serialized by lock.
+     */
+    rv = apr_pool_create_unmanaged_ex(&new_epoch->pool, apr_pool_abort_get(a),
+                                      NULL);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    apr_pool_cleanup_register(a, new_epoch->pool, epoch_pool_cleanup,
+                              apr_pool_cleanup_null);
+
+    /* before the subpools, which may be retired, get destroyed */
+    apr_pool_pre_cleanup_register(a, new_epoch, epoch_cleanup);
+
+    *epoch = new_epoch;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_epoch_register(apr_epoch_thread_t **thd,
+                                             apr_epoch_t *epoch)
+{
+    apr_epoch_thread_t *t;
+
+    apr_thread_mutex_lock(epoch->lock);
+
+    for (t = epoch->threads; t; t = t->next) {
+        if (!t->registered) {
+            break;
+        }
+    }
+    if (!t) {
+        t = apr_pcalloc(epoch->pool, sizeof(apr_epoch_thread_t));
+        t->epoch = epoch;
+        t->next = epoch->threads;
+        epoch->threads = t;
+    }
+    t->registered = 1;
+
+    apr_thread_mutex_unlock(epoch->lock);
+
+    *thd = t;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_epoch_unregister(apr_epoch_thread_t *thd)
+{
+    apr_epoch_t *epoch = thd->epoch;
+
+    if (thd->nesting) {
+        return APR_EBUSY;
+    }
+    if (thd->batch) {
+        epoch_flush(thd);
+    }
+
+    apr_thread_mutex_lock(epoch->lock);
+    thd->registered = 0;
+    apr_thread_mutex_unlock(epoch->lock);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_epoch_enter(apr_epoch_thread_t *thd)
+{
+    apr_epoch_t *epoch = thd->epoch;
+    apr_uint64_t e;
+
+    if (thd->nesting++) {
+        return;
+    }
+
+    /* The state must be visible before the structure is read, and the
+     * epoch it says must still be the global one by then: a reclaimer
+     * which missed the state can't have advanced past it.
+     */
+    do {
+        e = apr_atomic_read64_ex(&epoch->global, APR_ATOMIC_RELAXED);
+        apr_atomic_set64(&thd->state, (e << 1) | 1);
+    } while (apr_atomic_read64(&epoch->global) != e);
+}
+
+APR_DECLARE(void) apr_epoch_exit(apr_epoch_thread_t *thd)
+{
+    if (--thd->nesting) {
+        return;
+    }
+
+    apr_atomic_set64_ex(&thd->state, 0, APR_ATOMIC_RELEASE);
+    if (thd->batch) {
+        epoch_flush(thd);
+    }
+}
+
+static epoch_entry *epoch_retire(apr_epoch_thread_t *thd, int type,
+                                 void *data)
+{
+    epoch_entry *en = thd->cache;
+
+    if (!en) {
+        en = apr_atomic_xchgptr(&thd->returned, NULL);
+    }
+    if (!en) {
+        apr_epoch_t *epoch = thd->epoch;
+        int i;
+
+        apr_thread_mutex_lock(epoch->lock);
+        en = apr_palloc(epoch->pool, EPOCH_CHUNK * sizeof(epoch_entry));
+        apr_thread_mutex_unlock(epoch->lock);
+
+        for (i = 0; i < EPOCH_CHUNK - 1; i++) {
+            en[i].next = &en[i + 1];
+        }
+        en[i].next = NULL;
+    }
+    thd->cache = en->next;
+
+    en->next = NULL;
+    en->epoch = apr_atomic_read64(&thd->epoch->global);
+    en->owner = thd;
+    en->type = type;
+    en->data = data;
+
+    if (thd->batch_tail) {
+        thd->batch_tail->next = en;
+    }
+    else {
+        thd->batch = en;
+    }
+    thd->batch_tail = en;
+    thd->batch_cnt++;
+
+    return en;
+}
+
+/* Handed over at the outermost apr_epoch_exit(), or at once when not in
+ * a critical section.
+ */
+static void epoch_retired(apr_epoch_thread_t *thd)
+{
+    if (!thd->nesting || thd->batch_cnt >= EPOCH_BATCH) {
+        epoch_flush(thd);
+    }
+}
+
+APR_DECLARE(apr_status_t) apr_epoch_retire(apr_epoch_thread_t *thd,
+                                           void (*func)(void *data),
+                                           void *data)
+{
+    epoch_entry *en = epoch_retire(thd, EPOCH_FUNC, data);
+
+    en->u.func = func;
+    epoch_retired(thd);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_epoch_retire_pool(apr_epoch_thread_t *thd,
+                                                apr_pool_t *pool)
+{
+    epoch_retire(thd, EPOCH_POOL, pool);
+    epoch_retired(thd);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_epoch_retire_node(apr_epoch_thread_t *thd,
+                                                apr_allocator_t *allocator,
+                                                apr_memnode_t *node)
+{
+    epoch_entry *en = epoch_retire(thd, EPOCH_NODE, node);
+
+    en->u.allocator = allocator;
+    epoch_retired(thd);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_epoch_reclaim(apr_epoch_t *epoch,
+                                            apr_size_t *count)
+{
+    apr_epoch_thread_t *thd;
+    epoch_entry *en, **pen, *freed = NULL;
+    apr_uint64_t e;
+    apr_size_t n;
+
+    apr_thread_mutex_lock(epoch->lock);
+
+    /* Advance, unless a critical section entered in an older epoch runs */
+    e = apr_atomic_read64(&epoch->global);
+    for (thd = epoch->threads; thd; thd = thd->next) {
+        apr_uint64_t state = apr_atomic_read64(&thd->state);
+
+        if ((state & 1) && (state >> 1) != e) {
+            break;
+        }
+    }
+    if (!thd) {
+        apr_atomic_set64(&epoch->global, ++e);
+    }
+
+    /* Move the handed over entries to the limbo, and take out the ones
+     * which are safe to free now.
+     */
+    en = apr_atomic_xchgptr(&epoch->retired, NULL);
+    while (en) {
+        epoch_entry *next = en->next;
+
+        en->next = epoch->limbo;
+        epoch->limbo = en;
+        en = next;
+    }
+    pen = &epoch->limbo;
+    while ((en = *pen) != NULL) {
+        if (en->epoch + 2 <= e) {
+            *pen = en->next;
+            en->next = freed;
+            freed = en;
+        }
+        else {
+            pen = &en->next;
+        }
+    }
+
+    apr_thread_mutex_unlock(epoch->lock);
+
+    /* The frees may retire more objects themselves */
+    n = epoch_free_list(freed);
+    if (count) {
+        *count = n;
+    }
+    return APR_SUCCESS;
+}
+
+static void *APR_THREAD_FUNC epoch_reclaim_task(apr_thread_t *t, void *data)
+{
+    apr_epoch_t *epoch = data;
+
+    apr_epoch_reclaim(epoch, NULL);
+
+    /* Rescheduled under the lock, so that apr_epoch_reclaim_stop() either
+     * cancels the next task or sees this one still running.
+     */
+    apr_thread_mutex_lock(epoch->lock);
+    if (!epoch->stopping) {
+        apr_thread_pool_schedule(epoch->tp, epoch_reclaim_task, epoch,
+                                 epoch->interval, epoch);
+    }
+    apr_thread_mutex_unlock(epoch->lock);
+
+    return NULL;
+}
+
+APR_DECLARE(apr_status_t) apr_epoch_reclaim_start(apr_epoch_t *epoch,
+                                                  apr_thread_pool_t *tp,
+                                                  apr_interval_time_t interval)
+{
+    apr_status_t rv;
+
+    apr_thread_mutex_lock(epoch->lock);
+    if (epoch->tp) {
+        apr_thread_mutex_unlock(epoch->lock);
+        return APR_EBUSY;
+    }
+    epoch->tp = tp;
+    epoch->interval = interval;
+    epoch->stopping = 0;
+
+    rv = apr_thread_pool_schedule(tp, epoch_reclaim_task, epoch, interval,
+                                  epoch);
+    if (rv != APR_SUCCESS) {
+        epoch->tp = NULL;
+    }
+    apr_thread_mutex_unlock(epoch->lock);
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_epoch_reclaim_stop(apr_epoch_t *epoch)
+{
+    apr_thread_pool_t *tp;
+
+    apr_thread_mutex_lock(epoch->lock);
+    tp = epoch->tp;
+    epoch->stopping = 1;
+    apr_thread_mutex_unlock(epoch->lock);
+
+    if (tp) {
+        apr_thread_pool_tasks_cancel(tp, epoch);
+
+        apr_thread_mutex_lock(epoch->lock);
+        epoch->tp = NULL;
+        apr_thread_mutex_unlock(epoch->lock);
+    }
+    return APR_SUCCESS;
+}
+
+#endif /* APR_HAS_THREADS */
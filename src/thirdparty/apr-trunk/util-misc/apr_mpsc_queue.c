@@ -0,0 +1,223 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr.h"
+
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "apu.h"
+#include "apr_atomic.h"
+#include "apr_errno.h"
+#include "apr_mpsc_queue.h"
+
+#define MPSC_CACHELINE 64
+#define MPSC_MIN_SIZE  64
+
+/* Records are preceded by a header and aligned on its size. The type is
+ * zero until the record is committed; the consumer clears the room of
+ * the records it releases, so that any header it has not been given yet
+ * reads as zero. A record which does not fit before the end of the ring
+ * is put at the start of it, after a pad record covering the gap.
+ */
+#define MPSC_FREE   0
+#define MPSC_RECORD 1
+#define MPSC_PAD    2
+
+typedef struct mpsc_hdr {
+    volatile apr_uint32_t type;
+    apr_uint32_t len;
+    apr_uint32_t span;  /* room taken in the ring, header included */
+    apr_uint32_t cap;   /* reserved length */
+} mpsc_hdr;
+
+#define MPSC_SPAN(len) \
+    (((apr_uint64_t)(len) + 2 * sizeof(mpsc_hdr) - 1) & ~(sizeof(mpsc_hdr) - 1))
+
+/* The indexes are free running byte counters. The producers share a
+ * cached copy of tail, refreshed when it says the ring is full, and the
+ * consumer never reads head at all.
+ */
+struct apr_mpsc_queue_t {
+    char                  *buf;
+    apr_uint64_t           size;
+    apr_uint64_t           mask;
+    char                   pad0[MPSC_CACHELINE];
+    /* producers */
+    volatile apr_uint64_t  head;
+    volatile apr_uint64_t  tail_cache;
+    char                   pad1[MPSC_CACHELINE];
+    /* consumer */
+    volatile apr_uint64_t  tail;
+    mpsc_hdr              *peeked;
+    char                   pad2[MPSC_CACHELINE];
+};
+
+APR_DECLARE(apr_status_t) apr_mpsc_queue_create(apr_mpsc_queue_t **q,
+                                                apr_size_t size,
+                                                apr_pool_t *a)
+{
+    apr_mpsc_queue_t *queue;
+    apr_uint64_t n = MPSC_MIN_SIZE;
+
+    if (size > APR_UINT32_MAX) {
+        return APR_EINVAL;
+    }
+    while (n < size) {
+        n <<= 1;
+    }
+
+    queue = apr_pcalloc(a, sizeof(apr_mpsc_queue_t));
+    queue->buf = apr_pcalloc(a, n);
+    queue->size = n;
+    queue->mask = n - 1;
+
+    *q = queue;
+    return APR_SUCCESS;
+}
+
+/* Whether [pos, end) is free given tail, which may be newer than pos when
+ * head has moved since it was read.
+ */
+static APR_INLINE int mpsc_fits(apr_mpsc_queue_t *queue, apr_uint64_t pos,
+                                apr_uint64_t end, apr_uint64_t tail)
+{
+    return tail <= pos && end - tail <= queue->size;
+}
+
+APR_DECLARE(apr_status_t) apr_mpsc_queue_reserve(apr_mpsc_queue_t *queue,
+                                                 apr_size_t len, void **rec)
+{
+    apr_uint64_t pos, span, gap, tail;
+    mpsc_hdr *hdr;
+
+    if (len > queue->size / 2 - sizeof(mpsc_hdr)) {
+        return APR_EINVAL;
+    }
+    span = MPSC_SPAN(len);
+
+    for (;;) {
+        pos = apr_atomic_read64(&queue->head);
+        gap = queue->size - (pos & queue->mask);
+        if (gap >= span) {
+            gap = 0;
+        }
+
+        tail = apr_atomic_read64(&queue->tail_cache);
+        if (!mpsc_fits(queue, pos, pos + gap + span, tail)) {
+            tail = apr_atomic_read64(&queue->tail);
+            if (!mpsc_fits(queue, pos, pos + gap + span, tail)) {
+                if (tail > pos) {
+                    continue;
+                }
+                return APR_EAGAIN;
+            }
+            apr_atomic_set64(&queue->tail_cache, tail);
+        }
+
+        if (apr_atomic_cas64(&queue->head, pos + gap + span, pos) == pos) {
+            break;
+        }
+    }
+
+    if (gap) {
+        hdr = (mpsc_hdr *)(queue->buf + (pos & queue->mask));
+        hdr->span = (apr_uint32_t)gap;
+        apr_atomic_set32(&hdr->type, MPSC_PAD);
+        pos += gap;
+    }
+    hdr = (mpsc_hdr *)(queue->buf + (pos & queue->mask));
+    hdr->span = (apr_uint32_t)span;
+    hdr->cap = (apr_uint32_t)len;
+
+    *rec = hdr + 1;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_mpsc_queue_commit(apr_mpsc_queue_t *queue,
+                                                void *rec, apr_size_t len)
+{
+    mpsc_hdr *hdr = (mpsc_hdr *)rec - 1;
+
+    if (len > hdr->cap) {
+        return APR_EINVAL;
+    }
+    hdr->len = (apr_uint32_t)len;
+
+    /* the record is written before its type says so */
+    apr_atomic_set32(&hdr->type, MPSC_RECORD);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_mpsc_queue_push(apr_mpsc_queue_t *queue,
+                                              const void *data,
+                                              apr_size_t len)
+{
+    apr_status_t rv;
+    void *rec;
+
+    rv = apr_mpsc_queue_reserve(queue, len, &rec);
+    if (rv == APR_SUCCESS) {
+        memcpy(rec, data, len);
+        rv = apr_mpsc_queue_commit(queue, rec, len);
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_mpsc_queue_peek(apr_mpsc_queue_t *queue,
+                                              void **rec, apr_size_t *len)
+{
+    apr_uint64_t pos = queue->tail;
+    mpsc_hdr *hdr;
+
+    for (;;) {
+        hdr = (mpsc_hdr *)(queue->buf + (pos & queue->mask));
+        switch (apr_atomic_read32(&hdr->type)) {
+        case MPSC_FREE:
+            return APR_EAGAIN;
+        case MPSC_PAD:
+            /* the gap itself was never written */
+            pos += hdr->span;
+            memset(hdr, 0, sizeof(mpsc_hdr));
+            apr_atomic_set64(&queue->tail, pos);
+            continue;
+        }
+        break;
+    }
+
+    queue->peeked = hdr;
+    *rec = hdr + 1;
+    *len = hdr->len;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_mpsc_queue_release(apr_mpsc_queue_t *queue)
+{
+    mpsc_hdr *hdr = queue->peeked;
+    apr_uint64_t span;
+
+    if (!hdr) {
+        return APR_EINVAL;
+    }
+    span = hdr->span;
+
+    /* cleared before the producers may reuse it */
+    memset(hdr, 0, span);
+    apr_atomic_set64(&queue->tail, queue->tail + span);
+    queue->peeked = NULL;
+    return APR_SUCCESS;
+}
@@ -27,19 +27,74 @@
 #endif
 
 #include "apu.h"
+#include "apr_private.h"
 #include "apr_portable.h"
 #include "apr_thread_mutex.h"
 #include "apr_thread_cond.h"
+#include "apr_atomic.h"
 #include "apr_errno.h"
 #include "apr_queue.h"
 
 #if APR_HAS_THREADS
+
+#if defined(HAVE_LINUX_FUTEX_H) && defined(HAVE_SYS_SYSCALL_H)
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#define QUEUE_FUTEX 1
+#endif
+
 /*
  * define this to get debug messages
  *
 #define QUEUE_DEBUG
  */
 
+/* Lock-free queues: how many times a blocking call retries before going
+ * to sleep (on SMP only), and the padding keeping the hot indexes apart.
+ */
+#define QUEUE_SPINS 200
+#define QUEUE_CACHELINE 64
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define QUEUE_CPU_RELAX() __builtin_ia32_pause()
+#else
+#define QUEUE_CPU_RELAX()
+#endif
+
+struct queue_slot {
+    volatile apr_uint64_t seq; /**< lap and state of the slot */
+    void               *data;
+};
+
+/**
+ * What threads blocked on a lock-free queue sleep on: seq changes when
+ * they should wake up, which is only done when there are waiters. The
+ * waker takes all the waiters at once, so it is done only once however
+ * many pushes or pops happen before they run again.
+ */
+struct queue_event {
+    volatile apr_uint32_t seq;
+    volatile apr_uint32_t waiters;
+    apr_thread_cond_t    *cond;  /**< without futexes */
+};
+
+struct queue_lf {
+    struct queue_slot    *slots;
+    apr_uint64_t          bounds;
+    int                   spins; /**< retries before sleeping */
+    char                  pad0[QUEUE_CACHELINE];
+    volatile apr_uint64_t in;    /**< next position to fill */
+    char                  pad1[QUEUE_CACHELINE];
+    volatile apr_uint64_t out;   /**< next position to empty */
+    char                  pad2[QUEUE_CACHELINE];
+    struct queue_event    not_empty;
+    struct queue_event    not_full;
+    volatile apr_uint32_t intr;  /**< bumped by apr_queue_interrupt_all() */
+};
+
 struct apr_queue_t {
     void              **data;
     unsigned int        nelts; /**< # elements */
@@ -52,6 +107,7 @@ struct apr_queue_t {
     apr_thread_cond_t  *not_empty;
     apr_thread_cond_t  *not_full;
     int                 terminated;
+    struct queue_lf    *lf;    /**< lock-free ring, if created so */
 };
 
 #ifdef QUEUE_DEBUG
@@ -134,22 +190,326 @@ APR_DECLARE(apr_status_t) apr_queue_create(apr_queue_t **q,
     queue->terminated = 0;
     queue->full_waiters = 0;
     queue->empty_waiters = 0;
+    queue->lf = NULL;
 
     apr_pool_cleanup_register(a, queue, queue_destroy, apr_pool_cleanup_null);
 
     return APR_SUCCESS;
 }
 
+/**
+ * Initialize a lock-free apr_queue_t. The mutex and conditions are still
+ * created, they are used for sleeping when futexes are not available.
+ */
+APR_DECLARE(apr_status_t) apr_queue_create_lockfree(apr_queue_t **q,
+                                                    unsigned int queue_capacity,
+                                                    apr_pool_t *a)
+{
+    apr_status_t rv;
+    apr_queue_t *queue;
+    struct queue_lf *lf;
+    unsigned int i;
+
+    if (!queue_capacity) {
+        return APR_EINVAL;
+    }
+
+    rv = apr_queue_create(q, 0, a);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    queue = *q;
+    queue->bounds = queue_capacity;
+
+    lf = apr_pcalloc(a, sizeof(*lf));
+    lf->slots = apr_palloc(a, queue_capacity * sizeof(*lf->slots));
+    lf->bounds = queue_capacity;
+    lf->spins = QUEUE_SPINS;
+#if defined(_SC_NPROCESSORS_ONLN)
+    /* Nobody can make progress while we spin */
+    if (sysconf(_SC_NPROCESSORS_ONLN) == 1) {
+        lf->spins = 0;
+    }
+#endif
+    for (i = 0; i < queue_capacity; ++i) {
+        lf->slots[i].seq = i;
+        lf->slots[i].data = NULL;
+    }
+    lf->not_empty.cond = queue->not_empty;
+    lf->not_full.cond = queue->not_full;
+    queue->lf = lf;
+
+    return APR_SUCCESS;
+}
+
+/**
+ * Fill up to n free slots from the in position, returning how many. A slot
+ * is free for position pos when its sequence is pos, and filled when it is
+ * pos + 1. The slots are checked before they are claimed with a single CAS,
+ * none of them can change meanwhile since only the owner of a position
+ * writes its slot.
+ */
+static unsigned int lf_enqueue(struct queue_lf *lf, void *const *data,
+                               unsigned int n)
+{
+    apr_uint64_t pos, prev;
+    unsigned int i;
+
+    pos = apr_atomic_read64(&lf->in);
+    for (;;) {
+        for (i = 0; i < n; ++i) {
+            struct queue_slot *slot = &lf->slots[(pos + i) % lf->bounds];
+            if (apr_atomic_read64(&slot->seq) != pos + i) {
+                break;
+            }
+        }
+        if (!i) {
+            prev = apr_atomic_read64(&lf->in);
+            if (prev == pos) {
+                /* full (or the previous lap not popped yet) */
+                return 0;
+            }
+            pos = prev;
+            continue;
+        }
+        prev = apr_atomic_cas64(&lf->in, pos + i, pos);
+        if (prev == pos) {
+            break;
+        }
+        pos = prev;
+    }
+
+    n = i;
+    for (i = 0; i < n; ++i) {
+        struct queue_slot *slot = &lf->slots[(pos + i) % lf->bounds];
+        slot->data = data[i];
+        apr_atomic_set64(&slot->seq, pos + i + 1);
+    }
+    return n;
+}
+
+/**
+ * Empty up to n filled slots from the out position, returning how many.
+ */
+static unsigned int lf_dequeue(struct queue_lf *lf, void **data,
+                               unsigned int n)
+{
+    apr_uint64_t pos, prev;
+    unsigned int i;
+
+    pos = apr_atomic_read64(&lf->out);
+    for (;;) {
+        for (i = 0; i < n; ++i) {
+            struct queue_slot *slot = &lf->slots[(pos + i) % lf->bounds];
+            if (apr_atomic_read64(&slot->seq) != pos + i + 1) {
+                break;
+            }
+        }
+        if (!i) {
+            prev = apr_atomic_read64(&lf->out);
+            if (prev == pos) {
+                /* empty (or the first slot not filled yet) */
+                return 0;
+            }
+            pos = prev;
+            continue;
+        }
+        prev = apr_atomic_cas64(&lf->out, pos + i, pos);
+        if (prev == pos) {
+            break;
+        }
+        pos = prev;
+    }
+
+    n = i;
+    for (i = 0; i < n; ++i) {
+        struct queue_slot *slot = &lf->slots[(pos + i) % lf->bounds];
+        data[i] = slot->data;
+        apr_atomic_set64(&slot->seq, pos + i + lf->bounds);
+    }
+    return n;
+}
+
+static int lf_can_enqueue(struct queue_lf *lf)
+{
+    apr_uint64_t pos = apr_atomic_read64(&lf->in);
+    return apr_atomic_read64(&lf->slots[pos % lf->bounds].seq) == pos;
+}
+
+static int lf_can_dequeue(struct queue_lf *lf)
+{
+    apr_uint64_t pos = apr_atomic_read64(&lf->out);
+    return apr_atomic_read64(&lf->slots[pos % lf->bounds].seq) == pos + 1;
+}
+
+static apr_status_t event_wait(apr_queue_t *queue, struct queue_event *ev,
+                               apr_uint32_t seq, apr_interval_time_t timeout)
+{
+#ifdef QUEUE_FUTEX
+    struct timespec ts, *pts = NULL;
+
+    if (timeout >= 0) {
+        ts.tv_sec = apr_time_sec(timeout);
+        ts.tv_nsec = apr_time_usec(timeout) * 1000;
+        pts = &ts;
+    }
+    if (syscall(SYS_futex, &ev->seq, FUTEX_WAIT_PRIVATE, seq, pts,
+                NULL, 0) && errno == ETIMEDOUT) {
+        return APR_TIMEUP;
+    }
+    return APR_SUCCESS;
+#else
+    apr_status_t rv = APR_SUCCESS;
+
+    apr_thread_mutex_lock(queue->one_big_mutex);
+    if (apr_atomic_read32(&ev->seq) == seq) {
+        if (timeout >= 0) {
+            rv = apr_thread_cond_timedwait(ev->cond, queue->one_big_mutex,
+                                           timeout);
+        }
+        else {
+            rv = apr_thread_cond_wait(ev->cond, queue->one_big_mutex);
+        }
+    }
+    apr_thread_mutex_unlock(queue->one_big_mutex);
+    return rv;
+#endif
+}
+
+static void event_wake(apr_queue_t *queue, struct queue_event *ev)
+{
+    if (!apr_atomic_read32(&ev->waiters)
+            || !apr_atomic_xchg32(&ev->waiters, 0)) {
+        return;
+    }
+    apr_atomic_inc32(&ev->seq);
+#ifdef QUEUE_FUTEX
+    syscall(SYS_futex, &ev->seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+    apr_thread_mutex_lock(queue->one_big_mutex);
+    apr_thread_cond_broadcast(ev->cond);
+    apr_thread_mutex_unlock(queue->one_big_mutex);
+#endif
+}
+
+/**
+ * Called when a lock-free operation could not proceed: spin a while, then
+ * sleep on the event until woken up, interrupted, or timed out. Returns
+ * APR_SUCCESS when the operation should be retried.
+ */
+static apr_status_t lf_block(apr_queue_t *queue, struct queue_event *ev,
+                             int (*ready)(struct queue_lf *),
+                             apr_interval_time_t timeout, apr_time_t deadline,
+                             int *spins)
+{
+    struct queue_lf *lf = queue->lf;
+    apr_uint32_t seq, intr;
+    apr_status_t rv;
+
+    if (!timeout) {
+        return APR_EAGAIN;
+    }
+    if (*spins < lf->spins) {
+        ++*spins;
+        QUEUE_CPU_RELAX();
+        return APR_SUCCESS;
+    }
+
+    intr = apr_atomic_read32(&lf->intr);
+    seq = apr_atomic_read32(&ev->seq);
+    /* Not undone when not sleeping after all, which only costs a wakeup */
+    apr_atomic_inc32(&ev->waiters);
+
+    /* Check again now that the other side knows about us */
+    if (ready(lf) || queue->terminated) {
+        return APR_SUCCESS;
+    }
+    if (timeout > 0) {
+        timeout = deadline - apr_time_now();
+        if (timeout <= 0) {
+            return APR_TIMEUP;
+        }
+    }
+    rv = event_wait(queue, ev, seq, timeout);
+
+    if (rv == APR_SUCCESS && apr_atomic_read32(&lf->intr) != intr
+            && !ready(lf)) {
+        rv = queue->terminated ? APR_EOF : APR_EINTR;
+    }
+    return rv;
+}
+
+static apr_status_t lf_push(apr_queue_t *queue, void *const *data,
+                            unsigned int n, unsigned int *npushed,
+                            apr_interval_time_t timeout)
+{
+    struct queue_lf *lf = queue->lf;
+    apr_time_t deadline = timeout > 0 ? apr_time_now() + timeout : 0;
+    apr_status_t rv;
+    int spins = 0;
+
+    *npushed = 0;
+    for (;;) {
+        if (queue->terminated) {
+            return APR_EOF; /* no more elements ever again */
+        }
+        *npushed = lf_enqueue(lf, data, n);
+        if (*npushed) {
+            event_wake(queue, &lf->not_empty);
+            return APR_SUCCESS;
+        }
+        rv = lf_block(queue, &lf->not_full, lf_can_enqueue, timeout,
+                      deadline, &spins);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+}
+
+static apr_status_t lf_pop(apr_queue_t *queue, void **data,
+                           unsigned int n, unsigned int *npopped,
+                           apr_interval_time_t timeout)
+{
+    struct queue_lf *lf = queue->lf;
+    apr_time_t deadline = timeout > 0 ? apr_time_now() + timeout : 0;
+    apr_status_t rv;
+    int spins = 0;
+
+    *npopped = 0;
+    for (;;) {
+        if (queue->terminated) {
+            return APR_EOF; /* no more elements ever again */
+        }
+        *npopped = lf_dequeue(lf, data, n);
+        if (*npopped) {
+            event_wake(queue, &lf->not_full);
+            return APR_SUCCESS;
+        }
+        rv = lf_block(queue, &lf->not_empty, lf_can_dequeue, timeout,
+                      deadline, &spins);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+}
+
 /**
  * Push new data onto the queue. Blocks if the queue is full. Once
  * the push operation has completed, it signals other threads waiting
  * in apr_queue_pop() that they may continue consuming sockets.
  */
-static apr_status_t queue_push(apr_queue_t *queue, void *data,
+static apr_status_t queue_push(apr_queue_t *queue, void *const *data,
+                               unsigned int n, unsigned int *npushed,
                                apr_interval_time_t timeout)
 {
     apr_status_t rv;
+    unsigned int i;
+
+    if (queue->lf) {
+        return lf_push(queue, data, n, npushed, timeout);
+    }
 
+    *npushed = 0;
     if (queue->terminated) {
         return APR_EOF; /* no more elements ever again */
     }
@@ -197,15 +557,23 @@ static apr_status_t queue_push(apr_queue_t *queue, void *data,
         }
     }
 
-    queue->data[queue->in] = data;
-    queue->in++;
-    if (queue->in >= queue->bounds)
-        queue->in -= queue->bounds;
-    queue->nelts++;
+    for (i = 0; i < n && !apr_queue_full(queue); ++i) {
+        queue->data[queue->in] = data[i];
+        queue->in++;
+        if (queue->in >= queue->bounds)
+            queue->in -= queue->bounds;
+        queue->nelts++;
+    }
+    *npushed = i;
 
     if (queue->empty_waiters) {
         Q_DBG("sig !empty", queue);
-        rv = apr_thread_cond_signal(queue->not_empty);
+        if (i > 1) {
+            rv = apr_thread_cond_broadcast(queue->not_empty);
+        }
+        else {
+            rv = apr_thread_cond_signal(queue->not_empty);
+        }
         if (rv != APR_SUCCESS) {
             apr_thread_mutex_unlock(queue->one_big_mutex);
             return rv;
@@ -218,7 +586,8 @@ static apr_status_t queue_push(apr_queue_t *queue, void *data,
 
 APR_DECLARE(apr_status_t) apr_queue_push(apr_queue_t *queue, void *data)
 {
-    return queue_push(queue, data, -1);
+    unsigned int n;
+    return queue_push(queue, &data, 1, &n, -1);
 }
 
 /**
@@ -228,19 +597,55 @@ APR_DECLARE(apr_status_t) apr_queue_push(apr_queue_t *queue, void *data)
  */
 APR_DECLARE(apr_status_t) apr_queue_trypush(apr_queue_t *queue, void *data)
 {
-    return queue_push(queue, data, 0);
+    unsigned int n;
+    return queue_push(queue, &data, 1, &n, 0);
 }
 
 APR_DECLARE(apr_status_t) apr_queue_timedpush(apr_queue_t *queue, void *data,
                                               apr_interval_time_t timeout)
 {
-    return queue_push(queue, data, timeout);
+    unsigned int n;
+    return queue_push(queue, &data, 1, &n, timeout);
+}
+
+APR_DECLARE(apr_status_t) apr_queue_push_batch(apr_queue_t *queue,
+                                               void *const *data,
+                                               unsigned int n,
+                                               unsigned int *npushed)
+{
+    if (!n) {
+        *npushed = 0;
+        return APR_SUCCESS;
+    }
+    return queue_push(queue, data, n, npushed, -1);
+}
+
+APR_DECLARE(apr_status_t) apr_queue_trypush_batch(apr_queue_t *queue,
+                                                  void *const *data,
+                                                  unsigned int n,
+                                                  unsigned int *npushed)
+{
+    if (!n) {
+        *npushed = 0;
+        return APR_SUCCESS;
+    }
+    return queue_push(queue, data, n, npushed, 0);
 }
 
 /**
  * not thread safe
  */
 APR_DECLARE(unsigned int) apr_queue_size(apr_queue_t *queue) {
+    if (queue->lf) {
+        apr_uint64_t out = apr_atomic_read64(&queue->lf->out);
+        apr_uint64_t in = apr_atomic_read64(&queue->lf->in);
+        /* positions are claimed before their slots are filled or emptied */
+        if (in <= out) {
+            return 0;
+        }
+        return in - out < queue->bounds ? (unsigned int)(in - out)
+                                         : queue->bounds;
+    }
     return queue->nelts;
 }
 
@@ -252,10 +657,17 @@ APR_DECLARE(unsigned int) apr_queue_size(apr_queue_t *queue) {
  * item is placed into the address specified by 'data'.
  */
 static apr_status_t queue_pop(apr_queue_t *queue, void **data,
+                              unsigned int n, unsigned int *npopped,
                               apr_interval_time_t timeout)
 {
     apr_status_t rv;
+    unsigned int i;
+
+    if (queue->lf) {
+        return lf_pop(queue, data, n, npopped, timeout);
+    }
 
+    *npopped = 0;
     if (queue->terminated) {
         return APR_EOF; /* no more elements ever again */
     }
@@ -304,15 +716,23 @@ static apr_status_t queue_pop(apr_queue_t *queue, void **data,
         }
     }
 
-    *data = queue->data[queue->out];
-    queue->nelts--;
+    for (i = 0; i < n && !apr_queue_empty(queue); ++i) {
+        data[i] = queue->data[queue->out];
+        queue->nelts--;
 
-    queue->out++;
-    if (queue->out >= queue->bounds)
-        queue->out -= queue->bounds;
+        queue->out++;
+        if (queue->out >= queue->bounds)
+            queue->out -= queue->bounds;
+    }
+    *npopped = i;
     if (queue->full_waiters) {
         Q_DBG("signal !full", queue);
-        rv = apr_thread_cond_signal(queue->not_full);
+        if (i > 1) {
+            rv = apr_thread_cond_broadcast(queue->not_full);
+        }
+        else {
+            rv = apr_thread_cond_signal(queue->not_full);
+        }
         if (rv != APR_SUCCESS) {
             apr_thread_mutex_unlock(queue->one_big_mutex);
             return rv;
@@ -325,24 +745,59 @@ static apr_status_t queue_pop(apr_queue_t *queue, void **data,
 
 APR_DECLARE(apr_status_t) apr_queue_pop(apr_queue_t *queue, void **data)
 {
-    return queue_pop(queue, data, -1);
+    unsigned int n;
+    return queue_pop(queue, data, 1, &n, -1);
 }
 
 APR_DECLARE(apr_status_t) apr_queue_trypop(apr_queue_t *queue, void **data)
 {
-    return queue_pop(queue, data, 0);
+    unsigned int n;
+    return queue_pop(queue, data, 1, &n, 0);
 }
 
 APR_DECLARE(apr_status_t) apr_queue_timedpop(apr_queue_t *queue, void **data,
                                              apr_interval_time_t timeout)
 {
-    return queue_pop(queue, data, timeout);
+    unsigned int n;
+    return queue_pop(queue, data, 1, &n, timeout);
+}
+
+APR_DECLARE(apr_status_t) apr_queue_pop_batch(apr_queue_t *queue,
+                                              void **data,
+                                              unsigned int n,
+                                              unsigned int *npopped)
+{
+    if (!n) {
+        *npopped = 0;
+        return APR_SUCCESS;
+    }
+    return queue_pop(queue, data, n, npopped, -1);
+}
+
+APR_DECLARE(apr_status_t) apr_queue_trypop_batch(apr_queue_t *queue,
+                                                 void **data,
+                                                 unsigned int n,
+                                                 unsigned int *npopped)
+{
+    if (!n) {
+        *npopped = 0;
+        return APR_SUCCESS;
+    }
+    return queue_pop(queue, data, n, npopped, 0);
 }
 
 APR_DECLARE(apr_status_t) apr_queue_interrupt_all(apr_queue_t *queue)
 {
     apr_status_t rv;
     Q_DBG("intr all", queue);
+    if (queue->lf) {
+        struct queue_lf *lf = queue->lf;
+
+        apr_atomic_inc32(&lf->intr);
+        event_wake(queue, &lf->not_empty);
+        event_wake(queue, &lf->not_full);
+        return APR_SUCCESS;
+    }
     if ((rv = apr_thread_mutex_lock(queue->one_big_mutex)) != APR_SUCCESS) {
         return rv;
     }
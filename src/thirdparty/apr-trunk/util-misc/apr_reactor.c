@@ -0,0 +1,787 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_reactor.h"
+#include "apr_allocator.h"
+#include "apr_atomic.h"
+#include "apr_mpsc_queue.h"
+#include "apr_network_io.h"
+#include "apr_skiplist.h"
+#include "apr_thread_cond.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_proc.h"
+
+#if APR_HAS_THREADS
+
+/* How many connections a listener accepts per readiness, and how many
+ * posted tasks a loop runs before it looks at its descriptors and timers
+ */
+#define ACCEPT_BATCH 16
+#define TASK_BATCH 256
+
+/* A posted task, as queued */
+typedef struct reactor_task_t {
+    apr_reactor_fn_t func;
+    void *baton;
+} reactor_task_t;
+
+struct apr_reactor_io_t {
+    apr_pollfd_t pfd;
+    apr_reactor_loop_t *loop;
+    apr_reactor_io_fn_t func;
+    void *baton;
+    apr_reactor_io_t *next;     /* free or dead list */
+    int removed;
+};
+
+struct apr_reactor_timer_t {
+    apr_time_t when;
+    apr_uint64_t seq;           /* orders the timers due at the same time */
+    apr_reactor_loop_t *loop;
+    apr_reactor_fn_t func;
+    void *baton;
+    apr_reactor_timer_t *next;  /* free list */
+};
+
+struct apr_reactor_loop_t {
+    apr_reactor_t *reactor;
+    int index;
+    apr_pool_t *pool;
+    apr_thread_t *thread;
+    apr_pollcb_t *pollcb;
+    apr_mpsc_queue_t *tasks;
+    apr_skiplist *timers;
+    apr_uint64_t timer_seq;
+    apr_reactor_timer_t *free_timers;
+    apr_reactor_io_t *free_ios;
+    /* removed while polling, recycled after */
+    apr_reactor_io_t *dead_ios;
+    volatile apr_uint32_t stop;
+};
+
+struct apr_reactor_t {
+    apr_pool_t *pool;
+    int nloops;
+    apr_reactor_loop_t *loops;
+    volatile apr_uint32_t stopping;
+};
+
+/* A listening socket, and the loop(s) accepting on it */
+typedef struct reactor_listener_t {
+    apr_reactor_t *reactor;
+    apr_socket_t *sock;
+    apr_reactor_accept_fn_t func;
+    void *baton;
+    apr_int16_t reqevents;
+    /* the watch, once the loop has it */
+    apr_reactor_io_t *io;
+    /* the apr_reactor_listen() call waiting for the loops to (un)watch it */
+    struct listen_start_t *start;
+} reactor_listener_t;
+
+/* Collects the status of the loops (un)watching new listeners */
+typedef struct listen_start_t {
+    apr_thread_mutex_t *mutex;
+    apr_thread_cond_t *cond;
+    int pending;
+    apr_status_t rv;
+} listen_start_t;
+
+static int timer_compare(void *a, void *b)
+{
+    const apr_reactor_timer_t *t1 = a, *t2 = b;
+
+    if (t1->when != t2->when) {
+        return (t1->when < t2->when) ? -1 : 1;
+    }
+    if (t1->seq != t2->seq) {
+        return (t1->seq < t2->seq) ? -1 : 1;
+    }
+    return 0;
+}
+
+static apr_status_t io_dispatch(void *baton, apr_pollfd_t *pfd)
+{
+    apr_reactor_io_t *io = pfd->client_data;
+
+    /* removed by a previous callback of this batch */
+    if (!io->removed) {
+        io->func(io->loop, pfd, io->baton);
+    }
+    return APR_SUCCESS;
+}
+
+/* Run a batch of the posted tasks, returns whether some are left */
+static int run_tasks(apr_reactor_loop_t *loop)
+{
+    reactor_task_t *task;
+    apr_size_t len;
+    int n;
+
+    for (n = 0; n < TASK_BATCH; ++n) {
+        reactor_task_t t;
+
+        if (apr_mpsc_queue_peek(loop->tasks, (void **)&task,
+                                &len) != APR_SUCCESS) {
+            return 0;
+        }
+        t = *task;
+        apr_mpsc_queue_release(loop->tasks);
+        t.func(loop, t.baton);
+    }
+    return 1;
+}
+
+static void run_timers(apr_reactor_loop_t *loop)
+{
+    apr_reactor_timer_t *timer;
+    apr_time_t now = apr_time_now();
+
+    while ((timer = apr_skiplist_peek(loop->timers)) != NULL
+           && timer->when <= now) {
+        apr_reactor_fn_t func = timer->func;
+        void *baton = timer->baton;
+
+        apr_skiplist_pop(loop->timers, NULL);
+        timer->next = loop->free_timers;
+        loop->free_timers = timer;
+
+        func(loop, baton);
+    }
+}
+
+static apr_interval_time_t next_timeout(apr_reactor_loop_t *loop)
+{
+    apr_reactor_timer_t *timer = apr_skiplist_peek(loop->timers);
+    apr_time_t now;
+
+    if (!timer) {
+        return -1;
+    }
+    now = apr_time_now();
+    return (timer->when > now) ? timer->when - now : 0;
+}
+
+static void * APR_THREAD_FUNC loop_run(apr_thread_t *thread, void *data)
+{
+    apr_reactor_loop_t *loop = data;
+
+    apr_pool_owner_set(loop->pool, 0);
+
+    while (!apr_atomic_read32(&loop->stop)) {
+        apr_interval_time_t timeout;
+        apr_status_t rv;
+
+        timeout = run_tasks(loop) ? 0 : next_timeout(loop);
+        if (apr_atomic_read32(&loop->stop)) {
+            break;
+        }
+
+        /* A task posted from now on wakes the poll up, since the queue is
+         * looked at again after the wakeup pipe is drained.
+         */
+        rv = apr_pollcb_poll(loop->pollcb, timeout, io_dispatch, loop);
+        if (rv != APR_SUCCESS && !APR_STATUS_IS_EINTR(rv)
+                && !APR_STATUS_IS_TIMEUP(rv)) {
+            /* not much to do about it, but avoid spinning */
+            apr_sleep(apr_time_from_msec(1));
+        }
+
+        while (loop->dead_ios) {
+            apr_reactor_io_t *io = loop->dead_ios;
+
+            loop->dead_ios = io->next;
+            io->next = loop->free_ios;
+            loop->free_ios = io;
+        }
+
+        run_timers(loop);
+    }
+
+    apr_thread_exit(thread, APR_SUCCESS);
+    return NULL;
+}
+
+static apr_status_t reactor_cleanup(void *data)
+{
+    apr_reactor_t *reactor = data;
+    int i;
+
+    apr_atomic_set32(&reactor->stopping, 1);
+    for (i = 0; i < reactor->nloops; ++i) {
+        apr_reactor_loop_t *loop = &reactor->loops[i];
+
+        if (loop->thread) {
+            apr_atomic_set32(&loop->stop, 1);
+            apr_pollcb_wakeup(loop->pollcb);
+        }
+    }
+    for (i = 0; i < reactor->nloops; ++i) {
+        apr_reactor_loop_t *loop = &reactor->loops[i];
+        apr_status_t rv;
+
+        if (loop->thread) {
+            apr_thread_join(&rv, loop->thread);
+            loop->thread = NULL;
+        }
+    }
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t loop_create(apr_reactor_loop_t *loop,
+                                apr_uint32_t size)
+{
+    apr_allocator_t *allocator;
+    apr_status_t rv;
+
+    /* The loop's pool is only used by its thread, no need to share (and
+     * lock) the reactor's allocator.
+     */
+    rv = apr_allocator_create(&allocator);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    rv = apr_pool_create_ex(&loop->pool, loop->reactor->pool, NULL,
+                            allocator);
+    if (rv != APR_SUCCESS) {
+        apr_allocator_destroy(allocator);
+        return rv;
+    }
+    apr_allocator_owner_set(allocator, loop->pool);
+    apr_pool_tag(loop->pool, "apr_reactor_loop");
+
+    rv = apr_pollcb_create(&loop->pollcb, size, loop->pool,
+                           APR_POLLSET_WAKEABLE);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    /* a record takes its length and a header of 16 bytes */
+    rv = apr_mpsc_queue_create(&loop->tasks,
+                               size * (sizeof(reactor_task_t) + 16),
+                               loop->pool);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    rv = apr_skiplist_init(&loop->timers, loop->pool);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    apr_skiplist_set_compare(loop->timers, timer_compare, timer_compare);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_reactor_create(apr_reactor_t **preactor,
+                                             int nloops, apr_uint32_t size,
+                                             apr_pool_t *pool)
+{
+    apr_reactor_t *reactor;
+    apr_pool_t *p;
+    apr_status_t rv;
+    int i;
+
+    *preactor = NULL;
+    if (nloops <= 0 || !size) {
+        return APR_EINVAL;
+    }
+
+    rv = apr_pool_create(&p, pool);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    apr_pool_tag(p, "apr_reactor");
+
+    reactor = apr_pcalloc(p, sizeof(*reactor));
+    reactor->pool = p;
+    reactor->nloops = nloops;
+    reactor->loops = apr_pcalloc(p, nloops * sizeof(apr_reactor_loop_t));
+    apr_pool_pre_cleanup_register(p, reactor, reactor_cleanup);
+
+    for (i = 0; i < nloops; ++i) {
+        apr_reactor_loop_t *loop = &reactor->loops[i];
+
+        loop->reactor = reactor;
+        loop->index = i;
+        rv = loop_create(loop, size);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    for (i = 0; rv == APR_SUCCESS && i < nloops; ++i) {
+        apr_reactor_loop_t *loop = &reactor->loops[i];
+
+        rv = apr_thread_create(&loop->thread, NULL, loop_run, loop, p);
+    }
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(p);
+        return rv;
+    }
+
+    *preactor = reactor;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_reactor_destroy(apr_reactor_t *reactor)
+{
+    apr_pool_destroy(reactor->pool);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(int) apr_reactor_nloops(const apr_reactor_t *reactor)
+{
+    return reactor->nloops;
+}
+
+APR_DECLARE(apr_reactor_loop_t *) apr_reactor_loop_get(apr_reactor_t *reactor,
+                                                       int n)
+{
+    if (n < 0 || n >= reactor->nloops) {
+        return NULL;
+    }
+    return &reactor->loops[n];
+}
+
+APR_DECLARE(apr_reactor_loop_t *) apr_reactor_loop_for(apr_reactor_t *reactor,
+                                                       apr_uint64_t key)
+{
+    /* mix the bits, sequential keys shouldn't end up on a subset */
+    key ^= key >> 33;
+    key *= APR_UINT64_C(0xff51afd7ed558ccd);
+    key ^= key >> 33;
+
+    return &reactor->loops[key % (apr_uint64_t)reactor->nloops];
+}
+
+APR_DECLARE(int) apr_reactor_loop_index(const apr_reactor_loop_t *loop)
+{
+    return loop->index;
+}
+
+APR_DECLARE(apr_reactor_t *) apr_reactor_loop_reactor(const apr_reactor_loop_t *loop)
+{
+    return loop->reactor;
+}
+
+APR_DECLARE(apr_pool_t *) apr_reactor_loop_pool(const apr_reactor_loop_t *loop)
+{
+    return loop->pool;
+}
+
+APR_DECLARE(apr_status_t) apr_reactor_post(apr_reactor_loop_t *loop,
+                                           apr_reactor_fn_t func,
+                                           void *baton)
+{
+    reactor_task_t task;
+    apr_status_t rv;
+
+    if (apr_atomic_read32(&loop->reactor->stopping)) {
+        return APR_EOF;
+    }
+
+    task.func = func;
+    task.baton = baton;
+    rv = apr_mpsc_queue_push(loop->tasks, &task, sizeof(task));
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    /* coalesced with the pending wakeups, if any */
+    apr_pollcb_wakeup(loop->pollcb);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_reactor_io_add(apr_reactor_io_t **pio,
+                                             apr_reactor_loop_t *loop,
+                                             const apr_pollfd_t *pfd,
+                                             apr_reactor_io_fn_t func,
+                                             void *baton)
+{
+    apr_reactor_io_t *io = loop->free_ios;
+    apr_status_t rv;
+
+    if (io) {
+        loop->free_ios = io->next;
+    }
+    else {
+        io = apr_palloc(loop->pool, sizeof(*io));
+    }
+    io->pfd = *pfd;
+    io->pfd.client_data = io;
+    io->loop = loop;
+    io->func = func;
+    io->baton = baton;
+    io->next = NULL;
+    io->removed = 0;
+
+    rv = apr_pollcb_add(loop->pollcb, &io->pfd);
+    if (rv != APR_SUCCESS) {
+        io->next = loop->free_ios;
+        loop->free_ios = io;
+        return rv;
+    }
+
+    *pio = io;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_reactor_io_remove(apr_reactor_io_t *io)
+{
+    apr_reactor_loop_t *loop = io->loop;
+    apr_status_t rv;
+
+    rv = apr_pollcb_remove(loop->pollcb, &io->pfd);
+
+    /* The pollcb may still hold events for it, keep it until the poll
+     * returns.
+     */
+    io->removed = 1;
+    io->next = loop->dead_ios;
+    loop->dead_ios = io;
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_reactor_timer_add(apr_reactor_timer_t **ptimer,
+                                                apr_reactor_loop_t *loop,
+                                                apr_interval_time_t delay,
+                                                apr_reactor_fn_t func,
+                                                void *baton)
+{
+    apr_reactor_timer_t *timer = loop->free_timers;
+
+    if (timer) {
+        loop->free_timers = timer->next;
+    }
+    else {
+        timer = apr_palloc(loop->pool, sizeof(*timer));
+    }
+    timer->when = apr_time_now() + (delay > 0 ? delay : 0);
+    timer->seq = loop->timer_seq++;
+    timer->loop = loop;
+    timer->func = func;
+    timer->baton = baton;
+    timer->next = NULL;
+
+    if (!apr_skiplist_insert(loop->timers, timer)) {
+        timer->next = loop->free_timers;
+        loop->free_timers = timer;
+        return APR_ENOMEM;
+    }
+
+    if (ptimer) {
+        *ptimer = timer;
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_reactor_timer_cancel(apr_reactor_timer_t *timer)
+{
+    apr_reactor_loop_t *loop = timer->loop;
+
+    if (!apr_skiplist_remove(loop->timers, timer, NULL)) {
+        return APR_NOTFOUND;
+    }
+    timer->next = loop->free_timers;
+    loop->free_timers = timer;
+
+    return APR_SUCCESS;
+}
+
+static void listener_accept(apr_reactor_loop_t *loop,
+                            const apr_pollfd_t *pfd, void *baton)
+{
+    reactor_listener_t *listener = baton;
+    int n;
+
+    for (n = 0; n < ACCEPT_BATCH; ++n) {
+        apr_socket_t *sock;
+        apr_pool_t *p;
+
+        if (apr_pool_create(&p, loop->pool) != APR_SUCCESS) {
+            break;
+        }
+        if (apr_socket_accept(&sock, listener->sock, p) != APR_SUCCESS) {
+            /* mostly APR_EAGAIN, another loop took it or we're done */
+            apr_pool_destroy(p);
+            break;
+        }
+        apr_socket_opt_set(sock, APR_SO_NONBLOCK, 1);
+        apr_socket_timeout_set(sock, 0);
+
+        listener->func(loop, sock, p, listener->baton);
+    }
+}
+
+static apr_status_t listener_watch(apr_reactor_loop_t *loop,
+                                   reactor_listener_t *listener)
+{
+    apr_reactor_io_t *io;
+    apr_pollfd_t pfd;
+    apr_status_t rv;
+
+    pfd.p = loop->pool;
+    pfd.desc_type = APR_POLL_SOCKET;
+    pfd.reqevents = listener->reqevents;
+    pfd.rtnevents = 0;
+    pfd.desc.s = listener->sock;
+    pfd.client_data = NULL;
+
+    rv = apr_reactor_io_add(&io, loop, &pfd, listener_accept, listener);
+    if (rv != APR_SUCCESS) {
+        if (!(listener->reqevents & APR_POLLEXCL)) {
+            /* nobody would accept the connections the kernel gives it */
+            apr_socket_close(listener->sock);
+            listener->sock = NULL;
+        }
+        return rv;
+    }
+    listener->io = io;
+    return APR_SUCCESS;
+}
+
+/* Tell the waiting apr_reactor_listen() that a loop is done */
+static void listen_start_done(listen_start_t *start, apr_status_t rv)
+{
+    apr_thread_mutex_lock(start->mutex);
+    if (rv != APR_SUCCESS && start->rv == APR_SUCCESS) {
+        start->rv = rv;
+    }
+    if (--start->pending == 0) {
+        apr_thread_cond_signal(start->cond);
+    }
+    apr_thread_mutex_unlock(start->mutex);
+}
+
+static void listener_watch_task(apr_reactor_loop_t *loop, void *baton)
+{
+    reactor_listener_t *listener = baton;
+
+    listen_start_done(listener->start, listener_watch(loop, listener));
+}
+
+static void listener_unwatch_task(apr_reactor_loop_t *loop, void *baton)
+{
+    reactor_listener_t *listener = baton;
+
+    apr_reactor_io_remove(listener->io);
+    listener->io = NULL;
+    listen_start_done(listener->start, APR_SUCCESS);
+}
+
+/* Whether the caller runs in the thread of the loop */
+static int loop_is_current(apr_reactor_loop_t *loop)
+{
+    apr_os_thread_t *thread;
+
+    return apr_os_thread_get(&thread, loop->thread) == APR_SUCCESS
+           && apr_os_thread_equal(*thread, apr_os_thread_current());
+}
+
+static void listen_start_wait(listen_start_t *start)
+{
+    apr_thread_mutex_lock(start->mutex);
+    while (start->pending) {
+        apr_thread_cond_wait(start->cond, start->mutex);
+    }
+    apr_thread_mutex_unlock(start->mutex);
+}
+
+/* Undo a failed apr_reactor_listen(): have the loops stop watching their
+ * listener, then close the sockets (or the shared one) left unwatched.
+ */
+static void listen_unwind(apr_reactor_t *reactor,
+                          reactor_listener_t *listeners,
+                          listen_start_t *start, apr_socket_t *shared)
+{
+    int i, watched = 0;
+
+    for (i = 0; i < reactor->nloops; ++i) {
+        reactor_listener_t *listener = &listeners[i];
+        apr_reactor_loop_t *loop = &reactor->loops[i];
+
+        if (!listener->io) {
+            continue;
+        }
+        if (loop_is_current(loop)) {
+            apr_reactor_io_remove(listener->io);
+            listener->io = NULL;
+            continue;
+        }
+
+        apr_thread_mutex_lock(start->mutex);
+        ++start->pending;
+        apr_thread_mutex_unlock(start->mutex);
+
+        if (apr_reactor_post(loop, listener_unwatch_task,
+                             listener) != APR_SUCCESS) {
+            apr_thread_mutex_lock(start->mutex);
+            --start->pending;
+            apr_thread_mutex_unlock(start->mutex);
+        }
+    }
+    listen_start_wait(start);
+
+    for (i = 0; i < reactor->nloops; ++i) {
+        reactor_listener_t *listener = &listeners[i];
+
+        if (listener->io) {
+            /* the reactor is stopping, it closes the socket itself */
+            watched = 1;
+        }
+        else if (!shared && listener->sock) {
+            apr_socket_close(listener->sock);
+            listener->sock = NULL;
+        }
+    }
+    if (shared && !watched) {
+        apr_socket_close(shared);
+    }
+}
+
+static apr_status_t listener_create(apr_socket_t **sock, apr_sockaddr_t *sa,
+                                    apr_int32_t backlog, int reuseport,
+                                    apr_pool_t *p)
+{
+    apr_status_t rv;
+
+    rv = apr_socket_create(sock, sa->family, SOCK_STREAM, APR_PROTO_TCP, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    if ((rv = apr_socket_opt_set(*sock, APR_SO_REUSEADDR, 1)) != APR_SUCCESS
+            || (reuseport && (rv = apr_socket_opt_set(*sock,
+                                                      APR_SO_REUSEPORT, 1))
+                                != APR_SUCCESS)
+            || (rv = apr_socket_opt_set(*sock, APR_SO_NONBLOCK, 1))
+                != APR_SUCCESS
+            || (rv = apr_socket_timeout_set(*sock, 0)) != APR_SUCCESS
+            || (rv = apr_socket_bind(*sock, sa)) != APR_SUCCESS
+            || (rv = apr_socket_listen(*sock, backlog)) != APR_SUCCESS) {
+        apr_socket_close(*sock);
+        return rv;
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_reactor_listen(apr_reactor_t *reactor,
+                                             apr_sockaddr_t *sa,
+                                             apr_int32_t backlog,
+                                             apr_reactor_accept_fn_t func,
+                                             void *baton)
+{
+    reactor_listener_t *listeners;
+    listen_start_t start;
+    apr_socket_t *sock;
+    apr_pool_t *p;
+    apr_status_t rv;
+    int i, reuseport = (reactor->nloops > 1);
+
+    listeners = apr_pcalloc(reactor->pool,
+                            reactor->nloops * sizeof(*listeners));
+
+    rv = listener_create(&sock, sa, backlog, reuseport, reactor->pool);
+    if (reuseport && APR_STATUS_IS_ENOTIMPL(rv)) {
+        reuseport = 0;
+        rv = listener_create(&sock, sa, backlog, 0, reactor->pool);
+    }
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    if (reuseport) {
+        /* bind the others to the very same port */
+        rv = apr_socket_addr_get(&sa, APR_LOCAL, sock);
+        if (rv != APR_SUCCESS) {
+            apr_socket_close(sock);
+            return rv;
+        }
+    }
+
+    if ((rv = apr_pool_create(&p, reactor->pool)) != APR_SUCCESS) {
+        apr_socket_close(sock);
+        return rv;
+    }
+    if ((rv = apr_thread_mutex_create(&start.mutex, APR_THREAD_MUTEX_DEFAULT,
+                                      p)) != APR_SUCCESS
+            || (rv = apr_thread_cond_create(&start.cond, p)) != APR_SUCCESS) {
+        apr_socket_close(sock);
+        apr_pool_destroy(p);
+        return rv;
+    }
+    start.pending = 0;
+    start.rv = APR_SUCCESS;
+
+    for (i = 0; i < reactor->nloops; ++i) {
+        reactor_listener_t *listener = &listeners[i];
+        apr_reactor_loop_t *loop = &reactor->loops[i];
+
+        if (i > 0 && reuseport) {
+            rv = listener_create(&sock, sa, backlog, 1, reactor->pool);
+            if (rv != APR_SUCCESS) {
+                break;
+            }
+        }
+        listener->reactor = reactor;
+        listener->sock = sock;
+        listener->func = func;
+        listener->baton = baton;
+        /* a shared socket wakes up a single loop per connection */
+        listener->reqevents = APR_POLLIN | (reuseport ? 0 : APR_POLLEXCL);
+        listener->start = &start;
+
+        if (loop_is_current(loop)) {
+            /* called from that loop, it can't run the task while we wait */
+            rv = listener_watch(loop, listener);
+        }
+        else {
+            apr_thread_mutex_lock(start.mutex);
+            ++start.pending;
+            apr_thread_mutex_unlock(start.mutex);
+
+            rv = apr_reactor_post(loop, listener_watch_task, listener);
+            if (rv != APR_SUCCESS) {
+                apr_thread_mutex_lock(start.mutex);
+                --start.pending;
+                apr_thread_mutex_unlock(start.mutex);
+                if (reuseport) {
+                    apr_socket_close(sock);
+                    listener->sock = NULL;
+                }
+            }
+        }
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+
+    /* wait for the loops to tell whether they watch their listener */
+    listen_start_wait(&start);
+    if (rv == APR_SUCCESS) {
+        rv = start.rv;
+    }
+    if (rv != APR_SUCCESS) {
+        listen_unwind(reactor, listeners, &start, reuseport ? NULL : sock);
+    }
+    for (i = 0; i < reactor->nloops; ++i) {
+        listeners[i].start = NULL;
+    }
+    apr_pool_destroy(p);
+
+    return rv;
+}
+
+#endif /* APR_HAS_THREADS */
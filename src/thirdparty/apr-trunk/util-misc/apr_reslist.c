@@ -20,10 +20,16 @@
 #include "apr_reslist.h"
 #include "apr_errno.h"
 #include "apr_strings.h"
+#include "apr_atomic.h"
+#include "apr_portable.h"
 #include "apr_thread_mutex.h"
 #include "apr_thread_cond.h"
 #include "apr_ring.h"
 
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
 /**
  * A single resource element.
  */
@@ -40,6 +46,75 @@ typedef struct apr_res_t apr_res_t;
 APR_RING_HEAD(apr_resring_t, apr_res_t);
 typedef struct apr_resring_t apr_resring_t;
 
+#if APR_HAS_THREADS
+
+#define RESLIST_CACHELINE 64
+#define RESLIST_MIN_SLOTS 16
+#define RESLIST_MAX_SLOTS 1024
+
+/**
+ * A parking place for the resource last released by a thread, where it
+ * (most likely) finds it again without locking.
+ */
+#define SLOT_EMPTY 0
+#define SLOT_BUSY  1
+#define SLOT_FULL  2
+
+typedef union reslist_slot {
+    struct {
+        volatile apr_uint32_t state;
+        apr_time_t freed;
+        void *opaque;
+    } s;
+    char pad[RESLIST_CACHELINE];
+} reslist_slot;
+
+typedef struct reslist_entry {
+    apr_time_t freed;
+    void *opaque;
+} reslist_entry;
+
+/**
+ * A shard of the available resources, with its own lock. The entries are
+ * kept oldest first in a circular array, the capacities of all the shards
+ * adding up to at least hmax so that a released resource always fits in
+ * one of them.
+ */
+typedef struct reslist_shard {
+    apr_thread_mutex_t *lock;
+    reslist_entry *entries;
+    apr_uint32_t cap;
+    apr_uint32_t first;
+    volatile apr_uint32_t count;
+    char pad[RESLIST_CACHELINE];
+} reslist_shard;
+
+/**
+ * The state of a sharded list. The counters are maintained atomically,
+ * nidle is incremented before a resource is made available so that it
+ * never underflows, and listlock only serializes the constructor and
+ * destructor calls on the pool.
+ */
+typedef struct reslist_sharded {
+    reslist_shard *shards;
+    unsigned int nshards;
+    reslist_slot *slots;
+    unsigned int nslots;    /* a power of two */
+    char pad0[RESLIST_CACHELINE];
+    volatile apr_uint32_t ntotal;
+    char pad1[RESLIST_CACHELINE];
+    volatile apr_uint32_t nidle;
+    char pad2[RESLIST_CACHELINE];
+    volatile apr_uint32_t waiters;
+    volatile apr_uint32_t maintaining;
+    volatile apr_uint32_t next_shard;
+    volatile apr_uint64_t next_expiry;
+    apr_thread_mutex_t *waitlock;
+    apr_thread_cond_t *avail;
+} reslist_sharded;
+
+#endif /* APR_HAS_THREADS */
+
 struct apr_reslist_t {
     apr_pool_t *pool; /* the pool used in constructor and destructor calls */
     int ntotal;     /* total number of resources managed by this list */
@@ -57,6 +132,7 @@ struct apr_reslist_t {
 #if APR_HAS_THREADS
     apr_thread_mutex_t *listlock;
     apr_thread_cond_t *avail;
+    reslist_sharded *sh;    /* shards and slots, if created so */
 #endif
 };
 
@@ -152,6 +228,459 @@ static apr_status_t destroy_resource(apr_reslist_t *reslist, apr_res_t *res)
     return reslist->destructor(res->opaque, reslist->params, reslist->pool);
 }
 
+#if APR_HAS_THREADS
+
+/*
+ * Sharded lists: a released resource is parked in the slot of the
+ * releasing thread, where the same thread takes it back with a couple of
+ * atomic operations the next time. When the slot is taken, the resource
+ * goes to the thread's shard, and a thread which finds neither its slot
+ * nor its shard stocked looks at the other shards then the other slots.
+ * Only when no resource is available and hmax is reached does a thread
+ * have to wait on the (global) condition.
+ */
+
+static unsigned int thread_hash(void)
+{
+    apr_os_thread_t self = apr_os_thread_current();
+    apr_uint64_t h = 0;
+
+    memcpy(&h, &self, sizeof(self) < sizeof(h) ? sizeof(self) : sizeof(h));
+    /* thread ids are often aligned addresses, take the mixed high bits */
+    return (unsigned int)((h * APR_UINT64_C(0x9e3779b97f4a7c15)) >> 32);
+}
+
+static int slot_put(reslist_slot *slot, void *opaque, apr_time_t freed)
+{
+    if (apr_atomic_cas32(&slot->s.state, SLOT_BUSY, SLOT_EMPTY) != SLOT_EMPTY) {
+        return 0;
+    }
+    slot->s.opaque = opaque;
+    slot->s.freed = freed;
+    apr_atomic_set32(&slot->s.state, SLOT_FULL);
+    return 1;
+}
+
+/**
+ * Take the resource parked in a slot, if any and (when kill is not set)
+ * only if it has expired, otherwise account for its age in oldest.
+ */
+static int slot_take(reslist_slot *slot, reslist_entry *e, apr_time_t now,
+                     apr_interval_time_t ttl, int kill, apr_time_t *oldest)
+{
+    if (apr_atomic_read32(&slot->s.state) != SLOT_FULL
+            || apr_atomic_cas32(&slot->s.state, SLOT_BUSY,
+                                SLOT_FULL) != SLOT_FULL) {
+        return 0;
+    }
+    if (oldest && !(kill && now - slot->s.freed >= ttl)) {
+        if (slot->s.freed < *oldest) {
+            *oldest = slot->s.freed;
+        }
+        apr_atomic_set32(&slot->s.state, SLOT_FULL);
+        return 0;
+    }
+    e->opaque = slot->s.opaque;
+    e->freed = slot->s.freed;
+    apr_atomic_set32(&slot->s.state, SLOT_EMPTY);
+    return 1;
+}
+
+static int shard_put(reslist_shard *shard, void *opaque, apr_time_t freed)
+{
+    reslist_entry *e;
+
+    apr_thread_mutex_lock(shard->lock);
+    if (shard->count == shard->cap) {
+        apr_thread_mutex_unlock(shard->lock);
+        return 0;
+    }
+    e = &shard->entries[(shard->first + shard->count) % shard->cap];
+    e->opaque = opaque;
+    e->freed = freed;
+    shard->count++;
+    apr_thread_mutex_unlock(shard->lock);
+    return 1;
+}
+
+/**
+ * Take the latest or oldest resource of a shard or, when oldest is given,
+ * the oldest one only if (kill is set and) it has expired.
+ */
+static int shard_take(reslist_shard *shard, reslist_entry *e, int fifo,
+                      apr_time_t now, apr_interval_time_t ttl, int kill,
+                      apr_time_t *oldest)
+{
+    if (!shard->count) {
+        return 0;
+    }
+    apr_thread_mutex_lock(shard->lock);
+    if (!shard->count) {
+        apr_thread_mutex_unlock(shard->lock);
+        return 0;
+    }
+    if (oldest) {
+        apr_time_t freed = shard->entries[shard->first].freed;
+        if (!(kill && now - freed >= ttl)) {
+            if (freed < *oldest) {
+                *oldest = freed;
+            }
+            apr_thread_mutex_unlock(shard->lock);
+            return 0;
+        }
+        fifo = 1;
+    }
+    if (fifo) {
+        *e = shard->entries[shard->first];
+        shard->first = (shard->first + 1) % shard->cap;
+    }
+    else {
+        *e = shard->entries[(shard->first + shard->count - 1) % shard->cap];
+    }
+    shard->count--;
+    apr_thread_mutex_unlock(shard->lock);
+    return 1;
+}
+
+static void sharded_wake(reslist_sharded *sh)
+{
+    if (apr_atomic_read32(&sh->waiters)) {
+        apr_thread_mutex_lock(sh->waitlock);
+        apr_thread_cond_signal(sh->avail);
+        apr_thread_mutex_unlock(sh->waitlock);
+    }
+}
+
+/**
+ * Make a resource available, counted in nidle by the caller.
+ */
+static void sharded_put(reslist_sharded *sh, unsigned int hash,
+                        void *opaque, apr_time_t freed, int park)
+{
+    unsigned int i;
+
+    if (!park || !slot_put(&sh->slots[hash & (sh->nslots - 1)],
+                           opaque, freed)) {
+        for (i = 0; i < sh->nshards; ++i) {
+            if (shard_put(&sh->shards[(hash + i) % sh->nshards],
+                          opaque, freed)) {
+                break;
+            }
+        }
+        assert(i < sh->nshards);
+    }
+    sharded_wake(sh);
+}
+
+static int sharded_take(reslist_sharded *sh, unsigned int hash, int fifo,
+                        reslist_entry *e)
+{
+    unsigned int i;
+
+    /* FIFO rotates the resources, thus skips the thread's own slot */
+    if (!fifo && slot_take(&sh->slots[hash & (sh->nslots - 1)], e,
+                           0, 0, 0, NULL)) {
+        goto found;
+    }
+    if (!apr_atomic_read32(&sh->nidle)) {
+        return 0;
+    }
+    for (i = 0; i < sh->nshards; ++i) {
+        if (shard_take(&sh->shards[(hash + i) % sh->nshards], e, fifo,
+                       0, 0, 0, NULL)) {
+            goto found;
+        }
+    }
+    for (i = 0; i < sh->nslots; ++i) {
+        if (slot_take(&sh->slots[(hash + i) & (sh->nslots - 1)], e,
+                      0, 0, 0, NULL)) {
+            goto found;
+        }
+    }
+    return 0;
+
+found:
+    apr_atomic_dec32(&sh->nidle);
+    return 1;
+}
+
+/**
+ * Call the constructor, serialized on the pool.
+ */
+static apr_status_t sharded_construct(apr_reslist_t *reslist, void **opaque)
+{
+    apr_status_t rv;
+
+    apr_thread_mutex_lock(reslist->listlock);
+    apr_pool_owner_set(reslist->pool, 0);
+    rv = reslist->constructor(opaque, reslist->params, reslist->pool);
+    apr_thread_mutex_unlock(reslist->listlock);
+    return rv;
+}
+
+/**
+ * Call the destructor, serialized on the pool, and let a waiter create a
+ * new resource.
+ */
+static apr_status_t sharded_destroy(apr_reslist_t *reslist, void *opaque)
+{
+    apr_status_t rv;
+
+    apr_thread_mutex_lock(reslist->listlock);
+    apr_pool_owner_set(reslist->pool, 0);
+    rv = reslist->destructor(opaque, reslist->params, reslist->pool);
+    apr_thread_mutex_unlock(reslist->listlock);
+
+    apr_atomic_dec32(&reslist->sh->ntotal);
+    sharded_wake(reslist->sh);
+    return rv;
+}
+
+/**
+ * Account for one more resource if hmax allows.
+ */
+static int sharded_grow(apr_reslist_t *reslist)
+{
+    reslist_sharded *sh = reslist->sh;
+    apr_uint32_t n;
+
+    for (;;) {
+        n = apr_atomic_read32(&sh->ntotal);
+        if (n >= (apr_uint32_t)reslist->hmax) {
+            return 0;
+        }
+        if (apr_atomic_cas32(&sh->ntotal, n + 1, n) == n) {
+            return 1;
+        }
+    }
+}
+
+/**
+ * Same as reslist_maintain() for sharded lists. Expiry is skipped until
+ * the oldest resource seen by the previous run can have expired, and a
+ * run is skipped altogether when another thread is at it.
+ */
+static apr_status_t sharded_maintain(apr_reslist_t *reslist)
+{
+    reslist_sharded *sh = reslist->sh;
+    apr_status_t rv = APR_SUCCESS;
+    apr_time_t now, oldest;
+    reslist_entry e;
+    void *opaque;
+    int created_one = 0;
+    unsigned int i;
+
+    if (apr_atomic_cas32(&sh->maintaining, 1, 0)) {
+        return APR_SUCCESS;
+    }
+
+    while (apr_atomic_read32(&sh->nidle) < (apr_uint32_t)reslist->min
+           && sharded_grow(reslist)) {
+        rv = sharded_construct(reslist, &opaque);
+        if (rv != APR_SUCCESS) {
+            apr_atomic_dec32(&sh->ntotal);
+            sharded_wake(sh);
+            goto done;
+        }
+        apr_atomic_inc32(&sh->nidle);
+        sharded_put(sh, apr_atomic_inc32(&sh->next_shard), opaque,
+                    reslist->ttl ? apr_time_now() : 0, 0);
+        created_one++;
+    }
+
+    if (created_one || !reslist->ttl) {
+        goto done;
+    }
+    now = apr_time_now();
+    if (now < (apr_time_t)apr_atomic_read64(&sh->next_expiry)) {
+        goto done;
+    }
+
+    oldest = now;
+    for (i = 0; i < sh->nshards + sh->nslots; ++i) {
+        for (;;) {
+            int kill = apr_atomic_read32(&sh->nidle)
+                       > (apr_uint32_t)reslist->smax;
+            if (i < sh->nshards) {
+                if (!shard_take(&sh->shards[i], &e, 1, now, reslist->ttl,
+                                kill, &oldest)) {
+                    break;
+                }
+            }
+            else if (!slot_take(&sh->slots[i - sh->nshards], &e, now,
+                                reslist->ttl, kill, &oldest)) {
+                break;
+            }
+            apr_atomic_dec32(&sh->nidle);
+            rv = sharded_destroy(reslist, e.opaque);
+            if (rv != APR_SUCCESS) {
+                goto done;
+            }
+        }
+    }
+    apr_atomic_set64(&sh->next_expiry, oldest + reslist->ttl);
+
+done:
+    apr_atomic_set32(&sh->maintaining, 0);
+    return rv;
+}
+
+static apr_status_t sharded_acquire(apr_reslist_t *reslist,
+                                    void **resource, int fifo)
+{
+    reslist_sharded *sh = reslist->sh;
+    unsigned int hash = thread_hash();
+    reslist_entry e;
+    apr_status_t rv;
+
+    for (;;) {
+        if (sharded_take(sh, hash, fifo, &e)) {
+            /* If it has expired, kill it right away. */
+            if (reslist->ttl && apr_time_now() - e.freed >= reslist->ttl) {
+                rv = sharded_destroy(reslist, e.opaque);
+                if (rv != APR_SUCCESS) {
+                    return rv;
+                }
+                continue;
+            }
+            *resource = e.opaque;
+            return APR_SUCCESS;
+        }
+
+        if (sharded_grow(reslist)) {
+            rv = sharded_construct(reslist, resource);
+            if (rv != APR_SUCCESS) {
+                apr_atomic_dec32(&sh->ntotal);
+                sharded_wake(sh);
+            }
+            return rv;
+        }
+
+        /* Block until something is released or invalidated; waiters is
+         * raised before checking so that releasers will signal.
+         */
+        rv = APR_SUCCESS;
+        apr_thread_mutex_lock(sh->waitlock);
+        apr_atomic_inc32(&sh->waiters);
+        if (!apr_atomic_read32(&sh->nidle)
+                && apr_atomic_read32(&sh->ntotal)
+                   >= (apr_uint32_t)reslist->hmax) {
+            if (reslist->timeout) {
+                rv = apr_thread_cond_timedwait(sh->avail, sh->waitlock,
+                                               reslist->timeout);
+            }
+            else {
+                rv = apr_thread_cond_wait(sh->avail, sh->waitlock);
+            }
+        }
+        apr_atomic_dec32(&sh->waiters);
+        apr_thread_mutex_unlock(sh->waitlock);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+}
+
+static apr_status_t sharded_release(apr_reslist_t *reslist, void *resource)
+{
+    reslist_sharded *sh = reslist->sh;
+    apr_time_t now = reslist->ttl ? apr_time_now() : 0;
+    apr_uint32_t nidle;
+
+    nidle = apr_atomic_inc32(&sh->nidle) + 1;
+    sharded_put(sh, thread_hash(), resource, now, 1);
+
+    if (nidle < (apr_uint32_t)reslist->min
+            || (reslist->ttl && nidle > (apr_uint32_t)reslist->smax
+                && now >= (apr_time_t)apr_atomic_read64(&sh->next_expiry))) {
+        return sharded_maintain(reslist);
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t sharded_cleanup(apr_reslist_t *rl)
+{
+    reslist_sharded *sh = rl->sh;
+    apr_status_t rv = APR_SUCCESS;
+    reslist_entry e;
+    unsigned int i;
+
+    for (i = 0; i < sh->nshards + sh->nslots; ++i) {
+        for (;;) {
+            apr_status_t rv1;
+            if (i < sh->nshards) {
+                if (!shard_take(&sh->shards[i], &e, 0, 0, 0, 0, NULL)) {
+                    break;
+                }
+            }
+            else if (!slot_take(&sh->slots[i - sh->nshards], &e,
+                                0, 0, 0, NULL)) {
+                break;
+            }
+            apr_atomic_dec32(&sh->nidle);
+            apr_atomic_dec32(&sh->ntotal);
+            rv1 = rl->destructor(e.opaque, rl->params, rl->pool);
+            if (rv1 != APR_SUCCESS) {
+                rv = rv1;
+            }
+        }
+    }
+
+    assert(sh->nidle == 0);
+    assert(sh->ntotal == 0);
+
+    return rv;
+}
+
+static apr_status_t sharded_create(apr_reslist_t *rl, int nshards)
+{
+    reslist_sharded *sh;
+    apr_status_t rv;
+    apr_uint32_t cap;
+    unsigned int i;
+    char *mem;
+
+    sh = apr_pcalloc(rl->pool, sizeof(*sh));
+    sh->nshards = nshards;
+    sh->shards = apr_pcalloc(rl->pool, nshards * sizeof(reslist_shard));
+    cap = (rl->hmax + nshards - 1) / nshards;
+    for (i = 0; i < sh->nshards; ++i) {
+        reslist_shard *shard = &sh->shards[i];
+        shard->entries = apr_palloc(rl->pool, cap * sizeof(reslist_entry));
+        shard->cap = cap;
+        rv = apr_thread_mutex_create(&shard->lock, APR_THREAD_MUTEX_DEFAULT,
+                                     rl->pool);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+
+    /* enough slots for all the resources, each in its own cache line */
+    sh->nslots = RESLIST_MIN_SLOTS;
+    while (sh->nslots < RESLIST_MAX_SLOTS
+           && sh->nslots < 2 * (unsigned int)rl->hmax) {
+        sh->nslots <<= 1;
+    }
+    mem = apr_pcalloc(rl->pool, (sh->nslots + 1) * sizeof(reslist_slot));
+    sh->slots = (reslist_slot *)APR_ALIGN((apr_uintptr_t)mem,
+                                          RESLIST_CACHELINE);
+
+    rv = apr_thread_mutex_create(&sh->waitlock, APR_THREAD_MUTEX_DEFAULT,
+                                 rl->pool);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    rv = apr_thread_cond_create(&sh->avail, rl->pool);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    rl->sh = sh;
+    return APR_SUCCESS;
+}
+
+#endif /* APR_HAS_THREADS */
+
 static apr_status_t reslist_cleanup(void *data_)
 {
     apr_status_t rv = APR_SUCCESS;
@@ -161,6 +690,9 @@ static apr_status_t reslist_cleanup(void *data_)
 #if APR_HAS_THREADS
     apr_thread_mutex_lock(rl->listlock);
     apr_pool_owner_set(rl->pool, 0);
+    if (rl->sh) {
+        rv = sharded_cleanup(rl);
+    }
 #endif
 
     while (rl->nidle > 0) {
@@ -250,6 +782,9 @@ APR_DECLARE(apr_status_t) apr_reslist_maintain(apr_reslist_t *reslist)
     apr_status_t rv;
 
 #if APR_HAS_THREADS
+    if (reslist->sh) {
+        return sharded_maintain(reslist);
+    }
     apr_thread_mutex_lock(reslist->listlock);
     apr_pool_owner_set(reslist->pool, 0);
 #endif
@@ -260,13 +795,13 @@ APR_DECLARE(apr_status_t) apr_reslist_maintain(apr_reslist_t *reslist)
     return rv;
 }
 
-APR_DECLARE(apr_status_t) apr_reslist_create(apr_reslist_t **reslist,
-                                             int min, int smax, int hmax,
-                                             apr_interval_time_t ttl,
-                                             apr_reslist_constructor con,
-                                             apr_reslist_destructor de,
-                                             void *params,
-                                             apr_pool_t *pool)
+static apr_status_t reslist_create(apr_reslist_t **reslist,
+                                   int min, int smax, int hmax,
+                                   apr_interval_time_t ttl,
+                                   apr_reslist_constructor con,
+                                   apr_reslist_destructor de,
+                                   void *params, int nshards,
+                                   apr_pool_t *pool)
 {
     apr_status_t rv;
     apr_reslist_t *rl;
@@ -274,7 +809,7 @@ APR_DECLARE(apr_status_t) apr_reslist_create(apr_reslist_t **reslist,
     /* Do some sanity checks so we don't thrash around in the
      * maintenance routine later. */
     if (min < 0 || min > smax || min > hmax || smax > hmax || hmax == 0 ||
-        ttl < 0) {
+        ttl < 0 || nshards < 0) {
         return APR_EINVAL;
     }
 
@@ -312,8 +847,20 @@ APR_DECLARE(apr_status_t) apr_reslist_create(apr_reslist_t **reslist,
     if (rv != APR_SUCCESS) {
         return rv;
     }
+    if (nshards) {
+        rv = sharded_create(rl, nshards);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
 #endif
 
+#if APR_HAS_THREADS
+    if (rl->sh) {
+        rv = sharded_maintain(rl);
+    }
+    else
+#endif
     rv = reslist_maintain(rl);
     if (rv != APR_SUCCESS) {
         /* Destroy what we've created so far.
@@ -330,6 +877,35 @@ APR_DECLARE(apr_status_t) apr_reslist_create(apr_reslist_t **reslist,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_reslist_create(apr_reslist_t **reslist,
+                                             int min, int smax, int hmax,
+                                             apr_interval_time_t ttl,
+                                             apr_reslist_constructor con,
+                                             apr_reslist_destructor de,
+                                             void *params,
+                                             apr_pool_t *pool)
+{
+    return reslist_create(reslist, min, smax, hmax, ttl, con, de, params,
+                          0, pool);
+}
+
+APR_DECLARE(apr_status_t) apr_reslist_create_sharded(apr_reslist_t **reslist,
+                                                     int min, int smax,
+                                                     int hmax,
+                                                     apr_interval_time_t ttl,
+                                                     apr_reslist_constructor con,
+                                                     apr_reslist_destructor de,
+                                                     void *params,
+                                                     int nshards,
+                                                     apr_pool_t *pool)
+{
+    if (nshards <= 0) {
+        return APR_EINVAL;
+    }
+    return reslist_create(reslist, min, smax, hmax, ttl, con, de, params,
+                          nshards, pool);
+}
+
 APR_DECLARE(apr_status_t) apr_reslist_destroy(apr_reslist_t *reslist)
 {
     return apr_pool_cleanup_run(reslist->pool, reslist, reslist_cleanup);
@@ -348,6 +924,9 @@ static apr_status_t reslist_acquire(apr_reslist_t *reslist,
     fifo = flags & APR_RESLIST_ACQUIRE_FIFO;
 
 #if APR_HAS_THREADS
+    if (reslist->sh) {
+        return sharded_acquire(reslist, resource, fifo);
+    }
     apr_thread_mutex_lock(reslist->listlock);
     apr_pool_owner_set(reslist->pool, 0);
 #endif
@@ -452,6 +1031,9 @@ APR_DECLARE(apr_status_t) apr_reslist_release(apr_reslist_t *reslist,
     apr_res_t *res;
 
 #if APR_HAS_THREADS
+    if (reslist->sh) {
+        return sharded_release(reslist, resource);
+    }
     apr_thread_mutex_lock(reslist->listlock);
     apr_pool_owner_set(reslist->pool, 0);
 #endif
@@ -476,6 +1058,12 @@ APR_DECLARE(apr_uint32_t) apr_reslist_acquired_count(apr_reslist_t *reslist)
     apr_uint32_t count;
 
 #if APR_HAS_THREADS
+    if (reslist->sh) {
+        /* nidle is read first, it may lag behind an expiry */
+        apr_uint32_t nidle = apr_atomic_read32(&reslist->sh->nidle);
+        count = apr_atomic_read32(&reslist->sh->ntotal);
+        return count > nidle ? count - nidle : 0;
+    }
     apr_thread_mutex_lock(reslist->listlock);
     apr_pool_owner_set(reslist->pool, 0);
 #endif
@@ -492,6 +1080,9 @@ APR_DECLARE(apr_status_t) apr_reslist_invalidate(apr_reslist_t *reslist,
 {
     apr_status_t ret;
 #if APR_HAS_THREADS
+    if (reslist->sh) {
+        return sharded_destroy(reslist, resource);
+    }
     apr_thread_mutex_lock(reslist->listlock);
     apr_pool_owner_set(reslist->pool, 0);
 #endif
@@ -0,0 +1,196 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr.h"
+
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "apu.h"
+#include "apr_atomic.h"
+#include "apr_errno.h"
+#include "apr_spsc_queue.h"
+
+#define SPSC_CACHELINE 64
+#define SPSC_MIN_SIZE  64
+
+/* Records are preceded by a header and aligned on its size. A record
+ * which does not fit before the end of the ring is put at the start of
+ * it, after a pad record covering the gap.
+ */
+typedef struct spsc_hdr {
+    apr_uint32_t len;
+    apr_uint32_t pad;  /* non-zero for a pad record */
+} spsc_hdr;
+
+#define SPSC_SPAN(len) \
+    (((apr_uint64_t)(len) + 2 * sizeof(spsc_hdr) - 1) & ~(sizeof(spsc_hdr) - 1))
+
+/* The indexes are free running byte counters. The producer only reads
+ * tail when its cached copy says the ring is full, and the consumer only
+ * reads head when its cached copy says the ring is empty, so that the
+ * cache lines of the indexes bounce only when one side catches up with
+ * the other.
+ */
+struct apr_spsc_queue_t {
+    char                  *buf;
+    apr_uint64_t           size;
+    apr_uint64_t           mask;
+    char                   pad0[SPSC_CACHELINE];
+    /* producer */
+    volatile apr_uint64_t  head;
+    apr_uint64_t           tail_cache;
+    apr_uint64_t           reserved;    /* position of the pending record */
+    apr_uint64_t           reserved_len;
+    spsc_hdr              *pending;
+    char                   pad1[SPSC_CACHELINE];
+    /* consumer */
+    volatile apr_uint64_t  tail;
+    apr_uint64_t           head_cache;
+    apr_uint64_t           peeked;      /* span of the peeked record */
+    char                   pad2[SPSC_CACHELINE];
+};
+
+APR_DECLARE(apr_status_t) apr_spsc_queue_create(apr_spsc_queue_t **q,
+                                                apr_size_t size,
+                                                apr_pool_t *a)
+{
+    apr_spsc_queue_t *queue;
+    apr_uint64_t n = SPSC_MIN_SIZE;
+
+    if (size > APR_UINT32_MAX) {
+        return APR_EINVAL;
+    }
+    while (n < size) {
+        n <<= 1;
+    }
+
+    queue = apr_pcalloc(a, sizeof(apr_spsc_queue_t));
+    queue->buf = apr_palloc(a, n);
+    queue->size = n;
+    queue->mask = n - 1;
+
+    *q = queue;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_spsc_queue_reserve(apr_spsc_queue_t *queue,
+                                                 apr_size_t len, void **rec)
+{
+    apr_uint64_t pos = queue->head, span, gap;
+    spsc_hdr *hdr;
+
+    if (len > queue->size / 2 - sizeof(spsc_hdr)) {
+        return APR_EINVAL;
+    }
+    span = SPSC_SPAN(len);
+    gap = queue->size - (pos & queue->mask);
+    if (gap >= span) {
+        gap = 0;
+    }
+
+    if (pos + gap + span - queue->tail_cache > queue->size) {
+        queue->tail_cache = apr_atomic_read64(&queue->tail);
+        if (pos + gap + span - queue->tail_cache > queue->size) {
+            return APR_EAGAIN;
+        }
+    }
+
+    if (gap) {
+        /* published along with the record */
+        hdr = (spsc_hdr *)(queue->buf + (pos & queue->mask));
+        hdr->len = (apr_uint32_t)gap;
+        hdr->pad = 1;
+        pos += gap;
+    }
+    hdr = (spsc_hdr *)(queue->buf + (pos & queue->mask));
+    hdr->pad = 0;
+
+    queue->reserved = pos;
+    queue->reserved_len = len;
+    queue->pending = hdr;
+    *rec = hdr + 1;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_spsc_queue_commit(apr_spsc_queue_t *queue,
+                                                void *rec, apr_size_t len)
+{
+    spsc_hdr *hdr = queue->pending;
+
+    if (!hdr || rec != hdr + 1 || len > queue->reserved_len) {
+        return APR_EINVAL;
+    }
+    hdr->len = (apr_uint32_t)len;
+
+    /* the records (and pad) are written before head says so */
+    apr_atomic_set64(&queue->head, queue->reserved + SPSC_SPAN(len));
+    queue->pending = NULL;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_spsc_queue_push(apr_spsc_queue_t *queue,
+                                              const void *data,
+                                              apr_size_t len)
+{
+    apr_status_t rv;
+    void *rec;
+
+    rv = apr_spsc_queue_reserve(queue, len, &rec);
+    if (rv == APR_SUCCESS) {
+        memcpy(rec, data, len);
+        rv = apr_spsc_queue_commit(queue, rec, len);
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_spsc_queue_peek(apr_spsc_queue_t *queue,
+                                              void **rec, apr_size_t *len)
+{
+    apr_uint64_t pos = queue->tail;
+    spsc_hdr *hdr;
+
+    if (pos == queue->head_cache) {
+        queue->head_cache = apr_atomic_read64(&queue->head);
+        if (pos == queue->head_cache) {
+            return APR_EAGAIN;
+        }
+    }
+
+    hdr = (spsc_hdr *)(queue->buf + (pos & queue->mask));
+    if (hdr->pad) {
+        /* a pad is always followed by a record, committed at once */
+        pos += hdr->len;
+        apr_atomic_set64(&queue->tail, pos);
+        hdr = (spsc_hdr *)(queue->buf + (pos & queue->mask));
+    }
+
+    queue->peeked = SPSC_SPAN(hdr->len);
+    *rec = hdr + 1;
+    *len = hdr->len;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_spsc_queue_release(apr_spsc_queue_t *queue)
+{
+    if (!queue->peeked) {
+        return APR_EINVAL;
+    }
+    apr_atomic_set64(&queue->tail, queue->tail + queue->peeked);
+    queue->peeked = 0;
+    return APR_SUCCESS;
+}
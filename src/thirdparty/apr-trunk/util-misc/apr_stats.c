@@ -0,0 +1,469 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr.h"
+
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "apu.h"
+#include "apr_private.h"
+#include "apr_atomic.h"
+#include "apr_errno.h"
+#include "apr_strings.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_proc.h"
+#include "apr_stats.h"
+
+#if defined(HAVE_SCHED_GETCPU) && defined(HAVE_SCHED_H)
+#include <sched.h>
+#define STATS_HAVE_GETCPU 1
+#endif
+
+#define STATS_CACHELINE  64
+#define STATS_MAX_SHARDS 64
+#define STATS_LINE_WORDS (STATS_CACHELINE / sizeof(apr_uint64_t))
+
+/* Each shard of a metric starts on its own cache line, strides are in
+ * apr_uint64_t words. A histogram shard is its sum, its max then its
+ * buckets; the count is the sum of the buckets.
+ */
+#define HIST_SUM     0
+#define HIST_MAX     1
+#define HIST_BUCKETS 2
+
+typedef struct stats_metric_t stats_metric_t;
+
+struct stats_metric_t {
+    stats_metric_t        *next;
+    apr_stats_type_e       type;
+    const char            *name;
+    apr_stats_t           *stats;
+    volatile apr_uint64_t *data;
+    apr_size_t             stride;
+};
+
+struct apr_stats_counter_t {
+    stats_metric_t metric;
+};
+
+struct apr_stats_histogram_t {
+    stats_metric_t metric;
+    apr_uint64_t   highest;
+    apr_size_t     nbuckets;
+    int            precision;
+};
+
+struct apr_stats_t {
+    apr_pool_t          *pool;
+    apr_uint32_t         flags;
+    apr_uint32_t         mask;  /* number of shards - 1 */
+    stats_metric_t      *first;
+    stats_metric_t     **last;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t  *lock;
+#endif
+};
+
+#if APR_HAS_THREAD_LOCAL
+/* 1 + the shard slot of the thread, 0 until assigned */
+static APR_THREAD_LOCAL apr_uint32_t stats_thread_slot;
+static apr_uint32_t stats_next_slot;
+#endif
+
+static APR_INLINE apr_uint32_t stats_shard(const apr_stats_t *stats)
+{
+#ifdef STATS_HAVE_GETCPU
+    if (stats->flags & APR_STATS_PER_CPU) {
+        int cpu = sched_getcpu();
+        if (cpu >= 0) {
+            return (apr_uint32_t)cpu & stats->mask;
+        }
+    }
+#endif
+#if APR_HAS_THREAD_LOCAL
+    if (!stats_thread_slot) {
+        stats_thread_slot = apr_atomic_inc32(&stats_next_slot) + 1;
+    }
+    return (stats_thread_slot - 1) & stats->mask;
+#else
+    return 0;
+#endif
+}
+
+static int stats_msb(apr_uint64_t v)
+{
+#if defined(__GNUC__) && (__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4))
+    return 63 - __builtin_clzll(v);
+#else
+    int n = 0;
+    while (v >>= 1) {
+        ++n;
+    }
+    return n;
+#endif
+}
+
+/* Values below 2^(precision+1) have their own bucket, above that each
+ * power of two range is split in 2^precision buckets.
+ */
+static APR_INLINE apr_size_t hist_index(apr_uint64_t v, int precision)
+{
+    int shift = 0;
+
+    if (v >> (precision + 1)) {
+        shift = stats_msb(v) - precision;
+    }
+    return ((apr_size_t)shift << precision) + (apr_size_t)(v >> shift);
+}
+
+static apr_uint64_t hist_value(apr_size_t idx, int precision)
+{
+    apr_size_t shift = idx >> precision;
+
+    if (shift <= 1) {
+        return idx;
+    }
+    shift -= 1;
+    return (apr_uint64_t)(idx - (shift << precision)) << shift;
+}
+
+static volatile apr_uint64_t *stats_alloc_shards(apr_stats_t *stats,
+                                                 apr_size_t words,
+                                                 apr_size_t *stride)
+{
+    apr_size_t size;
+    char *mem;
+
+    *stride = (words + STATS_LINE_WORDS - 1) & ~(STATS_LINE_WORDS - 1);
+    size = *stride * sizeof(apr_uint64_t) * (stats->mask + 1);
+    mem = apr_pcalloc(stats->pool, size + STATS_CACHELINE);
+    mem += STATS_CACHELINE - ((apr_uintptr_t)mem & (STATS_CACHELINE - 1));
+    return (volatile apr_uint64_t *)mem;
+}
+
+static apr_status_t stats_add(apr_stats_t *stats, stats_metric_t *metric,
+                              apr_stats_type_e type, const char *name,
+                              apr_size_t words)
+{
+    apr_status_t rv = APR_SUCCESS;
+
+#if APR_HAS_THREADS
+    rv = apr_thread_mutex_lock(stats->lock);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+#endif
+
+    metric->type = type;
+    metric->name = apr_pstrdup(stats->pool, name);
+    metric->stats = stats;
+    metric->data = stats_alloc_shards(stats, words, &metric->stride);
+    metric->next = NULL;
+    *stats->last = metric;
+    stats->last = &metric->next;
+
+#if APR_HAS_THREADS
+    apr_thread_mutex_unlock(stats->lock);
+#endif
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_stats_create(apr_stats_t **stats,
+                                           apr_uint32_t flags,
+                                           apr_pool_t *p)
+{
+    apr_stats_t *s;
+    apr_uint32_t n = 1;
+    long ncpu = 1;
+
+#if defined(_SC_NPROCESSORS_ONLN)
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+#if APR_HAS_THREAD_LOCAL || defined(STATS_HAVE_GETCPU)
+    while (n < STATS_MAX_SHARDS && (long)n < ncpu) {
+        n <<= 1;
+    }
+#endif
+
+    s = apr_pcalloc(p, sizeof(*s));
+    s->pool = p;
+    s->flags = flags;
+    s->mask = n - 1;
+    s->last = &s->first;
+
+#if APR_HAS_THREADS
+    {
+        apr_status_t rv = apr_thread_mutex_create(&s->lock,
+                                                  APR_THREAD_MUTEX_DEFAULT, p);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+#endif
+
+    *stats = s;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_stats_counter_create(
+        apr_stats_counter_t **counter, apr_stats_t *stats, const char *name)
+{
+    apr_stats_counter_t *c = apr_palloc(stats->pool, sizeof(*c));
+    apr_status_t rv;
+
+    rv = stats_add(stats, &c->metric, APR_STATS_COUNTER, name, 1);
+    if (rv == APR_SUCCESS) {
+        *counter = c;
+    }
+    return rv;
+}
+
+APR_DECLARE(void) apr_stats_counter_add(apr_stats_counter_t *counter,
+                                        apr_uint64_t val)
+{
+    stats_metric_t *m = &counter->metric;
+
+    apr_atomic_add64_ex(&m->data[stats_shard(m->stats) * m->stride], val,
+                        APR_ATOMIC_RELAXED);
+}
+
+APR_DECLARE(void) apr_stats_counter_sub(apr_stats_counter_t *counter,
+                                        apr_uint64_t val)
+{
+    apr_stats_counter_add(counter, (apr_uint64_t)0 - val);
+}
+
+APR_DECLARE(apr_uint64_t) apr_stats_counter_read(
+        const apr_stats_counter_t *counter)
+{
+    const stats_metric_t *m = &counter->metric;
+    apr_uint64_t sum = 0;
+    apr_uint32_t i;
+
+    for (i = 0; i <= m->stats->mask; ++i) {
+        sum += apr_atomic_read64_ex(&m->data[i * m->stride],
+                                    APR_ATOMIC_RELAXED);
+    }
+    return sum;
+}
+
+APR_DECLARE(apr_status_t) apr_stats_histogram_create(
+        apr_stats_histogram_t **hist, apr_stats_t *stats, const char *name,
+        apr_uint64_t highest, int precision)
+{
+    apr_stats_histogram_t *h;
+    apr_status_t rv;
+
+    if (precision < 1 || precision > 10) {
+        return APR_EINVAL;
+    }
+
+    h = apr_palloc(stats->pool, sizeof(*h));
+    h->highest = highest;
+    h->precision = precision;
+    h->nbuckets = hist_index(highest, precision) + 1;
+
+    rv = stats_add(stats, &h->metric, APR_STATS_HISTOGRAM, name,
+                   HIST_BUCKETS + h->nbuckets);
+    if (rv == APR_SUCCESS) {
+        *hist = h;
+    }
+    return rv;
+}
+
+APR_DECLARE(void) apr_stats_histogram_record(apr_stats_histogram_t *hist,
+                                             apr_uint64_t val)
+{
+    stats_metric_t *m = &hist->metric;
+    volatile apr_uint64_t *shard = &m->data[stats_shard(m->stats) * m->stride];
+    apr_uint64_t max;
+
+    apr_atomic_add64_ex(&shard[HIST_BUCKETS
+                               + hist_index(val < hist->highest
+                                            ? val : hist->highest,
+                                            hist->precision)],
+                        1, APR_ATOMIC_RELAXED);
+    apr_atomic_add64_ex(&shard[HIST_SUM], val, APR_ATOMIC_RELAXED);
+
+    max = apr_atomic_read64_ex(&shard[HIST_MAX], APR_ATOMIC_RELAXED);
+    while (val > max) {
+        apr_uint64_t prev = apr_atomic_cas64_ex(&shard[HIST_MAX], val, max,
+                                                APR_ATOMIC_RELAXED);
+        if (prev == max) {
+            break;
+        }
+        max = prev;
+    }
+}
+
+APR_DECLARE(apr_status_t) apr_stats_histogram_snapshot(
+        apr_stats_snapshot_t **snap, const apr_stats_histogram_t *hist,
+        apr_pool_t *p)
+{
+    const stats_metric_t *m = &hist->metric;
+    apr_stats_snapshot_t *s;
+    apr_uint32_t i;
+    apr_size_t b;
+
+    s = apr_pcalloc(p, sizeof(*s));
+    s->nbuckets = hist->nbuckets;
+    s->precision = hist->precision;
+    s->buckets = apr_pcalloc(p, s->nbuckets * sizeof(apr_uint64_t));
+
+    for (i = 0; i <= m->stats->mask; ++i) {
+        volatile apr_uint64_t *shard = &m->data[i * m->stride];
+        apr_uint64_t max;
+
+        s->sum += apr_atomic_read64_ex(&shard[HIST_SUM], APR_ATOMIC_RELAXED);
+        max = apr_atomic_read64_ex(&shard[HIST_MAX], APR_ATOMIC_RELAXED);
+        if (max > s->max) {
+            s->max = max;
+        }
+        for (b = 0; b < s->nbuckets; ++b) {
+            s->buckets[b] += apr_atomic_read64_ex(&shard[HIST_BUCKETS + b],
+                                                  APR_ATOMIC_RELAXED);
+        }
+    }
+    for (b = 0; b < s->nbuckets; ++b) {
+        s->count += s->buckets[b];
+    }
+
+    *snap = s;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_uint64_t) apr_stats_bucket_value(
+        const apr_stats_snapshot_t *snap, apr_size_t bucket)
+{
+    return hist_value(bucket, snap->precision);
+}
+
+APR_DECLARE(apr_uint64_t) apr_stats_snapshot_percentile(
+        const apr_stats_snapshot_t *snap, double percentile)
+{
+    apr_uint64_t rank, seen = 0;
+    apr_size_t b;
+
+    if (!snap->count) {
+        return 0;
+    }
+    if (percentile < 0.0) {
+        percentile = 0.0;
+    }
+    else if (percentile > 100.0) {
+        percentile = 100.0;
+    }
+
+    rank = (apr_uint64_t)(percentile / 100.0 * (double)snap->count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    else if (rank > snap->count) {
+        rank = snap->count;
+    }
+
+    /* the highest value of the bucket reaching the rank */
+    for (b = 0; b < snap->nbuckets; ++b) {
+        seen += snap->buckets[b];
+        if (seen >= rank) {
+            apr_uint64_t val = hist_value(b + 1, snap->precision) - 1;
+            return val < snap->max ? val : snap->max;
+        }
+    }
+    return snap->max;
+}
+
+APR_DECLARE(apr_status_t) apr_stats_do(apr_stats_t *stats,
+                                       apr_stats_do_callback_fn_t *cb,
+                                       void *baton, apr_pool_t *p)
+{
+    stats_metric_t *m;
+    apr_status_t rv = APR_SUCCESS;
+
+#if APR_HAS_THREADS
+    rv = apr_thread_mutex_lock(stats->lock);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+#endif
+
+    for (m = stats->first; m && rv == APR_SUCCESS; m = m->next) {
+        if (m->type == APR_STATS_COUNTER) {
+            rv = cb(baton, m->name, m->type,
+                    apr_stats_counter_read((apr_stats_counter_t *)m), NULL);
+        }
+        else {
+            apr_stats_snapshot_t *snap;
+
+            apr_stats_histogram_snapshot(&snap, (apr_stats_histogram_t *)m, p);
+            rv = cb(baton, m->name, m->type, snap->count, snap);
+        }
+    }
+
+#if APR_HAS_THREADS
+    apr_thread_mutex_unlock(stats->lock);
+#endif
+
+    return rv;
+}
+
+typedef struct stats_dump_t {
+    apr_pool_t *pool;
+    char *text;
+} stats_dump_t;
+
+static apr_status_t stats_dump_one(void *baton, const char *name,
+                                   apr_stats_type_e type, apr_uint64_t value,
+                                   const apr_stats_snapshot_t *snap)
+{
+    stats_dump_t *dump = baton;
+    char *line;
+
+    if (type == APR_STATS_COUNTER) {
+        line = apr_psprintf(dump->pool, "%s %" APR_UINT64_T_FMT "\n",
+                            name, value);
+    }
+    else {
+        line = apr_psprintf(dump->pool,
+                            "%s count=%" APR_UINT64_T_FMT
+                            " sum=%" APR_UINT64_T_FMT
+                            " max=%" APR_UINT64_T_FMT
+                            " p50=%" APR_UINT64_T_FMT
+                            " p90=%" APR_UINT64_T_FMT
+                            " p99=%" APR_UINT64_T_FMT
+                            " p999=%" APR_UINT64_T_FMT "\n",
+                            name, snap->count, snap->sum, snap->max,
+                            apr_stats_snapshot_percentile(snap, 50.0),
+                            apr_stats_snapshot_percentile(snap, 90.0),
+                            apr_stats_snapshot_percentile(snap, 99.0),
+                            apr_stats_snapshot_percentile(snap, 99.9));
+    }
+    dump->text = apr_pstrcat(dump->pool, dump->text, line, NULL);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(const char *) apr_stats_dump(apr_stats_t *stats, apr_pool_t *p)
+{
+    stats_dump_t dump;
+
+    dump.pool = p;
+    dump.text = "";
+    apr_stats_do(stats, stats_dump_one, &dump, p);
+    return dump.text;
+}
@@ -21,11 +21,54 @@
 #include "apr_ring.h"
 #include "apr_thread_cond.h"
 #include "apr_portable.h"
+#include "apr_atomic.h"
+#include "apr_stats.h"
+#include "apr_strings.h"
 
 #if APR_HAS_THREADS
 
+#if defined(__linux__) && APR_HAVE_PTHREAD_H
+#include <sched.h>
+#ifdef CPU_SET
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#define THREAD_POOL_AFFINITY 1
+#endif
+#endif
+
+/* Queued tasks: a FIFO per priority, grouped in TASK_PRIORITY_SEGS lanes
+ * of TASK_LANE_PRIOS priorities, each with a bitmap of its non-empty ones.
+ */
 #define TASK_PRIORITY_SEGS 4
-#define TASK_PRIORITY_SEG(x) (((x)->dispatch.priority & 0xFF) / 64)
+#define TASK_LANE_PRIOS 64
+#define TASK_PRIORITIES (TASK_PRIORITY_SEGS * TASK_LANE_PRIOS)
+#define TASK_PRIORITY_SEG(x) ((x)->dispatch.priority / TASK_LANE_PRIOS)
+#define TASK_PRIORITY_BIT(x) \
+    ((apr_uint64_t)1 << ((x)->dispatch.priority % TASK_LANE_PRIOS))
+
+/* Work-stealing mode: capacity of each worker's deque (a power of two),
+ * how often a worker looks at the shared queue before its own deque,
+ * and the bounds of its private cache of task structures.
+ */
+#define WS_DEQUE_SIZE 512
+#define WS_DEQUE_MASK (WS_DEQUE_SIZE - 1)
+#define WS_GLOBAL_INTERVAL 61
+#define WS_CACHE_BATCH 32
+#define WS_CACHE_MAX 256
+#define WS_CACHELINE 64
+
+/* Scheduled tasks: a hierarchical timing wheel of TW_LEVELS levels of
+ * TW_SLOTS slots, ticking every 2^TW_TICK_SHIFT microseconds (about 1ms).
+ * Level 0 spans 64ms, level 3 nearly five hours; later tasks are kept in
+ * the last level and cascaded again until they fit.
+ */
+#define TW_LEVELS 4
+#define TW_BITS 6
+#define TW_SLOTS (1 << TW_BITS)
+#define TW_MASK (TW_SLOTS - 1)
+#define TW_TICK_SHIFT 10
+#define TW_TICK(time) ((apr_uint64_t)(time) >> TW_TICK_SHIFT)
 
 typedef struct apr_thread_pool_task
 {
@@ -33,6 +76,8 @@ typedef struct apr_thread_pool_task
     apr_thread_start_t func;
     void *param;
     void *owner;
+    apr_thread_pool_latch_t *latch;
+    apr_time_t queued;
     union
     {
         apr_byte_t priority;
@@ -42,13 +87,53 @@ typedef struct apr_thread_pool_task
 
 APR_RING_HEAD(apr_thread_pool_tasks, apr_thread_pool_task);
 
+struct apr_thread_pool_latch_t
+{
+    volatile apr_uint32_t count;
+    apr_thread_mutex_t *lock;
+    apr_thread_cond_t *zero;
+};
+
+struct timer_wheel
+{
+    /* All the ticks before this one have been expired */
+    apr_uint64_t now;
+    /* Bitmap of the non-empty slots of each level */
+    apr_uint64_t used[TW_LEVELS];
+    struct apr_thread_pool_tasks slot[TW_LEVELS][TW_SLOTS];
+    /* Tasks whose time has come, in expiry order */
+    struct apr_thread_pool_tasks due;
+};
+
 struct apr_thread_list_elt
 {
     APR_RING_ENTRY(apr_thread_list_elt) link;
     apr_thread_t *thd;
-    void *current_owner;
+    void *volatile current_owner;
     enum { TH_RUN, TH_STOP, TH_PROBATION } state;
-    int signal_work_done;
+    volatile apr_uint32_t signal_work_done;
+    /* Work-stealing mode only */
+    struct ws_deque *deque;
+    struct apr_thread_pool_tasks cache;
+    apr_size_t ncached;
+    apr_size_t tasks_run;
+    apr_uint32_t tick;
+    apr_uint32_t seed;
+};
+
+/*
+ * Chase-Lev deque: the owning worker pushes and takes at the bottom, other
+ * workers steal from the top.  The array has a fixed size, a worker whose
+ * deque is full pushes to the shared queue instead.
+ */
+struct ws_deque
+{
+    volatile apr_uint32_t top;
+    char pad0[WS_CACHELINE - sizeof(apr_uint32_t)];
+    volatile apr_uint32_t bottom;
+    char pad1[WS_CACHELINE - sizeof(apr_uint32_t)];
+    struct apr_thread_list_elt *owner;
+    apr_thread_pool_task_t *volatile buf[WS_DEQUE_SIZE];
 };
 
 APR_RING_HEAD(apr_thread_list, apr_thread_list_elt);
@@ -70,7 +155,7 @@ struct apr_thread_pool
     volatile apr_size_t thd_high;
     volatile apr_size_t thd_timed_out;
     struct apr_thread_pool_tasks *tasks;
-    struct apr_thread_pool_tasks *scheduled_tasks;
+    struct timer_wheel *timers;
     struct apr_thread_list *busy_thds;
     struct apr_thread_list *idle_thds;
     struct apr_thread_list *dead_thds;
@@ -81,21 +166,305 @@ struct apr_thread_pool
     volatile int terminated;
     struct apr_thread_pool_tasks *recycled_tasks;
     struct apr_thread_list *recycled_thds;
-    apr_thread_pool_task_t *task_idx[TASK_PRIORITY_SEGS];
+    apr_uint64_t lane_used[TASK_PRIORITY_SEGS];
+    apr_size_t lane_skips[TASK_PRIORITY_SEGS];
+    volatile apr_size_t starve_limit;
+    int *cpus;
+    apr_size_t ncpus;
+    apr_size_t cpus_max;
+    apr_size_t cpu_next;
+    int affinity_flags;
+    int flags;
+    struct ws_deque *ws_deques;
+    apr_size_t ws_ndeques;
+    volatile apr_uint32_t ws_sleepers;
+    apr_stats_histogram_t *volatile stats_wait;
+    apr_stats_histogram_t *volatile stats_run;
 };
 
+#if APR_HAS_THREAD_LOCAL
+/* The work-stealing worker running on this thread, if any */
+static APR_THREAD_LOCAL struct apr_thread_list_elt *ws_current = NULL;
+#endif
+
+/* Owner of a worker looking for its next task, which may belong to anyone */
+static char ws_taking;
+
+static void queue_task(apr_thread_pool_t *me, apr_thread_pool_task_t *t,
+                       int push);
+static void *APR_THREAD_FUNC thread_pool_func(apr_thread_t * t, void *param);
+
+/*
+ * A task counts its latch down once, when it has run or has been dropped.
+ */
+static void task_done(apr_thread_pool_task_t *t)
+{
+    if (t->latch) {
+        apr_thread_pool_latch_done(t->latch);
+    }
+}
+
+/*
+ * Run a task, accounting for its queue wait and run time if asked to.
+ */
+static void task_run(apr_thread_pool_t *me, apr_thread_t *t,
+                     apr_thread_pool_task_t *task)
+{
+    apr_stats_histogram_t *wait = me->stats_wait, *run = me->stats_run;
+    apr_time_t start = 0;
+
+    if (wait || run) {
+        start = apr_time_now();
+        if (wait && task->queued) {
+            apr_stats_histogram_record(wait, start > task->queued
+                                             ? start - task->queued : 0);
+        }
+    }
+
+    apr_thread_data_set(task, "apr_thread_pool_task", NULL, t);
+    task->func(t, task->param);
+
+    if (run) {
+        apr_time_t end = apr_time_now();
+        apr_stats_histogram_record(run, end > start ? end - start : 0);
+    }
+}
+
+/*
+ * Wake up as many idle threads as there are new tasks, at most.
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static void wake_idle(apr_thread_pool_t *me, apr_size_t n)
+{
+    if (n >= me->idle_cnt) {
+        apr_thread_cond_broadcast(me->more_work);
+    }
+    else {
+        while (n--) {
+            apr_thread_cond_signal(me->more_work);
+        }
+    }
+}
+
+static int tw_ctz(apr_uint64_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+static void tw_init(struct timer_wheel *tw, apr_time_t now)
+{
+    int level, idx;
+
+    tw->now = TW_TICK(now);
+    for (level = 0; level < TW_LEVELS; ++level) {
+        tw->used[level] = 0;
+        for (idx = 0; idx < TW_SLOTS; ++idx) {
+            APR_RING_INIT(&tw->slot[level][idx], apr_thread_pool_task, link);
+        }
+    }
+    APR_RING_INIT(&tw->due, apr_thread_pool_task, link);
+}
+
+/*
+ * Put a task in the slot of its tick, at the level whose span covers the
+ * distance from now.
+ */
+static void tw_insert(struct timer_wheel *tw, apr_thread_pool_task_t *t)
+{
+    apr_uint64_t expires = TW_TICK(t->dispatch.time);
+    apr_uint64_t delta;
+    int level = 0, idx;
+
+    if (expires < tw->now) {
+        APR_RING_INSERT_TAIL(&tw->due, t, apr_thread_pool_task, link);
+        return;
+    }
+    delta = expires - tw->now;
+    if (delta >> (TW_BITS * TW_LEVELS)) {
+        delta = ((apr_uint64_t)1 << (TW_BITS * TW_LEVELS)) - 1;
+        expires = tw->now + delta;
+    }
+    while (delta >> (TW_BITS * (level + 1))) {
+        ++level;
+    }
+    idx = (int)(expires >> (TW_BITS * level)) & TW_MASK;
+    APR_RING_INSERT_TAIL(&tw->slot[level][idx], t, apr_thread_pool_task, link);
+    tw->used[level] |= (apr_uint64_t)1 << idx;
+}
+
+/*
+ * The first tick from now with something to do: a level 0 slot to expire,
+ * or a higher level slot to cascade down.  Returns ~0 if the wheel is empty.
+ */
+static apr_uint64_t tw_next_tick(struct timer_wheel *tw)
+{
+    apr_uint64_t next = ~(apr_uint64_t)0;
+    int level;
+
+    for (level = 0; level < TW_LEVELS; ++level) {
+        int shift = TW_BITS * level, first;
+        apr_uint64_t used = tw->used[level], k, tick;
+
+        if (!used) {
+            continue;
+        }
+        /* Higher level slots are cascaded when their period begins, so
+         * the current one is already behind us.
+         */
+        k = (tw->now >> shift) + (level ? 1 : 0);
+        first = (int)k & TW_MASK;
+        if (first) {
+            used = (used >> first) | (used << (TW_SLOTS - first));
+        }
+        tick = (k + tw_ctz(used)) << shift;
+        if (tick < next) {
+            next = tick;
+        }
+    }
+    return next;
+}
+
+static void tw_cascade(struct timer_wheel *tw, int level, int idx)
+{
+    struct apr_thread_pool_tasks tasks;
+    apr_thread_pool_task_t *t;
+
+    if (!(tw->used[level] & ((apr_uint64_t)1 << idx))) {
+        return;
+    }
+    APR_RING_INIT(&tasks, apr_thread_pool_task, link);
+    APR_RING_CONCAT(&tasks, &tw->slot[level][idx], apr_thread_pool_task, link);
+    tw->used[level] &= ~((apr_uint64_t)1 << idx);
+    while (!APR_RING_EMPTY(&tasks, apr_thread_pool_task, link)) {
+        t = APR_RING_FIRST(&tasks);
+        APR_RING_REMOVE(t, link);
+        tw_insert(tw, t);
+    }
+}
+
+/*
+ * Move the tasks of a level 0 slot to the due list, all of them or only
+ * those whose time has come.
+ */
+static void tw_expire(struct timer_wheel *tw, int idx, apr_time_t now,
+                      int all)
+{
+    struct apr_thread_pool_tasks *slot = &tw->slot[0][idx];
+    apr_thread_pool_task_t *t, *next;
+
+    if (all) {
+        APR_RING_CONCAT(&tw->due, slot, apr_thread_pool_task, link);
+    }
+    else {
+        t = APR_RING_FIRST(slot);
+        while (t != APR_RING_SENTINEL(slot, apr_thread_pool_task, link)) {
+            next = APR_RING_NEXT(t, link);
+            if (t->dispatch.time <= now) {
+                APR_RING_REMOVE(t, link);
+                APR_RING_INSERT_TAIL(&tw->due, t, apr_thread_pool_task, link);
+            }
+            t = next;
+        }
+    }
+    if (APR_RING_EMPTY(slot, apr_thread_pool_task, link)) {
+        tw->used[0] &= ~((apr_uint64_t)1 << idx);
+    }
+}
+
+/*
+ * Bring the wheel to the given time, jumping over the ticks with nothing
+ * to do, and collect all the tasks due by then at once.
+ */
+static void tw_advance(struct timer_wheel *tw, apr_time_t now)
+{
+    apr_uint64_t target = TW_TICK(now), tick;
+    int level;
+
+    for (;;) {
+        tick = tw_next_tick(tw);
+        if (tick > target) {
+            if (target > tw->now) {
+                tw->now = target;
+            }
+            return;
+        }
+        tw->now = tick;
+        for (level = 1; level < TW_LEVELS; ++level) {
+            if (tick & (((apr_uint64_t)1 << (TW_BITS * level)) - 1)) {
+                break;
+            }
+            tw_cascade(tw, level, (int)(tick >> (TW_BITS * level)) & TW_MASK);
+        }
+        tw_expire(tw, (int)tick & TW_MASK, now, tick < target);
+        if (tick == target) {
+            return;
+        }
+    }
+}
+
+/*
+ * Remove the tasks of the given owner (or all if NULL) from the wheel,
+ * returning them to the recycled list.
+ */
+static apr_size_t tw_remove(struct timer_wheel *tw, void *owner,
+                            struct apr_thread_pool_tasks *recycled)
+{
+    struct apr_thread_pool_tasks *slot;
+    apr_thread_pool_task_t *t, *next;
+    apr_size_t n = 0;
+    int level, idx;
+
+    for (level = 0; level <= TW_LEVELS; ++level) {
+        apr_uint64_t used = level < TW_LEVELS ? tw->used[level] : 1;
+        while (used) {
+            idx = tw_ctz(used);
+            used &= used - 1;
+            slot = level < TW_LEVELS ? &tw->slot[level][idx] : &tw->due;
+            t = APR_RING_FIRST(slot);
+            while (t != APR_RING_SENTINEL(slot, apr_thread_pool_task, link)) {
+                next = APR_RING_NEXT(t, link);
+                if (!owner || t->owner == owner) {
+                    APR_RING_REMOVE(t, link);
+                    task_done(t);
+                    APR_RING_INSERT_TAIL(recycled, t, apr_thread_pool_task,
+                                         link);
+                    ++n;
+                }
+                t = next;
+            }
+            if (level < TW_LEVELS
+                    && APR_RING_EMPTY(slot, apr_thread_pool_task, link)) {
+                tw->used[level] &= ~((apr_uint64_t)1 << idx);
+            }
+        }
+    }
+    return n;
+}
+
 static apr_status_t thread_pool_construct(apr_thread_pool_t **tp,
                                           apr_size_t init_threads,
                                           apr_size_t max_threads,
+                                          int flags,
                                           apr_pool_t *pool)
 {
     apr_status_t rv;
     apr_thread_pool_t *me;
+    int i;
 
     me = *tp = apr_pcalloc(pool, sizeof(apr_thread_pool_t));
     me->thd_max = max_threads;
     me->idle_max = init_threads;
     me->threshold = init_threads / 2;
+    me->flags = flags;
 
     /* This pool will be used by different threads. As we cannot ensure that
      * our caller won't use the pool without acquiring the mutex, we must
@@ -130,16 +499,18 @@ static apr_status_t thread_pool_construct(apr_thread_pool_t **tp,
         apr_thread_mutex_destroy(me->lock);
         return rv;
     }
-    me->tasks = apr_palloc(me->pool, sizeof(*me->tasks));
+    me->tasks = apr_palloc(me->pool, TASK_PRIORITIES * sizeof(*me->tasks));
     if (!me->tasks) {
         goto CATCH_ENOMEM;
     }
-    APR_RING_INIT(me->tasks, apr_thread_pool_task, link);
-    me->scheduled_tasks = apr_palloc(me->pool, sizeof(*me->scheduled_tasks));
-    if (!me->scheduled_tasks) {
+    for (i = 0; i < TASK_PRIORITIES; ++i) {
+        APR_RING_INIT(&me->tasks[i], apr_thread_pool_task, link);
+    }
+    me->timers = apr_palloc(me->pool, sizeof(*me->timers));
+    if (!me->timers) {
         goto CATCH_ENOMEM;
     }
-    APR_RING_INIT(me->scheduled_tasks, apr_thread_pool_task, link);
+    tw_init(me->timers, apr_time_now());
     me->recycled_tasks = apr_palloc(me->pool, sizeof(*me->recycled_tasks));
     if (!me->recycled_tasks) {
         goto CATCH_ENOMEM;
@@ -165,6 +536,17 @@ static apr_status_t thread_pool_construct(apr_thread_pool_t **tp,
         goto CATCH_ENOMEM;
     }
     APR_RING_INIT(me->recycled_thds, apr_thread_list_elt, link);
+    if (flags & APR_THREAD_POOL_WORK_STEALING) {
+        /* One deque per thread up to the maximum given here; threads
+         * added later by apr_thread_pool_thread_max_set() only steal.
+         */
+        me->ws_ndeques = max_threads ? max_threads : 1;
+        me->ws_deques = apr_pcalloc(me->pool,
+                                    me->ws_ndeques * sizeof(*me->ws_deques));
+        if (!me->ws_deques) {
+            goto CATCH_ENOMEM;
+        }
+    }
     goto FINAL_EXIT;
   CATCH_ENOMEM:
     rv = APR_ENOMEM;
@@ -177,24 +559,87 @@ static apr_status_t thread_pool_construct(apr_thread_pool_t **tp,
 }
 
 /*
+ * Remove a queued task, clearing its priority from its lane if the last.
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static void unlink_task(apr_thread_pool_t *me, apr_thread_pool_task_t *task)
+{
+    APR_RING_REMOVE(task, link);
+    if (APR_RING_EMPTY(&me->tasks[task->dispatch.priority],
+                       apr_thread_pool_task, link)) {
+        me->lane_used[TASK_PRIORITY_SEG(task)] &= ~TASK_PRIORITY_BIT(task);
+    }
+}
+
+/* The highest bit set in x, which must not be zero */
+static int lane_msb(apr_uint64_t x)
+{
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(x);
+#else
+    int n = 63;
+    while (!(x >> n)) {
+        --n;
+    }
+    return n;
+#endif
+}
+
+/*
+ * Choose the lane of the next task: the highest non-empty one, unless a
+ * lower one has been passed over starve_limit times already.
  * NOTE: This function is not thread safe by itself. Caller should hold the lock
  */
+static int pick_lane(apr_thread_pool_t *me)
+{
+    int seg, lane = -1;
+
+    for (seg = TASK_PRIORITY_SEGS - 1; seg >= 0; --seg) {
+        if (!me->lane_used[seg]) {
+            continue;
+        }
+        if (lane < 0) {
+            lane = seg;
+        }
+        else if (me->starve_limit
+                 && me->lane_skips[seg] >= me->starve_limit) {
+            lane = seg;
+            break;
+        }
+    }
+    for (seg = 0; seg < TASK_PRIORITY_SEGS; ++seg) {
+        if (seg != lane && me->lane_used[seg]) {
+            ++me->lane_skips[seg];
+        }
+        else {
+            me->lane_skips[seg] = 0;
+        }
+    }
+    return lane;
+}
+
 static apr_thread_pool_task_t *pop_task(apr_thread_pool_t * me)
 {
     apr_thread_pool_task_t *task = NULL;
-    int seg;
+    int seg, prio;
 
     /* check for scheduled tasks */
     if (me->scheduled_task_cnt > 0) {
-        task = APR_RING_FIRST(me->scheduled_tasks);
-        assert(task != NULL);
-        assert(task !=
-               APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                                 link));
+        struct timer_wheel *tw = me->timers;
+
+        if (APR_RING_EMPTY(&tw->due, apr_thread_pool_task, link)) {
+            tw_advance(tw, apr_time_now());
+        }
         /* if it's time */
-        if (task->dispatch.time <= apr_time_now()) {
+        if (!APR_RING_EMPTY(&tw->due, apr_thread_pool_task, link)) {
+            task = APR_RING_FIRST(&tw->due);
             --me->scheduled_task_cnt;
             APR_RING_REMOVE(task, link);
+            /* Expired together, let the idle threads share them */
+            if (me->idle_cnt
+                    && !APR_RING_EMPTY(&tw->due, apr_thread_pool_task, link)) {
+                apr_thread_cond_signal(me->more_work);
+            }
             return task;
         }
     }
@@ -203,60 +648,676 @@ static apr_thread_pool_task_t *pop_task(apr_thread_pool_t * me)
         return NULL;
     }
 
-    task = APR_RING_FIRST(me->tasks);
-    assert(task != NULL);
-    assert(task != APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link));
+    seg = pick_lane(me);
+    assert(seg >= 0);
+    prio = seg * TASK_LANE_PRIOS + lane_msb(me->lane_used[seg]);
+    task = APR_RING_FIRST(&me->tasks[prio]);
+    assert(task != APR_RING_SENTINEL(&me->tasks[prio], apr_thread_pool_task,
+                                     link));
     --me->task_cnt;
-    seg = TASK_PRIORITY_SEG(task);
-    if (task == me->task_idx[seg]) {
-        me->task_idx[seg] = APR_RING_NEXT(task, link);
-        if (me->task_idx[seg] == APR_RING_SENTINEL(me->tasks,
-                                                   apr_thread_pool_task, link)
-            || TASK_PRIORITY_SEG(me->task_idx[seg]) != seg) {
-            me->task_idx[seg] = NULL;
+    unlink_task(me, task);
+    return task;
+}
+
+static apr_interval_time_t waiting_time(apr_thread_pool_t * me)
+{
+    struct timer_wheel *tw = me->timers;
+    apr_thread_pool_task_t *task;
+    apr_uint64_t tick;
+    apr_time_t when;
+    int idx;
+
+    if (!APR_RING_EMPTY(&tw->due, apr_thread_pool_task, link)) {
+        return 0;
+    }
+    tick = tw_next_tick(tw);
+    when = (apr_time_t)(tick << TW_TICK_SHIFT);
+
+    /* Unless a cascade is due then, wake up for the earliest task of the
+     * slot rather than at the start of its tick.
+     */
+    idx = (int)tick & TW_MASK;
+    if (idx && tick - tw->now < TW_SLOTS
+            && (tw->used[0] & ((apr_uint64_t)1 << idx))) {
+        struct apr_thread_pool_tasks *slot = &tw->slot[0][idx];
+        when = APR_RING_FIRST(slot)->dispatch.time;
+        for (task = APR_RING_FIRST(slot);
+             task != APR_RING_SENTINEL(slot, apr_thread_pool_task, link);
+             task = APR_RING_NEXT(task, link)) {
+            if (task->dispatch.time < when) {
+                when = task->dispatch.time;
+            }
+        }
+    }
+    when -= apr_time_now();
+    return when > 0 ? when : 0;
+}
+
+/*
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static struct apr_thread_list_elt *elt_new(apr_thread_pool_t * me,
+                                           apr_thread_t * t)
+{
+    struct apr_thread_list_elt *elt;
+
+    if (APR_RING_EMPTY(me->recycled_thds, apr_thread_list_elt, link)) {
+        elt = apr_palloc(me->pool, sizeof(*elt));
+        if (NULL == elt) {
+            return NULL;
+        }
+    }
+    else {
+        elt = APR_RING_FIRST(me->recycled_thds);
+        APR_RING_REMOVE(elt, link);
+    }
+
+    APR_RING_ELEM_INIT(elt, link);
+    elt->thd = t;
+    elt->current_owner = NULL;
+    elt->signal_work_done = 0;
+    elt->state = TH_RUN;
+    elt->deque = NULL;
+    APR_RING_INIT(&elt->cache, apr_thread_pool_task, link);
+    elt->ncached = 0;
+    elt->tasks_run = 0;
+    elt->tick = 0;
+    elt->seed = (apr_uint32_t)(apr_uintptr_t)elt | 1;
+    return elt;
+}
+
+/*
+ * Move a thread to the CPUs of the pool, or let it run anywhere if none.
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static apr_status_t thread_affinity_apply(apr_thread_pool_t *me,
+                                          struct apr_thread_list_elt *elt)
+{
+#ifdef THREAD_POOL_AFFINITY
+    apr_os_thread_t *os_thread;
+    cpu_set_t set;
+    apr_size_t i;
+    int rc;
+
+    CPU_ZERO(&set);
+    if (!me->ncpus) {
+        for (i = 0; i < CPU_SETSIZE; ++i) {
+            CPU_SET(i, &set);
+        }
+    }
+    else if (me->affinity_flags & APR_THREAD_POOL_AFFINITY_SPREAD) {
+        CPU_SET(me->cpus[me->cpu_next++ % me->ncpus], &set);
+    }
+    else {
+        for (i = 0; i < me->ncpus; ++i) {
+            CPU_SET(me->cpus[i], &set);
+        }
+    }
+
+    rc = apr_os_thread_get(&os_thread, elt->thd);
+    if (APR_SUCCESS != rc) {
+        return rc;
+    }
+    rc = pthread_setaffinity_np(*os_thread, sizeof(set), &set);
+    return rc ? APR_FROM_OS_ERROR(rc) : APR_SUCCESS;
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
+/*
+ * Work-stealing mode.
+ *
+ * The deque operations use the sequentially consistent apr_atomic
+ * functions, which provide the store-load ordering Chase-Lev needs between
+ * the owner's update of bottom and its read of top.  Likewise a worker
+ * going to sleep increments ws_sleepers before looking for work a last
+ * time, while a worker pushing to its deque reads ws_sleepers after the
+ * push, so that one of them always sees the other.
+ */
+static int ws_push(struct ws_deque *dq, apr_thread_pool_task_t *task)
+{
+    apr_uint32_t b = dq->bottom;
+    apr_uint32_t t = apr_atomic_read32(&dq->top);
+
+    if (b - t >= WS_DEQUE_SIZE) {
+        return 0;
+    }
+    dq->buf[b & WS_DEQUE_MASK] = task;
+    apr_atomic_set32(&dq->bottom, b + 1);
+    return 1;
+}
+
+static apr_thread_pool_task_t *ws_take(struct ws_deque *dq)
+{
+    apr_thread_pool_task_t *task;
+    apr_uint32_t b = dq->bottom - 1;
+    apr_uint32_t t;
+
+    apr_atomic_set32(&dq->bottom, b);
+    t = apr_atomic_read32(&dq->top);
+    if ((apr_int32_t)(b - t) < 0) {
+        apr_atomic_set32(&dq->bottom, b + 1);
+        return NULL;
+    }
+    task = dq->buf[b & WS_DEQUE_MASK];
+    if (b == t) {
+        /* Last one, race with the stealers */
+        if (apr_atomic_cas32(&dq->top, t + 1, t) != t) {
+            task = NULL;
+        }
+        apr_atomic_set32(&dq->bottom, b + 1);
+    }
+    return task;
+}
+
+static apr_thread_pool_task_t *ws_steal(struct ws_deque *dq, int *retry)
+{
+    apr_thread_pool_task_t *task;
+    apr_uint32_t t = apr_atomic_read32(&dq->top);
+    apr_uint32_t b = apr_atomic_read32(&dq->bottom);
+
+    if ((apr_int32_t)(b - t) <= 0) {
+        return NULL;
+    }
+    task = dq->buf[t & WS_DEQUE_MASK];
+    if (apr_atomic_cas32(&dq->top, t + 1, t) != t) {
+        *retry = 1;
+        return NULL;
+    }
+    return task;
+}
+
+static apr_size_t ws_deque_size(struct ws_deque *dq)
+{
+    apr_int32_t n = (apr_int32_t)(apr_atomic_read32(&dq->bottom)
+                                  - apr_atomic_read32(&dq->top));
+    return n > 0 ? n : 0;
+}
+
+static void *ws_load_ptr(void *volatile *mem)
+{
+    return apr_atomic_casptr(mem, NULL, NULL);
+}
+
+/*
+ * Publish the owner of the task a worker runs, waking up a thread waiting
+ * in apr_thread_pool_tasks_cancel() for the previous one.
+ */
+static void ws_owner_set(apr_thread_pool_t *me,
+                         struct apr_thread_list_elt *elt, void *owner)
+{
+    apr_atomic_xchgptr(&elt->current_owner, owner);
+    if (apr_atomic_read32(&elt->signal_work_done)) {
+        apr_thread_mutex_lock(me->lock);
+        apr_pool_owner_set(me->pool, 0);
+        elt->signal_work_done = 0;
+        apr_thread_cond_broadcast(me->work_done);
+        apr_thread_mutex_unlock(me->lock);
+    }
+}
+
+static apr_thread_pool_task_t *ws_task_new(apr_thread_pool_t *me,
+                                           struct apr_thread_list_elt *elt,
+                                           apr_thread_start_t func,
+                                           void *param, apr_byte_t priority,
+                                           void *owner)
+{
+    apr_thread_pool_task_t *t;
+
+    if (APR_RING_EMPTY(&elt->cache, apr_thread_pool_task, link)) {
+        int i;
+
+        apr_thread_mutex_lock(me->lock);
+        apr_pool_owner_set(me->pool, 0);
+        for (i = 0; i < WS_CACHE_BATCH; ++i) {
+            if (APR_RING_EMPTY(me->recycled_tasks, apr_thread_pool_task,
+                               link)) {
+                t = apr_palloc(me->pool, sizeof(*t));
+                if (NULL == t) {
+                    break;
+                }
+            }
+            else {
+                t = APR_RING_FIRST(me->recycled_tasks);
+                APR_RING_REMOVE(t, link);
+            }
+            APR_RING_INSERT_TAIL(&elt->cache, t, apr_thread_pool_task, link);
+            ++elt->ncached;
+        }
+        apr_thread_mutex_unlock(me->lock);
+        if (!i) {
+            return NULL;
+        }
+    }
+
+    t = APR_RING_FIRST(&elt->cache);
+    APR_RING_REMOVE(t, link);
+    --elt->ncached;
+    APR_RING_ELEM_INIT(t, link);
+
+    t->func = func;
+    t->param = param;
+    t->owner = owner;
+    t->latch = NULL;
+    t->queued = me->stats_wait ? apr_time_now() : 0;
+    t->dispatch.priority = priority;
+    return t;
+}
+
+static void ws_task_free(apr_thread_pool_t *me,
+                         struct apr_thread_list_elt *elt,
+                         apr_thread_pool_task_t *t)
+{
+    APR_RING_INSERT_TAIL(&elt->cache, t, apr_thread_pool_task, link);
+    if (++elt->ncached > WS_CACHE_MAX) {
+        apr_thread_mutex_lock(me->lock);
+        apr_pool_owner_set(me->pool, 0);
+        while (elt->ncached > WS_CACHE_MAX / 2) {
+            t = APR_RING_FIRST(&elt->cache);
+            APR_RING_REMOVE(t, link);
+            APR_RING_INSERT_TAIL(me->recycled_tasks, t,
+                                 apr_thread_pool_task, link);
+            --elt->ncached;
+        }
+        apr_thread_mutex_unlock(me->lock);
+    }
+}
+
+/*
+ * Take a task from the shared queue, or a due scheduled task if asked to.
+ */
+static apr_thread_pool_task_t *ws_global_task(apr_thread_pool_t *me,
+                                              int scheduled)
+{
+    apr_thread_pool_task_t *task;
+
+    if (!me->task_cnt && !(scheduled && me->scheduled_task_cnt)) {
+        return NULL;
+    }
+    apr_thread_mutex_lock(me->lock);
+    apr_pool_owner_set(me->pool, 0);
+    task = pop_task(me);
+    apr_thread_mutex_unlock(me->lock);
+    return task;
+}
+
+static apr_thread_pool_task_t *ws_steal_any(apr_thread_pool_t *me,
+                                            struct apr_thread_list_elt *elt)
+{
+    apr_thread_pool_task_t *task;
+    apr_size_t i, start;
+    int retry;
+
+    elt->seed ^= elt->seed << 13;
+    elt->seed ^= elt->seed >> 17;
+    elt->seed ^= elt->seed << 5;
+    start = elt->seed % me->ws_ndeques;
+    do {
+        retry = 0;
+        for (i = 0; i < me->ws_ndeques; ++i) {
+            struct ws_deque *dq = &me->ws_deques[(start + i) % me->ws_ndeques];
+            if (dq == elt->deque) {
+                continue;
+            }
+            task = ws_steal(dq, &retry);
+            if (task) {
+                return task;
+            }
+        }
+    } while (retry);
+    return NULL;
+}
+
+/*
+ * Find the next task of a worker: its own deque first (with a regular look
+ * at the shared queue so that it can't be starved), then the shared queue,
+ * then the other deques.
+ */
+static apr_thread_pool_task_t *ws_next_task(apr_thread_pool_t *me,
+                                            struct apr_thread_list_elt *elt)
+{
+    apr_thread_pool_task_t *task = NULL;
+
+    ws_owner_set(me, elt, &ws_taking);
+    if (++elt->tick % WS_GLOBAL_INTERVAL == 0) {
+        task = ws_global_task(me, 1);
+    }
+    if (!task && elt->deque) {
+        task = ws_take(elt->deque);
+    }
+    if (!task) {
+        task = ws_global_task(me, 0);
+    }
+    if (!task) {
+        task = ws_steal_any(me, elt);
+    }
+    if (!task) {
+        task = ws_global_task(me, 1);
+    }
+    ws_owner_set(me, elt, task ? task->owner : NULL);
+    return task;
+}
+
+/*
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static int ws_has_work(apr_thread_pool_t *me)
+{
+    apr_size_t i;
+
+    if (me->task_cnt) {
+        return 1;
+    }
+    for (i = 0; i < me->ws_ndeques; ++i) {
+        if (ws_deque_size(&me->ws_deques[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Steal all the tasks of the deques, dropping those of the given owner (or
+ * all if NULL) and moving the others to the shared queue.
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static void ws_remove_tasks(apr_thread_pool_t *me, void *owner)
+{
+    struct apr_thread_pool_tasks kept;
+    apr_thread_pool_task_t *task;
+    apr_size_t i;
+    int retry;
+
+    APR_RING_INIT(&kept, apr_thread_pool_task, link);
+    for (i = 0; i < me->ws_ndeques; ++i) {
+        do {
+            retry = 0;
+            while ((task = ws_steal(&me->ws_deques[i], &retry)) != NULL) {
+                if (!owner || task->owner == owner) {
+                    task_done(task);
+                    APR_RING_INSERT_TAIL(me->recycled_tasks, task,
+                                         apr_thread_pool_task, link);
+                }
+                else {
+                    APR_RING_INSERT_TAIL(&kept, task,
+                                         apr_thread_pool_task, link);
+                }
+            }
+        } while (retry);
+    }
+    if (!APR_RING_EMPTY(&kept, apr_thread_pool_task, link)) {
+        do {
+            task = APR_RING_FIRST(&kept);
+            APR_RING_REMOVE(task, link);
+            queue_task(me, task, 1);
+        } while (!APR_RING_EMPTY(&kept, apr_thread_pool_task, link));
+        apr_thread_cond_broadcast(me->more_work);
+    }
+}
+
+/*
+ * The worker of the calling thread, if it is one of ours and has a deque.
+ */
+static struct apr_thread_list_elt *ws_worker(apr_thread_pool_t *me)
+{
+#if APR_HAS_THREAD_LOCAL
+    struct apr_thread_list_elt *elt = ws_current;
+
+    if (elt && elt->deque && elt->deque->owner == elt
+            && elt->deque >= me->ws_deques
+            && elt->deque < me->ws_deques + me->ws_ndeques) {
+        return elt;
+    }
+#endif
+    return NULL;
+}
+
+/*
+ * Let the sleeping threads know about n tasks pushed to the deque of the
+ * worker, or add a thread if the deque is over the threshold.
+ */
+static void ws_wake(apr_thread_pool_t *me, struct apr_thread_list_elt *elt,
+                    apr_size_t n)
+{
+    apr_thread_t *thd;
+
+    if (apr_atomic_read32(&me->ws_sleepers)) {
+        apr_thread_mutex_lock(me->lock);
+        apr_pool_owner_set(me->pool, 0);
+        wake_idle(me, n);
+        apr_thread_mutex_unlock(me->lock);
+    }
+    else if (me->thd_cnt < me->thd_max
+             && ws_deque_size(elt->deque) > me->threshold) {
+        apr_thread_mutex_lock(me->lock);
+        apr_pool_owner_set(me->pool, 0);
+        if (me->thd_cnt < me->thd_max && !me->idle_cnt) {
+            if (APR_SUCCESS == apr_thread_create(&thd, NULL,
+                                                 thread_pool_func, me,
+                                                 me->pool)) {
+                ++me->thd_cnt;
+                if (me->thd_cnt > me->thd_high)
+                    me->thd_high = me->thd_cnt;
+            }
+        }
+        apr_thread_mutex_unlock(me->lock);
+    }
+}
+
+/*
+ * Push a task to the deque of the calling worker, if it is one of ours.
+ */
+static apr_status_t ws_add_task(apr_thread_pool_t *me,
+                                apr_thread_start_t func, void *param,
+                                apr_byte_t priority, void *owner)
+{
+    struct apr_thread_list_elt *elt = ws_worker(me);
+    apr_thread_pool_task_t *t;
+
+    if (!elt) {
+        return APR_EAGAIN;
+    }
+    if (me->terminated) {
+        return APR_NOTFOUND;
+    }
+
+    t = ws_task_new(me, elt, func, param, priority, owner);
+    if (NULL == t) {
+        return APR_ENOMEM;
+    }
+    if (!ws_push(elt->deque, t)) {
+        ws_task_free(me, elt, t);
+        return APR_EAGAIN;
+    }
+
+    ws_wake(me, elt, 1);
+    return APR_SUCCESS;
+}
+
+/*
+ * Push as many tasks of a batch as possible to the deque of the calling
+ * worker, returning how many were.
+ */
+static apr_size_t ws_add_batch(apr_thread_pool_t *me,
+                               const apr_thread_pool_task_desc_t *tasks,
+                               apr_size_t n, apr_thread_pool_latch_t *latch)
+{
+    struct apr_thread_list_elt *elt = ws_worker(me);
+    apr_thread_pool_task_t *t;
+    apr_size_t i;
+
+    if (!elt || me->terminated) {
+        return 0;
+    }
+
+    for (i = 0; i < n; ++i) {
+        t = ws_task_new(me, elt, tasks[i].func, tasks[i].param,
+                        tasks[i].priority, tasks[i].owner);
+        if (NULL == t) {
+            break;
+        }
+        t->latch = latch;
+        if (!ws_push(elt->deque, t)) {
+            ws_task_free(me, elt, t);
+            break;
+        }
+    }
+
+    if (i) {
+        ws_wake(me, elt, i);
+    }
+    return i;
+}
+
+/*
+ * The worker thread function of the work-stealing mode. It follows
+ * thread_pool_func(), but only takes the lock to sleep and to use the
+ * shared queue.
+ */
+static void *APR_THREAD_FUNC thread_pool_ws_func(apr_thread_t * t,
+                                                 void *param)
+{
+    apr_thread_pool_t *me = param;
+    apr_thread_pool_task_t *task = NULL;
+    apr_interval_time_t wait;
+    struct apr_thread_list_elt *elt;
+    apr_size_t i;
+
+    apr_thread_mutex_lock(me->lock);
+    apr_pool_owner_set(me->pool, 0);
+
+    elt = elt_new(me, t);
+    if (!elt) {
+        apr_thread_mutex_unlock(me->lock);
+        apr_thread_exit(t, APR_ENOMEM);
+    }
+    /* Don't inherit the affinity of the creating thread */
+    if (me->cpus) {
+        thread_affinity_apply(me, elt);
+    }
+    for (i = 0; i < me->ws_ndeques; ++i) {
+        if (!me->ws_deques[i].owner) {
+            me->ws_deques[i].owner = elt;
+            elt->deque = &me->ws_deques[i];
+            break;
+        }
+    }
+#if APR_HAS_THREAD_LOCAL
+    ws_current = elt;
+#endif
+
+    for (;;) {
+        /* Test if not new element, it is awakened from idle */
+        if (APR_RING_NEXT(elt, link) != elt) {
+            --me->idle_cnt;
+            APR_RING_REMOVE(elt, link);
+        }
+
+        if (elt->state != TH_STOP) {
+            ++me->busy_cnt;
+            APR_RING_INSERT_TAIL(me->busy_thds, elt,
+                                 apr_thread_list_elt, link);
+            apr_thread_mutex_unlock(me->lock);
+
+            while (elt->state != TH_STOP
+                   && (task = ws_next_task(me, elt)) != NULL) {
+                /* Run the task (or drop it if terminated already) */
+                if (!me->terminated) {
+                    task_run(me, t, task);
+                }
+                task_done(task);
+                ws_task_free(me, elt, task);
+                ++elt->tasks_run;
+                ws_owner_set(me, elt, NULL);
+            }
+
+            apr_thread_mutex_lock(me->lock);
+            apr_pool_owner_set(me->pool, 0);
+            APR_RING_REMOVE(elt, link);
+            --me->busy_cnt;
+        }
+        assert(NULL == elt->current_owner);
+        me->tasks_run += elt->tasks_run;
+        elt->tasks_run = 0;
+
+        /* thread should die? */
+        if (me->terminated
+                || elt->state != TH_RUN
+                || (me->idle_cnt >= me->idle_max
+                    && (me->idle_max || !me->scheduled_task_cnt)
+                    && !me->idle_wait)) {
+            if ((TH_PROBATION == elt->state) && me->idle_wait)
+                ++me->thd_timed_out;
+            break;
         }
-    }
-    APR_RING_REMOVE(task, link);
-    return task;
-}
 
-static apr_interval_time_t waiting_time(apr_thread_pool_t * me)
-{
-    apr_thread_pool_task_t *task = NULL;
+        /* busy thread become idle */
+        ++me->idle_cnt;
+        APR_RING_INSERT_TAIL(me->idle_thds, elt, apr_thread_list_elt, link);
 
-    task = APR_RING_FIRST(me->scheduled_tasks);
-    assert(task != NULL);
-    assert(task !=
-           APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                             link));
-    return task->dispatch.time - apr_time_now();
-}
+        /* Tasks pushed to a deque are only signaled to sleepers, so look
+         * for them once more after becoming one.
+         */
+        apr_atomic_inc32(&me->ws_sleepers);
+        if (!ws_has_work(me)) {
+            if (me->scheduled_task_cnt)
+                wait = waiting_time(me);
+            else if (me->idle_cnt > me->idle_max) {
+                wait = me->idle_wait;
+                elt->state = TH_PROBATION;
+            }
+            else
+                wait = -1;
 
-/*
- * NOTE: This function is not thread safe by itself. Caller should hold the lock
- */
-static struct apr_thread_list_elt *elt_new(apr_thread_pool_t * me,
-                                           apr_thread_t * t)
-{
-    struct apr_thread_list_elt *elt;
+            if (wait >= 0) {
+                apr_thread_cond_timedwait(me->more_work, me->lock, wait);
+            }
+            else {
+                apr_thread_cond_wait(me->more_work, me->lock);
+            }
+            apr_pool_owner_set(me->pool, 0);
+        }
+        apr_atomic_dec32(&me->ws_sleepers);
+    }
 
-    if (APR_RING_EMPTY(me->recycled_thds, apr_thread_list_elt, link)) {
-        elt = apr_palloc(me->pool, sizeof(*elt));
-        if (NULL == elt) {
-            return NULL;
+    /* Hand the tasks left in our deque over to the other threads, or drop
+     * them if terminated since none will run the queue anymore.
+     */
+    if (elt->deque) {
+        int moved = 0;
+        while ((task = ws_take(elt->deque)) != NULL) {
+            if (me->terminated) {
+                task_done(task);
+                APR_RING_INSERT_TAIL(me->recycled_tasks, task,
+                                     apr_thread_pool_task, link);
+                continue;
+            }
+            queue_task(me, task, 1);
+            moved = 1;
         }
+        if (moved) {
+            apr_thread_cond_signal(me->more_work);
+        }
+        elt->deque->owner = NULL;
+        elt->deque = NULL;
     }
-    else {
-        elt = APR_RING_FIRST(me->recycled_thds);
-        APR_RING_REMOVE(elt, link);
+    APR_RING_CONCAT(me->recycled_tasks, &elt->cache, apr_thread_pool_task,
+                    link);
+    elt->ncached = 0;
+#if APR_HAS_THREAD_LOCAL
+    ws_current = NULL;
+#endif
+
+    /* Dead thread, to be joined */
+    APR_RING_INSERT_TAIL(me->dead_thds, elt, apr_thread_list_elt, link);
+    if (--me->thd_cnt == 0 && me->terminated) {
+        apr_thread_cond_signal(me->all_done);
     }
+    apr_thread_mutex_unlock(me->lock);
 
-    APR_RING_ELEM_INIT(elt, link);
-    elt->thd = t;
-    elt->current_owner = NULL;
-    elt->signal_work_done = 0;
-    elt->state = TH_RUN;
-    return elt;
+    apr_thread_exit(t, APR_SUCCESS);
+    return NULL;                /* should not be here, safe net */
 }
 
 /*
@@ -274,6 +1335,10 @@ static void *APR_THREAD_FUNC thread_pool_func(apr_thread_t * t, void *param)
     apr_interval_time_t wait;
     struct apr_thread_list_elt *elt;
 
+    if (me->flags & APR_THREAD_POOL_WORK_STEALING) {
+        return thread_pool_ws_func(t, param);
+    }
+
     apr_thread_mutex_lock(me->lock);
     apr_pool_owner_set(me->pool, 0);
 
@@ -282,6 +1347,10 @@ static void *APR_THREAD_FUNC thread_pool_func(apr_thread_t * t, void *param)
         apr_thread_mutex_unlock(me->lock);
         apr_thread_exit(t, APR_ENOMEM);
     }
+    /* Don't inherit the affinity of the creating thread */
+    if (me->cpus) {
+        thread_affinity_apply(me, elt);
+    }
 
     for (;;) {
         /* Test if not new element, it is awakened from idle */
@@ -305,9 +1374,9 @@ static void *APR_THREAD_FUNC thread_pool_func(apr_thread_t * t, void *param)
 
                 /* Run the task (or drop it if terminated already) */
                 if (!me->terminated) {
-                    apr_thread_data_set(task, "apr_thread_pool_task", NULL, t);
-                    task->func(t, task->param);
+                    task_run(me, t, task);
                 }
+                task_done(task);
 
                 apr_thread_mutex_lock(me->lock);
                 apr_pool_owner_set(me->pool, 0);
@@ -420,6 +1489,15 @@ APR_DECLARE(apr_status_t) apr_thread_pool_create(apr_thread_pool_t ** me,
                                                  apr_size_t init_threads,
                                                  apr_size_t max_threads,
                                                  apr_pool_t * pool)
+{
+    return apr_thread_pool_create_ex(me, init_threads, max_threads, 0, pool);
+}
+
+APR_DECLARE(apr_status_t) apr_thread_pool_create_ex(apr_thread_pool_t ** me,
+                                                    apr_size_t init_threads,
+                                                    apr_size_t max_threads,
+                                                    int flags,
+                                                    apr_pool_t * pool)
 {
     apr_thread_t *t;
     apr_status_t rv = APR_SUCCESS;
@@ -427,7 +1505,7 @@ APR_DECLARE(apr_status_t) apr_thread_pool_create(apr_thread_pool_t ** me,
 
     *me = NULL;
 
-    rv = thread_pool_construct(&tp, init_threads, max_threads, pool);
+    rv = thread_pool_construct(&tp, init_threads, max_threads, flags, pool);
     if (APR_SUCCESS != rv)
         return rv;
     apr_pool_pre_cleanup_register(tp->pool, tp, thread_pool_cleanup);
@@ -488,67 +1566,30 @@ static apr_thread_pool_task_t *task_new(apr_thread_pool_t * me,
     t->func = func;
     t->param = param;
     t->owner = owner;
+    t->latch = NULL;
+    t->queued = 0;
     if (time > 0) {
         t->dispatch.time = apr_time_now() + time;
+        t->queued = t->dispatch.time;
     }
     else {
         t->dispatch.priority = priority;
     }
-    return t;
-}
-
-/*
- * Test it the task is the only one within the priority segment.
- * If it is not, return the first element with same or lower priority.
- * Otherwise, add the task into the queue and return NULL.
- *
- * NOTE: This function is not thread safe by itself. Caller should hold the lock
- */
-static apr_thread_pool_task_t *add_if_empty(apr_thread_pool_t * me,
-                                            apr_thread_pool_task_t * const t)
-{
-    int seg;
-    int next;
-    apr_thread_pool_task_t *t_next;
-
-    seg = TASK_PRIORITY_SEG(t);
-    if (me->task_idx[seg]) {
-        assert(APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link) !=
-               me->task_idx[seg]);
-        t_next = me->task_idx[seg];
-        while (t_next->dispatch.priority > t->dispatch.priority) {
-            t_next = APR_RING_NEXT(t_next, link);
-            if (APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link) ==
-                t_next) {
-                return t_next;
-            }
-        }
-        return t_next;
-    }
-
-    for (next = seg - 1; next >= 0; next--) {
-        if (me->task_idx[next]) {
-            APR_RING_INSERT_BEFORE(me->task_idx[next], t, link);
-            break;
-        }
-    }
-    if (0 > next) {
-        APR_RING_INSERT_TAIL(me->tasks, t, apr_thread_pool_task, link);
+    if (me->stats_wait && !t->queued) {
+        t->queued = apr_time_now();
     }
-    me->task_idx[seg] = t;
-    return NULL;
+    return t;
 }
 
 /*
-*   schedule a task to run in "time" microseconds. Find the spot in the ring where
-*   the time fits. Adjust the short_time so the thread wakes up when the time is reached.
+*   schedule a task to run in "time" microseconds. Put it in the timing wheel
+*   and signal a thread, which will recompute how long to wait.
 */
 static apr_status_t schedule_task(apr_thread_pool_t *me,
                                   apr_thread_start_t func, void *param,
                                   void *owner, apr_interval_time_t time)
 {
     apr_thread_pool_task_t *t;
-    apr_thread_pool_task_t *t_loc;
     apr_thread_t *thd;
     apr_status_t rv = APR_SUCCESS;
 
@@ -569,26 +1610,11 @@ static apr_status_t schedule_task(apr_thread_pool_t *me,
         apr_thread_mutex_unlock(me->lock);
         return APR_ENOMEM;
     }
-    t_loc = APR_RING_FIRST(me->scheduled_tasks);
-    while (NULL != t_loc) {
-        /* if the time is less than the entry insert ahead of it */
-        if (t->dispatch.time < t_loc->dispatch.time) {
-            ++me->scheduled_task_cnt;
-            APR_RING_INSERT_BEFORE(t_loc, t, link);
-            break;
-        }
-        else {
-            t_loc = APR_RING_NEXT(t_loc, link);
-            if (t_loc ==
-                APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                                  link)) {
-                ++me->scheduled_task_cnt;
-                APR_RING_INSERT_TAIL(me->scheduled_tasks, t,
-                                     apr_thread_pool_task, link);
-                break;
-            }
-        }
+    if (time <= 0) {
+        t->dispatch.time = apr_time_now();
     }
+    tw_insert(me->timers, t);
+    ++me->scheduled_task_cnt;
     /* there should be at least one thread for scheduled tasks */
     if (0 == me->thd_cnt) {
         rv = apr_thread_create(&thd, NULL, thread_pool_func, me, me->pool);
@@ -604,15 +1630,45 @@ static apr_status_t schedule_task(apr_thread_pool_t *me,
     return rv;
 }
 
+/*
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static void queue_task(apr_thread_pool_t *me, apr_thread_pool_task_t *t,
+                       int push)
+{
+    struct apr_thread_pool_tasks *fifo = &me->tasks[t->dispatch.priority];
+
+    /* pushed last of its priority, or first if topped */
+    if (push) {
+        APR_RING_INSERT_TAIL(fifo, t, apr_thread_pool_task, link);
+    }
+    else {
+        APR_RING_INSERT_HEAD(fifo, t, apr_thread_pool_task, link);
+    }
+    me->lane_used[TASK_PRIORITY_SEG(t)] |= TASK_PRIORITY_BIT(t);
+
+    me->task_cnt++;
+    if (me->task_cnt > me->tasks_high)
+        me->tasks_high = me->task_cnt;
+}
+
 static apr_status_t add_task(apr_thread_pool_t *me, apr_thread_start_t func,
                              void *param, apr_byte_t priority, int push,
                              void *owner)
 {
     apr_thread_pool_task_t *t;
-    apr_thread_pool_task_t *t_loc;
     apr_thread_t *thd;
     apr_status_t rv = APR_SUCCESS;
 
+    /* Tasks pushed by a worker go to its own deque */
+    if (me->flags & APR_THREAD_POOL_WORK_STEALING) {
+        rv = ws_add_task(me, func, param, priority, owner);
+        if (APR_EAGAIN != rv) {
+            return rv;
+        }
+        rv = APR_SUCCESS;
+    }
+
     apr_thread_mutex_lock(me->lock);
     apr_pool_owner_set(me->pool, 0);
 
@@ -631,28 +1687,8 @@ static apr_status_t add_task(apr_thread_pool_t *me, apr_thread_start_t func,
         return APR_ENOMEM;
     }
 
-    t_loc = add_if_empty(me, t);
-    if (NULL == t_loc) {
-        goto FINAL_EXIT;
-    }
-
-    if (push) {
-        while (APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link) !=
-               t_loc && t_loc->dispatch.priority >= t->dispatch.priority) {
-            t_loc = APR_RING_NEXT(t_loc, link);
-        }
-    }
-    APR_RING_INSERT_BEFORE(t_loc, t, link);
-    if (!push) {
-        if (t_loc == me->task_idx[TASK_PRIORITY_SEG(t)]) {
-            me->task_idx[TASK_PRIORITY_SEG(t)] = t;
-        }
-    }
+    queue_task(me, t, push);
 
-  FINAL_EXIT:
-    me->task_cnt++;
-    if (me->task_cnt > me->tasks_high)
-        me->tasks_high = me->task_cnt;
     if (0 == me->thd_cnt || (0 == me->idle_cnt && me->thd_cnt < me->thd_max &&
                              me->task_cnt > me->threshold)) {
         rv = apr_thread_create(&thd, NULL, thread_pool_func, me, me->pool);
@@ -678,6 +1714,87 @@ APR_DECLARE(apr_status_t) apr_thread_pool_push(apr_thread_pool_t *me,
     return add_task(me, func, param, priority, 1, owner);
 }
 
+APR_DECLARE(apr_status_t) apr_thread_pool_push_batch(apr_thread_pool_t *me,
+                                   const apr_thread_pool_task_desc_t *tasks,
+                                   apr_size_t n,
+                                   apr_thread_pool_latch_t *latch)
+{
+    apr_thread_pool_task_t *t;
+    apr_thread_t *thd;
+    apr_size_t i = 0, queued = 0, wake, created = 0;
+    apr_status_t rv = APR_SUCCESS;
+
+    if (!n) {
+        return APR_SUCCESS;
+    }
+    if (latch) {
+        apr_thread_pool_latch_add(latch, (apr_uint32_t)n);
+    }
+
+    /* Tasks pushed by a worker go to its own deque, while it has room */
+    if (me->flags & APR_THREAD_POOL_WORK_STEALING) {
+        i = ws_add_batch(me, tasks, n, latch);
+        if (i == n) {
+            return APR_SUCCESS;
+        }
+    }
+
+    apr_thread_mutex_lock(me->lock);
+    apr_pool_owner_set(me->pool, 0);
+
+    if (me->terminated) {
+        /* Let the caller know that we are done */
+        rv = APR_NOTFOUND;
+    }
+    else {
+        /* Maintain dead threads */
+        join_dead_threads(me);
+
+        for (; i < n; ++i) {
+            t = task_new(me, tasks[i].func, tasks[i].param,
+                         tasks[i].priority, tasks[i].owner, 0);
+            if (NULL == t) {
+                rv = APR_ENOMEM;
+                break;
+            }
+            t->latch = latch;
+            queue_task(me, t, 1);
+            ++queued;
+        }
+    }
+
+    /* Add threads for what the idle ones can't take */
+    wake = queued < me->idle_cnt ? queued : me->idle_cnt;
+    while (queued && me->thd_cnt < me->thd_max
+           && (0 == me->thd_cnt || (wake + created < queued
+                                    && me->task_cnt > me->threshold))) {
+        apr_status_t rc = apr_thread_create(&thd, NULL, thread_pool_func,
+                                            me, me->pool);
+        if (APR_SUCCESS != rc) {
+            if (APR_SUCCESS == rv) {
+                rv = rc;
+            }
+            break;
+        }
+        ++created;
+        ++me->thd_cnt;
+        if (me->thd_cnt > me->thd_high)
+            me->thd_high = me->thd_cnt;
+    }
+
+    if (queued) {
+        wake_idle(me, queued);
+    }
+    apr_thread_mutex_unlock(me->lock);
+
+    /* The tasks not queued won't count the latch down */
+    while (latch && i++ < n) {
+        apr_thread_pool_latch_done(latch);
+    }
+
+    return rv;
+}
+
 APR_DECLARE(apr_status_t) apr_thread_pool_schedule(apr_thread_pool_t *me,
                                                    apr_thread_start_t func,
                                                    void *param,
@@ -699,21 +1816,8 @@ APR_DECLARE(apr_status_t) apr_thread_pool_top(apr_thread_pool_t *me,
 static apr_status_t remove_scheduled_tasks(apr_thread_pool_t *me,
                                            void *owner)
 {
-    apr_thread_pool_task_t *t_loc;
-    apr_thread_pool_task_t *next;
-
-    t_loc = APR_RING_FIRST(me->scheduled_tasks);
-    while (t_loc !=
-           APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                             link)) {
-        next = APR_RING_NEXT(t_loc, link);
-        /* if this is the owner remove it */
-        if (!owner || t_loc->owner == owner) {
-            --me->scheduled_task_cnt;
-            APR_RING_REMOVE(t_loc, link);
-        }
-        t_loc = next;
-    }
+    me->scheduled_task_cnt -= tw_remove(me->timers, owner,
+                                        me->recycled_tasks);
     return APR_SUCCESS;
 }
 
@@ -723,24 +1827,25 @@ static apr_status_t remove_tasks(apr_thread_pool_t *me, void *owner)
     apr_thread_pool_task_t *next;
     int seg;
 
-    t_loc = APR_RING_FIRST(me->tasks);
-    while (t_loc != APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link)) {
-        next = APR_RING_NEXT(t_loc, link);
-        if (!owner || t_loc->owner == owner) {
-            --me->task_cnt;
-            seg = TASK_PRIORITY_SEG(t_loc);
-            if (t_loc == me->task_idx[seg]) {
-                me->task_idx[seg] = APR_RING_NEXT(t_loc, link);
-                if (me->task_idx[seg] == APR_RING_SENTINEL(me->tasks,
-                                                           apr_thread_pool_task,
-                                                           link)
-                    || TASK_PRIORITY_SEG(me->task_idx[seg]) != seg) {
-                    me->task_idx[seg] = NULL;
+    for (seg = 0; seg < TASK_PRIORITY_SEGS; ++seg) {
+        apr_uint64_t used = me->lane_used[seg];
+        while (used) {
+            int prio = seg * TASK_LANE_PRIOS + tw_ctz(used);
+            struct apr_thread_pool_tasks *fifo = &me->tasks[prio];
+
+            used &= used - 1;
+            t_loc = APR_RING_FIRST(fifo);
+            while (t_loc != APR_RING_SENTINEL(fifo, apr_thread_pool_task,
+                                              link)) {
+                next = APR_RING_NEXT(t_loc, link);
+                if (!owner || t_loc->owner == owner) {
+                    --me->task_cnt;
+                    unlink_task(me, t_loc);
+                    task_done(t_loc);
                 }
+                t_loc = next;
             }
-            APR_RING_REMOVE(t_loc, link);
         }
-        t_loc = next;
     }
     return APR_SUCCESS;
 }
@@ -752,10 +1857,14 @@ static void wait_on_busy_threads(apr_thread_pool_t *me, void *owner)
     apr_os_thread_t *os_thread;
 #endif
     struct apr_thread_list_elt *elt;
+    void *current;
 
     elt = APR_RING_FIRST(me->busy_thds);
     while (elt != APR_RING_SENTINEL(me->busy_thds, apr_thread_list_elt, link)) {
-        if (owner ? owner != elt->current_owner : !elt->current_owner) {
+        /* A work-stealing worker may be taking a task of the owner */
+        current = ws_load_ptr(&elt->current_owner);
+        if (current != &ws_taking
+                && (owner ? owner != current : !current)) {
             elt = APR_RING_NEXT(elt, link);
             continue;
         }
@@ -771,9 +1880,14 @@ static void wait_on_busy_threads(apr_thread_pool_t *me, void *owner)
 #endif
 #endif
 
-        elt->signal_work_done = 1;
-        apr_thread_cond_wait(me->work_done, me->lock);
-        apr_pool_owner_set(me->pool, 0);
+        /* Work-stealing workers change owners without the lock, they
+         * check the signal after doing so.
+         */
+        apr_atomic_set32(&elt->signal_work_done, 1);
+        if (ws_load_ptr(&elt->current_owner) == current) {
+            apr_thread_cond_wait(me->work_done, me->lock);
+            apr_pool_owner_set(me->pool, 0);
+        }
 
         /* Restart */
         elt = APR_RING_FIRST(me->busy_thds);
@@ -797,6 +1911,9 @@ APR_DECLARE(apr_status_t) apr_thread_pool_tasks_cancel(apr_thread_pool_t *me,
     if (me->scheduled_task_cnt > 0) {
         rv = remove_scheduled_tasks(me, owner);
     }
+    if (me->flags & APR_THREAD_POOL_WORK_STEALING) {
+        ws_remove_tasks(me, owner);
+    }
 
     wait_on_busy_threads(me, owner);
 
@@ -807,7 +1924,12 @@ APR_DECLARE(apr_status_t) apr_thread_pool_tasks_cancel(apr_thread_pool_t *me,
 
 APR_DECLARE(apr_size_t) apr_thread_pool_tasks_count(apr_thread_pool_t *me)
 {
-    return me->task_cnt;
+    apr_size_t n = me->task_cnt, i;
+
+    for (i = 0; i < me->ws_ndeques; ++i) {
+        n += ws_deque_size(&me->ws_deques[i]);
+    }
+    return n;
 }
 
 APR_DECLARE(apr_size_t)
@@ -997,6 +2119,130 @@ APR_DECLARE(apr_size_t) apr_thread_pool_threshold_set(apr_thread_pool_t *me,
     return ov;
 }
 
+APR_DECLARE(apr_size_t) apr_thread_pool_starvation_limit_set(
+                                                    apr_thread_pool_t *me,
+                                                    apr_size_t limit)
+{
+    apr_size_t ov;
+
+    ov = me->starve_limit;
+    me->starve_limit = limit;
+    return ov;
+}
+
+APR_DECLARE(apr_size_t) apr_thread_pool_starvation_limit_get(
+                                                    apr_thread_pool_t *me)
+{
+    return me->starve_limit;
+}
+
+APR_DECLARE(void) apr_thread_pool_stats_set(apr_thread_pool_t *me,
+                                struct apr_stats_histogram_t *queue_wait,
+                                struct apr_stats_histogram_t *run_time)
+{
+    me->stats_wait = queue_wait;
+    me->stats_run = run_time;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_pool_affinity_set(apr_thread_pool_t *me,
+                                                       const int *cpus,
+                                                       apr_size_t ncpus,
+                                                       int flags)
+{
+#ifdef THREAD_POOL_AFFINITY
+    struct apr_thread_list *lists[2];
+    struct apr_thread_list_elt *elt;
+    apr_status_t rv = APR_SUCCESS, rc;
+    apr_size_t i;
+
+    for (i = 0; i < ncpus; ++i) {
+        if (cpus[i] < 0 || cpus[i] >= CPU_SETSIZE) {
+            return APR_EINVAL;
+        }
+    }
+
+    apr_thread_mutex_lock(me->lock);
+    apr_pool_owner_set(me->pool, 0);
+
+    if (!me->cpus || ncpus > me->cpus_max) {
+        me->cpus_max = ncpus ? ncpus : 1;
+        me->cpus = apr_palloc(me->pool, me->cpus_max * sizeof(int));
+    }
+    for (i = 0; i < ncpus; ++i) {
+        me->cpus[i] = cpus[i];
+    }
+    me->ncpus = ncpus;
+    me->affinity_flags = flags;
+    me->cpu_next = 0;
+
+    lists[0] = me->busy_thds;
+    lists[1] = me->idle_thds;
+    for (i = 0; i < 2; ++i) {
+        for (elt = APR_RING_FIRST(lists[i]);
+             elt != APR_RING_SENTINEL(lists[i], apr_thread_list_elt, link);
+             elt = APR_RING_NEXT(elt, link)) {
+            rc = thread_affinity_apply(me, elt);
+            if (APR_SUCCESS == rv) {
+                rv = rc;
+            }
+        }
+    }
+
+    apr_thread_mutex_unlock(me->lock);
+    return rv;
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
+APR_DECLARE(apr_status_t) apr_thread_pool_numa_node_set(apr_thread_pool_t *me,
+                                                        int node, int flags)
+{
+#ifdef THREAD_POOL_AFFINITY
+    int cpus[CPU_SETSIZE];
+    apr_size_t n = 0;
+    char path[64], buf[4096], *str, *end;
+    long lo, hi;
+    FILE *f;
+
+    if (node < 0) {
+        return APR_EINVAL;
+    }
+    apr_snprintf(path, sizeof(path),
+                 "/sys/devices/system/node/node%d/cpulist", node);
+    f = fopen(path, "r");
+    if (!f) {
+        return errno == ENOENT ? APR_ENOENT : APR_FROM_OS_ERROR(errno);
+    }
+    str = fgets(buf, sizeof(buf), f);
+    fclose(f);
+
+    /* A list of ranges, like "0-3,8-11" */
+    while (str) {
+        lo = hi = strtol(str, &end, 10);
+        if (end == str) {
+            break;
+        }
+        if (*end == '-') {
+            str = end + 1;
+            hi = strtol(str, &end, 10);
+        }
+        for (; lo <= hi && lo < CPU_SETSIZE && n < CPU_SETSIZE; ++lo) {
+            cpus[n++] = (int)lo;
+        }
+        str = *end == ',' ? end + 1 : NULL;
+    }
+    if (!n) {
+        /* A node without CPUs */
+        return APR_EINVAL;
+    }
+
+    return apr_thread_pool_affinity_set(me, cpus, n, flags);
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
 APR_DECLARE(apr_status_t) apr_thread_pool_task_owner_get(apr_thread_t *thd,
                                                          void **owner)
 {
@@ -1019,6 +2265,94 @@ APR_DECLARE(apr_status_t) apr_thread_pool_task_owner_get(apr_thread_t *thd,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_thread_pool_latch_create(
+                                            apr_thread_pool_latch_t **latch,
+                                            apr_pool_t *pool)
+{
+    apr_thread_pool_latch_t *l;
+    apr_status_t rv;
+
+    l = apr_palloc(pool, sizeof(*l));
+    l->count = 0;
+    rv = apr_thread_mutex_create(&l->lock, APR_THREAD_MUTEX_DEFAULT, pool);
+    if (APR_SUCCESS != rv) {
+        return rv;
+    }
+    rv = apr_thread_cond_create(&l->zero, pool);
+    if (APR_SUCCESS != rv) {
+        return rv;
+    }
+
+    *latch = l;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_thread_pool_latch_add(apr_thread_pool_latch_t *latch,
+                                            apr_uint32_t n)
+{
+    apr_atomic_add32(&latch->count, n);
+}
+
+APR_DECLARE(void) apr_thread_pool_latch_done(apr_thread_pool_latch_t *latch)
+{
+    apr_uint32_t count = apr_atomic_read32(&latch->count);
+
+    /* Count down without locking unless this may be the last one */
+    while (count > 1) {
+        apr_uint32_t prev = apr_atomic_cas32(&latch->count, count - 1, count);
+        if (prev == count) {
+            return;
+        }
+        count = prev;
+    }
+
+    /* The count drops to zero under the lock only, so a waiter which saw
+     * it (and may free the latch) is not racing with us.
+     */
+    apr_thread_mutex_lock(latch->lock);
+    if (!apr_atomic_dec32(&latch->count)) {
+        apr_thread_cond_broadcast(latch->zero);
+    }
+    apr_thread_mutex_unlock(latch->lock);
+}
+
+APR_DECLARE(apr_uint32_t) apr_thread_pool_latch_count(
+                                            apr_thread_pool_latch_t *latch)
+{
+    return apr_atomic_read32(&latch->count);
+}
+
+APR_DECLARE(apr_status_t) apr_thread_pool_latch_wait(
+                                            apr_thread_pool_latch_t *latch)
+{
+    apr_thread_mutex_lock(latch->lock);
+    while (apr_atomic_read32(&latch->count)) {
+        apr_thread_cond_wait(latch->zero, latch->lock);
+    }
+    apr_thread_mutex_unlock(latch->lock);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_pool_latch_timedwait(
+                                            apr_thread_pool_latch_t *latch,
+                                            apr_interval_time_t timeout)
+{
+    apr_time_t deadline = apr_time_now() + timeout;
+    apr_status_t rv = APR_SUCCESS;
+
+    apr_thread_mutex_lock(latch->lock);
+    while (apr_atomic_read32(&latch->count)) {
+        timeout = deadline - apr_time_now();
+        if (timeout <= 0) {
+            rv = APR_TIMEUP;
+            break;
+        }
+        apr_thread_cond_timedwait(latch->zero, latch->lock, timeout);
+    }
+    apr_thread_mutex_unlock(latch->lock);
+    return rv;
+}
+
 #endif /* APR_HAS_THREADS */
 
 /* vim: set ts=4 sw=4 et cin tw=80: */